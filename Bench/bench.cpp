@@ -0,0 +1,285 @@
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <random>
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+#include <functional>
+#include <pthread.h>
+#include "../src/hpp_files/Graph.hpp"
+#include "../src/hpp_files/GraphGenerator.hpp"
+#include "../src/hpp_files/KruskalMST.hpp"
+#include "../src/hpp_files/MSTKernels.hpp"
+#include "../src/hpp_files/PrimMST.hpp"
+#include "../src/hpp_files/ThreadPool.hpp"
+#include "../src/hpp_files/Tree.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+// Microbenchmarks of the algorithm core: building a Graph, Kruskal, Prim, their kernels alone, and the
+// Tree queries the servers answer, on synthetic graphs of every model and size. Results go to stdout
+// as CSV or JSON lines, one per benchmark, model and size; progress goes to stderr.
+
+struct Options {
+    std::vector<GraphGenerator::Model> models = {GraphGenerator::ERDOS_RENYI, GraphGenerator::GRID,
+                                                 GraphGenerator::GEOMETRIC, GraphGenerator::RMAT,
+                                                 GraphGenerator::COMPLETE};
+    std::vector<size_t> sizes = {1000, 10000, 100000, 1000000, 10000000};  // Edges
+    double minTime = 0.2;    // Seconds measured per benchmark, at least
+    int apspLimit = 1024;    // Largest tree on which Floyd-Warshall and the path queries run, O(n^3)
+    size_t threads = 0;      // Pool for generation, Kruskal's sort and Floyd-Warshall; 0 runs them sequentially
+    uint64_t seed = 1;
+    bool json = false;
+};
+
+// Time per operation over the measured samples, in nanoseconds
+struct Measurement {
+    size_t samples;
+    size_t batch;  // Operations per sample
+    double median, min, mean;
+};
+
+// Keeps the compiler from dropping a computation whose result is otherwise unused
+template <typename T>
+inline void keep(const T& value) {
+    asm volatile("" : : "g"(&value) : "memory");
+}
+
+/**
+ * Runs `op` until at least `minTime` seconds and 3 samples were measured. Fast operations are
+ * timed in batches of about 100 microseconds, so the clock does not dominate.
+ */
+Measurement measure(double minTime, const std::function<void()>& op) {
+    Clock::time_point start = Clock::now();
+    op();  // Warms the caches and finds the batch size
+    double first = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+    size_t batch = static_cast<size_t>(std::clamp(1e5 / std::max(first, 1.0), 1.0, double(1 << 20)));
+
+    std::vector<double> perOp;
+    double elapsed = 0;
+    while (elapsed < minTime * 1e9 || perOp.size() < 3) {
+        start = Clock::now();
+        for (size_t i = 0; i < batch; ++i) op();
+        double nanos = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+        elapsed += nanos;
+        perOp.push_back(nanos / batch);
+    }
+    std::vector<double> sorted = perOp;
+    std::sort(sorted.begin(), sorted.end());
+    double sum = 0;
+    for (double value : perOp) sum += value;
+    return {perOp.size(), batch, sorted[sorted.size() / 2], sorted.front(), sum / perOp.size()};
+}
+
+/**
+ * Returns the number of vertices that gives a graph of the model about `edges` edges: an average
+ * degree of 8 for Erdős–Rényi and geometric graphs, 4 for grids, 16 for R-MAT as in Graph500.
+ */
+int verticesFor(GraphGenerator::Model model, size_t edges) {
+    switch (model) {
+        case GraphGenerator::ERDOS_RENYI:
+        case GraphGenerator::GEOMETRIC: return static_cast<int>(std::max<size_t>(edges / 4, 16));
+        case GraphGenerator::GRID: return static_cast<int>(std::max<size_t>(edges / 2, 16));
+        case GraphGenerator::RMAT: return static_cast<int>(std::max<size_t>(edges / 8, 16));
+        default: return static_cast<int>((1 + std::sqrt(1 + 8.0 * edges)) / 2);  // n(n-1)/2 edges
+    }
+}
+
+class Report {
+public:
+    explicit Report(bool json) : json(json) {
+        if (!json) std::cout << "benchmark,model,vertices,edges,samples,batch,median_ns,min_ns,mean_ns\n";
+    }
+
+    void add(const char* benchmark, GraphGenerator::Model model, int vertices, size_t edges, const Measurement& m) {
+        const char* name = GraphGenerator::modelName(model);
+        std::cout << std::fixed << std::setprecision(1);
+        if (json) {
+            std::cout << "{\"benchmark\":\"" << benchmark << "\",\"model\":\"" << name << "\",\"vertices\":" << vertices
+                      << ",\"edges\":" << edges << ",\"samples\":" << m.samples << ",\"batch\":" << m.batch
+                      << ",\"median_ns\":" << m.median << ",\"min_ns\":" << m.min << ",\"mean_ns\":" << m.mean << "}\n";
+        } else {
+            std::cout << benchmark << "," << name << "," << vertices << "," << edges << "," << m.samples << ","
+                      << m.batch << "," << m.median << "," << m.min << "," << m.mean << "\n";
+        }
+        std::cout.flush();
+        std::cerr << "  " << std::left << std::setw(18) << benchmark << std::right << std::setw(14) << std::fixed << std::setprecision(3)
+                  << m.median / 1e3 << " us" << std::endl;
+    }
+
+private:
+    bool json;
+};
+
+/**
+ * Benchmarks one model at one size.
+ */
+void runSize(const Options& options, GraphGenerator::Model model, size_t targetEdges, ThreadPool* pool, Report& report) {
+    int n = verticesFor(model, targetEdges);
+    GraphGenerator::EdgeList edges = GraphGenerator::generate(model, n, targetEdges, options.seed, pool);
+    size_t m = edges.size();
+    std::cerr << GraphGenerator::modelName(model) << ": " << n << " vertices, " << m << " edges" << std::endl;
+
+    report.add("generate", model, n, m, measure(options.minTime, [&] {
+        keep(GraphGenerator::generate(model, n, targetEdges, options.seed, pool).size());
+    }));
+    report.add("graph_build", model, n, m, measure(options.minTime, [&] {
+        Graph graph(n, edges);
+        keep(graph.getNumEdges());
+    }));
+
+    Graph graph(n, edges);
+    edges = GraphGenerator::EdgeList();  // The graph holds its own copy
+    report.add("kruskal", model, n, m, measure(options.minTime, [&] {
+        KruskalMST kruskal(graph, pool);  // Copies the edge list, as a snapshot of the servers does
+        keep(kruskal.findMST());
+    }));
+    report.add("prim", model, n, m, measure(options.minTime, [&] {
+        PrimMST prim(graph);
+        keep(prim.findMST());
+    }));
+
+    // The kernels alone on prebuilt arrays, with whole weights as integers and as doubles
+    EdgeArrays<uint32_t, uint32_t> integerArrays(graph.getEdges()), integerMst;
+    EdgeArrays<uint32_t, double> doubleArrays(graph.getEdges()), doubleMst;
+    report.add("kruskal_u32", model, n, m, measure(options.minTime, [&] {
+        keep(MSTKernels::kruskal<uint32_t, uint32_t>(n, integerArrays, integerMst, pool, nullptr));
+    }));
+    report.add("kruskal_f64", model, n, m, measure(options.minTime, [&] {
+        keep(MSTKernels::kruskal<uint32_t, double>(n, doubleArrays, doubleMst, pool, nullptr));
+    }));
+    report.add("prim_u32", model, n, m, measure(options.minTime, [&] {
+        keep(MSTKernels::prim<uint32_t, uint32_t>(n, integerArrays, integerMst, nullptr));
+    }));
+    report.add("prim_f64", model, n, m, measure(options.minTime, [&] {
+        keep(MSTKernels::prim<uint32_t, double>(n, doubleArrays, doubleMst, nullptr));
+    }));
+
+    KruskalMST kruskal(graph, pool);
+    kruskal.findMST();
+    GraphGenerator::EdgeList mstEdges = kruskal.getMSTEdges();
+    report.add("tree_build", model, n, m, measure(options.minTime, [&] {
+        Tree tree(n, mstEdges, pool);
+        keep(tree.getMSTWeight());
+    }));
+
+    Tree tree(n, mstEdges, pool);
+    std::mt19937_64 random(options.seed);
+    std::uniform_int_distribution<int> vertex(1, n);
+    std::vector<std::pair<int, int>> pairs(1024);
+    for (auto& pair : pairs) pair = {vertex(random), vertex(random)};
+    size_t next = 0;
+    auto nextPair = [&]() -> const std::pair<int, int>& { return pairs[next++ % pairs.size()]; };
+
+    report.add("mst_weight", model, n, m, measure(options.minTime, [&] { keep(tree.getMSTWeight()); }));
+    std::vector<int> path;
+    report.add("longest_distance", model, n, m, measure(options.minTime, [&] {
+        const auto& [u, v] = nextPair();
+        tree.getLongestPath(u, v, path);
+        keep(path.size());
+    }));
+
+    if (n > options.apspLimit) {
+        std::cerr << "  floyd_warshall and path_query skipped: more than " << options.apspLimit << " vertices" << std::endl;
+        return;
+    }
+    report.add("floyd_warshall", model, n, m, measure(options.minTime, [&] {
+        keep(tree.floydWarshall().first.size());
+    }));
+    const auto& index = tree.allPairs();
+    report.add("path_query", model, n, m, measure(options.minTime, [&] {
+        const auto& [u, v] = nextPair();
+        path.clear();
+        tree.reconstructPath(u, v, index.second, path);  // ShortestPath and AverageDistance look up and walk the index
+        keep(index.first[u][v]);
+        keep(path.size());
+    }));
+}
+
+void runAll(const Options& options) {
+    std::unique_ptr<ThreadPool> pool;
+    if (options.threads > 0) pool = std::make_unique<ThreadPool>(options.threads);
+    Report report(options.json);
+    for (size_t size : options.sizes) {
+        for (GraphGenerator::Model model : options.models) runSize(options, model, size, pool.get(), report);
+    }
+}
+
+void usage(const char* program) {
+    std::cerr << "Usage: " << program << " [--models er,grid,geometric,rmat,complete] [--sizes 1000,10000,...]\n"
+              << "       [--min-time S] [--apsp-limit N] [--threads N] [--seed S] [--json]\n"
+              << "Sizes are edge counts; each model picks the number of vertices for its usual density.\n";
+}
+
+bool parseOptions(int argc, char* argv[], Options& options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string flag = argv[i];
+        if (flag == "--json") {
+            options.json = true;
+            continue;
+        }
+        if (i + 1 >= argc) return false;
+        std::stringstream value(argv[++i]);
+        std::string item;
+        if (flag == "--models") {
+            options.models.clear();
+            while (std::getline(value, item, ',')) {
+                GraphGenerator::Model model;
+                if (!GraphGenerator::parseModel(item, model)) return false;
+                options.models.push_back(model);
+            }
+            continue;  // getline ends with the stream failed
+        } else if (flag == "--sizes") {
+            options.sizes.clear();
+            while (std::getline(value, item, ',')) options.sizes.push_back(static_cast<size_t>(std::stod(item)));  // 1e6 works too
+            continue;
+        } else if (flag == "--min-time") {
+            value >> options.minTime;
+        } else if (flag == "--apsp-limit") {
+            value >> options.apspLimit;
+        } else if (flag == "--threads") {
+            value >> options.threads;
+        } else if (flag == "--seed") {
+            value >> options.seed;
+        } else {
+            return false;
+        }
+        if (value.fail()) return false;
+    }
+    return !options.models.empty() && !options.sizes.empty();
+}
+
+int main(int argc, char* argv[]) {
+    Options options;
+    try {
+        if (!parseOptions(argc, argv, options)) {
+            usage(argv[0]);
+            return 1;
+        }
+    } catch (const std::exception&) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    // Tree::longestDistance recurses once per vertex of the path, which on a large grid is deeper
+    // than the main thread's stack allows
+    pthread_attr_t attributes;
+    pthread_attr_init(&attributes);
+    pthread_attr_setstacksize(&attributes, size_t(1) << 30);
+    pthread_t runner;
+    auto run = [](void* argument) -> void* {
+        runAll(*static_cast<Options*>(argument));
+        return nullptr;
+    };
+    if (pthread_create(&runner, &attributes, run, &options) != 0) {
+        std::cerr << "Cannot start the benchmark thread" << std::endl;
+        return 1;
+    }
+    pthread_join(runner, nullptr);
+    pthread_attr_destroy(&attributes);
+    return 0;
+}
@@ -3,11 +3,19 @@
 #include <unistd.h>
 #include <cstring>
 #include <arpa/inet.h>
+#include <sys/un.h>
+#include "../src/hpp_files/ShmClient.hpp"
 
 using namespace std;
 
+ShmClient* shmClient = nullptr; // Shared-memory channel when started with --shm, the socket is unused then
+
 /// @brief Sends a command to the server.
 void sendCommand(int socket, const string& command) {
+    if (shmClient) {
+        if (!shmClient->send(command)) cerr << "Error writing to shared memory channel" << endl;
+        return;
+    }
     // Send the command to the server using the provided socket
     if (write(socket, command.c_str(), command.size()) < 0) {
         cerr << "Error writing to socket" << endl; // Error handling
@@ -18,7 +26,8 @@ void sendCommand(int socket, const string& command) {
 void receiveResponse(int socket) {
     char buffer[1024];
     bzero(buffer, 1024); // Clear the buffer
-    int n = read(socket, buffer, 1023); // Read response from the server
+    int n = shmClient ? static_cast<int>(shmClient->receive(buffer, 1023)) // Wait for the response in the ring
+                      : read(socket, buffer, 1023); // Read response from the server
     if (n < 0) {
         cerr << "Error reading from socket" << endl; // Error handling
     } else {
@@ -39,17 +48,33 @@ void printHelp() {
          << "    3 4 3.0\n"
          << "    4 5 4.0\n"
          << "    5 1 5.0\n"
+         << "  - Vertices are numbered 1 to n, or use any ids up to 2^64 - 1, e.g. 4000000000 17 2.5\n"
+         << "GenerateGraph model n m seed\n"
+         << "  - Build a synthetic graph in the server: random, grid, geometric, power-law or complete\n"
+         << "  - Grid and complete graphs ignore m; the same seed always gives the same graph\n"
+         << "  - Example: GenerateGraph random 100000 800000 42\n"
          << "NewEdge u v weight\n"
          << "  - Add a new edge from vertex u to vertex v with the specified weight\n"
          << "  - Example: NewEdge 3 4 1.5\n"
          << "RemoveEdge u v\n"
          << "  - Remove an edge from vertex u to vertex v\n"
          << "  - Example: RemoveEdge 3 4\n"
-         << "Kruskal\n"
+         << "UpdateWeight u v weight\n"
+         << "  - Change the weight of the existing edge between u and v\n"
+         << "  - Example: UpdateWeight 3 4 2.5\n"
+         << "ApplyBatch k\n"
+         << "  - Apply k edge operations as one transaction, updating the MST once at the end\n"
+         << "  - After this command, provide the operations one by one:\n"
+         << "    NewEdge 1 4 2.0\n"
+         << "    UpdateWeight 1 2 0.5\n"
+         << "    RemoveEdge 2 3\n"
+         << "Kruskal [offset [limit]]\n"
          << "  - Run Kruskal's algorithm to find the minimum spanning tree\n"
-         << "  - Example: Kruskal\n"
-         << "Prim\n"
+         << "  - Optionally list only limit MST edges, skipping the first offset\n"
+         << "  - Example: Kruskal 0 100\n"
+         << "Prim [offset [limit]]\n"
          << "  - Run Prim's algorithm to find the minimum spanning tree\n"
+         << "  - Optionally list only limit MST edges, skipping the first offset\n"
          << "  - Example: Prim\n"
          << "MSTWeight\n"
          << "  - Get the total weight of the current MST\n"
@@ -63,9 +88,39 @@ void printHelp() {
          << "ShortestPath u v\n"
          << "  - Find the shortest path between two vertices u and v\n"
          << "  - Example: ShortestPath 1 3\n"
-         << "PrintGraph\n"
-         << "  - Print the current graph\n"
+         << "PrintGraph [offset [limit]]\n"
+         << "  - Print the current graph, optionally only limit vertices, skipping the first offset\n"
          << "  - Example: PrintGraph\n"
+         << "Async Kruskal|Prim [notify]\n"
+         << "  - Compute the MST as a background job and print its job id; other commands are served meanwhile\n"
+         << "  - With notify, the server sends the job's status line when it ends\n"
+         << "  - Example: Async Kruskal notify\n"
+         << "JobStatus id\n"
+         << "  - Show the state and progress of a job, and its MST weight once done\n"
+         << "  - Example: JobStatus 1\n"
+         << "JobResult id [offset [limit]]\n"
+         << "  - List the MST edges computed by a finished job\n"
+         << "  - Example: JobResult 1 0 100\n"
+         << "CancelJob id\n"
+         << "  - Stop a queued or running job\n"
+         << "  - Example: CancelJob 1\n"
+         << "Stats [prometheus]\n"
+         << "  - Show the server's command latencies, queue depths, lock times and memory use\n"
+         << "  - With prometheus, in the Prometheus text format\n"
+         << "  - Example: Stats\n"
+         << "Trace N\n"
+         << "  - Trace one request in N through the server's stages, 0 to stop tracing\n"
+         << "  - Example: Trace 100\n"
+         << "TraceDump\n"
+         << "  - Write the traced requests to the server's trace file as Chrome trace-event JSON\n"
+         << "  - Example: TraceDump\n"
+         << "Profile [hw] command\n"
+         << "  - Run the command and show its time, MST phase timings and counters before its response\n"
+         << "  - With hw, also hardware counters (cycles, instructions, cache and branch misses)\n"
+         << "  - Example: Profile Kruskal 0 10\n"
+         << "Deadline ms command\n"
+         << "  - Abort the MST or distance computation of the command if it is not done within ms milliseconds\n"
+         << "  - Example: Deadline 500 AverageDistance 1 3\n"
          << "exit\n"
          << "  - Exit the client\n"
          << "  - Example: exit\n"
@@ -75,29 +130,51 @@ void printHelp() {
          << endl;
 }
 
-int main() {
+/// @brief Connects to the server: over TCP, or with --unix PATH / --shm PATH to a server on this host.
+/// @return the socket, or -1 on failure. With --shm the commands go through shmClient instead.
+int connectToServer(int argc, char* argv[], ShmClient& channel) {
+    if (argc == 3 && strcmp(argv[1], "--shm") == 0) {
+        if (!channel.connect(argv[2])) return -1;
+        shmClient = &channel;
+        return 0;
+    }
+
+    if (argc == 3 && strcmp(argv[1], "--unix") == 0) {
+        struct sockaddr_un addr; // Address of the server's Unix domain socket
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        strncpy(addr.sun_path, argv[2], sizeof(addr.sun_path) - 1);
+        int sockfd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (sockfd < 0 || connect(sockfd, (struct sockaddr*)&addr, sizeof(addr)) < 0) return -1;
+        return sockfd;
+    }
+
     int sockfd, portno = 9034; // Port number of the server
     struct sockaddr_in serv_addr; // Struct to hold server address information
 
     sockfd = socket(AF_INET, SOCK_STREAM, 0); // Create a TCP socket
-    if (sockfd < 0) {
-        cerr << "Error opening socket" << endl; // Error handling if socket creation fails
-        return 1;
-    }
+    if (sockfd < 0) return -1;
 
     serv_addr.sin_family = AF_INET;
     serv_addr.sin_addr.s_addr = inet_addr("127.0.0.1"); // Use localhost for testing
     serv_addr.sin_port = htons(portno); // Convert the port number to network byte order (big-endian)
 
     // Attempt to connect to the server
-    if (connect(sockfd, (struct sockaddr*)&serv_addr, sizeof(serv_addr)) < 0) {
+    if (connect(sockfd, (struct sockaddr*)&serv_addr, sizeof(serv_addr)) < 0) return -1;
+    return sockfd;
+}
+
+int main(int argc, char* argv[]) {
+    ShmClient channel;
+    int sockfd = connectToServer(argc, argv, channel);
+    if (sockfd < 0) {
         cerr << "Error connecting" << endl; // Error handling if connection fails
         return 1;
     }
 
     // Main loop to continuously accept commands from the user
     while (true) {
-        cout << "Enter command (NewGraph, NewEdge, RemoveEdge, Kruskal, Prim, MSTWeight, LongestDistance, AverageDistance, ShortestPath, PrintGraph, help, exit): ";
+        cout << "Enter command (NewGraph, GenerateGraph, NewEdge, RemoveEdge, UpdateWeight, ApplyBatch, Kruskal, Prim, MSTWeight, LongestDistance, AverageDistance, ShortestPath, PrintGraph, Async, JobStatus, JobResult, CancelJob, Stats, Trace, TraceDump, help, exit): ";
         string command;
         getline(cin, command); // Read the user's input
 
@@ -122,8 +199,20 @@ int main() {
                 receiveResponse(sockfd); // Receive and print the server's response for each edge
             }
         }
+
+        // If the command is ApplyBatch, take additional input for the operations
+        if (command.find("ApplyBatch") == 0) {
+            int k = 0;
+            sscanf(command.c_str(), "ApplyBatch %d", &k); // Extract the number of operations
+            for (int i = 0; i < k; ++i) {
+                cout << "Enter operation " << i + 1 << " (NewEdge u v w, RemoveEdge u v, UpdateWeight u v w): ";
+                getline(cin, command); // Read each operation
+                sendCommand(sockfd, command + "\n"); // Send each operation to the server
+                receiveResponse(sockfd); // Receive and print the server's response for each operation
+            }
+        }
     }
 
-    close(sockfd); // Close the socket when done
+    if (!shmClient) close(sockfd); // Close the socket when done
     return 0;
 }
@@ -0,0 +1,685 @@
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <chrono>
+#include <random>
+#include <set>
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+#include <cstdlib>
+#include <fcntl.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+#include "../src/hpp_files/LatencyHistogram.hpp"
+
+using namespace std;
+using Clock = chrono::steady_clock;
+
+// Load generator for LFServer and pipelineServer. Every connection sends a seeded, reproducible stream
+// of commands, either at a fixed arrival rate (open loop) or as soon as its previous commands were
+// answered (closed loop), and the latency of every command type is recorded in a histogram. Given
+// several targets, the same workload runs against each of them in turn and the results are compared.
+
+// Command types of the built-in mix, reported separately. Scripts report by command name instead.
+const char* const mixTypes[] = {"ingest", "mutation", "batch", "mst", "prim", "weight", "path", "longest", "average"};
+const size_t mixTypeCount = sizeof(mixTypes) / sizeof(mixTypes[0]);
+
+struct Options {
+    vector<pair<string, string>> targets;  // Name and address: host:port or unix:PATH
+    size_t connections = 16;
+    size_t threads = 2;
+    double duration = 10;                  // Seconds measured
+    double warmup = 1;                     // Seconds run before measuring
+    double rate = 0;                       // Commands per second over all connections; 0 for closed loop
+    size_t depth = 1;                      // Commands in flight per connection in closed loop
+    vector<double> mix;                    // Weight of each mix type
+    string script;                         // File of command lines replayed instead of the mix
+    int vertices = 100;
+    int edges = 100;                       // At least vertices - 1, for the path through all vertices
+    int batch = 8;                         // Operations per ApplyBatch
+    uint64_t seed = 1;
+    bool csv = false;
+};
+
+// Statistics of one command type
+struct TypeStats {
+    LatencyHistogram latency;  // Nanoseconds, from the (intended) send to the last line of the response
+    uint64_t busy = 0;         // Shed by the server's admission control
+    uint64_t failed = 0;       // Invalid, rejected or aborted
+};
+
+// A command of a script: its lines, newline-terminated, and its type
+struct ScriptCommand {
+    string text;
+    size_t lines;
+    size_t type;
+};
+
+// Workload shared by all connections: the mix or the script, and the graph the commands refer to
+struct Workload {
+    vector<string> typeNames;
+    vector<double> cumulative;             // Cumulative mix weights, for choosing a type
+    vector<ScriptCommand> script;
+    int vertices;
+    int batch;
+};
+
+// A command sent, or due to be sent, and not fully answered yet
+struct Request {
+    size_t type;
+    size_t lines;             // Responses still expected: one per line sent
+    Clock::time_point start;  // Intended send time in open loop, actual send time in closed loop
+    bool failed = false;
+    bool busy = false;
+};
+
+/**
+ * Splits the byte stream of a connection into responses. The server answers every line it receives
+ * with exactly one response, which is one text line unless its first line announces more: MST listings
+ * say how many edges follow, distance replies are followed by their path, and so on.
+ */
+class ResponseParser {
+public:
+    /**
+     * Consumes one line.
+     * @return true if it completed a response.
+     */
+    bool line(const char* text, size_t size) {
+        string_view line(text, size);
+        if (remaining == 0) {
+            remaining = 1;  // First line of a new response
+            first = line;
+        }
+        remaining--;
+        remaining += extraLines(line);
+        return remaining == 0;
+    }
+
+    // First line of the last response, e.g. for recognizing errors
+    const string& firstLine() const { return first; }
+
+private:
+    size_t remaining = 0;  // Lines still expected in the current response
+    string first;
+
+    static bool startsWith(string_view line, const char* prefix) { return line.compare(0, strlen(prefix), prefix) == 0; }
+
+    // Number of further lines a line announces
+    static size_t extraLines(string_view line) {
+        if (startsWith(line, "Kruskal's algorithm executed") || startsWith(line, "Prim's algorithm executed") ||
+            startsWith(line, "Longest Distance between") || startsWith(line, "AverageDistance between") ||
+            startsWith(line, "Shortest Distance between") || startsWith(line, "Starting batch of")) {
+            return 1;
+        }
+        if (startsWith(line, "Edges of the MST (")) {
+            long first = 0, last = 0;  // "Edges of the MST (first-last of count):"
+            sscanf(string(line).c_str(), "Edges of the MST (%ld-%ld", &first, &last);
+            return last >= first ? last - first + 1 : 0;
+        }
+        if (startsWith(line, "Stats (") || startsWith(line, "# Stats prometheus: ")) {
+            long lines = 0;  // "Stats (N lines):" or "# Stats prometheus: N lines follow"
+            sscanf(string(line).c_str(), line[0] == '#' ? "# Stats prometheus: %ld" : "Stats (%ld", &lines);
+            return lines > 0 ? lines : 0;
+        }
+        if (startsWith(line, "Profile (")) {
+            long lines = 0;  // "Profile (N lines):", then the response of the profiled command
+            sscanf(string(line).c_str(), "Profile (%ld", &lines);
+            return lines > 0 ? lines + 1 : 1;
+        }
+        if (startsWith(line, "Staged operation ")) {
+            int done = 0, total = -1;  // The last operation is followed by the outcome of the batch
+            sscanf(string(line).c_str(), "Staged operation %d/%d", &done, &total);
+            return done == total ? 1 : 0;
+        }
+        return 0;
+    }
+};
+
+// One client connection and the commands it has in flight
+struct Connection {
+    int socket = -1;
+    mt19937_64 random;
+    size_t scriptLine = 0;          // Next script command to send
+    ResponseParser parser;
+    deque<Request> inFlight;        // Oldest first; responses arrive in this order
+    string output;                  // Lines not written to the socket yet
+    size_t written = 0;             // Bytes of output already written
+    string input;                   // Received bytes not parsed yet
+    bool watchingWrite = false;     // EPOLLOUT is armed
+    Clock::time_point nextSend;     // Open loop: intended time of the next command
+};
+
+// Results of one run against one target
+struct RunResult {
+    vector<TypeStats> types;
+    uint64_t completed = 0;  // Commands answered within the measured window
+    double seconds = 0;      // Length of the measured window
+    uint64_t unanswered = 0; // Commands still in flight when the run ended
+};
+
+/**
+ * Connects to host:port or unix:PATH.
+ * @return the socket, or -1 on failure.
+ */
+int connectTo(const string& address) {
+    if (address.compare(0, 5, "unix:") == 0) {
+        struct sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        strncpy(addr.sun_path, address.c_str() + 5, sizeof(addr.sun_path) - 1);
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd >= 0 && connect(fd, (struct sockaddr*)&addr, sizeof(addr)) == 0) return fd;
+        if (fd >= 0) close(fd);
+        return -1;
+    }
+
+    size_t colon = address.rfind(':');
+    string host = colon == string::npos ? address : address.substr(0, colon);
+    string port = colon == string::npos ? "9034" : address.substr(colon + 1);
+    struct addrinfo hints, *result;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(host.c_str(), port.c_str(), &hints, &result) != 0) return -1;
+    int fd = -1;
+    for (struct addrinfo* ai = result; ai; ai = ai->ai_next) {
+        fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (fd >= 0 && connect(fd, ai->ai_addr, ai->ai_addrlen) == 0) break;
+        if (fd >= 0) close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(result);
+    if (fd >= 0) {
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));  // Fails harmlessly on Unix sockets
+    }
+    return fd;
+}
+
+/**
+ * Creates the graph every run starts from: a path through all vertices, so the graph is connected and
+ * the mutations always find their edge, plus random extra edges. Waits until the server listed it.
+ * @return false if the server could not be reached or did not answer.
+ */
+bool createGraph(const string& address, const Options& options) {
+    int fd = connectTo(address);
+    if (fd < 0) return false;
+
+    mt19937_64 random(options.seed);
+    uniform_int_distribution<int> vertex(1, options.vertices), weight(1, 100);
+    set<pair<int, int>> present;
+    ostringstream request;
+    int n = options.vertices, m = options.edges;
+    request << "NewGraph " << n << " " << m << "\n";
+    for (int i = 1; i < n; ++i) {
+        present.insert({i, i + 1});
+        request << i << " " << i + 1 << " " << weight(random) << "\n";
+    }
+    for (int added = n - 1; added < m;) {
+        int u = vertex(random), v = vertex(random);
+        if (u == v || present.count({min(u, v), max(u, v)})) continue;
+        present.insert({min(u, v), max(u, v)});
+        request << u << " " << v << " " << weight(random) << "\n";
+        ++added;
+    }
+    string text = request.str();
+    bool ok = true;
+    for (size_t sent = 0; ok && sent < text.size();) {
+        ssize_t n = write(fd, text.data() + sent, text.size() - sent);
+        ok = n > 0;
+        if (ok) sent += n;
+    }
+
+    // The reply ends with the listing of the new graph, whose last line is that of the last vertex
+    string last = "\n" + to_string(n) + " -> ";
+    string input;
+    char buffer[65536];
+    for (bool found = false; ok && !found;) {
+        ssize_t n = read(fd, buffer, sizeof(buffer));
+        ok = n > 0;
+        if (ok) input.append(buffer, n);
+        found = input.find(last) != string::npos;
+        if (input.size() > last.size()) input.erase(0, input.size() - last.size());  // It may span two reads
+    }
+    close(fd);
+    return ok;
+}
+
+/**
+ * Appends the lines of the next command of a connection to its output.
+ * @return the type of the command and the number of lines.
+ */
+pair<size_t, size_t> nextCommand(Connection& conn, const Workload& workload) {
+    if (!workload.script.empty()) {
+        const ScriptCommand& command = workload.script[conn.scriptLine++ % workload.script.size()];
+        conn.output += command.text;
+        return {command.type, command.lines};
+    }
+
+    uniform_real_distribution<double> pick(0, workload.cumulative.back());
+    size_t type = upper_bound(workload.cumulative.begin(), workload.cumulative.end(), pick(conn.random)) -
+                  workload.cumulative.begin();
+    type = min(type, mixTypeCount - 1);
+    uniform_int_distribution<int> vertex(1, workload.vertices), pathVertex(1, workload.vertices - 1),
+        weight(1, 100);
+    int u = vertex(conn.random), v = vertex(conn.random);
+    char line[128];
+    size_t lines = 1;
+    switch (type) {
+        case 0: snprintf(line, sizeof(line), "NewEdge %d %d %d\n", u, v, weight(conn.random)); break;
+        case 1: u = pathVertex(conn.random);  // Edges of the initial path are never removed
+                snprintf(line, sizeof(line), "UpdateWeight %d %d %d\n", u, u + 1, weight(conn.random)); break;
+        case 2: snprintf(line, sizeof(line), "ApplyBatch %d\n", workload.batch);
+                conn.output += line;
+                for (int i = 0; i < workload.batch; ++i) {
+                    u = pathVertex(conn.random);
+                    snprintf(line, sizeof(line), "UpdateWeight %d %d %d\n", u, u + 1, weight(conn.random));
+                    if (i + 1 < workload.batch) conn.output += line;
+                }
+                lines = workload.batch + 1;
+                break;
+        case 3: snprintf(line, sizeof(line), "Kruskal 0 0\n"); break;  // No edge list: measures the MST, not the output
+        case 4: snprintf(line, sizeof(line), "Prim 0 0\n"); break;
+        case 5: snprintf(line, sizeof(line), "MSTWeight\n"); break;
+        case 6: snprintf(line, sizeof(line), "ShortestPath %d %d\n", u, v); break;
+        case 7: snprintf(line, sizeof(line), "LongestDistance %d %d\n", u, v); break;
+        default: snprintf(line, sizeof(line), "AverageDistance %d %d\n", u, v); break;
+    }
+    conn.output += line;
+    return {type, lines};
+}
+
+// Writes as much pending output as the socket takes, watching for writability while some is left
+void flush(Connection& conn, int epollFd) {
+    while (conn.written < conn.output.size()) {
+        ssize_t n = write(conn.socket, conn.output.data() + conn.written, conn.output.size() - conn.written);
+        if (n <= 0) break;  // Full, or the server is gone; reads will tell
+        conn.written += n;
+    }
+    if (conn.written == conn.output.size()) {
+        conn.output.clear();
+        conn.written = 0;
+    }
+    bool watch = !conn.output.empty();
+    if (watch != conn.watchingWrite) {
+        struct epoll_event ev;
+        ev.events = watch ? EPOLLIN | EPOLLOUT : EPOLLIN;
+        ev.data.ptr = &conn;
+        epoll_ctl(epollFd, EPOLL_CTL_MOD, conn.socket, &ev);
+        conn.watchingWrite = watch;
+    }
+}
+
+/**
+ * Runs the connections of one thread until `end`, recording into `result`.
+ */
+void runThread(vector<unique_ptr<Connection>>& connections, const Workload& workload, const Options& options,
+               Clock::time_point measureFrom, Clock::time_point end, RunResult& result) {
+    int epollFd = epoll_create1(0);
+    for (auto& conn : connections) {
+        struct epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.ptr = conn.get();
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, conn->socket, &ev);
+    }
+    // Open loop: every connection sends at rate / connections, phase-shifted so they do not send in bursts
+    chrono::nanoseconds interval(0);
+    if (options.rate > 0) {
+        interval = chrono::nanoseconds(static_cast<int64_t>(1e9 * options.connections / options.rate));
+    }
+
+    auto issue = [&](Connection& conn, Clock::time_point start) {
+        auto [type, lines] = nextCommand(conn, workload);
+        conn.inFlight.push_back({type, lines, start});
+    };
+
+    Clock::time_point now = Clock::now();
+    for (auto& conn : connections) {
+        if (options.rate > 0) {
+            conn->nextSend = now + interval * (conn->random() % 1000) / 1000;
+        } else {
+            for (size_t i = 0; i < options.depth; ++i) issue(*conn, now);
+            flush(*conn, epollFd);
+        }
+    }
+
+    struct epoll_event events[64];
+    char buffer[65536];
+    while ((now = Clock::now()) < end) {
+        int timeout = 100;
+        if (options.rate > 0) {
+            Clock::time_point earliest = end;
+            for (auto& conn : connections) {
+                bool due = false;
+                while (conn->nextSend <= now) {
+                    issue(*conn, conn->nextSend);  // Timed from when it should have been sent
+                    conn->nextSend += interval;
+                    due = true;
+                }
+                if (due) flush(*conn, epollFd);
+                earliest = min(earliest, conn->nextSend);
+            }
+            timeout = static_cast<int>(chrono::duration_cast<chrono::milliseconds>(earliest - now).count());
+        }
+
+        int ready = epoll_wait(epollFd, events, 64, max(timeout, 0));
+        for (int i = 0; i < ready; ++i) {
+            Connection& conn = *static_cast<Connection*>(events[i].data.ptr);
+            if (events[i].events & EPOLLOUT) flush(conn, epollFd);
+            if (!(events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))) continue;
+
+            ssize_t n = read(conn.socket, buffer, sizeof(buffer));
+            if (n <= 0) {
+                if (n < 0 && (errno == EAGAIN || errno == EINTR)) continue;
+                epoll_ctl(epollFd, EPOLL_CTL_DEL, conn.socket, nullptr);  // The server closed the connection
+                continue;
+            }
+            conn.input.append(buffer, n);
+            Clock::time_point received = Clock::now();
+            size_t begin = 0, newline;
+            while ((newline = conn.input.find('\n', begin)) != string::npos) {
+                bool complete = conn.parser.line(conn.input.data() + begin, newline - begin);
+                begin = newline + 1;
+                if (!complete || conn.inFlight.empty()) continue;
+
+                Request& request = conn.inFlight.front();
+                const string& first = conn.parser.firstLine();
+                if (first.compare(0, 4, "BUSY") == 0) {
+                    request.busy = true;
+                } else if (first.compare(0, 7, "Invalid") == 0 || first.compare(0, 5, "Batch rejected") == 0 ||
+                           first.compare(0, 8, "Deadline") == 0 || first.compare(0, 5, "Graph is not") == 0) {
+                    request.failed = true;
+                }
+                if (--request.lines > 0) continue;  // More lines of this command, e.g. of a batch
+
+                if (received >= measureFrom && request.start >= measureFrom) {
+                    TypeStats& stats = result.types[request.type];
+                    stats.latency.record(chrono::duration_cast<chrono::nanoseconds>(received - request.start).count());
+                    stats.busy += request.busy;
+                    stats.failed += request.failed;
+                    result.completed++;
+                }
+                conn.inFlight.pop_front();
+                if (options.rate == 0) {
+                    issue(conn, received);  // Closed loop: the next command replaces the answered one
+                    flush(conn, epollFd);
+                }
+            }
+            conn.input.erase(0, begin);
+        }
+    }
+
+    for (auto& conn : connections) result.unanswered += conn->inFlight.size();
+    close(epollFd);
+}
+
+/**
+ * Runs the workload against one target.
+ * @return false if the target could not be reached.
+ */
+bool runTarget(const string& address, const Workload& workload, const Options& options, RunResult& result) {
+    if (!createGraph(address, options)) return false;
+
+    // Connections are dealt out to the threads; each connection has its own seeded command stream
+    size_t threads = max<size_t>(1, min(options.threads, options.connections));
+    vector<vector<unique_ptr<Connection>>> owned(threads);
+    for (size_t i = 0; i < options.connections; ++i) {
+        auto conn = make_unique<Connection>();
+        conn->socket = connectTo(address);
+        if (conn->socket < 0) return false;
+        fcntl(conn->socket, F_SETFL, fcntl(conn->socket, F_GETFL) | O_NONBLOCK);
+        conn->random.seed(options.seed * 1000003 + i);
+        conn->scriptLine = workload.script.empty() ? 0 : i % workload.script.size();  // Connections do not march in step
+        owned[i % threads].push_back(move(conn));
+    }
+
+    Clock::time_point start = Clock::now();
+    Clock::time_point measureFrom = start + chrono::duration_cast<Clock::duration>(chrono::duration<double>(options.warmup));
+    Clock::time_point end = measureFrom + chrono::duration_cast<Clock::duration>(chrono::duration<double>(options.duration));
+    vector<RunResult> partial(threads);
+    vector<thread> workers;
+    for (size_t t = 0; t < threads; ++t) {
+        partial[t].types.resize(workload.typeNames.size());
+        workers.emplace_back(runThread, ref(owned[t]), cref(workload), cref(options), measureFrom, end, ref(partial[t]));
+    }
+    for (thread& worker : workers) worker.join();
+
+    result.types.assign(workload.typeNames.size(), TypeStats());
+    for (const RunResult& part : partial) {
+        for (size_t i = 0; i < part.types.size(); ++i) {
+            result.types[i].latency.merge(part.types[i].latency);
+            result.types[i].busy += part.types[i].busy;
+            result.types[i].failed += part.types[i].failed;
+        }
+        result.completed += part.completed;
+        result.unanswered += part.unanswered;
+    }
+    result.seconds = options.duration;
+    for (auto& connections : owned) {
+        for (auto& conn : connections) close(conn->socket);  // Commands in flight are dropped by the server
+    }
+    return true;
+}
+
+double millis(uint64_t nanos) { return nanos / 1e6; }
+
+void printResult(const string& name, const Workload& workload, const RunResult& result) {
+    cout << "\n== " << name << ": " << result.completed << " commands in " << result.seconds << " s, "
+         << fixed << setprecision(0) << result.completed / result.seconds << " commands/s";
+    if (result.unanswered) cout << ", " << result.unanswered << " unanswered at the end";
+    cout << "\n";
+    cout << left << setw(18) << "type" << right << setw(9) << "count" << setw(10) << "per s" << setw(10) << "mean"
+         << setw(10) << "p50" << setw(10) << "p90" << setw(10) << "p99" << setw(10) << "p99.9" << setw(10) << "max"
+         << setw(8) << "busy" << setw(8) << "failed" << "   (latencies in ms)\n";
+    for (size_t i = 0; i < workload.typeNames.size(); ++i) {
+        const TypeStats& stats = result.types[i];
+        const LatencyHistogram& h = stats.latency;
+        if (h.count() == 0) continue;
+        cout << left << setw(18) << workload.typeNames[i] << right << setw(9) << h.count() << setw(10)
+             << setprecision(0) << h.count() / result.seconds << setprecision(3) << setw(10) << h.mean() / 1e6
+             << setw(10) << millis(h.percentile(50)) << setw(10) << millis(h.percentile(90)) << setw(10)
+             << millis(h.percentile(99)) << setw(10) << millis(h.percentile(99.9)) << setw(10) << millis(h.max())
+             << setw(8) << stats.busy << setw(8) << stats.failed << "\n";
+    }
+    cout.unsetf(ios::floatfield);
+}
+
+// Prints the targets side by side: throughput and the median and p99 latency of every command type
+void printComparison(const Options& options, const Workload& workload, const vector<RunResult>& results) {
+    cout << "\n== Comparison (p50 / p99 in ms)\n" << left << setw(18) << "type";
+    for (const auto& target : options.targets) cout << right << setw(24) << target.first;
+    cout << "\n" << left << setw(18) << "commands/s" << fixed << setprecision(0);
+    for (const RunResult& result : results) cout << right << setw(24) << result.completed / result.seconds;
+    cout << "\n" << setprecision(3);
+    for (size_t i = 0; i < workload.typeNames.size(); ++i) {
+        bool any = false;
+        for (const RunResult& result : results) any = any || result.types[i].latency.count() > 0;
+        if (!any) continue;
+        cout << left << setw(18) << workload.typeNames[i];
+        for (const RunResult& result : results) {
+            const LatencyHistogram& h = result.types[i].latency;
+            ostringstream cell;
+            cell << fixed << setprecision(3) << millis(h.percentile(50)) << " / " << millis(h.percentile(99));
+            cout << right << setw(24) << cell.str();
+        }
+        cout << "\n";
+    }
+    cout.unsetf(ios::floatfield);
+}
+
+// One line per target and command type: target,type,count,per_second,mean_ms,p50_ms,p90_ms,p99_ms,p999_ms,max_ms,busy,failed
+void printCsv(const Options& options, const Workload& workload, const vector<RunResult>& results) {
+    cout << "\ntarget,type,count,per_second,mean_ms,p50_ms,p90_ms,p99_ms,p999_ms,max_ms,busy,failed\n";
+    for (size_t t = 0; t < results.size(); ++t) {
+        for (size_t i = 0; i < workload.typeNames.size(); ++i) {
+            const TypeStats& stats = results[t].types[i];
+            const LatencyHistogram& h = stats.latency;
+            if (h.count() == 0) continue;
+            cout << options.targets[t].first << "," << workload.typeNames[i] << "," << h.count() << ","
+                 << h.count() / results[t].seconds << "," << h.mean() / 1e6 << "," << millis(h.percentile(50)) << ","
+                 << millis(h.percentile(90)) << "," << millis(h.percentile(99)) << "," << millis(h.percentile(99.9))
+                 << "," << millis(h.max()) << "," << stats.busy << "," << stats.failed << "\n";
+        }
+    }
+}
+
+void usage(const char* program) {
+    cerr << "Usage: " << program << " [--target NAME=HOST:PORT|NAME=unix:PATH]... [--connections N] [--threads N]\n"
+         << "       [--duration S] [--warmup S] [--rate R | --depth D] [--mix TYPE=W,...] [--script FILE]\n"
+         << "       [--vertices N] [--edges M] [--batch K] [--seed S] [--csv]\n"
+         << "Mix types: ingest (NewEdge), mutation (UpdateWeight), batch (ApplyBatch), mst (Kruskal), prim,\n"
+         << "           weight (MSTWeight), path (ShortestPath), longest (LongestDistance), average (AverageDistance)\n"
+         << "--rate R sends R commands per second in total (open loop); otherwise every connection keeps\n"
+         << "D commands in flight (closed loop, 1 by default).\n";
+}
+
+/**
+ * Parses "type=weight,..." into one weight per mix type.
+ * @return false if a type is unknown or a weight is negative.
+ */
+bool parseMix(const string& text, vector<double>& weights) {
+    weights.assign(mixTypeCount, 0);
+    stringstream items(text);
+    string item;
+    while (getline(items, item, ',')) {
+        size_t equals = item.find('=');
+        string name = item.substr(0, equals);
+        double weight = equals == string::npos ? 1 : atof(item.c_str() + equals + 1);
+        auto it = find_if(begin(mixTypes), end(mixTypes), [&](const char* type) { return name == type; });
+        if (it == end(mixTypes) || weight < 0) return false;
+        weights[it - begin(mixTypes)] = weight;
+    }
+    return true;
+}
+
+bool parseOptions(int argc, char* argv[], Options& options) {
+    parseMix("weight=40,path=10,longest=10,mutation=20,ingest=10,mst=10", options.mix);
+    for (int i = 1; i < argc; ++i) {
+        string flag = argv[i];
+        if (flag == "--csv") {
+            options.csv = true;
+            continue;
+        }
+        if (i + 1 >= argc) return false;
+        const char* value = argv[++i];
+        if (flag == "--target") {
+            const char* equals = strchr(value, '=');
+            if (!equals) return false;
+            options.targets.push_back({string(value, equals - value), equals + 1});
+        } else if (flag == "--connections") {
+            options.connections = strtoul(value, nullptr, 10);
+        } else if (flag == "--threads") {
+            options.threads = strtoul(value, nullptr, 10);
+        } else if (flag == "--duration") {
+            options.duration = atof(value);
+        } else if (flag == "--warmup") {
+            options.warmup = atof(value);
+        } else if (flag == "--rate") {
+            options.rate = atof(value);
+        } else if (flag == "--depth") {
+            options.depth = strtoul(value, nullptr, 10);
+        } else if (flag == "--mix") {
+            if (!parseMix(value, options.mix)) return false;
+        } else if (flag == "--script") {
+            options.script = value;
+        } else if (flag == "--vertices") {
+            options.vertices = atoi(value);
+        } else if (flag == "--edges") {
+            options.edges = atoi(value);
+        } else if (flag == "--batch") {
+            options.batch = atoi(value);
+        } else if (flag == "--seed") {
+            options.seed = strtoull(value, nullptr, 10);
+        } else {
+            return false;
+        }
+    }
+    if (options.targets.empty()) options.targets.push_back({"server", "127.0.0.1:9034"});
+    options.edges = max(options.edges, options.vertices - 1);  // At least the path through all vertices
+    return options.connections > 0 && options.duration > 0 && options.warmup >= 0 && options.rate >= 0 &&
+           options.depth > 0 && options.vertices >= 2 && options.batch > 0;
+}
+
+/**
+ * Prepares the command types: the mix, or the commands of the script typed by their command name.
+ * An ApplyBatch line and the operations that follow it are one command.
+ * @return false if the script cannot be read or the mix is empty.
+ */
+bool buildWorkload(const Options& options, Workload& workload) {
+    workload.vertices = options.vertices;
+    workload.batch = options.batch;
+    if (options.script.empty()) {
+        workload.typeNames.assign(begin(mixTypes), end(mixTypes));
+        double sum = 0;
+        for (double weight : options.mix) workload.cumulative.push_back(sum += weight);
+        return sum > 0;
+    }
+
+    ifstream file(options.script);
+    string line;
+    int batchLines = 0;  // Lines still belonging to the last ApplyBatch
+    while (getline(file, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.empty() || line[0] == '#') continue;
+        if (batchLines > 0) {
+            workload.script.back().text += line + "\n";
+            workload.script.back().lines++;
+            batchLines--;
+            continue;
+        }
+        string name = line.substr(0, line.find(' '));
+        if (name == "NewGraph" || name == "Async") {
+            cerr << "Scripts cannot use " << name << ": the graph is set up by --vertices and --edges" << endl;
+            return false;
+        }
+        if (sscanf(line.c_str(), "ApplyBatch %d", &batchLines) != 1) batchLines = 0;
+        auto it = find(workload.typeNames.begin(), workload.typeNames.end(), name);
+        if (it == workload.typeNames.end()) it = workload.typeNames.insert(it, name);
+        workload.script.push_back({line + "\n", 1, static_cast<size_t>(it - workload.typeNames.begin())});
+    }
+    return !workload.script.empty();
+}
+
+int main(int argc, char* argv[]) {
+    Options options;
+    Workload workload;
+    if (!parseOptions(argc, argv, options)) {
+        usage(argv[0]);
+        return 1;
+    }
+    if (!buildWorkload(options, workload)) {
+        cerr << "Empty workload: check --mix or --script" << endl;
+        return 1;
+    }
+
+    cout << options.connections << " connections, " << (options.rate > 0 ? "open loop at " : "closed loop, depth ")
+         << (options.rate > 0 ? options.rate : options.depth) << (options.rate > 0 ? " commands/s" : "") << ", "
+         << options.warmup << " s warmup, " << options.duration << " s measured, graph of "
+         << options.vertices << " vertices and " << options.edges << " edges, seed " << options.seed << endl;
+
+    vector<RunResult> results(options.targets.size());
+    for (size_t t = 0; t < options.targets.size(); ++t) {
+        const auto& [name, address] = options.targets[t];
+        if (!runTarget(address, workload, options, results[t])) {
+            cerr << "Cannot run against " << name << " at " << address << endl;
+            return 1;
+        }
+        printResult(name, workload, results[t]);
+    }
+    if (options.targets.size() > 1) printComparison(options, workload, results);
+    if (options.csv) printCsv(options, workload, results);
+    return 0;
+}
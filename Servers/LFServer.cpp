@@ -9,359 +9,1252 @@
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/socket.h>
-#include <sys/select.h>
-#include <sstream>
+#include <sys/epoll.h>
 #include <cstring> // For memset
+#include <cerrno>
+#include <fcntl.h>
+#include <memory>
+#include <unordered_map>
+#include <chrono>
+#include <fstream>
+#include <optional>
 #include "../src/hpp_files/Graph.hpp"
+#include "../src/hpp_files/GraphGenerator.hpp"
 #include "../src/hpp_files/KruskalMST.hpp"
 #include "../src/hpp_files/PrimMST.hpp"
 #include "../src/hpp_files/Tree.hpp"  // Include the Tree class
+#include "../src/hpp_files/MSTCache.hpp"
 #include "../src/hpp_files/ThreadPool.hpp"  // Include the ThreadPool class
+#include "../src/hpp_files/SlabPool.hpp"
+#include "../src/hpp_files/ResponseBuilder.hpp"
+#include "../src/hpp_files/OutputQueue.hpp"
+#include "../src/hpp_files/IoUringBackend.hpp"
+#include "../src/hpp_files/ServerSocket.hpp"
+#include "../src/hpp_files/ShmTransport.hpp"
+#include "../src/hpp_files/JobManager.hpp"
+#include "../src/hpp_files/CommandClass.hpp"
+#include "../src/hpp_files/AdmissionControl.hpp"
+#include "../src/hpp_files/ServerMetrics.hpp"
+#include "../src/hpp_files/Tracer.hpp"
+#include "../src/hpp_files/Profiler.hpp"
 
 using namespace std;
 
 // Global graph and MST tree pointers
-Graph* graph = nullptr;  // Pointer to the current graph
-Tree* mstTree = nullptr; // Pointer to the current MST tree
-mutex graphMutex;        // Mutex for thread-safe graph operations
+shared_ptr<Graph> graph;  // The current graph
+MSTCache mstCache;       // MST of the current graph, recomputed only when the graph changes
+TimedMutex graphMutex;   // Mutex for thread-safe graph operations, timed for the Stats report
 
-// Command structure to hold client requests
+struct Connection;
+
+// Command structure to hold client requests. Commands are recycled per connection, so their
+// buffers keep the capacity of earlier requests and a steady stream of queries does not allocate.
 struct Command {
-    int clientSocket;   // Socket for client communication
-    string command;     // Command string sent by the client
+    Connection* connection;    // Connection the command came from
+    string command;            // Command string sent by the client
+    ResponseBuilder response;  // Response to send back to the client
+    unique_ptr<ResponseStream> stream;  // Rest of a long response, produced while the socket drains
+    function<void()> afterReply;  // Runs once the response is queued, e.g. starts a job whose notice must follow it
+    bool admitted = true;      // False if the command was shed under overload and is only answered with BUSY
+    ThreadPool::TaskClass taskClass = ThreadPool::NORMAL;  // Pool class the command runs in; NORMAL when run inline
+    JobControl control;        // Deadline of the request; also cancels its MST work once the client hung up
+    ServerMetrics::Clock::time_point received;  // When the line was read, for the latency metrics
+    uint64_t trace = 0;        // Trace id if the request is sampled, 0 otherwise
+    Profiler::Mode profile = Profiler::OFF;  // Set by the Profile prefix
+    Tracer::Clock::time_point stamp;  // When the request entered its current stage, for the trace spans
+};
+
+// A client connection, the command objects reused for its requests and its unsent output
+struct Connection {
+    int socket;
+    SlabPool<Command> commands;
+    string input;              // Receive buffer, only used by the thread handling the socket's event
+    size_t buffered = 0;       // Bytes of an unfinished command kept at the start of input
+    mutex outputMutex;         // Guards the fields below
+    OutputQueue output;        // Responses the socket did not accept yet, in request order
+    bool writeBlocked = false; // True while output waits for the socket to become writable
+    bool readPaused = false;   // True while reading is suspended until output drains
+    bool throttled = false;    // True while reading is suspended until fewer commands are in flight
+    bool inWriteSet = false;   // True once the socket was added to the write epoll set
+    bool sharedMemory = false; // Served by the shared-memory transport; socket is its handshake socket
+    bool closed = false;       // The connection was closed; output for it, such as job notices, is dropped
+    atomic<size_t> inFlight{0};  // Commands queued in the pool and not answered yet
+    atomic<bool> hungUp{false};  // The client closed its end: the MST work of its queued commands is abandoned
+
+    // Commands that span several lines, only used by the thread running the connection's commands
+    int edgesToReceive = 0;    // Edge lines still expected after NewGraph
+    int newVertices = 0;       // Vertices announced by NewGraph
+    vector<pair<pair<uint64_t, uint64_t>, double>> newEdges;  // Edges of the graph being created, on client ids
+    int batchOpsToReceive = 0; // Operation lines still expected after ApplyBatch
+    vector<EdgeOp> batchOps;   // Operations staged for ApplyBatch
+    vector<pair<uint64_t, uint64_t>> batchIds;  // Client ids of their endpoints, looked up when the batch is applied
+
+    // Scratch buffer for the paths of distance queries, kept here rather than in a command: the next
+    // query may get another command object, but the buffer has room for the paths asked for before
+    vector<int> path;
 };
 
-// Function to process client commands
-void processCommand(const Command& cmd) {
-    string response;  // Response to send back to the client
-    static int edgesToReceive = 0;  // Number of edges to receive for graph creation
-    static vector<pair<pair<int, int>, double>> edges;  // Vector to store edges with weights
+// Longest command line buffered while waiting for its newline
+const size_t maxCommandLength = 4096;
+
+unordered_map<int, shared_ptr<Connection>> connections;  // Open connections by socket
+mutex connectionsMutex;  // Guards connections
+
+int epollFd = -1;       // Readiness of the listening socket, the client sockets and writeEpollFd
+int writeEpollFd = -1;  // Sockets with blocked output, waiting to become writable
+IoUringBackend* uring = nullptr;  // Event source and socket I/O when started with --io-uring
+ShmTransport* shm = nullptr;      // Shared-memory channels of local clients
+ThreadPool* poolPtr = nullptr;    // The Leader-Follower pool, nullptr in reactor mode
+JobManager* jobs = nullptr;       // Background MST jobs started with Async
+AdmissionControl admission;       // Limits on the commands queued in the pool
+ServerMetrics metrics;            // Latencies, queues and locks reported by the Stats command
+Tracer tracer;                    // Stage spans of sampled requests, written by TraceDump
+string tracePath;                 // File TraceDump writes, set by --trace-file
+
+// Epoll set of the reactor running on this thread; -1 on pool threads. A reactor owns its
+// connections and processes their commands itself, so it is the only thread touching them.
+thread_local int reactorEpollFd = -1;
+
+// Re-arms a one-shot socket in the epoll set after its event was handled
+void rearm(int epollFd, int fd) {
+    struct epoll_event ev;
+    ev.events = EPOLLIN | EPOLLONESHOT;
+    ev.data.fd = fd;
+    epoll_ctl(epollFd, EPOLL_CTL_MOD, fd, &ev);
+}
+
+// Queues a response behind the unsent output of its connection and writes as much as the socket
+// accepts. A full socket never blocks the worker: the rest is written when the socket drains.
+void sendResponse(Connection& conn, ResponseBuilder& response, unique_ptr<ResponseStream> stream) {
+    unique_lock<mutex> lock(conn.outputMutex);
+    if (conn.closed) {
+        response.clear();  // A job finished after its client left
+        return;
+    }
+    conn.output.push(response);
+    if (stream) conn.output.push(move(stream));
+    if (conn.sharedMemory) {
+        lock.unlock();
+        shm->send(conn.socket);  // The session thread copies the output into the response ring
+        return;
+    }
+    if (uring) {
+        lock.unlock();
+        uring->send(conn.socket);  // Batched with the sends of other workers
+        return;
+    }
+    if (conn.writeBlocked) return;  // Earlier output is still waiting, keep the order
+    if (conn.output.writeTo(conn.socket) != ResponseBuilder::WOULD_BLOCK) return;
+
+    conn.writeBlocked = true;
+    struct epoll_event ev;
+    if (reactorEpollFd >= 0) {
+        // Wait for the socket to drain and stop reading the client's requests meanwhile
+        ev.events = EPOLLOUT;
+        ev.data.fd = conn.socket;
+        epoll_ctl(reactorEpollFd, EPOLL_CTL_MOD, conn.socket, &ev);
+        return;
+    }
+    ev.events = EPOLLOUT | EPOLLONESHOT;
+    ev.data.fd = conn.socket;
+    epoll_ctl(writeEpollFd, conn.inWriteSet ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, conn.socket, &ev);
+    conn.inWriteSet = true;
+}
+
+// Writes the pending output of a connection whose socket became writable
+void flushOutput(Connection& conn) {
+    lock_guard<mutex> lock(conn.outputMutex);
+    if (!conn.writeBlocked) return;
+    if (conn.output.writeTo(conn.socket) == ResponseBuilder::WOULD_BLOCK) {
+        struct epoll_event ev;
+        ev.events = EPOLLOUT | EPOLLONESHOT;
+        ev.data.fd = conn.socket;
+        epoll_ctl(writeEpollFd, EPOLL_CTL_MOD, conn.socket, &ev);
+        return;
+    }
+    conn.writeBlocked = false;
+    if (conn.readPaused) {
+        conn.readPaused = false;
+        if (admission.saturated(conn.inFlight)) {
+            conn.throttled = true;  // Resumes once commands were answered
+        } else {
+            rearm(epollFd, conn.socket);  // Output drained: accept requests again
+        }
+    }
+}
+
+// Drops a connection and closes its socket; unsent output is discarded
+void closeConnection(int fd) {
+    shared_ptr<Connection> conn;
+    {
+        lock_guard<mutex> lock(connectionsMutex);
+        auto it = connections.find(fd);
+        if (it == connections.end()) return;
+        conn = it->second;
+        if (!uring && !conn->sharedMemory) connections.erase(it);  // Dropped before the descriptor can be reused by accept
+    }
+    // io_uring and shared-memory connections are dropped by their transport once no send uses the output any more
+    if (conn->sharedMemory || uring) {
+        {
+            lock_guard<mutex> lock(conn->outputMutex);
+            conn->closed = true;
+        }
+        if (conn->sharedMemory) {
+            shm->close(fd);
+        } else {
+            uring->close(fd);
+        }
+        return;
+    }
+    lock_guard<mutex> lock(conn->outputMutex);  // Waits for a flush in progress on this socket
+    conn->closed = true;
+    conn->writeBlocked = false;
+    conn->output.clear();
+    close(fd);
+}
+
+// Re-arms reading from a client, unless its output is backed up or it has too many commands in
+// flight; then reading resumes once the output drained or commands were answered
+void resumeReading(Connection& conn) {
+    lock_guard<mutex> lock(conn.outputMutex);
+    if (conn.writeBlocked) {
+        conn.readPaused = true;
+    } else if (admission.saturated(conn.inFlight)) {
+        conn.throttled = true;
+    } else {
+        rearm(epollFd, conn.socket);
+    }
+}
+
+// Accounts for an answered pool command, and reads its connection again if it waited for that
+void commandDone(Connection& conn, bool admitted) {
+    if (admitted) admission.release();
+    size_t inFlight = --conn.inFlight;
+    if (admission.saturated(inFlight)) return;
+    lock_guard<mutex> lock(conn.outputMutex);
+    if (!conn.throttled) return;
+    conn.throttled = false;
+    if (uring) {
+        uring->resumeReading(conn.socket);  // The transport also waits for blocked output itself
+    } else if (conn.writeBlocked) {
+        conn.readPaused = true;
+    } else {
+        rearm(epollFd, conn.socket);
+    }
+}
+
+// Listings of up to this many lines are built in place; longer ones are streamed chunk by chunk
+const size_t inlineLines = 1024;
+
+// Reads the optional "offset limit" arguments of a listing command into the range [first, last) of count items
+bool parsePage(const char* arguments, size_t count, size_t& first, size_t& last) {
+    long long offset = 0, limit = -1;
+    int parsed = sscanf(arguments, "%lld %lld", &offset, &limit);
+    first = min(static_cast<size_t>(max(offset, 0LL)), count);
+    last = (parsed == 2 && limit >= 0) ? min(count, first + static_cast<size_t>(limit)) : count;
+    return parsed >= 1;
+}
+
+// Reads the "u v" vertex ids of an edge command and, if `weight` is given, the weight that follows them
+bool parseEdge(const char* arguments, uint64_t& u, uint64_t& v, double* weight = nullptr) {
+    if (!VertexIds::parse(arguments, u) || !VertexIds::parse(arguments, v)) return false;
+    return !weight || sscanf(arguments, "%lf", weight) == 1;
+}
+
+// Appends a path of the MST as client ids joined by " -> ", and ends the line
+void appendPath(ResponseBuilder& response, const Tree& mst, const vector<int>& path) {
+    for (size_t i = 0; i < path.size(); ++i) {
+        response << mst.vertexId(path[i]);
+        if (i < path.size() - 1) response << " -> ";
+    }
+    response << "\n";
+}
+
+// Appends the adjacency lists selected by the optional paging arguments. Called with graphMutex held.
+void appendGraph(Command& cmd, const char* arguments) {
+    size_t first, last, count = graph->getNumNodes();
+    if (parsePage(arguments, count, first, last)) {
+        cmd.response << "\nCurrent Graph (Adjacency List with Weights, vertices " << first + 1 << "-" << last
+                     << " of " << count << "):\n";
+    } else {
+        cmd.response << "\nCurrent Graph (Adjacency List with Weights):\n";
+    }
+    if (last - first <= inlineLines) {
+        graph->printVertices(cmd.response, first + 1, last + 1);
+    } else {
+        cmd.stream = make_unique<GraphPrintStream>(graph, graphMutex, first + 1, last + 1);  // Large graph
+    }
+}
+
+// Appends the MST edges selected by the optional paging arguments. Trees are never modified once
+// built, so a long list is streamed from the tree without holding graphMutex.
+void appendEdgeList(Command& cmd, shared_ptr<const Tree> mst, const char* arguments) {
+    size_t first, last, count = mst->getNumEdges();
+    if (parsePage(arguments, count, first, last)) {
+        cmd.response << "Edges of the MST (" << first + 1 << "-" << last << " of " << count << "):\n";
+    } else {
+        cmd.response << "Edges of the MST:\n";
+    }
+    if (last - first <= inlineLines) {
+        EdgeListStream::printEdges(cmd.response, *mst, first, last);
+    } else {
+        cmd.stream = make_unique<EdgeListStream>(move(mst), first, last);  // Large MST
+    }
+}
+
+// Starts Kruskal or Prim as a background job and replies with its id. Called with graphMutex held.
+// The job works on a copy of the edges, so the graph stays available to other commands while the
+// MST is computed; the tree is cached afterwards if the graph did not change meanwhile.
+void startMSTJob(Command& cmd, MSTFactory::AlgorithmType algorithm, bool notify) {
+    // Copying the edge list is far cheaper than the MST algorithm that runs on it
+    auto edges = make_shared<vector<pair<pair<int, int>, double>>>(graph->getEdges());
+    int n = graph->getNumNodes();
+    shared_ptr<const VertexIds> ids = graph->getVertexIds();  // Never modified, so the job reads it unlocked
+    uint64_t version = graph->getVersion();
+    const char* name = algorithm == MSTFactory::KRUSKAL ? "Kruskal" : "Prim";
+
+    JobManager::Callback finished;
+    if (notify) {
+        // Reactor connections are not shared with other threads, so they can only poll
+        weak_ptr<Connection> owner;
+        {
+            lock_guard<mutex> lock(connectionsMutex);
+            auto it = connections.find(cmd.connection->socket);
+            if (it != connections.end() && it->second.get() == cmd.connection) owner = it->second;
+        }
+        if (owner.expired()) {
+            cmd.response << "Notifications are not available in reactor mode, use JobStatus\n";
+        } else {
+            finished = [owner](const JobManager::Job& job) {
+                shared_ptr<Connection> conn = owner.lock();
+                if (!conn) return;
+                ResponseBuilder notice;
+                JobManager::describe(job, notice);
+                sendResponse(*conn, notice, nullptr);  // Dropped if the connection closed meanwhile
+            };
+        }
+    }
+
+    shared_ptr<JobManager::Job> job = jobs->create(name);
+    job->control.copyDeadline(cmd.control);  // Outlives its client, but not the deadline of its request
+    JobManager::Work work = [edges, n, ids, version, algorithm, name](JobManager::Job& job) {
+        shared_ptr<Tree> tree = MSTCache::compute(n, move(*edges), ids, algorithm, mstCache.threadPool(), &job.control);
+        if (!tree) return;  // Cancelled
+        {
+            lock_guard<TimedMutex> lock(graphMutex);
+            if (graph) mstCache.install(*graph, version, tree, algorithm);  // Served to later queries if still current
+        }
+        ResponseBuilder summary;
+        summary << name << " MST Weight: " << tree->getMSTWeight() << ", " << tree->getNumEdges() << " edges";
+        job.summary = summary.str();
+        job.tree = tree;
+    };
+    cmd.response << "Job " << static_cast<unsigned long long>(job->id) << " started: " << name << "\n";
+    cmd.afterReply = [job, work, finished] { jobs->start(job, work, finished); };  // The notice follows this reply
+}
+
+// Reads the state of the server for the Stats report
+ServerMetrics::Gauges collectGauges() {
+    ServerMetrics::Gauges gauges;
+    gauges.allocationsCounted = Profiler::countsAllocations();
+    gauges.allocations = Profiler::processAllocations();  // Before the report allocates
+    gauges.inFlight = admission.inUse();
+    gauges.shed = admission.shedCount();
+    lock_guard<TimedMutex> lock(graphMutex);
+    if (graph) {
+        gauges.vertices = graph->getNumNodes();
+        gauges.edges = graph->getNumEdges();
+        gauges.graphBytes = graph->memoryUsage();
+    }
+    if (shared_ptr<const Tree> mst = mstCache.share()) gauges.mstBytes = mst->memoryUsage();
+    return gauges;
+}
+
+// Function to process client commands. Returns false without answering if the command runs as
+// LIGHT but would rebuild the MST; the caller then runs it again as a HEAVY task.
+bool processCommand(Command& cmd) {
+    optional<Profiler> profiler;  // Times the command and its MST phases if it came with a Profile prefix
+    if (cmd.profile != Profiler::OFF) profiler.emplace(cmd.profile == Profiler::HARDWARE);
+    ResponseBuilder& response = cmd.response;  // Response to send back to the client
+    response.clear();
+    Connection& conn = *cmd.connection;  // Multi-line commands continue on the connection that started them
+    int& edgesToReceive = conn.edgesToReceive;
+    vector<pair<pair<uint64_t, uint64_t>, double>>& edges = conn.newEdges;
+    int& batchOpsToReceive = conn.batchOpsToReceive;
+    vector<EdgeOp>& batchOps = conn.batchOps;
+    vector<pair<uint64_t, uint64_t>>& batchIds = conn.batchIds;
 
     const string& command = cmd.command;  // Command extracted from the client request
+    bool continuation = edgesToReceive > 0 || batchOpsToReceive > 0;
+    ServerMetrics::CommandType type = !cmd.admitted && !continuation ? ServerMetrics::SHED
+                                                                      : ServerMetrics::commandType(command, continuation);
 
-    if (command.find("NewGraph") == 0) {
+    if (!cmd.admitted && !continuation) {
+        // Shed under overload: answered in order, without touching the graph. Lines that continue an
+        // admitted NewGraph or ApplyBatch still run, so a multi-line command is shed whole or not at all.
+        response << AdmissionControl::busyResponse;
+
+    } else if (command.find("NewGraph") == 0) {
         // Command to create a new graph
         int n, m;
-        sscanf(command.c_str(), "NewGraph %d %d", &n, &m);
-        edgesToReceive = m;  // Set the number of edges expected
-        edges.clear();
-        edges.resize(m);  // Resize edges vector to match the number of edges
-        response = "Creating new graph...\n";
-        response += "Number of vertices: " + to_string(n) + ", Number of edges: " + to_string(m) + "\n";
-        response += "Please provide the edges one by one (format: u v weight):\n";
+        if (sscanf(command.c_str(), "NewGraph %d %d", &n, &m) != 2 || n < 1 || m < 0) {
+            response << "Invalid NewGraph command format. Use: NewGraph n m\n";
+        } else if (static_cast<unsigned long long>(n) > maxGeneratedEdges ||
+                   static_cast<unsigned long long>(m) > maxGeneratedEdges) {
+            // Checked before anything is allocated for the announced sizes
+            response << "Invalid NewGraph size: at most " << maxGeneratedEdges << " vertices and edges.\n";
+        } else {
+            conn.newVertices = n;
+            edgesToReceive = m;  // Set the number of edges expected
+            edges.clear();
+            edges.resize(m);  // Resize edges vector to match the number of edges
+            response << "Creating new graph...\n";
+            response << "Number of vertices: " << n << ", Number of edges: " << m << "\n";
+            response << "Please provide the edges one by one (format: u v weight):\n";
+        }
 
     } else if (edgesToReceive > 0) {
-        // Expecting edges to complete the graph creation
-        int u, v;
+        // Expecting edges to complete the graph creation; vertex ids are any unsigned 64-bit numbers
+        uint64_t u, v;
         double weight;
-        if (sscanf(command.c_str(), "%d %d %lf", &u, &v, &weight) == 3) {
-            // Ensure valid vertex numbers
-            if (u > 0 && v > 0) {
-                edges[edges.size() - edgesToReceive] = {{u, v}, weight};
-                response = "Edge " + to_string(edges.size() - edgesToReceive + 1) +
-                           ": " + to_string(u) + " -> " + to_string(v) + " with weight " + to_string(weight) + "\n";
-                edgesToReceive--;
-
-                if (edgesToReceive == 0) {
-                    // All edges received, create the graph
-                    lock_guard<mutex> lock(graphMutex);
-                    delete graph;  // Delete any existing graph
-                    graph = new Graph(edges.size(), edges);  // Create a new graph
-                    response += "Graph created successfully with " + to_string(edges.size()) + " edges\n";
-
-                    // Capture and send the graph structure
-                    stringstream ss;
-                    streambuf* coutbuf = cout.rdbuf();
-                    cout.rdbuf(ss.rdbuf());
-                    graph->printGraph();
-                    cout.rdbuf(coutbuf);
-                    response += ss.str();
+        if (parseEdge(command.c_str(), u, v, &weight)) {
+            edges[edges.size() - edgesToReceive] = {{u, v}, weight};
+            response << "Edge " << (edges.size() - edgesToReceive + 1) << ": " << u << " -> " << v
+                     << " with weight " << weight << "\n";
+            edgesToReceive--;
+
+            if (edgesToReceive == 0) {
+                // All edges received: number the vertices and build the graph before taking the lock
+                vector<pair<pair<int, int>, double>> dense;
+                shared_ptr<const VertexIds> ids = VertexIds::build(conn.newVertices, edges, dense);
+                auto created = make_shared<Graph>(ids ? ids->size() : conn.newVertices, dense);
+                created->setVertexIds(move(ids));
+                edges.clear();
+                edges.shrink_to_fit();
+
+                lock_guard<TimedMutex> lock(graphMutex);
+                // Replaces any existing graph; responses still streaming it keep it alive until they finish
+                graph = created;
+                mstCache.clear();  // The old MST belongs to the replaced graph
+                response << "Graph created successfully with " << dense.size() << " edges\n";
+                if (created->getVertexIds()) {
+                    // Renumbered ids only know the vertices their edges name, not the n announced
+                    response << "Vertex ids renumbered: " << created->getNumNodes() << " vertices named by the edges, "
+                             << "isolated vertices are not kept\n";
                 }
-            } else {
-                response = "Invalid edge input. Ensure vertices are in range.\n";
+
+                // Send the graph structure
+                appendGraph(cmd, "");
+            }
+        } else {
+            response << "Invalid edge format. Use: u v weight\n";
+        }
+
+    } else if (command.find("GenerateGraph") == 0) {
+        // Command to build a synthetic graph in the server instead of receiving its edges
+        char name[32];
+        int n;
+        unsigned long long m, seed;
+        GraphGenerator::Model model;
+        if (sscanf(command.c_str(), "GenerateGraph %31s %d %llu %llu", name, &n, &m, &seed) != 4 ||
+            !GraphGenerator::parseModel(name, model) || n < 2) {
+            response << "Invalid GenerateGraph command format. Use: GenerateGraph random|grid|geometric|power-law|complete n m seed\n";
+        } else if (static_cast<unsigned long long>(n) > maxGeneratedEdges ||
+                   GraphGenerator::edgeCount(model, n, m) > maxGeneratedEdges) {
+            response << "Invalid GenerateGraph size: at most " << maxGeneratedEdges << " vertices and edges.\n";
+        } else {
+            auto start = chrono::steady_clock::now();
+            // Generated and built without the graph lock, so the other clients keep using the old graph meanwhile
+            auto generated = make_shared<Graph>(n, GraphGenerator::generate(model, n, m, seed, mstCache.threadPool()));
+            {
+                lock_guard<TimedMutex> lock(graphMutex);
+                graph = generated;  // Responses still streaming the old graph keep it alive until they finish
+                mstCache.clear();
             }
+            auto millis = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start).count();
+            response << "Graph generated: " << name << " with " << n << " vertices and "
+                     << generated->getNumEdges() << " edges (seed " << seed << ") in " << millis << " ms\n";
+        }
+
+    } else if (command.find("ApplyBatch") == 0) {
+        // Command to start a batch of edge mutations applied as one transaction
+        int k;
+        if (sscanf(command.c_str(), "ApplyBatch %d", &k) == 1 && k > 0) {
+            batchOpsToReceive = k;
+            batchOps.clear();
+            batchOps.reserve(k);
+            batchIds.clear();
+            batchIds.reserve(k);
+            response << "Starting batch of " << k << " operations.\n";
+            response << "Please provide the operations one by one (NewEdge u v w, RemoveEdge u v, UpdateWeight u v w):\n";
+        } else {
+            response << "Invalid ApplyBatch command format. Use: ApplyBatch k (k > 0)\n";
+        }
+
+    } else if (batchOpsToReceive > 0) {
+        // Expecting operations of the current batch
+        EdgeOp op{EdgeOp::REMOVE, 0, 0, 0};  // Endpoints are looked up when the batch is applied
+        uint64_t u, v;
+        bool parsed = false;
+        if (command.find("NewEdge") == 0) {
+            op.type = EdgeOp::ADD;
+            parsed = parseEdge(command.c_str() + strlen("NewEdge"), u, v, &op.weight);
+        } else if (command.find("UpdateWeight") == 0) {
+            op.type = EdgeOp::UPDATE;
+            parsed = parseEdge(command.c_str() + strlen("UpdateWeight"), u, v, &op.weight);
+        } else if (command.find("RemoveEdge") == 0) {
+            parsed = parseEdge(command.c_str() + strlen("RemoveEdge"), u, v);
+        }
+
+        if (!parsed) {
+            response << "Invalid batch operation. Use: NewEdge u v w, RemoveEdge u v or UpdateWeight u v w\n";
         } else {
-            response = "Invalid edge format. Use: u v weight\n";
+            batchOps.push_back(op);
+            batchIds.push_back({u, v});
+            batchOpsToReceive--;
+            response << "Staged operation " << batchOps.size() << "/" << (batchOps.size() + batchOpsToReceive)
+                     << "\n";
+
+            if (batchOpsToReceive == 0) {
+                // All operations received: apply them under a single lock and update the MST once
+                lock_guard<TimedMutex> lock(graphMutex);
+                size_t failedOp;
+                uint64_t previousVersion = graph ? graph->getVersion() : 0;
+                for (size_t i = 0; graph && i < batchOps.size(); ++i) {
+                    batchOps[i].u = graph->findVertex(batchIds[i].first);  // 0 for an unknown id, which fails validation
+                    batchOps[i].v = graph->findVertex(batchIds[i].second);
+                }
+                if (!graph) {
+                    response << "Graph is not initialized.\n";
+                } else if (!graph->applyBatch(batchOps, failedOp)) {
+                    response << "Batch rejected: operation " << (failedOp + 1) << " (" << batchIds[failedOp].first
+                             << " -> " << batchIds[failedOp].second << ") cannot be applied. No changes were made.\n";
+                } else {
+                    response << "Batch applied: " << batchOps.size() << " operations";
+                    switch (mstCache.update(*graph, batchOps, previousVersion)) {
+                        case MSTCache::INCREMENTAL: response << ", MST updated incrementally\n"; break;
+                        case MSTCache::REBUILT: response << ", MST rebuilt\n"; break;
+                        case MSTCache::NOT_CACHED: response << "\n"; break;
+                    }
+                }
+                batchOps.clear();
+                batchIds.clear();
+            }
         }
 
     } else if (command.find("NewEdge") == 0) {
         // Command to add a new edge to the graph
-        int u, v;
+        uint64_t u, v;
         double weight;
-        if (sscanf(command.c_str(), "NewEdge %d %d %lf", &u, &v, &weight) == 3) {
-            lock_guard<mutex> lock(graphMutex);
+        if (parseEdge(command.c_str() + strlen("NewEdge"), u, v, &weight)) {
+            lock_guard<TimedMutex> lock(graphMutex);
             if (graph) {
-                graph->addEdge(u, v, weight);  // Add the edge to the graph
-                response = "Edge added successfully: " + to_string(u) + " -> " + to_string(v) +
-                           " with weight " + to_string(weight) + "\n";
+                int a = graph->findVertex(u), b = graph->findVertex(v);  // Edges only join vertices the graph was loaded with
+                if (a == 0 || b == 0) {
+                    response << "Invalid edge input. Ensure vertices are in range.\n";
+                } else if (graph->addEdge(a, b, weight)) {  // Add the edge to the graph
+                    response << "Edge added successfully: " << u << " -> " << v << " with weight " << weight << "\n";
+                } else {
+                    response << "Edge already exists: " << u << " -> " << v
+                             << ". Use UpdateWeight to change its weight.\n";
+                }
             } else {
-                response = "Graph is not initialized.\n";
+                response << "Graph is not initialized.\n";
             }
         } else {
-            response = "Invalid NewEdge command format. Use: NewEdge u v weight\n";
+            response << "Invalid NewEdge command format. Use: NewEdge u v weight\n";
         }
 
     } else if (command.find("RemoveEdge") == 0) {
         // Command to remove an edge from the graph
-        int u, v;
-        if (sscanf(command.c_str(), "RemoveEdge %d %d", &u, &v) == 2) {
-            lock_guard<mutex> lock(graphMutex);
+        uint64_t u, v;
+        if (parseEdge(command.c_str() + strlen("RemoveEdge"), u, v)) {
+            lock_guard<TimedMutex> lock(graphMutex);
             if (graph) {
-                graph->removeEdge(u, v);  // Remove the edge
-                response = "Edge removed successfully: " + to_string(u) + " -> " + to_string(v) + "\n";
+                if (graph->removeEdge(graph->findVertex(u), graph->findVertex(v))) {  // Remove the edge
+                    response << "Edge removed successfully: " << u << " -> " << v << "\n";
+                } else {
+                    response << "Edge not found: " << u << " -> " << v << "\n";
+                }
             } else {
-                response = "Graph is not initialized.\n";
+                response << "Graph is not initialized.\n";
             }
         } else {
-            response = "Invalid RemoveEdge command format. Use: RemoveEdge u v\n";
+            response << "Invalid RemoveEdge command format. Use: RemoveEdge u v\n";
+        }
+
+    } else if (command.find("UpdateWeight") == 0) {
+        // Command to change the weight of an existing edge in place
+        uint64_t u, v;
+        double weight;
+        if (parseEdge(command.c_str() + strlen("UpdateWeight"), u, v, &weight)) {
+            lock_guard<TimedMutex> lock(graphMutex);
+            if (graph) {
+                if (graph->updateWeight(graph->findVertex(u), graph->findVertex(v), weight)) {
+                    response << "Edge weight updated: " << u << " -> " << v << " with weight " << weight << "\n";
+                } else {
+                    response << "Edge not found: " << u << " -> " << v << "\n";
+                }
+            } else {
+                response << "Graph is not initialized.\n";
+            }
+        } else {
+            response << "Invalid UpdateWeight command format. Use: UpdateWeight u v weight\n";
+        }
+
+    } else if (command.find("Async") == 0) {
+        // Command to run Kruskal or Prim as a background job: Async Kruskal|Prim [notify]
+        char name[16] = "", option[16] = "";
+        sscanf(command.c_str(), "Async %15s %15s", name, option);
+        bool kruskal = strcmp(name, "Kruskal") == 0, notify = strcmp(option, "notify") == 0;
+        if ((!kruskal && strcmp(name, "Prim") != 0) || (option[0] != '\0' && !notify)) {
+            response << "Invalid Async command format. Use: Async Kruskal|Prim [notify]\n";
+        } else {
+            lock_guard<TimedMutex> lock(graphMutex);
+            if (graph) {
+                startMSTJob(cmd, kruskal ? MSTFactory::KRUSKAL : MSTFactory::PRIM, notify);
+            } else {
+                response << "Graph is not initialized.\n";
+            }
+        }
+
+    } else if (command.find("JobStatus") == 0 || command.find("JobResult") == 0) {
+        // Commands to poll a background job, and to list the MST edges it computed: JobResult id [offset [limit]]
+        bool listEdges = command.find("JobResult") == 0;
+        unsigned long long id;
+        int consumed = 0;
+        if (sscanf(command.c_str() + strlen("JobStatus"), "%llu%n", &id, &consumed) == 1) {
+            shared_ptr<const JobManager::Job> job = jobs->find(id);
+            if (!job) {
+                response << "Unknown job: " << id << "\n";
+            } else {
+                JobManager::describe(*job, response);
+                if (listEdges && job->state == JobManager::DONE) {
+                    appendEdgeList(cmd, job->tree, command.c_str() + strlen("JobResult") + consumed);
+                }
+            }
+        } else {
+            response << "Invalid job command format. Use: JobStatus id or JobResult id [offset [limit]]\n";
+        }
+
+    } else if (command.find("CancelJob") == 0) {
+        // Command to stop a background job
+        unsigned long long id;
+        if (sscanf(command.c_str(), "CancelJob %llu", &id) == 1) {
+            if (jobs->cancel(id)) {
+                response << "Cancelling job " << id << "\n";
+            } else {
+                response << "Job " << id << " is unknown or already ended\n";
+            }
+        } else {
+            response << "Invalid CancelJob command format. Use: CancelJob id\n";
         }
 
     } else if (command.find("Kruskal") == 0) {
         // Command to run Kruskal's algorithm
-        lock_guard<mutex> lock(graphMutex);
+        unique_lock<TimedMutex> lock(graphMutex);
         if (graph) {
-            KruskalMST kruskalMST(*graph);  // Initialize KruskalMST
-            double mstWeight = kruskalMST.findMST();  // Calculate MST weight
-            response = "Kruskal's algorithm executed. MST Weight: " + to_string(mstWeight) + "\n";
-
-            // Store the MST in the tree
-            if (mstTree) delete mstTree;
-            mstTree = new Tree(graph->getNumNodes(), kruskalMST.getMSTEdges());
-
-            response += "Edges of the MST:\n";
-            for (const auto& edge : kruskalMST.getMSTEdges()) {
-                response += to_string(edge.first.first) + " -> " + to_string(edge.first.second) +
-                           " (Weight: " + to_string(edge.second) + ")\n";
+            // Reuses the stored MST when the graph did not change since the last run
+            shared_ptr<Tree> mst = mstCache.refresh(lock, graph, MSTFactory::KRUSKAL, false, &cmd.control);
+            if (mst) {
+                response << "Kruskal's algorithm executed. MST Weight: " << mst->getMSTWeight() << "\n";
+                appendEdgeList(cmd, mst, command.c_str() + strlen("Kruskal"));
+            } else {
+                response << deadlineResponse;  // Aborted; the graph lock is released on return
             }
         } else {
-            response = "Graph is not initialized.\n";
+            response << "Graph is not initialized.\n";
         }
 
     } else if (command.find("Prim") == 0) {
         // Command to run Prim's algorithm
-        lock_guard<mutex> lock(graphMutex);
+        unique_lock<TimedMutex> lock(graphMutex);
         if (graph) {
-            PrimMST primMST(*graph);  // Initialize PrimMST
-            double mstWeight = primMST.findMST();  // Calculate MST weight
-            response = "Prim's algorithm executed. MST Weight: " + to_string(mstWeight) + "\n";
-
-            // Store the MST in the tree
-            if (mstTree) delete mstTree;
-            mstTree = new Tree(graph->getNumNodes(), primMST.getMSTEdges());
-
-            response += "Edges of the MST:\n";
-            for (const auto& edge : primMST.getMSTEdges()) {
-                response += to_string(edge.first.first) + " -> " + to_string(edge.first.second) +
-                           " (Weight: " + to_string(edge.second) + ")\n";
+            // Reuses the stored MST when the graph did not change since the last run
+            shared_ptr<Tree> mst = mstCache.refresh(lock, graph, MSTFactory::PRIM, false, &cmd.control);
+            if (mst) {
+                response << "Prim's algorithm executed. MST Weight: " << mst->getMSTWeight() << "\n";
+                appendEdgeList(cmd, mst, command.c_str() + strlen("Prim"));
+            } else {
+                response << deadlineResponse;  // Aborted; the graph lock is released on return
             }
         } else {
-            response = "Graph is not initialized.\n";
+            response << "Graph is not initialized.\n";
         }
 
     } else if (command.find("MSTWeight") == 0) {
         // Command to return the total weight of the MST
-        if (mstTree) {
-            double mstWeight = mstTree->getMSTWeight();
-            response = "Total MST Weight: " + to_string(mstWeight) + "\n";
+        unique_lock<TimedMutex> lock(graphMutex);
+        if (graph && mustRunHeavy(cmd.taskClass, mstCache, *graph)) {
+            return false;  // Stale after a mutation: the rebuild waits for a HEAVY slot
+        } else if (graph) {
+            shared_ptr<Tree> mst = mstCache.refresh(lock, graph, MSTFactory::KRUSKAL, true, &cmd.control);
+            if (mst) {
+                response << "Total MST Weight: " << mst->getMSTWeight() << "\n";  // O(1) if fresh
+            } else {
+                response << deadlineResponse;
+            }
         } else {
-            response = "MST not calculated. Run Prim or Kruskal first.\n";
+            response << "Graph is not initialized.\n";
         }
 
     } else if (command.find("LongestDistance") == 0) {
         // Command to calculate the longest distance between two vertices
-        int u, v;
-        if (sscanf(command.c_str(), "LongestDistance %d %d", &u, &v) == 2) {
-            if (mstTree) {
-                double distance = mstTree->longestDistance(u, v);
+        uint64_t u, v;
+        if (parseEdge(command.c_str() + strlen("LongestDistance"), u, v)) {
+            unique_lock<TimedMutex> lock(graphMutex);
+            shared_ptr<Tree> tree;  // Rebuilt only if stale
+            int a = graph ? graph->findVertex(u) : 0, b = graph ? graph->findVertex(v) : 0;
+            if (!graph) {
+                response << "Graph is not initialized.\n";
+            } else if (a == 0 || b == 0) {
+                response << "Invalid vertices. Ensure vertices are in range.\n";
+            } else if (!(tree = mstCache.refresh(lock, graph, MSTFactory::KRUSKAL, true, &cmd.control))) {
+                response << deadlineResponse;  // Aborted; the graph lock is released on return
+            } else {
+                Tree& mst = *tree;
+                double distance = mst.longestDistance(a, b);
                 if (distance >= 0) {
-                    response = "Longest Distance between " + to_string(u) + " and " + to_string(v) +
-                               " is: " + to_string(distance) + "\n";
+                    response << "Longest Distance between " << u << " and " << v << " is: " << distance << "\n";
 
                     // Get the longest path
-                    vector<int> path = mstTree->getLongestPath(u, v);
-                    stringstream ss;
-                    ss << "Longest path: ";
-                    for (size_t i = 0; i < path.size(); ++i) {
-                        ss << path[i];
-                        if (i < path.size() - 1) ss << " -> ";
-                    }
-                    ss << "\n";
-                    response += ss.str();
+                    vector<int>& path = conn.path;
+                    mst.getLongestPath(a, b, path);
+                    response << "Longest path: ";
+                    appendPath(response, mst, path);
                 } else {
-                    response = "No path exists between the vertices.\n";
+                    response << "No path exists between the vertices.\n";
                 }
-            } else {
-                response = "MST not calculated. Run Prim or Kruskal first.\n";
             }
         } else {
-            response = "Invalid LongestDistance command format. Use: LongestDistance u v\n";
+            response << "Invalid LongestDistance command format. Use: LongestDistance u v\n";
         }
 
     } else if (command.find("AverageDistance") == 0) {
         // Command to calculate the average distance between two vertices using Floyd-Warshall
-        int u, v;
-        if (sscanf(command.c_str(), "AverageDistance %d %d", &u, &v) == 2) {
-            if (mstTree) {
-                auto [dist, next] = mstTree->floydWarshall();  // Run Floyd-Warshall algorithm
-                double distance = dist[u][v];
+        uint64_t u, v;
+        if (parseEdge(command.c_str() + strlen("AverageDistance"), u, v)) {
+            unique_lock<TimedMutex> lock(graphMutex);
+            shared_ptr<Tree> tree;  // Rebuilt only if stale
+            int a = graph ? graph->findVertex(u) : 0, b = graph ? graph->findVertex(v) : 0;
+            if (!graph) {
+                response << "Graph is not initialized.\n";
+            } else if (a == 0 || b == 0) {
+                response << "Invalid vertices. Ensure vertices are in range.\n";
+            } else if (!(tree = mstCache.refresh(lock, graph, MSTFactory::KRUSKAL, true, &cmd.control)) ||
+                       tree->allPairs(&cmd.control).first.empty()) {
+                response << deadlineResponse;  // Aborted; the graph lock is released on return
+            } else {
+                Tree& mst = *tree;
+                const auto& [dist, next] = mst.allPairs();  // Floyd-Warshall, computed above
+                double distance = dist[a][b];
 
                 if (distance < numeric_limits<double>::infinity()) {
-                    response = "AverageDistance between " + to_string(u) + " and " + to_string(v) + ": " + to_string(distance) + "\n";
+                    response << "AverageDistance between " << u << " and " << v << ": " << distance << "\n";
 
-                    vector<int> path;
-                    mstTree->reconstructPath(u, v, next, path);  // Reconstruct the path
+                    vector<int>& path = conn.path;
+                    path.clear();
+                    mst.reconstructPath(a, b, next, path);  // Reconstruct the path
 
-                    response += "Path from " + to_string(u) + " to " + to_string(v) + ": ";
-                    for (size_t i = 0; i < path.size(); ++i) {
-                        response += to_string(path[i]);
-                        if (i < path.size() - 1) response += " -> ";
-                    }
-                    response += "\n";
+                    response << "Path from " << u << " to " << v << ": ";
+                    appendPath(response, mst, path);
                 } else {
-                    response = "No path exists between the vertices.\n";
+                    response << "No path exists between the vertices.\n";
                 }
-            } else {
-                response = "MST not calculated. Run Prim or Kruskal first.\n";
             }
         } else {
-            response = "Invalid AverageDistance command format. Use: AverageDistance u v\n";
+            response << "Invalid AverageDistance command format. Use: AverageDistance u v\n";
         }
 
     } else if (command.find("ShortestPath") == 0) {
         // Command to calculate the shortest path between two vertices
-        int u, v;
-        if (sscanf(command.c_str(), "ShortestPath %d %d", &u, &v) == 2) {
-            if (mstTree) {
-                auto [dist, next] = mstTree->floydWarshall();  // Run Floyd-Warshall algorithm
-                double distance = dist[u][v];
+        uint64_t u, v;
+        if (parseEdge(command.c_str() + strlen("ShortestPath"), u, v)) {
+            unique_lock<TimedMutex> lock(graphMutex);
+            shared_ptr<Tree> tree;  // Rebuilt only if stale
+            int a = graph ? graph->findVertex(u) : 0, b = graph ? graph->findVertex(v) : 0;
+            if (!graph) {
+                response << "Graph is not initialized.\n";
+            } else if (a == 0 || b == 0) {
+                response << "Invalid vertices. Ensure vertices are in range.\n";
+            } else if (!(tree = mstCache.refresh(lock, graph, MSTFactory::KRUSKAL, true, &cmd.control)) ||
+                       tree->allPairs(&cmd.control).first.empty()) {
+                response << deadlineResponse;  // Aborted; the graph lock is released on return
+            } else {
+                Tree& mst = *tree;
+                const auto& [dist, next] = mst.allPairs();  // Floyd-Warshall, computed above
+                double distance = dist[a][b];
 
                 if (distance < numeric_limits<double>::infinity()) {
-                    response = "Shortest Distance between " + to_string(u) + " and " + to_string(v) + ": " + to_string(distance) + "\n";
+                    response << "Shortest Distance between " << u << " and " << v << ": " << distance << "\n";
 
                     // Reconstruct the shortest path
-                    vector<int> path;
-                    mstTree->reconstructPath(u, v, next, path);
+                    vector<int>& path = conn.path;
+                    path.clear();
+                    mst.reconstructPath(a, b, next, path);
 
-                    response += "Path from " + to_string(u) + " to " + to_string(v) + ": ";
-                    for (size_t i = 0; i < path.size(); ++i) {
-                        response += to_string(path[i]);
-                        if (i < path.size() - 1) response += " -> ";
-                    }
-                    response += "\n";
+                    response << "Path from " << u << " to " << v << ": ";
+                    appendPath(response, mst, path);
                 } else {
-                    response = "No path exists between the vertices.\n";
+                    response << "No path exists between the vertices.\n";
                 }
-            } else {
-                response = "MST not calculated. Run Prim or Kruskal first.\n";
             }
         } else {
-            response = "Invalid ShortestPath command format. Use: ShortestPath u v\n";
+            response << "Invalid ShortestPath command format. Use: ShortestPath u v\n";
         }
 
     } else if (command.find("PrintGraph") == 0) {
         // Command to print the current graph structure
-        lock_guard<mutex> lock(graphMutex);
+        lock_guard<TimedMutex> lock(graphMutex);
         if (graph) {
-            stringstream ss;
-            streambuf* coutbuf = cout.rdbuf();
-            cout.rdbuf(ss.rdbuf());
-            graph->printGraph();
-            cout.rdbuf(coutbuf);
-            response = ss.str();
+            appendGraph(cmd, command.c_str() + strlen("PrintGraph"));  // Optional paging: PrintGraph offset limit
+        } else {
+            response << "Graph is not initialized.\n";
+        }
+
+    } else if (command.find("Stats") == 0) {
+        // Command to report the server's metrics, or with "Stats prometheus" to feed a Prometheus scraper
+        char format[16] = "";
+        sscanf(command.c_str(), "Stats %15s", format);
+        if (format[0] == '\0') {
+            metrics.report(response, collectGauges());
+        } else if (strcmp(format, "prometheus") == 0) {
+            metrics.reportPrometheus(response, collectGauges());
+        } else {
+            response << "Invalid Stats command format. Use: Stats [prometheus]\n";
+        }
+
+    } else if (command.find("TraceDump") == 0) {
+        // Command to write the spans of the sampled requests to the trace file, for chrome://tracing or Perfetto
+        ofstream file(tracePath, ios::trunc);
+        size_t spans = tracer.writeChromeTrace(file);
+        file.close();
+        if (file) {
+            response << "Trace written: " << static_cast<unsigned long long>(spans) << " spans to " << tracePath << "\n";
+        } else {
+            response << "Trace could not be written to " << tracePath << "\n";
+        }
+
+    } else if (command.find("Trace") == 0) {
+        // Command to trace one request in N, or to stop tracing with 0
+        unsigned every;
+        char extra;
+        if (sscanf(command.c_str(), "Trace %u %c", &every, &extra) == 1) {
+            tracer.setSampling(every);
+            if (every == 0) {
+                response << "Tracing off\n";
+            } else {
+                response << "Tracing one request in " << every << "\n";
+            }
         } else {
-            response = "Graph is not initialized.\n";
+            response << "Invalid Trace command format. Use: Trace N (0 turns tracing off)\n";
         }
 
     } else if (command.find("exit") == 0) {
         // Command to exit the server
-        response = "Exiting...\n";
+        response << "Exiting...\n";
 
     } else {
-        response = "Invalid command\n";  // Invalid command received
+        response << "Invalid command\n";  // Invalid command received
     }
 
+    if (profiler) profiler->report(response);  // The profile goes first, then the command's own response
+
     // Send response back to client
-    write(cmd.clientSocket, response.c_str(), response.size());
+    tracer.lap(cmd.trace, Tracer::EXECUTE, cmd.stamp);
+    sendResponse(*cmd.connection, response, move(cmd.stream));
+    tracer.lap(cmd.trace, Tracer::SEND, cmd.stamp);
+    tracer.span(cmd.trace, Tracer::REQUEST, cmd.received, cmd.stamp, ServerMetrics::commandName(type));
+    metrics.recordCommand(type, cmd.received);
+    if (cmd.afterReply) {
+        cmd.afterReply();
+        cmd.afterReply = nullptr;
+    }
+    return true;
 }
 
-int main() {
-    // Server setup
-    int serverSocket, clientSocket;
-    struct sockaddr_in serverAddr, clientAddr;
-    socklen_t addrLen = sizeof(clientAddr);
-    fd_set masterSet;  // Set of file descriptors for select()
+// Runs a command queued in its connection's strand and recycles it, or puts it back in front of
+// the strand as a HEAVY task if it found that it has to rebuild the MST
+void runQueued(Connection* conn, Command* cmd) {
+    tracer.lap(cmd->trace, Tracer::STRAND_QUEUE, cmd->stamp);
+    if (!processCommand(*cmd)) {
+        cmd->taskClass = ThreadPool::HEAVY;
+        poolPtr->enqueueNext(conn->socket, [conn, cmd] { runQueued(conn, cmd); }, ThreadPool::HEAVY);
+        return;
+    }
+    bool admitted = cmd->admitted;
+    conn->commands.release(cmd);  // Ready for the next request of this client
+    commandDone(*conn, admitted);
+}
 
-    ThreadPool pool(4);  // Create thread pool with 4 threads
+// Splits the first `total` bytes of the connection's input into commands and queues them in the
+// connection's strand. A read may carry several commands, and its last line may continue in the next read.
+void queueCommands(Connection* conn, size_t total) {
+    string& input = conn->input;
+    size_t begin = 0;
+    while (true) {
+        size_t end = input.find('\n', begin);
+        if (end == string::npos || end >= total) {
+            if (total - begin < maxCommandLength) break;  // Wait for the rest of the line
+            end = total;  // Overlong line without a newline: take it as it is
+        }
+        if (end > begin) {
+            // Each command goes into a recycled command object, whose buffers already have room
+            Command* cmd = conn->commands.acquire();
+            cmd->connection = conn;
+            cmd->command.assign(input, begin, end - begin);
+            cmd->control.reset();
+            cmd->control.watch(&conn->hungUp);
+            cmd->received = ServerMetrics::Clock::now();
+            cmd->trace = tracer.sample();
+            cmd->stamp = cmd->received;
+            cmd->profile = Profiler::strip(cmd->command);
+            if (long millis = stripDeadline(cmd->command)) {
+                // Counted from now, so time spent queued behind other commands counts too
+                cmd->control.setDeadline(cmd->received + chrono::milliseconds(millis));
+            }
+            if (reactorEpollFd >= 0 || conn->sharedMemory) {
+                // Reactors and shared-memory sessions run their connections' commands themselves, in arrival order
+                cmd->taskClass = ThreadPool::NORMAL;
+                processCommand(*cmd);
+                conn->commands.release(cmd);
+            } else {
+                // The connection's strand keeps its commands in arrival order; the class lets cheap
+                // commands of other connections pass expensive ones. Beyond the queue capacity,
+                // commands are shed and only answered with BUSY, which is cheap.
+                cmd->admitted = admission.admit();
+                cmd->taskClass = cmd->admitted ? classifyCommand(cmd->command) : ThreadPool::LIGHT;
+                conn->inFlight++;
+                poolPtr->enqueue(conn->socket, [conn, cmd] { runQueued(conn, cmd); }, cmd->taskClass);
+            }
+        }
+        begin = end + 1;
+        if (begin >= total) break;
+    }
+    conn->buffered = begin < total ? total - begin : 0;
+    if (conn->buffered > 0) input.erase(0, begin);  // Move the unfinished line to the front
+}
 
-    serverSocket = socket(AF_INET, SOCK_STREAM, 0);  // Create server socket
-    if (serverSocket < 0) {
-        cerr << "Error opening socket" << endl;
-        return 1;
+// Connects a transport that does its own I/O to the connections of this server. The io_uring
+// callbacks run on pool threads, the shared-memory callbacks on the session thread of the channel.
+class TransportHandler : public ConnectionHandler {
+public:
+    explicit TransportHandler(bool sharedMemory) : sharedMemory(sharedMemory) {}
+
+    void accepted(int fd) override {
+        cout << "New " << (sharedMemory ? "shared memory " : "") << "connection on socket " << fd << endl;
+        lock_guard<mutex> lock(connectionsMutex);
+        connections[fd] = make_shared<Connection>();
+        connections[fd]->socket = fd;
+        connections[fd]->sharedMemory = sharedMemory;
     }
 
-    int opt = 1;
-    if (setsockopt(serverSocket, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) < 0) {
-        cerr << "Error setting socket options" << endl;
-        return 1;
+    void received(int fd, const char* data, size_t size) override {
+        shared_ptr<Connection> conn = find(fd);
+        if (!conn) return;  // Closed meanwhile
+        conn->input.resize(conn->buffered);  // Keeps its capacity from one receive to the next
+        conn->input.append(data, size);
+        queueCommands(conn.get(), conn->buffered + size);
+        if (sharedMemory) return;  // The session thread ran the commands already
+        lock_guard<mutex> lock(conn->outputMutex);  // Checked under the lock commandDone() takes to resume
+        if (admission.saturated(conn->inFlight)) {
+            conn->throttled = true;  // Too many commands in flight: stop reading until commandDone() resumes it
+            uring->pauseReading(fd);
+        }
+    }
+
+    void hungUp(int fd) override {
+        if (shared_ptr<Connection> conn = find(fd)) conn->hungUp = true;
+        if (sharedMemory) {
+            closeConnection(fd);  // The session thread already ran the commands
+            return;
+        }
+        // Close the socket after its queued commands ran
+        poolPtr->enqueue(fd, [fd] { closeConnection(fd); });
     }
 
-    memset((char*)&serverAddr, 0, sizeof(serverAddr));  // Clear server address structure
-    serverAddr.sin_family = AF_INET;
-    serverAddr.sin_addr.s_addr = INADDR_ANY;
-    serverAddr.sin_port = htons(9034);  // Set port to 9034
+    int gather(int fd, iovec* iov, int max) override {
+        shared_ptr<Connection> conn = find(fd);
+        if (!conn) return 0;
+        lock_guard<mutex> lock(conn->outputMutex);
+        return conn->output.gather(iov, max);
+    }
 
-    if (bind(serverSocket, (struct sockaddr*)&serverAddr, sizeof(serverAddr)) < 0) {
-        cerr << "Error on binding" << endl;
-        return 1;
+    void sent(int fd, size_t bytes) override {
+        shared_ptr<Connection> conn = find(fd);
+        if (!conn) return;  // Closed meanwhile; its output went with it
+        lock_guard<mutex> lock(conn->outputMutex);
+        conn->output.consume(bytes);
+    }
+
+    void closed(int fd) override {
+        lock_guard<mutex> lock(connectionsMutex);
+        connections.erase(fd);  // Unsent output is discarded with the connection
+    }
+
+private:
+    bool sharedMemory;  // Handles the shared-memory transport rather than io_uring
+
+    static shared_ptr<Connection> find(int fd) {
+        lock_guard<mutex> lock(connectionsMutex);
+        auto it = connections.find(fd);
+        return it == connections.end() ? nullptr : it->second;
     }
+};
 
-    listen(serverSocket, 1);  // Start listening for connections
-    cout << "Server started on port 9034" << endl;
+// Runs one reactor: its own SO_REUSEPORT listener and epoll set on a pinned thread. The kernel
+// spreads new connections over the listeners, and a connection's requests are read, executed and
+// answered on the reactor that accepted it, so it never crosses cores.
+void runReactor(size_t index, int port, int cpu, int unixSocket) {
+    if (!ServerSocket::pinCurrentThread(cpu)) {
+        cerr << "Reactor " << index << " could not be pinned to CPU " << cpu << endl;
+    }
+    int listener = ServerSocket::listenOn(port, true);
+    if (listener < 0) return;
+    fcntl(listener, F_SETFL, fcntl(listener, F_GETFL) | O_NONBLOCK);  // Accept until the queue is empty
+    // Prefer this listener for connections whose packets are processed on this CPU
+    setsockopt(listener, SOL_SOCKET, SO_INCOMING_CPU, &cpu, sizeof(cpu));
 
-    FD_ZERO(&masterSet);  // Initialize the master set
-    FD_SET(serverSocket, &masterSet);  // Add the server socket to the set
+    reactorEpollFd = epoll_create1(0);
+    if (reactorEpollFd < 0) {
+        cerr << "Error creating epoll instance" << endl;
+        return;
+    }
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.fd = listener;
+    epoll_ctl(reactorEpollFd, EPOLL_CTL_ADD, listener, &ev);
+    if (unixSocket >= 0) {
+        fcntl(unixSocket, F_SETFL, fcntl(unixSocket, F_GETFL) | O_NONBLOCK);
+        ev.data.fd = unixSocket;
+        epoll_ctl(reactorEpollFd, EPOLL_CTL_ADD, unixSocket, &ev);
+    }
 
-    // Main loop for accepting client connections
+    unordered_map<int, unique_ptr<Connection>> owned;  // Connections of this reactor, by socket
+    struct epoll_event events[64];
     while (true) {
-        fd_set readSet = masterSet;  // Copy the master set
-        if (select(FD_SETSIZE, &readSet, nullptr, nullptr, nullptr) == -1) {
-            cerr << "Error on select" << endl;
+        int ready = epoll_wait(reactorEpollFd, events, 64, -1);
+        for (int i = 0; i < ready; ++i) {
+            int fd = events[i].data.fd;
+            if (fd == listener || fd == unixSocket) {
+                int clientSocket;
+                while ((clientSocket = accept4(fd, nullptr, nullptr, SOCK_NONBLOCK)) >= 0) {
+                    cout << "New connection on socket " << clientSocket << " (reactor " << index << ")" << endl;
+                    auto conn = make_unique<Connection>();
+                    conn->socket = clientSocket;
+                    owned[clientSocket] = move(conn);
+                    ev.events = EPOLLIN;
+                    ev.data.fd = clientSocket;
+                    epoll_ctl(reactorEpollFd, EPOLL_CTL_ADD, clientSocket, &ev);
+                }
+                continue;
+            }
+
+            auto it = owned.find(fd);
+            if (it == owned.end()) continue;
+            Connection& conn = *it->second;
+
+            if (conn.writeBlocked) {
+                // Only EPOLLOUT is watched while output is backed up: write on, and read again once it drained
+                if (conn.output.writeTo(fd) == ResponseBuilder::WOULD_BLOCK) continue;
+                conn.writeBlocked = false;
+                ev.events = EPOLLIN;
+                ev.data.fd = fd;
+                epoll_ctl(reactorEpollFd, EPOLL_CTL_MOD, fd, &ev);
+                continue;
+            }
+
+            string& input = conn.input;
+            input.resize(conn.buffered + 1023);  // Keeps its capacity from one read to the next
+            int nbytes = read(fd, &input[conn.buffered], 1023);
+            if (nbytes > 0) {
+                queueCommands(&conn, conn.buffered + nbytes);  // Executes the commands right here
+            } else if (nbytes == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+                epoll_ctl(reactorEpollFd, EPOLL_CTL_DEL, fd, nullptr);
+                close(fd);
+                owned.erase(it);  // No command of the connection is in flight
+            }
+        }
+    }
+}
+
+// Completions taken by a leader from io_uring; the same thread handles them after promoting a follower
+thread_local IoUringBackend::Completion uringEvents[16];
+thread_local size_t uringEventCount = 0;
+
+int main(int argc, char* argv[]) {
+    ServerOptions options;
+    if (!ServerSocket::parseOptions(argc, argv, options, true)) return 1;
+    admission.configure(options.queue, options.inflight);
+    metrics.addLock("graph", graphMutex);
+    tracer.setSampling(options.trace);
+    tracePath = options.tracePath;
+
+    // Local clients connect through a Unix domain socket, or exchange commands through shared memory
+    int unixSocket = ServerSocket::listenOnUnix(options.unixPath);
+    if (unixSocket < 0) return 1;
+    TransportHandler shmHandler(true);
+    ShmTransport shmTransport(shmHandler);
+    if (!shmTransport.start(options.shmPath)) return 1;
+    shm = &shmTransport;
+    JobManager jobManager;  // Async jobs run on threads of their own, whatever the mode
+    jobs = &jobManager;
+
+    if (options.reactors > 0) {
+        // Reactor mode: no shared listener and no pool, every reactor serves its own connections.
+        // MST kernels run on the reactor that received the command instead of being forked.
+        vector<int> cpus = ServerSocket::availableCpus();
+        vector<thread> reactors;
+        for (size_t i = 0; i < options.reactors; ++i) {
+            // The first reactor also serves the Unix socket, which cannot be shared with SO_REUSEPORT
+            reactors.emplace_back(runReactor, i, options.port, cpus[i % cpus.size()], i == 0 ? unixSocket : -1);
+        }
+        cout << "Server started on port " << options.port << " with " << options.reactors << " reactors" << endl;
+        cout << "Local clients: " << options.unixPath << ", shared memory " << options.shmPath << endl;
+        for (thread& reactor : reactors) {
+            reactor.join();  // Reactors only return if their setup failed
+        }
+        return 1;
+    }
+
+    // Server setup
+    int serverSocket = ServerSocket::listenOn(options.port, false);
+    if (serverSocket < 0) return 1;
+    cout << "Server started on port " << options.port << endl;
+    cout << "Local clients: " << options.unixPath << ", shared memory " << options.shmPath << endl;
+
+    TransportHandler uringHandler(false);
+    IoUringBackend uringBackend(uringHandler);
+    if (options.ioUring) {
+        if (uringBackend.start(serverSocket)) {
+            uringBackend.addListener(unixSocket);
+            uring = &uringBackend;
+            cout << "Using io_uring" << endl;
+        } else {
+            cout << "io_uring is not available, using epoll" << endl;
+        }
+    }
+
+    // The event source shared by the pool: every socket is registered one-shot, so an event is
+    // delivered to exactly one leader and the socket stays silent until it is re-armed
+    if (!uring) {
+        epollFd = epoll_create1(0);
+        writeEpollFd = epoll_create1(0);
+        if (epollFd < 0 || writeEpollFd < 0) {
+            cerr << "Error creating epoll instance" << endl;
             return 1;
         }
+        struct epoll_event ev;
+        ev.events = EPOLLIN | EPOLLONESHOT;
+        ev.data.fd = serverSocket;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, serverSocket, &ev);
+        ev.data.fd = unixSocket;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, unixSocket, &ev);
+        ev.data.fd = writeEpollFd;  // An epoll set is itself pollable: readable when a blocked socket drained
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, writeEpollFd, &ev);
+    }
 
-        for (int i = 0; i < FD_SETSIZE; ++i) {
-            if (FD_ISSET(i, &readSet)) {
-                if (i == serverSocket) {
-                    clientSocket = accept(serverSocket, (struct sockaddr*)&clientAddr, &addrLen);  // Accept new connection
-                    if (clientSocket != -1) {
-                        cout << "New connection on socket " << clientSocket << endl;
-                        pool.enqueue(clientSocket, [clientSocket] {
-                        // Handling the client in a separate thread from the thread pool
-                        char buffer[1024];
-                        memset(buffer, 0, sizeof(buffer));  // Clear buffer
-
-                        // Process all commands from the client in the same thread
-                        while (true) {
-                            int nbytes = read(clientSocket, buffer, sizeof(buffer) - 1);  // Read data from the client
-                            if (nbytes > 0) {
-                                Command cmd = {clientSocket, string(buffer)};
-
-                                // Process the client command within the same thread
-                                processCommand(cmd);
-
-                                // Clear the buffer after each command to avoid residual data issues
-                                memset(buffer, 0, sizeof(buffer));
-                            } else {
-                                // Close the client socket on error or disconnect
-                                close(clientSocket);
-                                break;
-                            }
-                        }
-                    });
-                    }
+    // The pool's threads start in its constructor, before poolPtr is set. Each thread passes through
+    // startMutex, which main holds until the pool is published, before it first waits for an event.
+    mutex startMutex;
+    unique_lock<mutex> starting(startMutex);
+
+    // The leader waits for one ready socket at a time, or for a batch of io_uring completions
+    auto waitEvent = [&startMutex]() {
+        static thread_local bool started = false;
+        if (!started) {
+            lock_guard<mutex> lock(startMutex);
+            started = true;
+        }
+        if (uring) {
+            uringEventCount = uring->wait(uringEvents, 16);
+            return uringEventCount > 0 ? 0 : -1;
+        }
+        struct epoll_event event;
+        if (epoll_wait(epollFd, &event, 1, -1) != 1) return -1;  // Interrupted, the leader retries
+        return event.data.fd;
+    };
+
+    // Runs on the former leader after a follower was promoted
+    auto handleEvent = [serverSocket, unixSocket](int fd) {
+        if (uring) {
+            for (size_t i = 0; i < uringEventCount; ++i) {
+                uring->dispatch(uringEvents[i]);
+            }
+            uring->submit();  // The leader is asleep in the ring, so submit the follow-up operations here
+            return;
+        }
+
+        if (fd == writeEpollFd) {
+            // Some sockets with backed-up output became writable
+            struct epoll_event events[64];
+            int ready = epoll_wait(writeEpollFd, events, 64, 0);
+            for (int i = 0; i < ready; ++i) {
+                shared_ptr<Connection> conn;
+                {
+                    lock_guard<mutex> lock(connectionsMutex);
+                    auto it = connections.find(events[i].data.fd);
+                    if (it != connections.end()) conn = it->second;
+                }
+                if (conn) flushOutput(*conn);
+            }
+            rearm(epollFd, writeEpollFd);
+            return;
+        }
+
+        if (fd == serverSocket || fd == unixSocket) {
+            int clientSocket = accept(fd, nullptr, nullptr);  // Accept new connection, over TCP or the Unix socket
+            if (clientSocket != -1) {
+                cout << "New connection on socket " << clientSocket << endl;
+                fcntl(clientSocket, F_SETFL, fcntl(clientSocket, F_GETFL) | O_NONBLOCK);  // Writes must never block a worker
+                {
+                    lock_guard<mutex> lock(connectionsMutex);
+                    connections[clientSocket] = make_shared<Connection>();
+                    connections[clientSocket]->socket = clientSocket;
                 }
+                struct epoll_event clientEv;
+                clientEv.events = EPOLLIN | EPOLLONESHOT;
+                clientEv.data.fd = clientSocket;
+                epoll_ctl(epollFd, EPOLL_CTL_ADD, clientSocket, &clientEv);
             }
+            rearm(epollFd, fd);
+            return;
         }
+
+        Connection* conn;
+        {
+            lock_guard<mutex> lock(connectionsMutex);
+            conn = connections.at(fd).get();
+        }
+
+        string& input = conn->input;
+        input.resize(conn->buffered + 1023);  // Keeps its capacity from one read to the next
+        int nbytes = read(fd, &input[conn->buffered], 1023);  // Read data from the client
+        if (nbytes > 0) {
+            queueCommands(conn, conn->buffered + nbytes);
+            resumeReading(*conn);
+        } else if (nbytes < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            resumeReading(*conn);  // Spurious wakeup, nothing to read yet
+        } else {
+            // Close the client socket on error or disconnect, after its queued commands ran
+            conn->hungUp = true;
+            epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+            poolPtr->enqueue(fd, [fd] { closeConnection(fd); });
+        }
+    };
+
+    ThreadPool pool(options.threads ? options.threads : 4, waitEvent, handleEvent);  // 4 threads unless --threads is given
+    poolPtr = &pool;
+    metrics.addQueue("pool_light", pool.queueStats(ThreadPool::LIGHT));
+    metrics.addQueue("pool_normal", pool.queueStats(ThreadPool::NORMAL));
+    metrics.addQueue("pool_heavy", pool.queueStats(ThreadPool::HEAVY));
+    if (options.heavy) pool.setHeavyLimit(options.heavy);  // Commands that may rebuild the MST, 1 at a time by default
+    mstCache.setThreadPool(&pool);  // Idle threads steal the fork-join jobs of the MST kernels
+    starting.unlock();  // Events may be handled from now on
+
+    // The pool threads serve all connections; the main thread only keeps the process alive
+    while (true) {
+        pause();
     }
 
     close(serverSocket);  // Close server socket
@@ -371,36 +1264,87 @@ int main() {
 /*
 Leader-Follower Pattern Implementation:
 
-1. **Adding a Task to the Queue**  
-   - Function: `enqueue(int graphId, function<void()> task)`  
-   - Adds a task to the queue, associating it with a graph identifier (`graphId`).
-   - The queue ensures that tasks related to the same graph are handled by only one thread at a time.
+1. **Waiting for Events as the Leader**  
+   - Function: `ThreadPool::worker()`  
+   - At most one idle thread, the Leader, blocks in `epoll_wait` on the listening socket and all client sockets.
+     The other idle threads are Followers sleeping on a condition variable.
+
+2. **Promoting a Follower**  
+   - Function: `ThreadPool::worker()`  
+   - As soon as the Leader receives an event, it gives up the leader role and wakes one Follower, which becomes the new Leader.
+     Sockets are registered with `EPOLLONESHOT`, so each event is handled by exactly one thread.
+
+3. **Processing the Event**  
+   - Function: `handleEvent` in `main()`  
+   - The former Leader accepts the new connection, or reads the client's commands and enqueues them, then re-arms the socket.
+     No thread blocks in `read` waiting for a client, so the number of clients is not limited by the number of threads.
+   - Responses are written with a gathering `sendmsg` on non-blocking sockets. What a full socket does not accept stays queued on the
+     connection and is written by a Leader once the socket is writable; meanwhile the client's requests are not read.
+   - With `--io-uring` the Leader waits on the completion queue instead and takes up to 16 completions at once.
+     Workers only queue their output; the next Leader submits the sends of all workers in one `io_uring_enter`.
+
+4. **Serializing Commands per Connection with Strands**  
+   - Function: `enqueue(int strandId, Task task, TaskClass taskClass)`  
+   - Commands are queued in the strand of their connection. A strand runs one task at a time in FIFO order;
+     while a connection's command runs, its next commands wait in the strand without occupying or spinning a thread.
+     Commands of different connections run side by side and meet only at the graph lock.
+
+5. **Running Strands by Cost Class**  
+   - Functions: `classifyCommand()`, `mustRunHeavy()`, `runQueued()`, `ThreadPool::takeReadyStrand()`, `ThreadPool::runStrand()`  
+   - Every command is LIGHT (`MSTWeight`, job polling), HEAVY (anything that may rebuild the MST) or NORMAL.
+     A ready strand waits in the queue of its next command's class, and idle threads serve the queues by weighted
+     round robin (8:4:1), so a lookup never waits behind a row of `Kruskal` runs. At most `--heavy N` HEAVY
+     commands run at once (1 by default), which keeps threads free for the others. An `MSTWeight` that finds the
+     cached MST stale does not rebuild it in its LIGHT slot: `runQueued()` puts it back in front of its strand as a
+     HEAVY task (`ThreadPool::enqueueNext()`), so rebuilds stay under the cap and the connection's order is kept. A Kruskal rebuild sorts a
+     copy of the edges without the graph lock, so other connections' commands do not wait for it either.
+
+6. **Reactors**  
+   - Function: `runReactor()`  
+   - With `--reactors N` there is no pool: each reactor thread is pinned to a CPU, listens on its own `SO_REUSEPORT`
+     socket and runs the commands of its connections itself, so a connection is served on a single core.
+
+7. **Background Jobs**  
+   - Function: `startMSTJob()`  
+   - `Async Kruskal|Prim` copies the edge list and hands the MST to the `JobManager` threads, so the strand and the
+     connection move on at once. Clients poll the job or get its status line pushed when it ends.
+   - `Deadline ms` before a command gives its `JobControl` a deadline; the MST kernels and Floyd-Warshall check it,
+     and the client's hang-up, at bounded intervals and stop early, releasing the graph lock.
 
-2. **Thread Becomes the Leader and Picks a Task**  
-   - Function: `worker()`  
-   - One of the threads takes the first task from the queue and starts processing it as the Leader.
+8. **Admission Control**  
+   - Functions: `AdmissionControl::admit()`, `commandDone()`  
+   - At most `--queue N` commands (512 by default) are queued or running in the pool. Beyond that a command is not
+     executed but answered with `BUSY` in its place in the response order, so an overload is refused in microseconds
+     instead of growing every strand. A connection with `--inflight N` commands in flight (32 by default) is not
+     read until one of them was answered, so a single client cannot fill the queue on its own.
 
-3. **Locking the Graph by graphId**  
-   - Function: `worker()`  
-   - The thread checks if the graph with the given `graphId` is already locked.
-     If it is locked, the task is returned to the queue.  
-     If not, the thread locks the graph to prevent other threads from accessing it simultaneously.
+9. **Metrics**  
+   - Functions: `ServerMetrics::recordCommand()`, `collectGauges()`  
+   - Each command's latency, from reading its line to queueing its response, goes into the calling thread's shard of
+     `ServerMetrics`. The pool's class queues and the graph lock (`TimedMutex`) keep their own waiting and holding times.
+     `Stats` merges them into a text or Prometheus report.
 
-4. **Performing All Operations on the Same Graph**  
-   - Function: `processCommand(const Command& cmd)`  
-   - The thread performs all commands related to the graph in sequence without interruptions.
+10. **Tracing**  
+   - Functions: `Tracer::sample()`, `Tracer::lap()`  
+   - With `--trace N` or `Trace N`, one request in N gets a trace id. Its time in the strand queue, executing and
+     sending goes as spans into the ring buffer of the thread that recorded them, without a lock; `TraceDump` writes
+     the spans of all threads to `--trace-file` as Chrome trace-event JSON.
 
-5. **Releasing the Lock After the Task is Complete**  
-   - Function: `worker()`  
-   - Once the thread finishes processing the task, it releases the lock on the graph, allowing other threads to work on it if needed.
+11. **Profiling**  
+   - Functions: `processCommand()`, `Profiler::report()`  
+   - `Profile [hw] command` runs the command under a `Profiler` active on its thread. The MST kernels add their
+     phase times and hot-loop counters to it through macros that only `make profile` compiles in, and the profile
+     goes in front of the command's response.
 
-6. **Waiting for New Tasks**  
-   - Function: `worker()`  
-   - After releasing the lock, the thread returns to wait for new tasks from the queue. If a new task arrives, the thread becomes the Leader again and handles it.
+12. **Vertex Ids**  
+   - Functions: `VertexIds::build()`, `Graph::findVertex()`, `Graph::vertexId()`  
+   - Clients name vertices by any 64-bit ids. `NewGraph` numbers them densely once its last edge arrived, unless
+     they already are 1..n, and the graph and its trees share the table; commands look ids up and responses print them back.
+     A renumbered graph only has the vertices its edges name, which the `NewGraph` reply reports.
 
 Purpose of the Implementation:
-- **Prevents Conflicts**: Only one thread works on a specific graph at any given time.
-- **Improves Performance**: All operations on a graph are handled by the same thread, improving cache locality and minimizing context switching.
-- **Simplifies Task Management**: Tasks are organized in a queue, and the leading thread completes the entire task before releasing the graph for others.
+- **Prevents Conflicts**: The graph lock lets only one thread work on the graph at any given time, and never for the length of an MST sort.
+- **Scales with Connections**: Threads are only busy while there is an event or a command to process.
+- **Keeps Order**: Commands of a client are executed and answered in the order they were sent.
 
 */
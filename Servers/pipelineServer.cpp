@@ -2,451 +2,1277 @@
 #include <vector>
 #include <string>
 #include <functional>  // For std::function
+#include <memory>
+#include <atomic>
+#include <unordered_map>
+#include <chrono>
 #include <mutex>
-#include <queue>
 #include <thread>
-#include <condition_variable>
 #include <netinet/in.h>
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <sys/select.h>
-#include <sstream>
-#include <cstring>  // For bzero
+#include <cstring>  // For strlen
+#include <cerrno>
+#include <fcntl.h>
+#include <fstream>
 #include "../src/hpp_files/Graph.hpp"
+#include "../src/hpp_files/GraphGenerator.hpp"
 #include "../src/hpp_files/KruskalMST.hpp"
 #include "../src/hpp_files/PrimMST.hpp"
 #include "../src/hpp_files/Tree.hpp"
+#include "../src/hpp_files/MSTCache.hpp"
+#include "../src/hpp_files/ThreadPool.hpp"
+#include "../src/hpp_files/MPSCQueue.hpp"
+#include "../src/hpp_files/SlabPool.hpp"
+#include "../src/hpp_files/ResponseBuilder.hpp"
+#include "../src/hpp_files/OutputQueue.hpp"
+#include "../src/hpp_files/IoUringBackend.hpp"
+#include "../src/hpp_files/ServerSocket.hpp"
+#include "../src/hpp_files/ShmTransport.hpp"
+#include "../src/hpp_files/JobManager.hpp"
+#include "../src/hpp_files/CommandClass.hpp"
+#include "../src/hpp_files/AdmissionControl.hpp"
+#include "../src/hpp_files/ServerMetrics.hpp"
+#include "../src/hpp_files/Tracer.hpp"
+#include "../src/hpp_files/Profiler.hpp"
 
 using namespace std;
 
-// Structure to represent a client command
+struct Connection;
+
+IoUringBackend* uring = nullptr;  // Event source and socket I/O when started with --io-uring
+ShmTransport* shm = nullptr;      // Shared-memory channels of local clients
+JobManager* jobs = nullptr;       // Background MST jobs started with Async
+AdmissionControl admission;       // Limits on the commands in the pipeline
+ServerMetrics metrics;            // Latencies, queues and locks reported by the Stats command
+Tracer tracer;                    // Stage spans of sampled requests, written by TraceDump
+string tracePath;                 // File TraceDump writes, set by --trace-file
+
+// Message passed between the pipeline stages: the command on the way in, the response on the way out.
+// Commands are recycled per connection, so their buffers keep the capacity of earlier requests and
+// a steady stream of queries does not allocate.
 struct Command {
-    int clientSocket;
+    shared_ptr<Connection> connection;  // Keeps the socket open until the response is sent
+    uint64_t sequence;                  // Position of the request on its connection
     string command;
+    ResponseBuilder response;
+    unique_ptr<ResponseStream> stream;  // Rest of a long response, produced while the socket drains
+    function<void()> afterReply;        // Runs once the response is queued, e.g. starts a job whose notice must follow it
+    bool admitted;                      // False if the command was shed under overload and is only answered with BUSY
+    ThreadPool::TaskClass taskClass;    // Class of the command's task in graphPool
+    JobControl control;                 // Deadline of the request; also cancels its MST work once the client hung up
+    ServerMetrics::Clock::time_point received;  // When the line was read, for the latency metrics
+    ServerMetrics::CommandType type;    // Kind of request, set by the graph stage
+    uint64_t trace;                     // Trace id if the request is sampled, 0 otherwise
+    Tracer::Clock::time_point stamp;    // When the request entered its current stage, for the trace spans
+    Profiler::Mode profile;             // Set by the Profile prefix
 };
 
-// ActiveObject class manages a thread to process tasks asynchronously.
+// State shared by all in-flight commands of one client connection
+struct Connection {
+    int socket;                          // Client socket, closed when the last command is done with it
+    uint64_t nextSequence = 0;           // Sequence number of the next request (reader thread only)
+    SlabPool<Command> commands;          // Command objects reused for the requests of this connection
+    string input;                        // Receive buffer (reader thread only)
+    size_t buffered = 0;                 // Bytes of an unfinished command kept at the start of input
+    atomic<size_t> inFlight{0};          // Commands submitted and not answered yet
+    // The client closed its end; output for it, such as job notices, is dropped and the MST work of its
+    // pending commands is abandoned. Set under sendMutex
+    atomic<bool> hungUp{false};
+    mutex sendMutex;                     // Guards the fields below
+    uint64_t nextToSend = 0;             // Sequence number of the next response to write
+    vector<Command*> outOfOrder;         // Commands whose response finished before an earlier one
+    OutputQueue output;                  // Responses the socket did not accept yet, in request order
+    bool writeBlocked = false;           // True while output waits for the socket to become writable
+    bool readPaused = false;             // Reading suspended until output drains (main thread only)
+    bool throttled = false;              // Reading suspended until fewer commands are in flight
+    bool sharedMemory;                   // Served by the shared-memory transport; socket is its handshake socket
+
+    // Commands that span several lines (graph stage only)
+    int edgesToReceive = 0;              // Edge lines still expected after NewGraph
+    int newVertices = 0;                 // Vertices announced by NewGraph
+    vector<pair<pair<uint64_t, uint64_t>, double>> newEdges;  // Edges of the graph being created, on client ids
+    int batchOpsToReceive = 0;           // Operation lines still expected after ApplyBatch
+    vector<EdgeOp> batchOps;             // Operations staged for ApplyBatch
+    vector<pair<uint64_t, uint64_t>> batchIds;  // Client ids of their endpoints, looked up when the batch is applied
+
+    // Scratch buffer for the paths of distance queries (graph stage only), kept here rather than in a
+    // command: the next query may get another command object, but the buffer has room for the paths asked for before
+    vector<int> path;
+
+    Connection(int socket, bool sharedMemory = false) : socket(socket), sharedMemory(sharedMemory) { outOfOrder.reserve(16); }
+    ~Connection() {
+        if (!uring && !sharedMemory) close(socket);  // Otherwise the transport closes the socket
+    }
+};
+
+// Longest command line buffered while waiting for its newline
+const size_t maxCommandLength = 4096;
+
+// ActiveObject class manages a thread that processes messages of one pipeline stage.
+// Messages travel through a bounded lock-free ring buffer instead of heap-allocated closures,
+// stamped with the time they were submitted for the queue gauge of the stage.
+template <typename Message>
 class ActiveObject {
 public:
-    using Task = std::function<void()>;
+    using Handler = function<void(Message&)>;
 
-    ActiveObject() : stopFlag(false), workerThread(&ActiveObject::run, this) {}
+    ActiveObject(Handler handler, size_t capacity = 1024)
+        : handler(move(handler)), messages(capacity), workerThread(&ActiveObject::run, this) {}
 
     ~ActiveObject() {
-        stop();
+        messages.close();
         workerThread.join();
     }
 
-    // Submit a new task to the active object
-    void submit(Task task) {
-        unique_lock<mutex> lock(queueMutex);
-        taskQueue.push(move(task));
-        condition.notify_one();
+    // Submit a new message to the active object, waiting while its queue is full
+    void submit(Message message) {
+        messages.push({move(message), gauge.enqueued()});
     }
 
+    // Depth of the queue and how long messages waited in it
+    const QueueGauge& queueStats() const { return gauge; }
+
 private:
-    queue<Task> taskQueue;
-    mutex queueMutex;
-    condition_variable condition;
-    bool stopFlag;
+    struct Envelope {
+        Message message;
+        QueueGauge::Clock::time_point submitted;
+    };
+
+    Handler handler;
+    QueueGauge gauge;
+    MPSCQueue<Envelope> messages;
     thread workerThread;
 
-    // The run function continuously processes tasks from the queue
+    // The run function continuously processes messages from the queue
     void run() {
-        while (true) {
-            Task task;
-            {
-                unique_lock<mutex> lock(queueMutex);
-                condition.wait(lock, [this] { return stopFlag || !taskQueue.empty(); });
-                if (stopFlag && taskQueue.empty()) break;
-                task = move(taskQueue.front());
-                taskQueue.pop();
+        Envelope envelope;
+        while (messages.pop(envelope)) {
+            gauge.dequeued(envelope.submitted);
+            handler(envelope.message);  // Execute the stage on the message
+        }
+    }
+};
+
+// Global variables for thread synchronization
+TimedMutex graphMutex;  // Timed for the Stats report
+
+// The graph and the cached MST of it
+shared_ptr<Graph> graph;
+MSTCache mstCache;
+
+// Self-pipe that wakes the select loop when a response stage left output on a full socket, or let a
+// throttled connection be read again
+int wakePipe[2];
+mutex blockedMutex;
+vector<int> blockedSockets;  // Sockets that became blocked since the select loop last looked, guarded by blockedMutex
+vector<int> resumedSockets;  // Throttled sockets to read again, guarded by blockedMutex
+
+// Hands a socket to the select loop: to watch it for writability, or to read it again
+void notifySelectLoop(int socket, bool blocked) {
+    {
+        lock_guard<mutex> lock(blockedMutex);
+        (blocked ? blockedSockets : resumedSockets).push_back(socket);
+    }
+    char wake = 1;
+    if (write(wakePipe[1], &wake, 1) < 0) {
+        // The pipe is full, so the select loop is already due to wake up
+    }
+}
+
+// Queues a response behind the unsent output of its connection and writes as much as the socket
+// accepts. A full socket never blocks the stage: the select loop writes the rest when it drains.
+// Called with conn.sendMutex held.
+void sendResponse(Connection& conn, ResponseBuilder& response, unique_ptr<ResponseStream> stream) {
+    conn.output.push(response);
+    if (stream) conn.output.push(move(stream));
+    if (conn.sharedMemory) {
+        shm->send(conn.socket);  // The session thread copies the output into the response ring
+        return;
+    }
+    if (uring) {
+        uring->send(conn.socket);  // The main thread submits the sends of all responders together
+        return;
+    }
+    if (conn.writeBlocked) return;  // Earlier output is still waiting, keep the order
+    if (conn.output.writeTo(conn.socket) != ResponseBuilder::WOULD_BLOCK) return;
+
+    conn.writeBlocked = true;
+    notifySelectLoop(conn.socket, true);
+}
+
+// Stops reading a connection that has too many commands in flight; finishCommand() resumes it.
+// Called by the thread that reads the connection after submitting its commands.
+// @return true if the select loop must take the socket out of its read set.
+bool throttle(Connection& conn) {
+    lock_guard<mutex> lock(conn.sendMutex);  // Checked under the lock finishCommand() takes to resume
+    if (!admission.saturated(conn.inFlight)) return false;
+    conn.throttled = true;
+    if (conn.sharedMemory) {
+        shm->pauseReading(conn.socket);
+    } else if (uring) {
+        uring->pauseReading(conn.socket);
+    }
+    return true;
+}
+
+// Sends the response of a command and returns the command to its connection
+void finishCommand(Connection& conn, Command* cmd) {
+    sendResponse(conn, cmd->response, move(cmd->stream));
+    tracer.lap(cmd->trace, Tracer::SEND, cmd->stamp);
+    tracer.span(cmd->trace, Tracer::REQUEST, cmd->received, cmd->stamp, ServerMetrics::commandName(cmd->type));
+    metrics.recordCommand(cmd->type, cmd->received);
+    if (cmd->afterReply) {
+        cmd->afterReply();
+        cmd->afterReply = nullptr;
+    }
+    conn.nextToSend++;
+    if (cmd->admitted) admission.release();
+    size_t inFlight = --conn.inFlight;
+    if (conn.throttled && !admission.saturated(inFlight)) {
+        conn.throttled = false;  // Read the client's next commands
+        if (conn.sharedMemory) {
+            shm->resumeReading(conn.socket);
+        } else if (uring) {
+            uring->resumeReading(conn.socket);
+        } else {
+            notifySelectLoop(conn.socket, false);
+        }
+    }
+    if (conn.hungUp && conn.nextToSend == conn.nextSequence) {
+        // Last response to a client that hung up
+        if (conn.sharedMemory) {
+            shm->close(conn.socket);
+        } else if (uring) {
+            uring->close(conn.socket);
+        }  // A plain socket closes with the last reference to the connection
+    }
+    cmd->connection.reset();  // The caller still holds a reference to the connection
+    conn.commands.release(cmd);
+}
+
+// Sends the response of a command in request order, whichever response stage finished it first
+void deliverResponse(Command* cmd) {
+    shared_ptr<Connection> connection = cmd->connection;  // The last command may be the last owner
+    Connection& conn = *connection;
+    lock_guard<mutex> lock(conn.sendMutex);
+    if (cmd->sequence != conn.nextToSend) {
+        conn.outOfOrder.push_back(cmd);  // An earlier response is still on its way
+        return;
+    }
+    finishCommand(conn, cmd);
+
+    // Flush the responses that were waiting for this one
+    bool flushed = true;
+    while (flushed) {
+        flushed = false;
+        for (size_t i = 0; i < conn.outOfOrder.size(); ++i) {
+            if (conn.outOfOrder[i]->sequence == conn.nextToSend) {
+                Command* next = conn.outOfOrder[i];
+                conn.outOfOrder[i] = conn.outOfOrder.back();
+                conn.outOfOrder.pop_back();
+                tracer.lap(next->trace, Tracer::REORDER, next->stamp);
+                finishCommand(conn, next);
+                flushed = true;
+                break;
             }
-            task();  // Execute the task
         }
     }
+}
 
-    // Stop the active object by setting the stop flag
-    void stop() {
-        unique_lock<mutex> lock(queueMutex);
-        stopFlag = true;
-        condition.notify_all();
+// Listings of up to this many lines are built in place; longer ones are streamed chunk by chunk
+const size_t inlineLines = 1024;
+
+// Reads the optional "offset limit" arguments of a listing command into the range [first, last) of count items
+bool parsePage(const char* arguments, size_t count, size_t& first, size_t& last) {
+    long long offset = 0, limit = -1;
+    int parsed = sscanf(arguments, "%lld %lld", &offset, &limit);
+    first = min(static_cast<size_t>(max(offset, 0LL)), count);
+    last = (parsed == 2 && limit >= 0) ? min(count, first + static_cast<size_t>(limit)) : count;
+    return parsed >= 1;
+}
+
+// Reads the "u v" vertex ids of an edge command and, if `weight` is given, the weight that follows them
+bool parseEdge(const char* arguments, uint64_t& u, uint64_t& v, double* weight = nullptr) {
+    if (!VertexIds::parse(arguments, u) || !VertexIds::parse(arguments, v)) return false;
+    return !weight || sscanf(arguments, "%lf", weight) == 1;
+}
+
+// Appends a path of the MST as client ids joined by " -> ", and ends the line
+void appendPath(ResponseBuilder& response, const Tree& mst, const vector<int>& path) {
+    for (size_t i = 0; i < path.size(); ++i) {
+        response << mst.vertexId(path[i]);
+        if (i < path.size() - 1) response << " -> ";
     }
-};
+    response << "\n";
+}
 
-// Global variables for thread synchronization and task management
-mutex graphMutex;  
-mutex queueMutex;
-condition_variable queueCondition;
-queue<Command> commandQueue;
+// Appends the adjacency lists selected by the optional paging arguments. Called with graphMutex held.
+void appendGraph(Command& cmd, const char* arguments) {
+    size_t first, last, count = graph->getNumNodes();
+    if (parsePage(arguments, count, first, last)) {
+        cmd.response << "\nCurrent Graph (Adjacency List with Weights, vertices " << first + 1 << "-" << last
+                     << " of " << count << "):\n";
+    } else {
+        cmd.response << "\nCurrent Graph (Adjacency List with Weights):\n";
+    }
+    if (last - first <= inlineLines) {
+        graph->printVertices(cmd.response, first + 1, last + 1);
+    } else {
+        cmd.stream = make_unique<GraphPrintStream>(graph, graphMutex, first + 1, last + 1);  // Large graph
+    }
+}
 
-// Pointers to the graph and MST tree
-Graph* graph = nullptr;
-Tree* mstTree = nullptr;
+// Appends the MST edges selected by the optional paging arguments. Trees are never modified once
+// built, so a long list is streamed from the tree without holding graphMutex.
+void appendEdgeList(Command& cmd, shared_ptr<const Tree> mst, const char* arguments) {
+    size_t first, last, count = mst->getNumEdges();
+    if (parsePage(arguments, count, first, last)) {
+        cmd.response << "Edges of the MST (" << first + 1 << "-" << last << " of " << count << "):\n";
+    } else {
+        cmd.response << "Edges of the MST:\n";
+    }
+    if (last - first <= inlineLines) {
+        EdgeListStream::printEdges(cmd.response, *mst, first, last);
+    } else {
+        cmd.stream = make_unique<EdgeListStream>(move(mst), first, last);  // Large MST
+    }
+}
+
+// Starts Kruskal or Prim as a background job and replies with its id. Called with graphMutex held.
+// The job works on a copy of the edges, so the graph stage moves on to the next command while the
+// MST is computed; the tree is cached afterwards if the graph did not change meanwhile.
+void startMSTJob(Command& cmd, MSTFactory::AlgorithmType algorithm, bool notify) {
+    // Copying the edge list is far cheaper than the MST algorithm that runs on it
+    auto edges = make_shared<vector<pair<pair<int, int>, double>>>(graph->getEdges());
+    int n = graph->getNumNodes();
+    shared_ptr<const VertexIds> ids = graph->getVertexIds();  // Never modified, so the job reads it unlocked
+    uint64_t version = graph->getVersion();
+    const char* name = algorithm == MSTFactory::KRUSKAL ? "Kruskal" : "Prim";
 
-// ActiveObjects for different pipeline stages
-ActiveObject commandParser, graphOperator, responseHandler;
+    JobManager::Callback finished;
+    if (notify) {
+        weak_ptr<Connection> owner = cmd.connection;
+        finished = [owner](const JobManager::Job& job) {
+            shared_ptr<Connection> conn = owner.lock();
+            if (!conn) return;
+            ResponseBuilder notice;
+            JobManager::describe(job, notice);
+            lock_guard<mutex> lock(conn->sendMutex);
+            if (!conn->hungUp) sendResponse(*conn, notice, nullptr);  // Between two responses, never inside one
+        };
+    }
+
+    shared_ptr<JobManager::Job> job = jobs->create(name);
+    job->control.copyDeadline(cmd.control);  // Outlives its client, but not the deadline of its request
+    JobManager::Work work = [edges, n, ids, version, algorithm, name](JobManager::Job& job) {
+        shared_ptr<Tree> tree = MSTCache::compute(n, move(*edges), ids, algorithm, mstCache.threadPool(), &job.control);
+        if (!tree) return;  // Cancelled
+        {
+            lock_guard<TimedMutex> lock(graphMutex);
+            if (graph) mstCache.install(*graph, version, tree, algorithm);  // Served to later queries if still current
+        }
+        ResponseBuilder summary;
+        summary << name << " MST Weight: " << tree->getMSTWeight() << ", " << tree->getNumEdges() << " edges";
+        job.summary = summary.str();
+        job.tree = tree;
+    };
+    cmd.response << "Job " << static_cast<unsigned long long>(job->id) << " started: " << name << "\n";
+    cmd.afterReply = [job, work, finished] { jobs->start(job, work, finished); };  // The notice follows this reply
+}
 
-void sendResponse(int clientSocket, const std::string& response) {
-    write(clientSocket, response.c_str(), response.size());
+// Reads the state of the server for the Stats report
+ServerMetrics::Gauges collectGauges() {
+    ServerMetrics::Gauges gauges;
+    gauges.allocationsCounted = Profiler::countsAllocations();
+    gauges.allocations = Profiler::processAllocations();  // Before the report allocates
+    gauges.inFlight = admission.inUse();
+    gauges.shed = admission.shedCount();
+    lock_guard<TimedMutex> lock(graphMutex);
+    if (graph) {
+        gauges.vertices = graph->getNumNodes();
+        gauges.edges = graph->getNumEdges();
+        gauges.graphBytes = graph->memoryUsage();
+    }
+    if (shared_ptr<const Tree> mst = mstCache.share()) gauges.mstBytes = mst->memoryUsage();
+    return gauges;
 }
 
-// Function to parse a command and pass it to the appropriate pipeline stage
-void handleCommand(const Command& cmd) {
-    string response;  // Response to send back to the client
-    static int edgesToReceive = 0;  // Number of edges to receive for graph creation
-    static vector<pair<pair<int, int>, double>> edges;  // Vector to store edges with weights
+// Function to execute a command on the graph, storing the reply in cmd.response. Returns false
+// without a reply if the command runs as LIGHT but would rebuild the MST, so it has to run as HEAVY.
+bool handleCommand(Command& cmd) {
+    ResponseBuilder& response = cmd.response;  // Response to send back to the client
+    response.clear();
+    Connection& conn = *cmd.connection;  // Multi-line commands continue on the connection that started them
+    int& edgesToReceive = conn.edgesToReceive;
+    vector<pair<pair<uint64_t, uint64_t>, double>>& edges = conn.newEdges;
+    int& batchOpsToReceive = conn.batchOpsToReceive;
+    vector<EdgeOp>& batchOps = conn.batchOps;
+    vector<pair<uint64_t, uint64_t>>& batchIds = conn.batchIds;
 
     const string& command = cmd.command;  // Command extracted from the client request
+    bool continuation = edgesToReceive > 0 || batchOpsToReceive > 0;
+    cmd.type = !cmd.admitted && !continuation ? ServerMetrics::SHED : ServerMetrics::commandType(command, continuation);
+
+    if (!cmd.admitted && !continuation) {
+        // Shed under overload: answered in order, without touching the graph. Lines that continue an
+        // admitted NewGraph or ApplyBatch still run, so a multi-line command is shed whole or not at all.
+        response << AdmissionControl::busyResponse;
 
-    if (command.find("NewGraph") == 0) {
+    } else if (command.find("NewGraph") == 0) {
         // Command to create a new graph
         int n, m;
-        sscanf(command.c_str(), "NewGraph %d %d", &n, &m);
-        edgesToReceive = m;  // Set the number of edges expected
-        edges.clear();
-        edges.resize(m);  // Resize edges vector to match the number of edges
-        response = "Creating new graph...\n";
-        response += "Number of vertices: " + to_string(n) + ", Number of edges: " + to_string(m) + "\n";
-        response += "Please provide the edges one by one (format: u v weight):\n";
+        if (sscanf(command.c_str(), "NewGraph %d %d", &n, &m) != 2 || n < 1 || m < 0) {
+            response << "Invalid NewGraph command format. Use: NewGraph n m\n";
+        } else if (static_cast<unsigned long long>(n) > maxGeneratedEdges ||
+                   static_cast<unsigned long long>(m) > maxGeneratedEdges) {
+            // Checked before anything is allocated for the announced sizes
+            response << "Invalid NewGraph size: at most " << maxGeneratedEdges << " vertices and edges.\n";
+        } else {
+            conn.newVertices = n;
+            edgesToReceive = m;  // Set the number of edges expected
+            edges.clear();
+            edges.resize(m);  // Resize edges vector to match the number of edges
+            response << "Creating new graph...\n";
+            response << "Number of vertices: " << n << ", Number of edges: " << m << "\n";
+            response << "Please provide the edges one by one (format: u v weight):\n";
+        }
 
     } else if (edgesToReceive > 0) {
-        // Expecting edges to complete the graph creation
-        int u, v;
+        // Expecting edges to complete the graph creation; vertex ids are any unsigned 64-bit numbers
+        uint64_t u, v;
         double weight;
-        if (sscanf(command.c_str(), "%d %d %lf", &u, &v, &weight) == 3) {
-            // Ensure valid vertex numbers
-            if (u > 0 && v > 0) {
-                edges[edges.size() - edgesToReceive] = {{u, v}, weight};
-                response = "Edge " + to_string(edges.size() - edgesToReceive + 1) +
-                           ": " + to_string(u) + " -> " + to_string(v) + " with weight " + to_string(weight) + "\n";
-                edgesToReceive--;
-
-                if (edgesToReceive == 0) {
-                    // All edges received, create the graph
-                    lock_guard<mutex> lock(graphMutex);
-                    delete graph;  // Delete any existing graph
-                    graph = new Graph(edges.size(), edges);  // Create a new graph
-                    response += "Graph created successfully with " + to_string(edges.size()) + " edges\n";
-
-                    // Capture and send the graph structure
-                    stringstream ss;
-                    streambuf* coutbuf = cout.rdbuf();
-                    cout.rdbuf(ss.rdbuf());
-                    graph->printGraph();
-                    cout.rdbuf(coutbuf);
-                    response += ss.str();
+        if (parseEdge(command.c_str(), u, v, &weight)) {
+            edges[edges.size() - edgesToReceive] = {{u, v}, weight};
+            response << "Edge " << (edges.size() - edgesToReceive + 1) << ": " << u << " -> " << v
+                     << " with weight " << weight << "\n";
+            edgesToReceive--;
+
+            if (edgesToReceive == 0) {
+                // All edges received: number the vertices and build the graph before taking the lock
+                vector<pair<pair<int, int>, double>> dense;
+                shared_ptr<const VertexIds> ids = VertexIds::build(conn.newVertices, edges, dense);
+                auto created = make_shared<Graph>(ids ? ids->size() : conn.newVertices, dense);
+                created->setVertexIds(move(ids));
+                edges.clear();
+                edges.shrink_to_fit();
+
+                lock_guard<TimedMutex> lock(graphMutex);
+                // Replaces any existing graph; responses still streaming it keep it alive until they finish
+                graph = created;
+                mstCache.clear();  // The old MST belongs to the replaced graph
+                response << "Graph created successfully with " << dense.size() << " edges\n";
+                if (created->getVertexIds()) {
+                    // Renumbered ids only know the vertices their edges name, not the n announced
+                    response << "Vertex ids renumbered: " << created->getNumNodes() << " vertices named by the edges, "
+                             << "isolated vertices are not kept\n";
                 }
-            } else {
-                response = "Invalid edge input. Ensure vertices are in range.\n";
+
+                // Send the graph structure
+                appendGraph(cmd, "");
+            }
+        } else {
+            response << "Invalid edge format. Use: u v weight\n";
+        }
+
+    } else if (command.find("GenerateGraph") == 0) {
+        // Command to build a synthetic graph in the server instead of receiving its edges
+        char name[32];
+        int n;
+        unsigned long long m, seed;
+        GraphGenerator::Model model;
+        if (sscanf(command.c_str(), "GenerateGraph %31s %d %llu %llu", name, &n, &m, &seed) != 4 ||
+            !GraphGenerator::parseModel(name, model) || n < 2) {
+            response << "Invalid GenerateGraph command format. Use: GenerateGraph random|grid|geometric|power-law|complete n m seed\n";
+        } else if (static_cast<unsigned long long>(n) > maxGeneratedEdges ||
+                   GraphGenerator::edgeCount(model, n, m) > maxGeneratedEdges) {
+            response << "Invalid GenerateGraph size: at most " << maxGeneratedEdges << " vertices and edges.\n";
+        } else {
+            auto start = chrono::steady_clock::now();
+            // Generated and built without the graph lock, so the other clients keep using the old graph meanwhile
+            auto generated = make_shared<Graph>(n, GraphGenerator::generate(model, n, m, seed, mstCache.threadPool()));
+            {
+                lock_guard<TimedMutex> lock(graphMutex);
+                graph = generated;  // Responses still streaming the old graph keep it alive until they finish
+                mstCache.clear();
             }
+            auto millis = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start).count();
+            response << "Graph generated: " << name << " with " << n << " vertices and "
+                     << generated->getNumEdges() << " edges (seed " << seed << ") in " << millis << " ms\n";
+        }
+
+    } else if (command.find("ApplyBatch") == 0) {
+        // Command to start a batch of edge mutations applied as one transaction
+        int k;
+        if (sscanf(command.c_str(), "ApplyBatch %d", &k) == 1 && k > 0) {
+            batchOpsToReceive = k;
+            batchOps.clear();
+            batchOps.reserve(k);
+            batchIds.clear();
+            batchIds.reserve(k);
+            response << "Starting batch of " << k << " operations.\n";
+            response << "Please provide the operations one by one (NewEdge u v w, RemoveEdge u v, UpdateWeight u v w):\n";
+        } else {
+            response << "Invalid ApplyBatch command format. Use: ApplyBatch k (k > 0)\n";
+        }
+
+    } else if (batchOpsToReceive > 0) {
+        // Expecting operations of the current batch
+        EdgeOp op{EdgeOp::REMOVE, 0, 0, 0};  // Endpoints are looked up when the batch is applied
+        uint64_t u, v;
+        bool parsed = false;
+        if (command.find("NewEdge") == 0) {
+            op.type = EdgeOp::ADD;
+            parsed = parseEdge(command.c_str() + strlen("NewEdge"), u, v, &op.weight);
+        } else if (command.find("UpdateWeight") == 0) {
+            op.type = EdgeOp::UPDATE;
+            parsed = parseEdge(command.c_str() + strlen("UpdateWeight"), u, v, &op.weight);
+        } else if (command.find("RemoveEdge") == 0) {
+            parsed = parseEdge(command.c_str() + strlen("RemoveEdge"), u, v);
+        }
+
+        if (!parsed) {
+            response << "Invalid batch operation. Use: NewEdge u v w, RemoveEdge u v or UpdateWeight u v w\n";
         } else {
-            response = "Invalid edge format. Use: u v weight\n";
+            batchOps.push_back(op);
+            batchIds.push_back({u, v});
+            batchOpsToReceive--;
+            response << "Staged operation " << batchOps.size() << "/" << (batchOps.size() + batchOpsToReceive)
+                     << "\n";
+
+            if (batchOpsToReceive == 0) {
+                // All operations received: apply them under a single lock and update the MST once
+                lock_guard<TimedMutex> lock(graphMutex);
+                size_t failedOp;
+                uint64_t previousVersion = graph ? graph->getVersion() : 0;
+                for (size_t i = 0; graph && i < batchOps.size(); ++i) {
+                    batchOps[i].u = graph->findVertex(batchIds[i].first);  // 0 for an unknown id, which fails validation
+                    batchOps[i].v = graph->findVertex(batchIds[i].second);
+                }
+                if (!graph) {
+                    response << "Graph is not initialized.\n";
+                } else if (!graph->applyBatch(batchOps, failedOp)) {
+                    response << "Batch rejected: operation " << (failedOp + 1) << " (" << batchIds[failedOp].first
+                             << " -> " << batchIds[failedOp].second << ") cannot be applied. No changes were made.\n";
+                } else {
+                    response << "Batch applied: " << batchOps.size() << " operations";
+                    switch (mstCache.update(*graph, batchOps, previousVersion)) {
+                        case MSTCache::INCREMENTAL: response << ", MST updated incrementally\n"; break;
+                        case MSTCache::REBUILT: response << ", MST rebuilt\n"; break;
+                        case MSTCache::NOT_CACHED: response << "\n"; break;
+                    }
+                }
+                batchOps.clear();
+                batchIds.clear();
+            }
         }
 
     } else if (command.find("NewEdge") == 0) {
         // Command to add a new edge to the graph
-        int u, v;
+        uint64_t u, v;
         double weight;
-        if (sscanf(command.c_str(), "NewEdge %d %d %lf", &u, &v, &weight) == 3) {
-            lock_guard<mutex> lock(graphMutex);
+        if (parseEdge(command.c_str() + strlen("NewEdge"), u, v, &weight)) {
+            lock_guard<TimedMutex> lock(graphMutex);
             if (graph) {
-                graph->addEdge(u, v, weight);  // Add the edge to the graph
-                response = "Edge added successfully: " + to_string(u) + " -> " + to_string(v) +
-                           " with weight " + to_string(weight) + "\n";
+                int a = graph->findVertex(u), b = graph->findVertex(v);  // Edges only join vertices the graph was loaded with
+                if (a == 0 || b == 0) {
+                    response << "Invalid edge input. Ensure vertices are in range.\n";
+                } else if (graph->addEdge(a, b, weight)) {  // Add the edge to the graph
+                    response << "Edge added successfully: " << u << " -> " << v << " with weight " << weight << "\n";
+                } else {
+                    response << "Edge already exists: " << u << " -> " << v
+                             << ". Use UpdateWeight to change its weight.\n";
+                }
             } else {
-                response = "Graph is not initialized.\n";
+                response << "Graph is not initialized.\n";
             }
         } else {
-            response = "Invalid NewEdge command format. Use: NewEdge u v weight\n";
+            response << "Invalid NewEdge command format. Use: NewEdge u v weight\n";
         }
 
     } else if (command.find("RemoveEdge") == 0) {
         // Command to remove an edge from the graph
-        int u, v;
-        if (sscanf(command.c_str(), "RemoveEdge %d %d", &u, &v) == 2) {
-            lock_guard<mutex> lock(graphMutex);
+        uint64_t u, v;
+        if (parseEdge(command.c_str() + strlen("RemoveEdge"), u, v)) {
+            lock_guard<TimedMutex> lock(graphMutex);
+            if (graph) {
+                if (graph->removeEdge(graph->findVertex(u), graph->findVertex(v))) {  // Remove the edge
+                    response << "Edge removed successfully: " << u << " -> " << v << "\n";
+                } else {
+                    response << "Edge not found: " << u << " -> " << v << "\n";
+                }
+            } else {
+                response << "Graph is not initialized.\n";
+            }
+        } else {
+            response << "Invalid RemoveEdge command format. Use: RemoveEdge u v\n";
+        }
+
+    } else if (command.find("UpdateWeight") == 0) {
+        // Command to change the weight of an existing edge in place
+        uint64_t u, v;
+        double weight;
+        if (parseEdge(command.c_str() + strlen("UpdateWeight"), u, v, &weight)) {
+            lock_guard<TimedMutex> lock(graphMutex);
+            if (graph) {
+                if (graph->updateWeight(graph->findVertex(u), graph->findVertex(v), weight)) {
+                    response << "Edge weight updated: " << u << " -> " << v << " with weight " << weight << "\n";
+                } else {
+                    response << "Edge not found: " << u << " -> " << v << "\n";
+                }
+            } else {
+                response << "Graph is not initialized.\n";
+            }
+        } else {
+            response << "Invalid UpdateWeight command format. Use: UpdateWeight u v weight\n";
+        }
+
+    } else if (command.find("Async") == 0) {
+        // Command to run Kruskal or Prim as a background job: Async Kruskal|Prim [notify]
+        char name[16] = "", option[16] = "";
+        sscanf(command.c_str(), "Async %15s %15s", name, option);
+        bool kruskal = strcmp(name, "Kruskal") == 0, notify = strcmp(option, "notify") == 0;
+        if ((!kruskal && strcmp(name, "Prim") != 0) || (option[0] != '\0' && !notify)) {
+            response << "Invalid Async command format. Use: Async Kruskal|Prim [notify]\n";
+        } else {
+            lock_guard<TimedMutex> lock(graphMutex);
             if (graph) {
-                graph->removeEdge(u, v);  // Remove the edge
-                response = "Edge removed successfully: " + to_string(u) + " -> " + to_string(v) + "\n";
+                startMSTJob(cmd, kruskal ? MSTFactory::KRUSKAL : MSTFactory::PRIM, notify);
             } else {
-                response = "Graph is not initialized.\n";
+                response << "Graph is not initialized.\n";
+            }
+        }
+
+    } else if (command.find("JobStatus") == 0 || command.find("JobResult") == 0) {
+        // Commands to poll a background job, and to list the MST edges it computed: JobResult id [offset [limit]]
+        bool listEdges = command.find("JobResult") == 0;
+        unsigned long long id;
+        int consumed = 0;
+        if (sscanf(command.c_str() + strlen("JobStatus"), "%llu%n", &id, &consumed) == 1) {
+            shared_ptr<const JobManager::Job> job = jobs->find(id);
+            if (!job) {
+                response << "Unknown job: " << id << "\n";
+            } else {
+                JobManager::describe(*job, response);
+                if (listEdges && job->state == JobManager::DONE) {
+                    appendEdgeList(cmd, job->tree, command.c_str() + strlen("JobResult") + consumed);
+                }
             }
         } else {
-            response = "Invalid RemoveEdge command format. Use: RemoveEdge u v\n";
+            response << "Invalid job command format. Use: JobStatus id or JobResult id [offset [limit]]\n";
+        }
+
+    } else if (command.find("CancelJob") == 0) {
+        // Command to stop a background job
+        unsigned long long id;
+        if (sscanf(command.c_str(), "CancelJob %llu", &id) == 1) {
+            if (jobs->cancel(id)) {
+                response << "Cancelling job " << id << "\n";
+            } else {
+                response << "Job " << id << " is unknown or already ended\n";
+            }
+        } else {
+            response << "Invalid CancelJob command format. Use: CancelJob id\n";
         }
 
     } else if (command.find("Kruskal") == 0) {
         // Command to run Kruskal's algorithm
-        lock_guard<mutex> lock(graphMutex);
+        unique_lock<TimedMutex> lock(graphMutex);
         if (graph) {
-            KruskalMST kruskalMST(*graph);  // Initialize KruskalMST
-            double mstWeight = kruskalMST.findMST();  // Calculate MST weight
-            response = "Kruskal's algorithm executed. MST Weight: " + to_string(mstWeight) + "\n";
-
-            // Store the MST in the tree
-            if (mstTree) delete mstTree;
-            mstTree = new Tree(graph->getNumNodes(), kruskalMST.getMSTEdges());
-
-            response += "Edges of the MST:\n";
-            for (const auto& edge : kruskalMST.getMSTEdges()) {
-                response += to_string(edge.first.first) + " -> " + to_string(edge.first.second) +
-                           " (Weight: " + to_string(edge.second) + ")\n";
+            // Reuses the stored MST when the graph did not change since the last run
+            shared_ptr<Tree> mst = mstCache.refresh(lock, graph, MSTFactory::KRUSKAL, false, &cmd.control);
+            if (mst) {
+                response << "Kruskal's algorithm executed. MST Weight: " << mst->getMSTWeight() << "\n";
+                appendEdgeList(cmd, mst, command.c_str() + strlen("Kruskal"));
+            } else {
+                response << deadlineResponse;  // Aborted; the graph lock is released on return
             }
         } else {
-            response = "Graph is not initialized.\n";
+            response << "Graph is not initialized.\n";
         }
 
     } else if (command.find("Prim") == 0) {
         // Command to run Prim's algorithm
-        lock_guard<mutex> lock(graphMutex);
+        unique_lock<TimedMutex> lock(graphMutex);
         if (graph) {
-            PrimMST primMST(*graph);  // Initialize PrimMST
-            double mstWeight = primMST.findMST();  // Calculate MST weight
-            response = "Prim's algorithm executed. MST Weight: " + to_string(mstWeight) + "\n";
-
-            // Store the MST in the tree
-            if (mstTree) delete mstTree;
-            mstTree = new Tree(graph->getNumNodes(), primMST.getMSTEdges());
-
-            response += "Edges of the MST:\n";
-            for (const auto& edge : primMST.getMSTEdges()) {
-                response += to_string(edge.first.first) + " -> " + to_string(edge.first.second) +
-                           " (Weight: " + to_string(edge.second) + ")\n";
+            // Reuses the stored MST when the graph did not change since the last run
+            shared_ptr<Tree> mst = mstCache.refresh(lock, graph, MSTFactory::PRIM, false, &cmd.control);
+            if (mst) {
+                response << "Prim's algorithm executed. MST Weight: " << mst->getMSTWeight() << "\n";
+                appendEdgeList(cmd, mst, command.c_str() + strlen("Prim"));
+            } else {
+                response << deadlineResponse;  // Aborted; the graph lock is released on return
             }
         } else {
-            response = "Graph is not initialized.\n";
+            response << "Graph is not initialized.\n";
         }
 
     } else if (command.find("MSTWeight") == 0) {
         // Command to return the total weight of the MST
-        if (mstTree) {
-            double mstWeight = mstTree->getMSTWeight();
-            response = "Total MST Weight: " + to_string(mstWeight) + "\n";
+        unique_lock<TimedMutex> lock(graphMutex);
+        if (graph && mustRunHeavy(cmd.taskClass, mstCache, *graph)) {
+            return false;  // Stale after a mutation: the rebuild waits for a HEAVY slot
+        } else if (graph) {
+            shared_ptr<Tree> mst = mstCache.refresh(lock, graph, MSTFactory::KRUSKAL, true, &cmd.control);
+            if (mst) {
+                response << "Total MST Weight: " << mst->getMSTWeight() << "\n";  // O(1) if fresh
+            } else {
+                response << deadlineResponse;
+            }
         } else {
-            response = "MST not calculated. Run Prim or Kruskal first.\n";
+            response << "Graph is not initialized.\n";
         }
 
     } else if (command.find("LongestDistance") == 0) {
         // Command to calculate the longest distance between two vertices
-        int u, v;
-        if (sscanf(command.c_str(), "LongestDistance %d %d", &u, &v) == 2) {
-            if (mstTree) {
-                double distance = mstTree->longestDistance(u, v);
+        uint64_t u, v;
+        if (parseEdge(command.c_str() + strlen("LongestDistance"), u, v)) {
+            unique_lock<TimedMutex> lock(graphMutex);
+            shared_ptr<Tree> tree;  // Rebuilt only if stale
+            int a = graph ? graph->findVertex(u) : 0, b = graph ? graph->findVertex(v) : 0;
+            if (!graph) {
+                response << "Graph is not initialized.\n";
+            } else if (a == 0 || b == 0) {
+                response << "Invalid vertices. Ensure vertices are in range.\n";
+            } else if (!(tree = mstCache.refresh(lock, graph, MSTFactory::KRUSKAL, true, &cmd.control))) {
+                response << deadlineResponse;  // Aborted; the graph lock is released on return
+            } else {
+                Tree& mst = *tree;
+                double distance = mst.longestDistance(a, b);
                 if (distance >= 0) {
-                    response = "Longest Distance between " + to_string(u) + " and " + to_string(v) +
-                               " is: " + to_string(distance) + "\n";
+                    response << "Longest Distance between " << u << " and " << v << " is: " << distance << "\n";
 
                     // Get the longest path
-                    vector<int> path = mstTree->getLongestPath(u, v);
-                    stringstream ss;
-                    ss << "Longest path: ";
-                    for (size_t i = 0; i < path.size(); ++i) {
-                        ss << path[i];
-                        if (i < path.size() - 1) ss << " -> ";
-                    }
-                    ss << "\n";
-                    response += ss.str();
+                    vector<int>& path = conn.path;
+                    mst.getLongestPath(a, b, path);
+                    response << "Longest path: ";
+                    appendPath(response, mst, path);
                 } else {
-                    response = "No path exists between the vertices.\n";
+                    response << "No path exists between the vertices.\n";
                 }
-            } else {
-                response = "MST not calculated. Run Prim or Kruskal first.\n";
             }
         } else {
-            response = "Invalid LongestDistance command format. Use: LongestDistance u v\n";
+            response << "Invalid LongestDistance command format. Use: LongestDistance u v\n";
         }
 
     } else if (command.find("AverageDistance") == 0) {
         // Command to calculate the average distance between two vertices using Floyd-Warshall
-        int u, v;
-        if (sscanf(command.c_str(), "AverageDistance %d %d", &u, &v) == 2) {
-            if (mstTree) {
-                auto [dist, next] = mstTree->floydWarshall();  // Run Floyd-Warshall algorithm
-                double distance = dist[u][v];
+        uint64_t u, v;
+        if (parseEdge(command.c_str() + strlen("AverageDistance"), u, v)) {
+            unique_lock<TimedMutex> lock(graphMutex);
+            shared_ptr<Tree> tree;  // Rebuilt only if stale
+            int a = graph ? graph->findVertex(u) : 0, b = graph ? graph->findVertex(v) : 0;
+            if (!graph) {
+                response << "Graph is not initialized.\n";
+            } else if (a == 0 || b == 0) {
+                response << "Invalid vertices. Ensure vertices are in range.\n";
+            } else if (!(tree = mstCache.refresh(lock, graph, MSTFactory::KRUSKAL, true, &cmd.control)) ||
+                       tree->allPairs(&cmd.control).first.empty()) {
+                response << deadlineResponse;  // Aborted; the graph lock is released on return
+            } else {
+                Tree& mst = *tree;
+                const auto& [dist, next] = mst.allPairs();  // Floyd-Warshall, computed above
+                double distance = dist[a][b];
 
                 if (distance < numeric_limits<double>::infinity()) {
-                    response = "AverageDistance between " + to_string(u) + " and " + to_string(v) + ": " + to_string(distance) + "\n";
+                    response << "AverageDistance between " << u << " and " << v << ": " << distance << "\n";
 
-                    vector<int> path;
-                    mstTree->reconstructPath(u, v, next, path);  // Reconstruct the path
+                    vector<int>& path = conn.path;
+                    path.clear();
+                    mst.reconstructPath(a, b, next, path);  // Reconstruct the path
 
-                    response += "Path from " + to_string(u) + " to " + to_string(v) + ": ";
-                    for (size_t i = 0; i < path.size(); ++i) {
-                        response += to_string(path[i]);
-                        if (i < path.size() - 1) response += " -> ";
-                    }
-                    response += "\n";
+                    response << "Path from " << u << " to " << v << ": ";
+                    appendPath(response, mst, path);
                 } else {
-                    response = "No path exists between the vertices.\n";
+                    response << "No path exists between the vertices.\n";
                 }
-            } else {
-                response = "MST not calculated. Run Prim or Kruskal first.\n";
             }
         } else {
-            response = "Invalid AverageDistance command format. Use: AverageDistance u v\n";
+            response << "Invalid AverageDistance command format. Use: AverageDistance u v\n";
         }
 
     } else if (command.find("ShortestPath") == 0) {
         // Command to calculate the shortest path between two vertices
-        int u, v;
-        if (sscanf(command.c_str(), "ShortestPath %d %d", &u, &v) == 2) {
-            if (mstTree) {
-                auto [dist, next] = mstTree->floydWarshall();  // Run Floyd-Warshall algorithm
-                double distance = dist[u][v];
+        uint64_t u, v;
+        if (parseEdge(command.c_str() + strlen("ShortestPath"), u, v)) {
+            unique_lock<TimedMutex> lock(graphMutex);
+            shared_ptr<Tree> tree;  // Rebuilt only if stale
+            int a = graph ? graph->findVertex(u) : 0, b = graph ? graph->findVertex(v) : 0;
+            if (!graph) {
+                response << "Graph is not initialized.\n";
+            } else if (a == 0 || b == 0) {
+                response << "Invalid vertices. Ensure vertices are in range.\n";
+            } else if (!(tree = mstCache.refresh(lock, graph, MSTFactory::KRUSKAL, true, &cmd.control)) ||
+                       tree->allPairs(&cmd.control).first.empty()) {
+                response << deadlineResponse;  // Aborted; the graph lock is released on return
+            } else {
+                Tree& mst = *tree;
+                const auto& [dist, next] = mst.allPairs();  // Floyd-Warshall, computed above
+                double distance = dist[a][b];
 
                 if (distance < numeric_limits<double>::infinity()) {
-                    response = "Shortest Distance between " + to_string(u) + " and " + to_string(v) + ": " + to_string(distance) + "\n";
+                    response << "Shortest Distance between " << u << " and " << v << ": " << distance << "\n";
 
                     // Reconstruct the shortest path
-                    vector<int> path;
-                    mstTree->reconstructPath(u, v, next, path);
+                    vector<int>& path = conn.path;
+                    path.clear();
+                    mst.reconstructPath(a, b, next, path);
 
-                    response += "Path from " + to_string(u) + " to " + to_string(v) + ": ";
-                    for (size_t i = 0; i < path.size(); ++i) {
-                        response += to_string(path[i]);
-                        if (i < path.size() - 1) response += " -> ";
-                    }
-                    response += "\n";
+                    response << "Path from " << u << " to " << v << ": ";
+                    appendPath(response, mst, path);
                 } else {
-                    response = "No path exists between the vertices.\n";
+                    response << "No path exists between the vertices.\n";
                 }
-            } else {
-                response = "MST not calculated. Run Prim or Kruskal first.\n";
             }
         } else {
-            response = "Invalid ShortestPath command format. Use: ShortestPath u v\n";
+            response << "Invalid ShortestPath command format. Use: ShortestPath u v\n";
         }
 
     } else if (command.find("PrintGraph") == 0) {
         // Command to print the current graph structure
-        lock_guard<mutex> lock(graphMutex);
+        lock_guard<TimedMutex> lock(graphMutex);
         if (graph) {
-            stringstream ss;
-            streambuf* coutbuf = cout.rdbuf();
-            cout.rdbuf(ss.rdbuf());
-            graph->printGraph();
-            cout.rdbuf(coutbuf);
-            response = ss.str();
+            appendGraph(cmd, command.c_str() + strlen("PrintGraph"));  // Optional paging: PrintGraph offset limit
+        } else {
+            response << "Graph is not initialized.\n";
+        }
+
+    } else if (command.find("Stats") == 0) {
+        // Command to report the server's metrics, or with "Stats prometheus" to feed a Prometheus scraper
+        char format[16] = "";
+        sscanf(command.c_str(), "Stats %15s", format);
+        if (format[0] == '\0') {
+            metrics.report(response, collectGauges());
+        } else if (strcmp(format, "prometheus") == 0) {
+            metrics.reportPrometheus(response, collectGauges());
+        } else {
+            response << "Invalid Stats command format. Use: Stats [prometheus]\n";
+        }
+
+    } else if (command.find("TraceDump") == 0) {
+        // Command to write the spans of the sampled requests to the trace file, for chrome://tracing or Perfetto
+        ofstream file(tracePath, ios::trunc);
+        size_t spans = tracer.writeChromeTrace(file);
+        file.close();
+        if (file) {
+            response << "Trace written: " << static_cast<unsigned long long>(spans) << " spans to " << tracePath << "\n";
         } else {
-            response = "Graph is not initialized.\n";
+            response << "Trace could not be written to " << tracePath << "\n";
+        }
+
+    } else if (command.find("Trace") == 0) {
+        // Command to trace one request in N, or to stop tracing with 0
+        unsigned every;
+        char extra;
+        if (sscanf(command.c_str(), "Trace %u %c", &every, &extra) == 1) {
+            tracer.setSampling(every);
+            if (every == 0) {
+                response << "Tracing off\n";
+            } else {
+                response << "Tracing one request in " << every << "\n";
+            }
+        } else {
+            response << "Invalid Trace command format. Use: Trace N (0 turns tracing off)\n";
         }
 
     } else if (command.find("exit") == 0) {
         // Command to exit the server
-        response = "Exiting...\n";
+        response << "Exiting...\n";
 
     } else {
-        response = "Invalid command\n";  // Invalid command received
+        response << "Invalid command\n";  // Invalid command received
     }
+    return true;
+}
+
+// Pipeline stages. Parse and response replicas are stateless; the graph stage runs on the strands of graphPool
+vector<unique_ptr<ActiveObject<Command*>>> commandParsers, responseHandlers;
+ThreadPool* graphPool = nullptr;
+atomic<size_t> nextResponder{0};  // Round-robin cursor over the response replicas
 
-    responseHandler.submit([cmd, response] {
-        sendResponse(cmd.clientSocket, response);  // העברת התשובה לשלב הבא
-    });
+// The graph stage: executes a command and passes it to any responder
+void graphOperator(Command* cmd) {
+    tracer.lap(cmd->trace, Tracer::STRAND_QUEUE, cmd->stamp);
+    bool done;
+    if (cmd->profile != Profiler::OFF) {
+        Profiler profiler(cmd->profile == Profiler::HARDWARE);
+        done = handleCommand(*cmd);
+        if (done) profiler.report(cmd->response);  // The profile goes first, then the command's own response
+    } else {
+        done = handleCommand(*cmd);
+    }
+    if (!done) {
+        // It has to rebuild the MST: again in front of the connection's strand, as a HEAVY task
+        cmd->taskClass = ThreadPool::HEAVY;
+        graphPool->enqueueNext(cmd->connection->socket, [cmd] { graphOperator(cmd); }, ThreadPool::HEAVY);
+        return;
+    }
+    tracer.lap(cmd->trace, Tracer::EXECUTE, cmd->stamp);
+    // Any responder will do: sequence numbers restore the order per connection
+    size_t responder = nextResponder.fetch_add(1, memory_order_relaxed) % responseHandlers.size();
+    responseHandlers[responder]->submit(cmd);
 }
 
-void parseCommand(const Command& cmd) {
-    graphOperator.submit([cmd] {
-        handleCommand(cmd);  // העברת הפקודה לשלב הבא
-    });
+// Creates the stage replicas, from the last stage to the first so each one can hand over to the next
+void startPipeline(size_t parsers, size_t responders) {
+    for (size_t i = 0; i < responders; ++i) {
+        responseHandlers.push_back(make_unique<ActiveObject<Command*>>([](Command*& cmd) {
+            tracer.lap(cmd->trace, Tracer::RESPOND_QUEUE, cmd->stamp);
+            deliverResponse(cmd);  // Last stage: send the reply in request order
+        }));
+        metrics.addQueue("respond_" + to_string(i), responseHandlers.back()->queueStats());
+    }
+
+    for (size_t i = 0; i < parsers; ++i) {
+        commandParsers.push_back(make_unique<ActiveObject<Command*>>([](Command*& cmd) {
+            tracer.lap(cmd->trace, Tracer::PARSE_QUEUE, cmd->stamp);
+            // Keep only the first line of the request, without the line terminator
+            size_t end = cmd->command.find_first_of("\r\n");
+            if (end != string::npos) cmd->command.resize(end);
+            tracer.lap(cmd->trace, Tracer::PARSE, cmd->stamp);
+            // The connection's strand executes its commands in arrival order; the class lets cheap
+            // commands of other connections pass expensive ones. Shed commands are only answered.
+            cmd->taskClass = cmd->admitted ? classifyCommand(cmd->command) : ThreadPool::LIGHT;
+            graphPool->enqueue(cmd->connection->socket, [cmd] { graphOperator(cmd); }, cmd->taskClass);
+        }));
+        metrics.addQueue("parse_" + to_string(i), commandParsers.back()->queueStats());
+    }
 }
 
-// Worker thread function to process commands from the queue
-void workerThread() {
+unordered_map<int, shared_ptr<Connection>> connections;  // Open connections by socket (main thread only)
+
+// Splits the first `total` bytes of the connection's input into commands and submits them to the
+// pipeline. A read may carry several commands, and its last line may continue in the next read.
+void queueCommands(const shared_ptr<Connection>& conn, size_t total) {
+    string& input = conn->input;
+    size_t begin = 0;
     while (true) {
-        Command cmd;
-        {
-            unique_lock<mutex> lock(queueMutex);
-            queueCondition.wait(lock, [] { return !commandQueue.empty(); });
-            cmd = commandQueue.front();
-            commandQueue.pop();
+        size_t end = input.find('\n', begin);
+        if (end == string::npos || end >= total) {
+            if (total - begin < maxCommandLength) break;  // Wait for the rest of the line
+            end = total;  // Overlong line without a newline: take it as it is
+        }
+        if (end > begin) {
+            // Each command goes into a recycled command object, whose buffers already have room
+            Command* cmd = conn->commands.acquire();
+            cmd->command.assign(input, begin, end - begin);
+            cmd->connection = conn;
+            cmd->sequence = conn->nextSequence++;
+            cmd->control.reset();
+            cmd->control.watch(&conn->hungUp);
+            cmd->received = ServerMetrics::Clock::now();
+            cmd->trace = tracer.sample();
+            cmd->stamp = cmd->received;
+            cmd->profile = Profiler::strip(cmd->command);
+            if (long millis = stripDeadline(cmd->command)) {
+                // Counted from now, so time spent in the earlier stages counts too
+                cmd->control.setDeadline(cmd->received + chrono::milliseconds(millis));
+            }
+            cmd->admitted = admission.admit();
+            conn->inFlight++;
+            // Commands of one connection always use the same parser, so they keep their order
+            commandParsers[conn->socket % commandParsers.size()]->submit(cmd);  // First pipeline stage
         }
-        commandParser.submit([cmd] { parseCommand(cmd); });
+        begin = end + 1;
+        if (begin >= total) break;
     }
+    conn->buffered = begin < total ? total - begin : 0;
+    if (conn->buffered > 0) input.erase(0, begin);  // Move the unfinished line to the front
 }
 
-// Main function to set up the server and handle incoming connections
-int main() {
-    int serverSocket, clientSocket;
-    struct sockaddr_in serverAddr, clientAddr;
-    socklen_t addrLen = sizeof(clientAddr);
-    fd_set masterSet, readSet;
-    int fdMax;
+// Connects the io_uring backend to the connections of this server. Callbacks run on the main thread.
+class UringHandler : public IoUringBackend::Handler {
+public:
+    void accepted(int fd) override {
+        connections[fd] = make_shared<Connection>(fd);
+        cout << "New connection on socket " << fd << endl;
+    }
 
-    // Create the server socket
-    serverSocket = socket(AF_INET, SOCK_STREAM, 0);
-    if (serverSocket < 0) {
-        cerr << "Error opening socket" << endl;
-        return 1;
+    void received(int fd, const char* data, size_t size) override {
+        auto it = connections.find(fd);
+        if (it == connections.end()) return;  // Closed meanwhile
+        shared_ptr<Connection>& conn = it->second;
+        conn->input.resize(conn->buffered);  // Keeps its capacity from one receive to the next
+        conn->input.append(data, size);
+        queueCommands(conn, conn->buffered + size);
+        throttle(*conn);
     }
 
-    int opt = 1;
-    setsockopt(serverSocket, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    void hungUp(int fd) override {
+        cout << "Socket " << fd << " hung up" << endl;
+        auto it = connections.find(fd);
+        if (it == connections.end()) return;
+        Connection& conn = *it->second;
+        lock_guard<mutex> lock(conn.sendMutex);
+        conn.hungUp = true;
+        if (conn.nextToSend == conn.nextSequence) {
+            uring->close(fd);  // Nothing in flight; otherwise the last response closes it
+        }
+    }
 
-    bzero((char*)&serverAddr, sizeof(serverAddr));
-    serverAddr.sin_family = AF_INET;
-    serverAddr.sin_addr.s_addr = INADDR_ANY;
-    serverAddr.sin_port = htons(9034);
+    int gather(int fd, iovec* iov, int max) override {
+        auto it = connections.find(fd);
+        if (it == connections.end()) return 0;
+        lock_guard<mutex> lock(it->second->sendMutex);
+        return it->second->output.gather(iov, max);
+    }
 
-    // Bind the socket to the specified port
-    if (bind(serverSocket, (struct sockaddr*)&serverAddr, sizeof(serverAddr)) < 0) {
-        cerr << "Error on binding" << endl;
-        return 1;
+    void sent(int fd, size_t bytes) override {
+        auto it = connections.find(fd);
+        if (it == connections.end()) return;  // Closed meanwhile; its output went with it
+        lock_guard<mutex> lock(it->second->sendMutex);
+        it->second->output.consume(bytes);
     }
 
-    // Start listening for incoming connections
-    listen(serverSocket, 1);
-    cout << "Server started on port 9034" << endl;
+    void closed(int fd) override {
+        connections.erase(fd);
+    }
+};
+
+// Connects the shared-memory transport to the pipeline. Callbacks run on the session thread of each
+// channel, so these connections are kept apart from the main thread's map.
+class SharedMemoryHandler : public ConnectionHandler {
+public:
+    void accepted(int fd) override {
+        lock_guard<mutex> lock(channelsMutex);
+        channels[fd] = make_shared<Connection>(fd, true);
+        cout << "New shared memory connection on socket " << fd << endl;
+    }
+
+    void received(int fd, const char* data, size_t size) override {
+        shared_ptr<Connection> conn = find(fd);
+        if (!conn) return;  // Closed meanwhile
+        conn->input.resize(conn->buffered);  // Keeps its capacity from one receive to the next
+        conn->input.append(data, size);
+        queueCommands(conn, conn->buffered + size);
+        throttle(*conn);
+    }
+
+    void hungUp(int fd) override {
+        shared_ptr<Connection> conn = find(fd);
+        if (!conn) return;
+        lock_guard<mutex> lock(conn->sendMutex);
+        conn->hungUp = true;
+        if (conn->nextToSend == conn->nextSequence) {
+            shm->close(fd);  // Nothing in flight; otherwise the last response closes it
+        }
+    }
+
+    int gather(int fd, iovec* iov, int max) override {
+        shared_ptr<Connection> conn = find(fd);
+        if (!conn) return 0;
+        lock_guard<mutex> lock(conn->sendMutex);
+        return conn->output.gather(iov, max);
+    }
+
+    void sent(int fd, size_t bytes) override {
+        shared_ptr<Connection> conn = find(fd);
+        if (!conn) return;  // Closed meanwhile; its output went with it
+        lock_guard<mutex> lock(conn->sendMutex);
+        conn->output.consume(bytes);
+    }
+
+    void closed(int fd) override {
+        lock_guard<mutex> lock(channelsMutex);
+        channels.erase(fd);
+    }
+
+private:
+    mutex channelsMutex;
+    unordered_map<int, shared_ptr<Connection>> channels;  // Open shared-memory connections by handshake socket
+
+    // Returns nullptr once the connection was closed
+    shared_ptr<Connection> find(int fd) {
+        lock_guard<mutex> lock(channelsMutex);
+        auto it = channels.find(fd);
+        return it == channels.end() ? nullptr : it->second;
+    }
+};
+
+// Main function to set up the server and handle incoming connections
+int main(int argc, char* argv[]) {
+    ServerOptions options;
+    if (!ServerSocket::parseOptions(argc, argv, options, false)) return 1;
+    admission.configure(options.queue, options.inflight);
+    tracer.setSampling(options.trace);
+    tracePath = options.tracePath;
+    int clientSocket;
+    fd_set masterSet, readSet, writeMasterSet, writeSet;
+    int fdMax;
+
+    // Create the server socket and start listening for incoming connections
+    int serverSocket = ServerSocket::listenOn(options.port, false);
+    if (serverSocket < 0) return 1;
+    cout << "Server started on port " << options.port << endl;
+
+    // Local clients connect through a Unix domain socket, or exchange commands through shared memory
+    int unixSocket = ServerSocket::listenOnUnix(options.unixPath);
+    if (unixSocket < 0) return 1;
+    cout << "Local clients: " << options.unixPath << ", shared memory " << options.shmPath << endl;
+
+    if (pipe(wakePipe) < 0) {
+        cerr << "Error creating wake pipe" << endl;
+        return 1;
+    }
+    fcntl(wakePipe[0], F_SETFL, O_NONBLOCK);
+    fcntl(wakePipe[1], F_SETFL, O_NONBLOCK);
+    blockedSockets.reserve(64);
 
     FD_ZERO(&masterSet);
+    FD_ZERO(&writeMasterSet);
     FD_SET(serverSocket, &masterSet);
-    fdMax = serverSocket;
+    FD_SET(unixSocket, &masterSet);
+    FD_SET(wakePipe[0], &masterSet);
+    fdMax = max({serverSocket, unixSocket, wakePipe[0]});
 
-    // Start the worker thread
-    thread worker(workerThread);
-    worker.detach();
+    // The graph stage: commands run on the strands of this pool, whose idle threads also steal the
+    // parallel parts of the MST kernels
+    size_t cores = max(1u, thread::hardware_concurrency());
+    ThreadPool computePool(max<size_t>(2, cores));  // A HEAVY command always leaves a thread for the others
+    if (options.heavy) computePool.setHeavyLimit(options.heavy);
+    mstCache.setThreadPool(&computePool);
+    graphPool = &computePool;
+    metrics.addQueue("graph_light", computePool.queueStats(ThreadPool::LIGHT));
+    metrics.addQueue("graph_normal", computePool.queueStats(ThreadPool::NORMAL));
+    metrics.addQueue("graph_heavy", computePool.queueStats(ThreadPool::HEAVY));
+    metrics.addLock("graph", graphMutex);
+
+    // Parsing and writing scale with the cores unless --threads is given
+    size_t replicas = options.threads ? options.threads : max<size_t>(2, cores / 2);
+    startPipeline(replicas, replicas);
+    JobManager jobManager;  // Async jobs run beside the pipeline, so the graph stage is free meanwhile
+    jobs = &jobManager;
+
+    SharedMemoryHandler shmHandler;
+    ShmTransport shmTransport(shmHandler);
+    if (!shmTransport.start(options.shmPath)) return 1;
+    shm = &shmTransport;
+
+    UringHandler uringHandler;
+    IoUringBackend uringBackend(uringHandler);
+    if (options.ioUring) {
+        if (uringBackend.start(serverSocket)) {
+            uringBackend.addListener(unixSocket);
+            uring = &uringBackend;
+            cout << "Using io_uring" << endl;
+        } else {
+            cout << "io_uring is not available, using select" << endl;
+        }
+    }
+    if (uring) {
+        // Completions are handled in batches; the operations they prepare go out with the next wait
+        IoUringBackend::Completion events[64];
+        while (true) {
+            size_t count = uring->wait(events, 64);
+            for (size_t i = 0; i < count; ++i) {
+                uring->dispatch(events[i]);
+            }
+        }
+    }
 
     // Main server loop to handle connections and commands
     while (true) {
         readSet = masterSet;
-        if (select(fdMax + 1, &readSet, nullptr, nullptr, nullptr) == -1) {
+        writeSet = writeMasterSet;
+        if (select(fdMax + 1, &readSet, &writeSet, nullptr, nullptr) == -1) {
+            if (errno == EINTR) continue;  // Interrupted by a signal, not an error
             cerr << "Error on select" << endl;
             return 1;
         }
 
         for (int i = 0; i <= fdMax; ++i) {
+            if (FD_ISSET(i, &writeSet)) {
+                // A socket with backed-up output drained: continue writing, and reading once it is empty
+                auto it = connections.find(i);
+                if (it == connections.end()) {
+                    FD_CLR(i, &writeMasterSet);
+                } else {
+                    Connection& conn = *it->second;
+                    lock_guard<mutex> lock(conn.sendMutex);
+                    if (conn.output.writeTo(i) != ResponseBuilder::WOULD_BLOCK) {
+                        conn.writeBlocked = false;
+                        FD_CLR(i, &writeMasterSet);
+                        if (conn.readPaused) {
+                            conn.readPaused = false;
+                            if (!conn.throttled) FD_SET(i, &masterSet);  // Otherwise finishCommand() resumes it
+                        }
+                    }
+                }
+            }
+
             if (FD_ISSET(i, &readSet)) {
-                if (i == serverSocket) {
-                    clientSocket = accept(serverSocket, (struct sockaddr*)&clientAddr, &addrLen);
+                if (i == wakePipe[0]) {
+                    // Response stages reported blocked sockets: watch them for writability
+                    char drain[64];
+                    while (read(wakePipe[0], drain, sizeof(drain)) > 0) {
+                    }
+                    vector<int> resumed;
+                    {
+                        lock_guard<mutex> lock(blockedMutex);
+                        for (int fd : blockedSockets) {
+                            if (connections.count(fd)) FD_SET(fd, &writeMasterSet);
+                        }
+                        blockedSockets.clear();
+                        resumed.swap(resumedSockets);  // Handled after blockedMutex, which is taken under sendMutex
+                    }
+                    // Throttled sockets whose commands were answered: read them again, once their output drained
+                    for (int fd : resumed) {
+                        auto it = connections.find(fd);
+                        if (it == connections.end()) continue;
+                        lock_guard<mutex> lock(it->second->sendMutex);
+                        if (it->second->writeBlocked) {
+                            it->second->readPaused = true;
+                        } else {
+                            FD_SET(fd, &masterSet);
+                        }
+                    }
+                } else if (i == serverSocket || i == unixSocket) {
+                    clientSocket = accept(i, nullptr, nullptr);  // Over TCP or the Unix socket
                     if (clientSocket == -1) {
                         cerr << "Error on accept" << endl;
                     } else {
+                        fcntl(clientSocket, F_SETFL, fcntl(clientSocket, F_GETFL) | O_NONBLOCK);  // Writes must never block a stage
                         FD_SET(clientSocket, &masterSet);
                         if (clientSocket > fdMax) {
                             fdMax = clientSocket;
                         }
+                        connections[clientSocket] = make_shared<Connection>(clientSocket);
                         cout << "New connection on socket " << clientSocket << endl;
                     }
                 } else {
-                    char buffer[1024];
-                    bzero(buffer, 1024);
-                    int nbytes = read(i, buffer, 1023);
-                    if (nbytes <= 0) {
+                    shared_ptr<Connection>& conn = connections[i];
+                    {
+                        lock_guard<mutex> lock(conn->sendMutex);
+                        if (conn->writeBlocked) {
+                            // Backpressure: the client does not read its responses, so stop reading its requests
+                            conn->readPaused = true;
+                            FD_CLR(i, &masterSet);
+                            continue;
+                        }
+                    }
+                    string& input = conn->input;
+                    input.resize(conn->buffered + 1023);  // Keeps its capacity from one read to the next
+                    int nbytes = read(i, &input[conn->buffered], 1023);
+                    if (nbytes < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                        // Spurious wakeup, nothing to read yet
+                    } else if (nbytes <= 0) {
                         if (nbytes == 0) {
                             cout << "Socket " << i << " hung up" << endl;
                         } else {
                             cerr << "Error on read" << endl;
                         }
-                        close(i);
-                        FD_CLR(i, &masterSet);
-                    } else {
-                        Command cmd{i, string(buffer)};
                         {
-                            unique_lock<mutex> lock(queueMutex);
-                            commandQueue.push(cmd);
+                            lock_guard<mutex> lock(conn->sendMutex);
+                            conn->hungUp = true;
                         }
-                        queueCondition.notify_one();
+                        FD_CLR(i, &masterSet);
+                        FD_CLR(i, &writeMasterSet);
+                        connections.erase(i);  // The socket closes once its in-flight commands are answered
+                    } else {
+                        queueCommands(conn, conn->buffered + nbytes);
+                        if (throttle(*conn)) FD_CLR(i, &masterSet);  // Too many commands in flight
                     }
                 }
             }
@@ -460,9 +1286,42 @@ int main() {
 /**
  * Pipeline Design Pattern Implementation:
  * 
- * - Client sends a command – The server receives the command and pushes it to the command queue.
- * - workerThread retrieves a command from the queue and passes it to commandParser.
- * - commandParser interprets the command and forwards it to graphOperator for processing.
- * - graphOperator performs the requested operation and sends the result to responseHandler.
- * - responseHandler sends the response back to the client.
+ * - Client sends a command – The server reads it, numbers it per connection and submits a Command message to
+ *   the commandParser replica of that connection.
+ * - commandParser normalizes the command line and queues the message in the strand of its connection on the graph stage.
+ * - graphOperator performs the requested operation, stores the reply in the message and passes it to any responseHandler.
+ *   The graph stage runs on a pool: strands keep each connection's commands in order, while commands of different
+ *   connections run side by side. A strand waits in the queue of its next command's cost class (LIGHT lookups such as
+ *   MSTWeight, NORMAL mutations and listings, HEAVY MST rebuilds); the queues are served by weighted round robin and at
+ *   most --heavy N HEAVY commands (1 by default) run at once, so lookups never wait behind a row of Kruskal runs.
+ *   An MSTWeight that finds the cached MST stale is not rebuilt in its LIGHT slot: graphOperator puts it back in
+ *   front of the connection's strand as a HEAVY task, so rebuilds stay under the cap.
+ * - responseHandler sends the response back to the client; replies that overtook an earlier one on the same
+ *   connection wait until it was sent, so every client sees its responses in request order.
+ *   Sockets are non-blocking: output a client does not read yet is left to the select loop, which writes it when
+ *   the socket drains and stops reading that client's requests until then.
+ *   With --io-uring the main thread runs an io_uring loop instead of select: responders only queue their output,
+ *   and the main thread submits the sends of all of them together with its next wait.
+ * - Async Kruskal|Prim leaves the pipeline: graphOperator copies the edge list and replies with a job id, and the
+ *   MST is computed on the JobManager threads while the stages serve the following commands.
+ * - Admission control bounds the commands in the pipeline to --queue N (512 by default): a command read beyond that
+ *   is not executed but answered with BUSY in its place, and a connection with --inflight N commands in flight
+ *   (32 by default) is not read until finishCommand answered one of them.
+ * - A command prefixed with "Deadline ms" is timed from the moment it was read; graphOperator passes its JobControl
+ *   to the MST kernels and Floyd-Warshall, which stop early once the deadline passed or the client hung up.
+ * - finishCommand records the latency of each command, from reading its line to queueing its response; every stage's
+ *   queue and the graph lock record how long messages and threads waited. Stats reports them as text or for Prometheus.
+ * - With --trace N (or the Trace command) one request in N is traced: each stage records when the request entered and
+ *   left its queue and its work into a ring buffer of the stage's thread, and TraceDump writes the spans of all threads
+ *   as Chrome trace-event JSON to --trace-file, one track per request.
+ * - "Profile [hw]" before a command makes graphOperator run it under a Profiler, which puts the command's time,
+ *   the phase timings and hot-loop counters of the MST kernels (make profile builds only) and optionally
+ *   hardware counters in front of its response.
+ * - Vertex ids are any 64-bit numbers: graphOperator numbers the ids of a NewGraph densely (VertexIds) unless they
+ *   already are 1..n, looks up the ids of every later command, and responses translate the vertices back. Renumbered
+ *   graphs only have the vertices their edges name, which the NewGraph reply reports.
+ *
+ * The parse and response stages are ActiveObjects with their own thread and a bounded lock-free MPSC ring buffer: handing a
+ * message to the next stage is a CAS and a release store, and a mutex is only touched to wake a stage
+ * that ran out of work and parked. A full ring makes the previous stage wait (backpressure).
  */
@@ -0,0 +1,223 @@
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <chrono>
+#include <thread>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+using namespace std;
+
+// Allocation test for LFServer and pipelineServer. Each server binary given on the command line is
+// started on a port of its own, loads a generated graph and warms its MST cache; then each cached
+// query is sent many times, and the whole server process must not allocate for them: reading the
+// requests, queueing and running them and sending the replies. The server counts the operator new
+// calls of all its threads only when built with make profile (MST_PROFILE), which make test does
+// first, and Stats reports the count.
+
+const int firstPort = 19500;          // Ports firstPort, firstPort + 1, ... for the servers under test
+const int warmupRounds = 3;           // Rounds before counting, which let the reused buffers grow
+const int warmupBurst = 4;            // Copies of each query sent at once while warming up
+const int measuredRounds = 200;       // Copies of each query counted together
+const int replyTimeoutMs = 10000;
+
+// A steady-state query and the number of lines of its reply
+struct Query {
+    const char* command;
+    int lines;
+};
+
+// Cached queries on the test graph: none of them recomputes the MST. The first ShortestPath builds
+// the tree's all-pairs index, which is cubic in the vertices, so the graph is kept small.
+const char* const graphCommand = "GenerateGraph random 200 800 1";
+const Query queries[] = {
+    {"MSTWeight", 1},
+    {"LongestDistance 1 100", 2},
+    {"ShortestPath 1 100", 2},
+    {"Kruskal 0 5", 7},  // Algorithm line, listing header and five edges
+};
+
+// Reads the replies of a server line by line
+class LineReader {
+public:
+    explicit LineReader(int fd) : fd(fd) {}
+
+    // Returns false if the server closed the connection or did not answer in time
+    bool readLine(string& line) {
+        size_t end;
+        while ((end = buffer.find('\n')) == string::npos) {
+            struct pollfd ready = {fd, POLLIN, 0};
+            if (poll(&ready, 1, replyTimeoutMs) <= 0) return false;
+            char chunk[4096];
+            ssize_t n = read(fd, chunk, sizeof(chunk));
+            if (n <= 0) return false;
+            buffer.append(chunk, static_cast<size_t>(n));
+        }
+        line.assign(buffer, 0, end);
+        buffer.erase(0, end + 1);
+        return true;
+    }
+
+private:
+    int fd;
+    string buffer;
+};
+
+// Starts a server on a port, with its output discarded
+pid_t startServer(const string& binary, int port) {
+    pid_t pid = fork();
+    if (pid == 0) {
+        int devNull = open("/dev/null", O_WRONLY);
+        dup2(devNull, STDOUT_FILENO);
+        dup2(devNull, STDERR_FILENO);
+        string portText = to_string(port);
+        execl(binary.c_str(), binary.c_str(), "--port", portText.c_str(), static_cast<char*>(nullptr));
+        _exit(127);
+    }
+    return pid;
+}
+
+// Connects to the Unix domain socket of a server, waiting for it to start listening
+int connectServer(int port) {
+    string path = "/tmp/mst-server-" + to_string(port) + ".sock";
+    for (int attempt = 0; attempt < 100; ++attempt) {
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0) return -1;
+        struct sockaddr_un address;
+        memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+        if (connect(fd, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) == 0) return fd;
+        close(fd);
+        this_thread::sleep_for(chrono::milliseconds(50));
+    }
+    return -1;
+}
+
+// Sends a command and reads its reply of `lines` lines
+bool request(int fd, LineReader& reader, const string& command, int lines) {
+    string line = command + "\n";
+    if (write(fd, line.data(), line.size()) != static_cast<ssize_t>(line.size())) return false;
+    for (int i = 0; i < lines; ++i) {
+        if (!reader.readLine(line)) return false;
+    }
+    return true;
+}
+
+// Sends `copies` copies of a query in one write and reads their replies
+bool burst(int fd, LineReader& reader, const Query& query, int copies) {
+    string lines;
+    for (int i = 0; i < copies; ++i) lines += string(query.command) + "\n";
+    if (write(fd, lines.data(), lines.size()) != static_cast<ssize_t>(lines.size())) return false;
+    for (int i = 0; i < copies * query.lines; ++i) {
+        if (!reader.readLine(lines)) return false;
+    }
+    return true;
+}
+
+// Reads the allocations of the server process so far from a Stats report. Returns false on a
+// broken reply or if the server was built without the counter.
+bool processAllocations(int fd, LineReader& reader, long long& allocations) {
+    string line = "Stats\n";
+    if (write(fd, line.data(), line.size()) != static_cast<ssize_t>(line.size())) return false;
+    unsigned long long statsLines;
+    if (!reader.readLine(line) || sscanf(line.c_str(), "Stats (%llu lines):", &statsLines) != 1) return false;
+    bool counted = false;
+    for (unsigned long long i = 0; i < statsLines; ++i) {
+        if (!reader.readLine(line)) return false;
+        if (sscanf(line.c_str(), "Allocations: %lld since", &allocations) == 1) counted = true;
+    }
+    return counted;
+}
+
+// Counts what the server allocates for `rounds` copies of a query sent one after the other. The
+// count is read before each Stats report is built, so a window also holds one report and the reading
+// of the next Stats request: that cost is taken from two Stats in a row right before and after the
+// window, and the larger one is subtracted. Returns false if a request failed.
+bool countAllocations(int fd, LineReader& reader, const Query& query, int rounds, long long& allocations) {
+    long long before[2], after[2];
+    if (!processAllocations(fd, reader, before[0]) || !processAllocations(fd, reader, before[1])) return false;
+    for (int round = 0; round < rounds; ++round) {
+        if (!request(fd, reader, query.command, query.lines)) return false;
+    }
+    if (!processAllocations(fd, reader, after[0]) || !processAllocations(fd, reader, after[1])) return false;
+    long long statsCost = max(before[1] - before[0], after[1] - after[0]);
+    allocations = max(0LL, after[0] - before[1] - statsCost);
+    return true;
+}
+
+// Runs the test against one server binary
+bool testServer(const string& binary, int port) {
+    pid_t pid = startServer(binary, port);
+    if (pid < 0) {
+        cerr << binary << ": cannot start: " << strerror(errno) << endl;
+        return false;
+    }
+    int fd = connectServer(port);
+    bool passed = fd >= 0;
+    if (!passed) cerr << binary << ": no connection on port " << port << endl;
+
+    LineReader reader(fd);
+    // One line for the generated graph, then the MST is computed once and cached
+    if (passed && !request(fd, reader, graphCommand, 1)) {
+        cerr << binary << ": GenerateGraph failed" << endl;
+        passed = false;
+    }
+
+    // A connection recycles its command objects, and a reply can reach us before the server returned
+    // its command, so the next query may run on another one. Warm-up bursts keep several commands
+    // busy at once, so every command a measured query can land on has sized its response buffer.
+    // Stats is warmed up too: its report has a line per command type that ran, and grows meanwhile.
+    long long allocations = 0;
+    for (int round = 0; passed && round < warmupRounds; ++round) {
+        for (const Query& query : queries) {
+            passed = passed && burst(fd, reader, query, warmupBurst);
+        }
+        passed = passed && processAllocations(fd, reader, allocations);
+    }
+    if (fd >= 0 && !passed) {
+        cerr << binary << ": no reply or no allocation count (is the server built with make profile?)" << endl;
+    }
+
+    long long total = 0;
+    for (const Query& query : queries) {
+        if (!passed) break;
+        if (!countAllocations(fd, reader, query, measuredRounds, allocations)) {
+            cerr << binary << ": no reply to " << query.command << " or Stats" << endl;
+            passed = false;
+        } else if (allocations > 0) {
+            cerr << binary << ": " << allocations << " allocations for " << measuredRounds << " x " << query.command << endl;
+            total += allocations;
+        }
+    }
+    int measured = measuredRounds * static_cast<int>(sizeof(queries) / sizeof(queries[0]));
+    if (passed && total > 0) passed = false;
+    if (passed) cout << binary << ": " << measured << " cached queries, 0 allocations in the server process" << endl;
+
+    if (fd >= 0) close(fd);
+    kill(pid, SIGTERM);
+    waitpid(pid, nullptr, 0);
+    return passed;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        cerr << "Usage: " << argv[0] << " SERVER_BINARY..." << endl;
+        return 2;
+    }
+    signal(SIGPIPE, SIG_IGN);  // A server that died shows up as a failed request
+    bool passed = true;
+    for (int i = 1; i < argc; ++i) {
+        passed = testServer(argv[i], firstPort + i - 1) && passed;
+    }
+    cout << (passed ? "PASSED" : "FAILED") << endl;
+    return passed ? 0 : 1;
+}
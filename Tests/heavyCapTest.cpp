@@ -0,0 +1,131 @@
+#include <iostream>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <utility>
+#include "../src/hpp_files/CommandClass.hpp"
+#include "../src/hpp_files/Graph.hpp"
+#include "../src/hpp_files/MSTCache.hpp"
+#include "../src/hpp_files/Metrics.hpp"
+#include "../src/hpp_files/ThreadPool.hpp"
+
+using namespace std;
+
+// Heavy cap test for MSTWeight. Several clients each send a mutation and then MSTWeight lookups,
+// scheduled as the servers do: one strand per client, the lookups classified LIGHT. The first
+// lookup after a mutation finds the cached MST stale; it must not rebuild in its LIGHT slot but
+// continue as HEAVY, so no more than the HEAVY cap of rebuilds run at once, and every client's
+// commands still run in order.
+
+const int vertices = 20000;
+const int edgesPerVertex = 5;
+const int clients = 6;
+const int lookupsPerClient = 4;
+const size_t threads = 4;
+const size_t heavyLimit = 1;
+
+TimedMutex graphMutex;
+shared_ptr<Graph> graph;
+MSTCache mstCache;
+
+atomic<int> rebuilding{0};      // Rebuilds running now
+atomic<int> mostRebuilding{0};  // Most rebuilds that ran at once
+atomic<int> lightRebuilds{0};   // Rebuilds that ran in a LIGHT slot
+atomic<int> outOfOrder{0};      // Commands that ran before an earlier command of their client
+atomic<int> failedLookups{0};
+
+vector<int> nextCommand(clients, 0);  // Next command each client expects to run, only used by its strand
+
+// Checks that a command of a client runs in arrival order
+void arrive(int client, int command) {
+    if (nextCommand[client] != command) outOfOrder++;
+    nextCommand[client] = command + 1;
+}
+
+// Changes the weight of an edge, which makes the cached MST stale
+void mutation(int client, int command, const pair<pair<int, int>, double>& edge) {
+    arrive(client, command);
+    lock_guard<TimedMutex> lock(graphMutex);
+    graph->updateWeight(edge.first.first, edge.first.second, edge.second + 1);
+}
+
+// The MSTWeight handler of the servers, with the rebuilds counted
+void lookup(ThreadPool& pool, int client, int command, ThreadPool::TaskClass taskClass) {
+    unique_lock<TimedMutex> lock(graphMutex);
+    if (mustRunHeavy(taskClass, mstCache, *graph)) {
+        lock.unlock();
+        pool.enqueueNext(client, [&pool, client, command] { lookup(pool, client, command, ThreadPool::HEAVY); },
+                         ThreadPool::HEAVY);
+        return;
+    }
+    arrive(client, command);
+    bool rebuilds = !mstCache.isFresh(*graph);
+    if (rebuilds) {
+        if (taskClass == ThreadPool::LIGHT) lightRebuilds++;
+        int running = ++rebuilding;
+        int most = mostRebuilding;
+        while (running > most && !mostRebuilding.compare_exchange_weak(most, running)) {}
+    }
+    shared_ptr<Tree> mst = mstCache.refresh(lock, graph, MSTFactory::KRUSKAL, true);  // Sorts with the lock released
+    if (rebuilds) rebuilding--;
+    if (!mst || mst->getMSTWeight() <= 0) failedLookups++;
+}
+
+int main() {
+    // A connected random graph: a path through all vertices, then random edges
+    vector<pair<pair<int, int>, double>> edges;
+    uint64_t state = 42;
+    auto next = [&state] {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        return state >> 33;
+    };
+    for (int v = 1; v < vertices; ++v) edges.push_back({{v, v + 1}, static_cast<double>(next() % 1000 + 1)});
+    while (edges.size() < static_cast<size_t>(vertices) * edgesPerVertex) {
+        int u = static_cast<int>(next() % vertices) + 1, v = static_cast<int>(next() % vertices) + 1;
+        if (u != v) edges.push_back({{u, v}, static_cast<double>(next() % 1000 + 1)});
+    }
+    graph = make_shared<Graph>(vertices, edges);
+
+    {
+        ThreadPool pool(threads);
+        pool.setHeavyLimit(heavyLimit);
+        for (int client = 0; client < clients; ++client) {
+            pool.enqueue(client, [client, edge = edges[client]] { mutation(client, 0, edge); }, ThreadPool::NORMAL);
+            for (int command = 1; command <= lookupsPerClient; ++command) {
+                pool.enqueue(client, [&pool, client, command] { lookup(pool, client, command, ThreadPool::LIGHT); },
+                             classifyCommand("MSTWeight"));
+            }
+        }
+    }  // Runs every queued task, then joins the threads
+
+    bool passed = true;
+    if (lightRebuilds > 0) {
+        cerr << lightRebuilds << " MST rebuilds ran in a LIGHT slot" << endl;
+        passed = false;
+    }
+    if (mostRebuilding > static_cast<int>(heavyLimit)) {
+        cerr << mostRebuilding << " MST rebuilds ran at once, the HEAVY cap is " << heavyLimit << endl;
+        passed = false;
+    }
+    if (outOfOrder > 0) {
+        cerr << outOfOrder << " commands ran before an earlier command of their client" << endl;
+        passed = false;
+    }
+    for (int client = 0; client < clients; ++client) {
+        if (nextCommand[client] != lookupsPerClient + 1) {
+            cerr << "Client " << client << " ran " << nextCommand[client] << " of " << lookupsPerClient + 1 << " commands" << endl;
+            passed = false;
+        }
+    }
+    if (failedLookups > 0) {
+        cerr << failedLookups << " lookups got no MST" << endl;
+        passed = false;
+    }
+    if (passed) {
+        cout << clients << " clients, stale MSTWeight rebuilt in HEAVY slots, at most " << mostRebuilding
+             << " at once" << endl;
+    }
+    cout << (passed ? "PASSED" : "FAILED") << endl;
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,68 @@
+#include "../hpp_files/EdgeIndex.hpp"
+#include "../hpp_files/LinearProbing.hpp"
+#include <utility>
+
+EdgeIndex::EdgeIndex() : count(0) {}
+
+uint64_t EdgeIndex::makeKey(int u, int v) {
+    if (u > v) std::swap(u, v); // Undirected edge: normalize the endpoint order
+    return (static_cast<uint64_t>(static_cast<uint32_t>(u)) << 32) | static_cast<uint32_t>(v);
+}
+
+size_t EdgeIndex::probe(uint64_t key) const {
+    return LinearProbing::probe(table, key, isEmpty);
+}
+
+size_t EdgeIndex::find(int u, int v) const {
+    if (count == 0) return npos;
+    const Entry& entry = table[probe(makeKey(u, v))];
+    return entry.key == emptyKey ? npos : entry.slot;
+}
+
+void EdgeIndex::assign(int u, int v, size_t slot) {
+    // Keep the load factor below 1/2 so probe sequences stay short
+    if ((count + 1) * 2 > table.size()) {
+        rehash(table.empty() ? 16 : table.size() * 2);
+    }
+    uint64_t key = makeKey(u, v);
+    Entry& entry = table[probe(key)];
+    if (entry.key == emptyKey) {
+        entry.key = key;
+        count++;
+    }
+    entry.slot = slot;
+}
+
+bool EdgeIndex::erase(int u, int v) {
+    if (count == 0) return false;
+    size_t mask = table.size() - 1;
+    size_t hole = probe(makeKey(u, v));
+    if (table[hole].key == emptyKey) return false;
+
+    // Backward-shift deletion: pull later members of the probe run into the hole
+    size_t pos = hole;
+    while (true) {
+        pos = (pos + 1) & mask;
+        if (table[pos].key == emptyKey) break;
+        size_t home = LinearProbing::hash(table[pos].key) & mask;
+        // Move the entry only if its home position is not between the hole and its current position
+        bool between = (hole <= pos) ? (home > hole && home <= pos) : (home > hole || home <= pos);
+        if (!between) {
+            table[hole] = table[pos];
+            hole = pos;
+        }
+    }
+    table[hole].key = emptyKey;
+    count--;
+    return true;
+}
+
+void EdgeIndex::reserve(size_t n) {
+    size_t capacity = table.empty() ? 16 : table.size();
+    while (capacity < n * 2) capacity *= 2;
+    if (capacity > table.size()) rehash(capacity);
+}
+
+void EdgeIndex::rehash(size_t newCapacity) {
+    LinearProbing::rehash(table, newCapacity, Entry{emptyKey, 0}, isEmpty);
+}
@@ -1,42 +1,142 @@
 #include "../hpp_files/Graph.hpp"
 #include <iostream>
 #include <algorithm>
+#include <atomic>
 
 using namespace std;
 
-Graph::Graph(int n, const vector<pair<pair<int, int>, double>>& edges) : n(n) {
+// Source of version stamps shared by every graph, so stamps are never reused
+static atomic<uint64_t> versionCounter{0};
+
+Graph::Graph(int n, const vector<pair<pair<int, int>, double>>& edges) : n(n), version(++versionCounter) {
+    // Make sure every vertex mentioned by an edge has an adjacency list
+    for (const auto& edge : edges) {
+        this->n = max(this->n, max(edge.first.first, edge.first.second));
+    }
     // Initialize the graph with n+1 nodes to accommodate 1-based indexing
-    graph.resize(n + 1);
-    // Initialize the edges vector
-    this->edges = edges; // Store edges for Kruskal's algorithm
+    graph.resize(this->n + 1);
+    this->edges.reserve(edges.size());
+    edgeSlots.reserve(edges.size());
+    edgeIndex.reserve(edges.size());
     for (const auto& edge : edges) {
         int u = edge.first.first;
         int v = edge.first.second;
         double weight = edge.second;
-        // Add edge with weight to the graph
-        graph[u].push_back({v, weight});
-        // Since it's undirected, add the reverse edge
-        graph[v].push_back({u, weight});
+        // A repeated edge only matters for its lightest copy
+        if (!addEdge(u, v, weight) && hasEdge(u, v) && weight < this->edges[edgeIndex.find(u, v)].second) {
+            updateWeight(u, v, weight);
+        }
     }
 }
 
 void Graph::printGraph() const {
-    cout << "\nCurrent Graph (Adjacency List with Weights):\n";
-    for (int i = 1; i <= n; ++i) {
-        cout << i << " -> ";
+    ResponseBuilder out;
+    printGraph(out);
+    cout << out.str() << flush;
+}
+
+void Graph::printGraph(ResponseBuilder& out) const {
+    out << "\nCurrent Graph (Adjacency List with Weights):\n";
+    printVertices(out, 1, n + 1);
+}
+
+void Graph::printVertices(ResponseBuilder& out, int first, int last) const {
+    for (int i = max(first, 1); i < min(last, n + 1); ++i) {
+        out << vertexId(i) << " -> ";
         for (const auto& neighbor : graph[i]) {
-            cout << "(" << neighbor.first << ", " << neighbor.second << ") "; // Print node and weight
+            out << "(" << vertexId(neighbor.first) << ", ";
+            out.general(neighbor.second) << ") "; // Print node and weight
         }
-        cout << endl;
+        out << '\n';
+    }
+}
+
+bool Graph::addEdge(int u, int v, double weight) {
+    if (!isValidVertex(u) || !isValidVertex(v) || hasEdge(u, v)) return false; // No parallel edges
+    Neighbor toV = graph[u].insert(graph[u].end(), {v, weight}); // Add edge with weight to the graph
+    Neighbor toU = graph[v].insert(graph[v].end(), {u, weight}); // Add reverse edge
+    edgeIndex.assign(u, v, edges.size());
+    edges.push_back({{u, v}, weight});
+    edgeSlots.push_back({toV, toU});
+    bumpVersion();
+    return true;
+}
+
+bool Graph::removeEdge(int u, int v) {
+    size_t pos = edgeIndex.find(u, v);
+    if (pos == EdgeIndex::npos) return false;
+
+    const auto& edge = edges[pos].first;
+    graph[edge.first].erase(edgeSlots[pos].first);   // Remove edge from the graph
+    graph[edge.second].erase(edgeSlots[pos].second); // Remove reverse edge from the graph
+    edgeIndex.erase(u, v);
+
+    // Fill the gap with the last edge so the edge vector stays dense
+    size_t last = edges.size() - 1;
+    if (pos != last) {
+        edges[pos] = edges[last];
+        edgeSlots[pos] = edgeSlots[last];
+        edgeIndex.assign(edges[pos].first.first, edges[pos].first.second, pos);
     }
+    edges.pop_back();
+    edgeSlots.pop_back();
+    bumpVersion();
+    return true;
+}
+
+bool Graph::updateWeight(int u, int v, double weight) {
+    size_t pos = edgeIndex.find(u, v);
+    if (pos == EdgeIndex::npos) return false;
+    edges[pos].second = weight;
+    edgeSlots[pos].first->second = weight;  // Weight seen from u
+    edgeSlots[pos].second->second = weight; // Weight seen from v
+    bumpVersion();
+    return true;
 }
 
-void Graph::addEdge(int u, int v, double weight) {
-    graph[u].push_back({v, weight}); // Add edge with weight to the graph
-    graph[v].push_back({u, weight}); // Add reverse edge
+void Graph::bumpVersion() {
+    version = ++versionCounter;
+}
+
+bool Graph::getEdgeWeight(int u, int v, double& weight) const {
+    size_t pos = edgeIndex.find(u, v);
+    if (pos == EdgeIndex::npos) return false;
+    weight = edges[pos].second;
+    return true;
+}
+
+bool Graph::applyBatch(const vector<EdgeOp>& ops, size_t& failedOp) {
+    // Validate against the graph as it will look after the earlier operations of the batch
+    EdgeIndex staged; // Slot 1 = edge present, 0 = edge absent, missing = as in the graph
+    for (size_t i = 0; i < ops.size(); ++i) {
+        const EdgeOp& op = ops[i];
+        size_t state = staged.find(op.u, op.v);
+        bool present = state == EdgeIndex::npos ? hasEdge(op.u, op.v) : state == 1;
+        bool valid = op.type == EdgeOp::ADD
+            ? isValidVertex(op.u) && isValidVertex(op.v) && !present
+            : present;
+        if (!valid) {
+            failedOp = i;
+            return false;
+        }
+        staged.assign(op.u, op.v, op.type == EdgeOp::REMOVE ? 0 : 1);
+    }
+
+    // Every operation is known to succeed now
+    for (const auto& op : ops) {
+        switch (op.type) {
+            case EdgeOp::ADD: addEdge(op.u, op.v, op.weight); break;
+            case EdgeOp::REMOVE: removeEdge(op.u, op.v); break;
+            case EdgeOp::UPDATE: updateWeight(op.u, op.v, op.weight); break;
+        }
+    }
+    return true;
 }
 
-void Graph::removeEdge(int u, int v) {
-    graph[u].remove_if([v](const pair<int, double>& p) { return p.first == v; }); // Remove edge from the graph
-    graph[v].remove_if([u](const pair<int, double>& p) { return p.first == u; }); // Remove reverse edge from the graph
+size_t Graph::memoryUsage() const {
+    // Every edge has a node in the lists of both endpoints: the neighbor and two links
+    size_t listNodes = 2 * edges.size() * (sizeof(pair<int, double>) + 2 * sizeof(void*));
+    return sizeof(*this) + graph.capacity() * sizeof(graph[0]) + listNodes + edges.capacity() * sizeof(edges[0]) +
+           edgeSlots.capacity() * sizeof(edgeSlots[0]) + edgeIndex.memoryUsage() +
+           (vertexIds ? vertexIds->memoryUsage() : 0);
 }
@@ -0,0 +1,269 @@
+#include "../hpp_files/GraphGenerator.hpp"
+#include "../hpp_files/ThreadPool.hpp"
+#include <algorithm>
+#include <cmath>
+#include <functional>
+
+// Independent random streams, so e.g. the weights do not depend on how the endpoints were drawn
+enum Stream : uint64_t { ENDPOINT_U = 1, ENDPOINT_V, WEIGHT, POINT_X, POINT_Y, QUADRANT };
+
+// Rounds of sampling before distinctEdges() settles for fewer edges than asked for
+static const int maxRounds = 64;
+
+// Items per chunk of parallel work. Fixed, so the chunks and their order do not depend on the pool
+static const size_t sampleGrain = 1 << 16;
+static const size_t vertexGrain = 1 << 12;
+
+// splitmix64 finalizer: a cheap bijective hash whose outputs look independent
+static uint64_t mix(uint64_t x) {
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+// The index-th random number of a stream
+static uint64_t draw(uint64_t seed, uint64_t stream, uint64_t index) {
+    return mix(mix(seed ^ mix(stream)) + index);
+}
+
+// Uniform in [0, 1)
+static double unit(uint64_t bits) {
+    return (bits >> 11) * (1.0 / (uint64_t(1) << 53));
+}
+
+// The weight of an edge depends only on its endpoints, not on when it was produced
+static double pairWeight(uint64_t seed, int u, int v) {
+    uint64_t key = (uint64_t(std::min(u, v)) << 32) | uint64_t(std::max(u, v));
+    return double(1 + draw(seed, WEIGHT, key) % GraphGenerator::maxWeight);
+}
+
+bool GraphGenerator::parseModel(const std::string& name, Model& model) {
+    if (name == "er" || name == "erdos-renyi" || name == "random") {
+        model = ERDOS_RENYI;
+    } else if (name == "grid") {
+        model = GRID;
+    } else if (name == "geometric") {
+        model = GEOMETRIC;
+    } else if (name == "rmat" || name == "power-law") {
+        model = RMAT;
+    } else if (name == "complete") {
+        model = COMPLETE;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const char* GraphGenerator::modelName(Model model) {
+    switch (model) {
+        case ERDOS_RENYI: return "er";
+        case GRID: return "grid";
+        case GEOMETRIC: return "geometric";
+        case RMAT: return "rmat";
+        default: return "complete";
+    }
+}
+
+GraphGenerator::EdgeList GraphGenerator::generate(Model model, int n, size_t m, uint64_t seed, ThreadPool* pool) {
+    switch (model) {
+        case ERDOS_RENYI: return erdosRenyi(n, m, seed, pool);
+        case GRID: return grid(n, seed, pool);
+        case GEOMETRIC: return randomGeometric(n, m, seed, pool);
+        case RMAT: return rmat(n, m, seed, pool);
+        default: return complete(n, seed, pool);
+    }
+}
+
+uint64_t GraphGenerator::edgeCount(Model model, int n, uint64_t m) {
+    if (n < 2) return 0;
+    uint64_t pairs = uint64_t(n) * (n - 1) / 2;
+    if (model == GRID) {
+        uint64_t cols = std::max(1, int(std::sqrt(double(n))));
+        uint64_t rows = (n + cols - 1) / cols;
+        return 2 * uint64_t(n) - rows - cols;  // Right and lower neighbours, except on the borders
+    }
+    return model == COMPLETE ? pairs : std::min(m, pairs);
+}
+
+template <typename Producer>
+GraphGenerator::EdgeList GraphGenerator::joinChunks(size_t count, size_t grain, ThreadPool* pool, Producer produce) {
+    std::vector<EdgeList> chunks((count + grain - 1) / grain);
+    auto run = [&chunks, &produce, count, grain](size_t first, size_t last) {
+        for (size_t c = first; c < last; ++c) produce(c * grain, std::min(count, (c + 1) * grain), chunks[c]);
+    };
+    if (pool) {
+        pool->parallelFor(0, chunks.size(), 1, run);
+    } else {
+        run(0, chunks.size());
+    }
+
+    size_t total = 0;
+    for (const EdgeList& chunk : chunks) total += chunk.size();
+    EdgeList edges;
+    edges.reserve(total);
+    for (EdgeList& chunk : chunks) {
+        edges.insert(edges.end(), chunk.begin(), chunk.end());
+        EdgeList().swap(chunk);  // Frees the chunk at once, halving the peak memory
+    }
+    return edges;
+}
+
+template <typename Sampler>
+GraphGenerator::EdgeList GraphGenerator::distinctEdges(size_t m, uint64_t seed, ThreadPool* pool, Sampler sample) {
+    struct Candidate {
+        int u, v;
+        uint64_t index;  // Position in the sampled sequence
+    };
+    auto byPair = [](const Candidate& a, const Candidate& b) {
+        return a.u != b.u ? a.u < b.u : a.v != b.v ? a.v < b.v : a.index < b.index;
+    };
+    auto byIndex = [](const Candidate& a, const Candidate& b) { return a.index < b.index; };
+    auto forRange = [pool](size_t first, size_t last, const std::function<void(size_t, size_t)>& body) {
+        if (pool) {
+            pool->parallelFor(first, last, sampleGrain, body);
+        } else {
+            body(first, last);
+        }
+    };
+
+    std::vector<Candidate> kept;
+    uint64_t next = 0;
+    for (int round = 0; kept.size() < m && round < maxRounds; ++round) {
+        // Sample a little more than is missing, since some samples repeat a pair
+        size_t missing = m - kept.size(), old = kept.size();
+        size_t count = missing + missing / 8 + 16;
+        kept.resize(old + count);
+        forRange(0, count, [&kept, &sample, old, next](size_t first, size_t last) {
+            for (size_t i = first; i < last; ++i) {
+                int u, v;
+                sample(next + i, u, v);
+                kept[old + i] = {std::min(u, v), std::max(u, v), next + i};
+            }
+        });
+        next += count;
+        kept.erase(std::remove_if(kept.begin() + old, kept.end(), [](const Candidate& c) { return c.u == c.v; }),
+                   kept.end());
+
+        // Of repeated pairs only the first sample counts; the order is total, so any sort gives the same result
+        if (pool) {
+            pool->parallelSort(kept.begin(), kept.end(), byPair);
+        } else {
+            std::sort(kept.begin(), kept.end(), byPair);
+        }
+        kept.erase(std::unique(kept.begin(), kept.end(),
+                               [](const Candidate& a, const Candidate& b) { return a.u == b.u && a.v == b.v; }),
+                   kept.end());
+    }
+    // The first m distinct pairs of the sequence, in sampling order
+    if (pool) {
+        pool->parallelSort(kept.begin(), kept.end(), byIndex);
+    } else {
+        std::sort(kept.begin(), kept.end(), byIndex);
+    }
+    kept.resize(std::min(kept.size(), m));
+
+    EdgeList edges(kept.size());
+    forRange(0, kept.size(), [&edges, &kept, seed](size_t first, size_t last) {
+        for (size_t i = first; i < last; ++i) {
+            edges[i] = {{kept[i].u, kept[i].v}, pairWeight(seed, kept[i].u, kept[i].v)};
+        }
+    });
+    return edges;
+}
+
+GraphGenerator::EdgeList GraphGenerator::erdosRenyi(int n, size_t m, uint64_t seed, ThreadPool* pool) {
+    if (n < 2) return {};
+    uint64_t pairs = uint64_t(n) * (n - 1) / 2;
+    if (m >= pairs) return complete(n, seed, pool);  // Rejection sampling would only slow down near the end
+
+    return distinctEdges(m, seed, pool, [seed, n](uint64_t i, int& u, int& v) {
+        u = int(draw(seed, ENDPOINT_U, i) % n) + 1;
+        v = int(draw(seed, ENDPOINT_V, i) % n) + 1;
+    });
+}
+
+GraphGenerator::EdgeList GraphGenerator::grid(int n, uint64_t seed, ThreadPool* pool) {
+    if (n < 2) return {};
+    int cols = std::max(1, int(std::sqrt(double(n))));
+    return joinChunks(n, vertexGrain, pool, [n, cols, seed](size_t first, size_t last, EdgeList& out) {
+        out.reserve(2 * (last - first));
+        for (int u = int(first) + 1; u <= int(last); ++u) {
+            if (u % cols != 0 && u + 1 <= n) out.push_back({{u, u + 1}, pairWeight(seed, u, u + 1)});  // Right
+            if (u + cols <= n) out.push_back({{u, u + cols}, pairWeight(seed, u, u + cols)});          // Down
+        }
+    });
+}
+
+GraphGenerator::EdgeList GraphGenerator::randomGeometric(int n, size_t m, uint64_t seed, ThreadPool* pool) {
+    if (n < 2) return {};
+    std::vector<double> x(n), y(n);
+    for (int i = 0; i < n; ++i) {
+        x[i] = unit(draw(seed, POINT_X, i));
+        y[i] = unit(draw(seed, POINT_Y, i));
+    }
+    // About pi r^2 of all pairs are closer than r, ignoring the border of the square
+    double radius = std::sqrt(2.0 * m / (M_PI * double(n) * (n - 1)));
+    radius = std::min(radius, std::sqrt(2.0));
+
+    // Points are bucketed into square cells at least as wide as the radius, so neighbours
+    // are found in the 3x3 cells around a point
+    int cells = int(std::min(1.0 / radius, std::sqrt(double(n)) + 1));
+    cells = std::max(cells, 1);
+    auto cellOf = [cells](double coordinate) { return std::min(int(coordinate * cells), cells - 1); };
+    std::vector<int> start(size_t(cells) * cells + 1, 0), order(n);
+    for (int i = 0; i < n; ++i) start[size_t(cellOf(y[i])) * cells + cellOf(x[i]) + 1]++;
+    for (size_t c = 1; c < start.size(); ++c) start[c] += start[c - 1];
+    std::vector<int> fill(start.begin(), start.end() - 1);
+    for (int i = 0; i < n; ++i) order[fill[size_t(cellOf(y[i])) * cells + cellOf(x[i])]++] = i;
+
+    // Each chunk of points finds its neighbours with a higher number
+    return joinChunks(n, vertexGrain, pool, [&](size_t first, size_t last, EdgeList& out) {
+        for (int i = int(first); i < int(last); ++i) {
+            int cx = cellOf(x[i]), cy = cellOf(y[i]);
+            for (int ny = std::max(cy - 1, 0); ny <= std::min(cy + 1, cells - 1); ++ny) {
+                for (int nx = std::max(cx - 1, 0); nx <= std::min(cx + 1, cells - 1); ++nx) {
+                    size_t cell = size_t(ny) * cells + nx;
+                    for (int k = start[cell]; k < start[cell + 1]; ++k) {
+                        int j = order[k];
+                        if (j <= i) continue;  // Each pair once
+                        double distance = std::hypot(x[i] - x[j], y[i] - y[j]);
+                        if (distance > radius) continue;
+                        double weight = std::max(1.0, std::ceil(distance / radius * maxWeight));
+                        out.push_back({{i + 1, j + 1}, weight});
+                    }
+                }
+            }
+        }
+    });
+}
+
+GraphGenerator::EdgeList GraphGenerator::rmat(int n, size_t m, uint64_t seed, ThreadPool* pool) {
+    if (n < 2) return {};
+    int levels = 0;
+    while ((int64_t(1) << levels) < n) ++levels;
+    m = std::min<uint64_t>(m, uint64_t(n) * (n - 1) / 2);
+
+    return distinctEdges(m, seed, pool, [seed, n, levels](uint64_t i, int& u, int& v) {
+        // Each level picks a quadrant of the adjacency matrix, i.e. one bit of each endpoint
+        int64_t row = 0, col = 0;
+        for (int level = 0; level < levels; ++level) {
+            double p = unit(draw(seed, QUADRANT, i * 64 + level));
+            row = row << 1 | (p >= 0.76);                            // c or d
+            col = col << 1 | ((p >= 0.57 && p < 0.76) || p >= 0.95);  // b or d
+        }
+        if (row >= n || col >= n) row = col = 0;  // Outside the matrix: rejected like a self-loop
+        u = int(row) + 1;
+        v = int(col) + 1;
+    });
+}
+
+GraphGenerator::EdgeList GraphGenerator::complete(int n, uint64_t seed, ThreadPool* pool) {
+    if (n < 2) return {};
+    // Row u holds the edges to the higher vertices; rows are chunked few at a time, as they are long
+    return joinChunks(n, 16, pool, [n, seed](size_t first, size_t last, EdgeList& out) {
+        for (int u = int(first) + 1; u <= int(last); ++u) {
+            for (int v = u + 1; v <= n; ++v) out.push_back({{u, v}, pairWeight(seed, u, v)});
+        }
+    });
+}
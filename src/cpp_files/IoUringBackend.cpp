@@ -0,0 +1,500 @@
+#include "../hpp_files/IoUringBackend.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// Ring size; the completion queue is twice as large
+static const unsigned ringEntries = 1024;
+
+// Provided receive buffers: count (a power of two) and size of each
+static const unsigned bufferCount = 256;
+static const size_t bufferSize = 4096;
+static const unsigned short bufferGroup = 0;
+
+// Operation encoded in the upper half of the user data, the socket in the lower half
+enum Operation : uint64_t { ACCEPT = 1, RECEIVE, SEND, WAKE, CANCEL };
+
+static uint64_t tag(Operation operation, int fd) {
+    return (static_cast<uint64_t>(operation) << 32) | static_cast<uint32_t>(fd);
+}
+
+// There is no liburing on the build hosts, so the three system calls are made directly
+static int ioUringSetup(unsigned entries, io_uring_params* params) {
+    return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+}
+
+static int ioUringEnter(int ringFd, unsigned toSubmit, unsigned minComplete, unsigned flags) {
+    return static_cast<int>(syscall(__NR_io_uring_enter, ringFd, toSubmit, minComplete, flags, nullptr, 0));
+}
+
+static int ioUringRegister(int ringFd, unsigned opcode, void* arg, unsigned count) {
+    return static_cast<int>(syscall(__NR_io_uring_register, ringFd, opcode, arg, count));
+}
+
+IoUringBackend::IoUringBackend(Handler& handler)
+    : handler(handler), ringFd(-1), wakeFd(-1), wakeValue(0), sqEntries(0), sqHead(nullptr),
+      sqTail(nullptr), sqMask(nullptr), sqArray(nullptr), sqes(nullptr), cqHead(nullptr), cqTail(nullptr),
+      cqMask(nullptr), cqes(nullptr), rings(nullptr), ringsSize(0), sqesSize(0), bufferRing(nullptr),
+      buffers(nullptr), bufferTail(0) {}
+
+IoUringBackend::~IoUringBackend() {
+    release();
+}
+
+bool IoUringBackend::start(int listenSocket) {
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    ringFd = ioUringSetup(ringEntries, &params);
+    if (ringFd < 0) return false;  // Kernel without io_uring, or disabled by policy
+    if (!(params.features & IORING_FEAT_SINGLE_MMAP) || !(params.features & IORING_FEAT_NODROP)) {
+        release();
+        return false;
+    }
+
+    // Map the rings shared with the kernel
+    size_t sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    size_t cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    ringsSize = std::max(sqRingSize, cqRingSize);
+    rings = mmap(nullptr, ringsSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+    sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+    void* entries = mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES);
+    if (rings == MAP_FAILED || entries == MAP_FAILED) {
+        if (rings == MAP_FAILED) rings = nullptr;
+        if (entries != MAP_FAILED) munmap(entries, sqesSize);
+        release();
+        return false;
+    }
+    char* base = static_cast<char*>(rings);
+    sqEntries = params.sq_entries;
+    sqHead = reinterpret_cast<unsigned*>(base + params.sq_off.head);
+    sqTail = reinterpret_cast<unsigned*>(base + params.sq_off.tail);
+    sqMask = reinterpret_cast<unsigned*>(base + params.sq_off.ring_mask);
+    sqArray = reinterpret_cast<unsigned*>(base + params.sq_off.array);
+    sqes = static_cast<io_uring_sqe*>(entries);
+    cqHead = reinterpret_cast<unsigned*>(base + params.cq_off.head);
+    cqTail = reinterpret_cast<unsigned*>(base + params.cq_off.tail);
+    cqMask = reinterpret_cast<unsigned*>(base + params.cq_off.ring_mask);
+    cqes = reinterpret_cast<io_uring_cqe*>(base + params.cq_off.cqes);
+
+    // Register the ring of provided receive buffers (Linux 5.19, like multishot accept)
+    void* ring = mmap(nullptr, bufferCount * sizeof(io_uring_buf), PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ring == MAP_FAILED) {
+        release();
+        return false;
+    }
+    // Entries are addressed as a plain array: in C++ the header's flexible array member sits behind an
+    // empty struct of size 1 and would be misplaced. The ring tail overlays the reserved field of entry 0.
+    bufferRing = static_cast<io_uring_buf*>(ring);
+    io_uring_buf_reg registration;
+    memset(&registration, 0, sizeof(registration));
+    registration.ring_addr = reinterpret_cast<uint64_t>(bufferRing);
+    registration.ring_entries = bufferCount;
+    registration.bgid = bufferGroup;
+    if (ioUringRegister(ringFd, IORING_REGISTER_PBUF_RING, &registration, 1) < 0) {
+        release();
+        return false;
+    }
+    buffers = new char[bufferCount * bufferSize];
+    for (unsigned i = 0; i < bufferCount; ++i) {
+        returnBuffer(static_cast<unsigned short>(i));
+    }
+
+    wakeFd = eventfd(0, EFD_CLOEXEC);
+    if (wakeFd < 0) {
+        release();
+        return false;
+    }
+
+    prepareAccept(listenSocket);
+    prepareWake();
+    submit();
+    return true;
+}
+
+size_t IoUringBackend::wait(Completion* events, size_t max) {
+    while (true) {
+        takeRequests();
+
+        // Only this thread consumes completions, so the head needs no lock
+        unsigned head = *cqHead;
+        unsigned tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+        size_t count = 0;
+        while (head != tail && count < max) {
+            const io_uring_cqe& cqe = cqes[head & *cqMask];
+            head++;
+            Operation operation = static_cast<Operation>(cqe.user_data >> 32);
+            if (operation == WAKE) {
+                prepareWake();  // Another thread queued requests; they are taken in the next round
+                continue;
+            }
+            if (operation == CANCEL) continue;
+            events[count++] = Completion{cqe.user_data, cqe.res, cqe.flags};
+        }
+        __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+        if (count > 0) return count;
+        if (head != tail) continue;  // Only internal completions so far, look again
+
+        // Submit everything prepared since the last round and sleep until a completion arrives
+        if (ioUringEnter(ringFd, pendingEntries(), 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR &&
+            errno != EAGAIN && errno != EBUSY) {
+            std::cerr << "Error on io_uring_enter: " << strerror(errno) << std::endl;
+            return 0;
+        }
+    }
+}
+
+void IoUringBackend::dispatch(const Completion& event) {
+    Operation operation = static_cast<Operation>(event.data >> 32);
+    int fd = static_cast<int>(static_cast<uint32_t>(event.data));
+
+    if (operation == ACCEPT) {
+        if (event.result >= 0) {
+            int client = event.result;
+            {
+                std::lock_guard<std::mutex> lock(stateMutex);
+                sockets[client].reading = true;
+            }
+            handler.accepted(client);
+            prepareReceive(client);
+        } else {
+            std::cerr << "Error on accept: " << strerror(-event.result) << std::endl;
+        }
+        if (!(event.flags & IORING_CQE_F_MORE)) prepareAccept(fd);  // The multishot accept ended, re-arm it
+    } else if (operation == RECEIVE) {
+        onReceive(fd, event);
+    } else if (operation == SEND) {
+        onSend(fd, event);
+    }
+}
+
+void IoUringBackend::addListener(int socket) {
+    prepareAccept(socket);
+}
+
+void IoUringBackend::submit() {
+    if (pendingEntries() > 0) ioUringEnter(ringFd, pendingEntries(), 0, 0);
+}
+
+void IoUringBackend::send(int fd) {
+    bool idle;
+    {
+        std::lock_guard<std::mutex> lock(requestMutex);
+        idle = sendRequests.empty() && closeRequests.empty() && resumeRequests.empty();
+        sendRequests.push_back(fd);
+    }
+    if (idle) wake();  // Later requests ride on the same wakeup
+}
+
+void IoUringBackend::pauseReading(int fd) {
+    std::lock_guard<std::mutex> lock(stateMutex);
+    auto it = sockets.find(fd);
+    if (it != sockets.end()) it->second.throttled = true;  // Takes effect when the receive in flight completes
+}
+
+void IoUringBackend::resumeReading(int fd) {
+    bool idle;
+    {
+        std::lock_guard<std::mutex> lock(requestMutex);
+        idle = sendRequests.empty() && closeRequests.empty() && resumeRequests.empty();
+        resumeRequests.push_back(fd);
+    }
+    if (idle) wake();
+}
+
+void IoUringBackend::close(int fd) {
+    bool idle;
+    {
+        std::lock_guard<std::mutex> lock(requestMutex);
+        idle = sendRequests.empty() && closeRequests.empty() && resumeRequests.empty();
+        closeRequests.push_back(fd);
+    }
+    if (idle) wake();
+}
+
+io_uring_sqe* IoUringBackend::nextEntry() {
+    while (true) {
+        unsigned head = __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+        unsigned tail = *sqTail;
+        if (tail - head < sqEntries) {
+            io_uring_sqe* entry = &sqes[tail & *sqMask];
+            memset(entry, 0, sizeof(*entry));
+            return entry;
+        }
+        ioUringEnter(ringFd, tail - head, 0, 0);  // Queue full: hand the prepared entries to the kernel first
+    }
+}
+
+void IoUringBackend::publish(io_uring_sqe* entry) {
+    unsigned tail = *sqTail;
+    sqArray[tail & *sqMask] = static_cast<unsigned>(entry - sqes);
+    __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+}
+
+void IoUringBackend::prepareAccept(int listenSocket) {
+    std::lock_guard<std::mutex> lock(sqMutex);
+    io_uring_sqe* entry = nextEntry();
+    entry->opcode = IORING_OP_ACCEPT;
+    entry->fd = listenSocket;
+    entry->ioprio = IORING_ACCEPT_MULTISHOT;  // One entry accepts every client
+    entry->user_data = tag(ACCEPT, listenSocket);
+    publish(entry);
+}
+
+void IoUringBackend::prepareReceive(int fd) {
+    std::lock_guard<std::mutex> lock(sqMutex);
+    io_uring_sqe* entry = nextEntry();
+    entry->opcode = IORING_OP_RECV;
+    entry->fd = fd;
+    entry->len = bufferSize;
+    entry->flags = IOSQE_BUFFER_SELECT;  // The kernel picks a buffer when data arrives, not when armed
+    entry->buf_group = bufferGroup;
+    entry->user_data = tag(RECEIVE, fd);
+    publish(entry);
+}
+
+void IoUringBackend::prepareWake() {
+    std::lock_guard<std::mutex> lock(sqMutex);
+    io_uring_sqe* entry = nextEntry();
+    entry->opcode = IORING_OP_READ;
+    entry->fd = wakeFd;
+    entry->addr = reinterpret_cast<uint64_t>(&wakeValue);
+    entry->len = sizeof(wakeValue);
+    entry->user_data = tag(WAKE, wakeFd);
+    publish(entry);
+}
+
+void IoUringBackend::prepareCancel(uint64_t target) {
+    std::lock_guard<std::mutex> lock(sqMutex);
+    io_uring_sqe* entry = nextEntry();
+    entry->opcode = IORING_OP_ASYNC_CANCEL;
+    entry->addr = target;
+    entry->user_data = tag(CANCEL, 0);
+    publish(entry);
+}
+
+void IoUringBackend::returnBuffer(unsigned short id) {
+    std::lock_guard<std::mutex> lock(bufferMutex);
+    io_uring_buf& buffer = bufferRing[bufferTail & (bufferCount - 1)];
+    buffer.addr = reinterpret_cast<uint64_t>(buffers + id * bufferSize);
+    buffer.len = bufferSize;
+    buffer.bid = id;
+    bufferTail++;
+    __atomic_store_n(&bufferRing[0].resv, bufferTail, __ATOMIC_RELEASE);
+}
+
+void IoUringBackend::writeNext(int fd, Socket& socket) {
+    while (true) {
+        int count = handler.gather(fd, socket.iov, maxIovecs);
+        if (count > 0) {
+            socket.requested = 0;
+            for (int i = 0; i < count; ++i) {
+                socket.requested += socket.iov[i].iov_len;
+            }
+            memset(&socket.message, 0, sizeof(socket.message));
+            socket.message.msg_iov = socket.iov;
+            socket.message.msg_iovlen = count;
+
+            std::lock_guard<std::mutex> lock(sqMutex);
+            io_uring_sqe* entry = nextEntry();
+            entry->opcode = IORING_OP_SENDMSG;
+            entry->fd = fd;
+            entry->addr = reinterpret_cast<uint64_t>(&socket.message);
+            entry->len = 1;
+            entry->msg_flags = MSG_NOSIGNAL;  // A client that went away fails the send instead of raising SIGPIPE
+            entry->user_data = tag(SEND, fd);
+            publish(entry);
+            return;
+        }
+
+        // Output drained
+        bool rearm = false, closeNow = false;
+        {
+            std::lock_guard<std::mutex> lock(stateMutex);
+            if (socket.sendAgain) {
+                socket.sendAgain = false;  // Output was queued after gather looked, try again
+                continue;
+            }
+            socket.writing = false;
+            if (socket.blocked) {
+                socket.blocked = false;
+                if (socket.readPaused && !socket.closing && !socket.throttled) {
+                    socket.readPaused = false;  // The client caught up: accept requests again
+                    socket.reading = true;
+                    rearm = true;
+                }
+            }
+            closeNow = finishClose(fd, socket);
+        }
+        if (rearm) prepareReceive(fd);
+        if (closeNow) closeSocket(fd);
+        return;
+    }
+}
+
+void IoUringBackend::takeRequests() {
+    {
+        std::lock_guard<std::mutex> lock(requestMutex);
+        takenSends.swap(sendRequests);
+        takenCloses.swap(closeRequests);
+        takenResumes.swap(resumeRequests);
+    }
+    for (int fd : takenSends) {
+        startSend(fd);
+    }
+    for (int fd : takenResumes) {
+        bool rearm = false;
+        {
+            std::lock_guard<std::mutex> lock(stateMutex);
+            auto it = sockets.find(fd);
+            if (it == sockets.end()) continue;
+            Socket& socket = it->second;
+            socket.throttled = false;
+            if (socket.readPaused && !socket.blocked && !socket.closing) {
+                socket.readPaused = false;
+                socket.reading = true;
+                rearm = true;
+            }
+        }
+        if (rearm) prepareReceive(fd);
+    }
+    for (int fd : takenCloses) {
+        bool closeNow = false;
+        {
+            std::lock_guard<std::mutex> lock(stateMutex);
+            auto it = sockets.find(fd);
+            if (it == sockets.end()) continue;
+            Socket& socket = it->second;
+            socket.closing = true;
+            if (socket.reading) prepareCancel(tag(RECEIVE, fd));  // The socket closes when the receive ends
+            closeNow = finishClose(fd, socket);
+        }
+        if (closeNow) closeSocket(fd);
+    }
+    takenSends.clear();
+    takenCloses.clear();
+    takenResumes.clear();
+}
+
+void IoUringBackend::startSend(int fd) {
+    Socket* socket;
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        auto it = sockets.find(fd);
+        if (it == sockets.end() || it->second.failed) return;  // Closed, or the client is gone
+        socket = &it->second;
+        if (socket->writing) {
+            socket->sendAgain = true;  // The send in flight continues with the new output
+            return;
+        }
+        socket->writing = true;
+    }
+    writeNext(fd, *socket);
+}
+
+bool IoUringBackend::finishClose(int fd, Socket& socket) {
+    if (!socket.closing || socket.reading || socket.writing) return false;
+    sockets.erase(fd);
+    return true;
+}
+
+void IoUringBackend::closeSocket(int fd) {
+    handler.closed(fd);  // Before the descriptor can be reused by accept
+    ::close(fd);
+}
+
+void IoUringBackend::wake() {
+    uint64_t one = 1;
+    if (write(wakeFd, &one, sizeof(one)) < 0) {
+        // The counter is saturated, so a wakeup is pending anyway
+    }
+}
+
+void IoUringBackend::onReceive(int fd, const Completion& event) {
+    if (event.flags & IORING_CQE_F_BUFFER) {
+        unsigned short id = static_cast<unsigned short>(event.flags >> IORING_CQE_BUFFER_SHIFT);
+        if (event.result > 0) handler.received(fd, buffers + id * bufferSize, event.result);
+        returnBuffer(id);
+    }
+
+    bool rearm = false, hangUp = false, closeNow = false;
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        Socket& socket = sockets.at(fd);  // Kept while its receive was in flight
+        socket.reading = false;
+        if (event.result > 0 || event.result == -ENOBUFS || event.result == -EINTR) {
+            if (socket.closing) {
+                // Not read any more
+            } else if (socket.blocked || socket.throttled) {
+                socket.readPaused = true;  // Backpressure: resumes once the output drained and reading is resumed
+            } else {
+                socket.reading = true;
+                rearm = true;
+            }
+        } else if (event.result != -ECANCELED && !socket.hungUp) {
+            socket.hungUp = true;  // 0: the client closed its end
+            hangUp = true;
+        }
+        closeNow = finishClose(fd, socket);
+    }
+    if (rearm) prepareReceive(fd);
+    if (hangUp) handler.hungUp(fd);
+    if (closeNow) closeSocket(fd);
+}
+
+void IoUringBackend::onSend(int fd, const Completion& event) {
+    Socket* socket;
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        socket = &sockets.at(fd);  // Kept while its send was in flight
+    }
+
+    if (event.result >= 0) {
+        handler.sent(fd, event.result);
+        if (static_cast<size_t>(event.result) < socket->requested) {
+            std::lock_guard<std::mutex> lock(stateMutex);
+            socket->blocked = true;  // The socket buffer is full
+        }
+        writeNext(fd, *socket);  // The next send waits in the kernel until the socket drains
+        return;
+    }
+
+    // The client is gone: drop the output and report it once
+    bool hangUp = false, closeNow = false;
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        socket->writing = false;
+        socket->sendAgain = false;
+        socket->failed = true;
+        if (!socket->hungUp) {
+            socket->hungUp = true;
+            hangUp = true;
+        }
+        closeNow = finishClose(fd, *socket);
+    }
+    if (hangUp) handler.hungUp(fd);
+    if (closeNow) closeSocket(fd);
+}
+
+unsigned IoUringBackend::pendingEntries() {
+    return __atomic_load_n(sqTail, __ATOMIC_ACQUIRE) - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+}
+
+void IoUringBackend::release() {
+    if (wakeFd >= 0) ::close(wakeFd);
+    if (ringFd >= 0) ::close(ringFd);  // Also unregisters the buffer ring
+    if (sqes) munmap(sqes, sqesSize);
+    if (rings) munmap(rings, ringsSize);
+    if (bufferRing) munmap(bufferRing, bufferCount * sizeof(io_uring_buf));
+    delete[] buffers;
+    wakeFd = ringFd = -1;
+    sqes = nullptr;
+    rings = nullptr;
+    bufferRing = nullptr;
+    buffers = nullptr;
+}
@@ -0,0 +1,135 @@
+#include "../hpp_files/JobManager.hpp"
+
+JobManager::JobManager(size_t threads, size_t retained) : retained(retained), nextId(1), stopFlag(false) {
+    for (size_t i = 0; i < threads; ++i) {
+        workers.emplace_back(&JobManager::worker, this);
+    }
+}
+
+JobManager::~JobManager() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopFlag = true;
+        for (auto& entry : jobs) {
+            entry.second->control.cancel();  // Running jobs stop at their next check
+        }
+        queue.clear();  // Queued jobs never start
+    }
+    condition.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+std::shared_ptr<JobManager::Job> JobManager::create(const std::string& name) {
+    std::lock_guard<std::mutex> lock(mutex);
+    uint64_t id = nextId++;
+    auto job = std::make_shared<Job>(id, name);
+    job->submitted = std::chrono::steady_clock::now();
+    jobs[id] = job;
+    return job;
+}
+
+void JobManager::start(const std::shared_ptr<Job>& job, Work work, Callback finished) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (stopFlag || job->state != QUEUED) return;  // Cancelled before it was started
+    queue.push_back({job, std::move(work), std::move(finished)});
+    condition.notify_one();
+}
+
+std::shared_ptr<const JobManager::Job> JobManager::find(uint64_t id) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = jobs.find(id);
+    return it == jobs.end() ? nullptr : it->second;
+}
+
+bool JobManager::cancel(uint64_t id) {
+    Entry cancelled;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = jobs.find(id);
+        if (it == jobs.end()) return false;
+        Job& job = *it->second;
+        State state = job.state.load();
+        if (state == DONE || state == CANCELLED) return false;
+        job.control.cancel();
+        if (state == RUNNING) return true;  // The job thread ends it at the job's next check
+
+        // Still queued, or not started yet: take it out, so it does not wait for a thread only to be dropped
+        for (auto entry = queue.begin(); entry != queue.end(); ++entry) {
+            if (entry->job->id == id) {
+                cancelled = std::move(*entry);
+                queue.erase(entry);
+                break;
+            }
+        }
+        retire(job, CANCELLED);
+    }
+    if (cancelled.finished) cancelled.finished(*cancelled.job);
+    return true;
+}
+
+const char* JobManager::stateName(State state) {
+    switch (state) {
+        case QUEUED: return "queued";
+        case RUNNING: return "running";
+        case DONE: return "done";
+        case CANCELLED: return "cancelled";
+    }
+    return "unknown";
+}
+
+void JobManager::describe(const Job& job, ResponseBuilder& out) {
+    State state = job.state.load();
+    out << "Job " << static_cast<unsigned long long>(job.id) << " (" << job.name << "): " << stateName(state);
+    if (state == RUNNING) {
+        out << ", " << job.control.progress() << "%";
+        if (job.control.cancelled()) out << ", cancelling";
+    } else if (state == DONE || state == CANCELLED) {
+        std::chrono::duration<double> elapsed = job.finished - job.submitted;
+        out << " after ";
+        out.general(elapsed.count()) << " s";
+        if (state == DONE) out << ". " << job.summary;
+        if (state == CANCELLED && job.control.expired(job.finished)) out << ", deadline exceeded";
+    }
+    out << "\n";
+}
+
+void JobManager::worker() {
+    while (true) {
+        Entry entry;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            condition.wait(lock, [this] { return stopFlag || !queue.empty(); });
+            if (stopFlag) return;
+            entry = std::move(queue.front());
+            queue.pop_front();
+            entry.job->state = RUNNING;
+        }
+
+        Job& job = *entry.job;
+        entry.work(job);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (job.control.cancelled()) {
+                job.summary.clear();  // The result of a cancelled job is partial
+                job.tree.reset();
+                retire(job, CANCELLED);
+            } else {
+                retire(job, DONE);
+            }
+        }
+        if (entry.finished) entry.finished(job);
+    }
+}
+
+void JobManager::retire(Job& job, State state) {
+    job.finished = std::chrono::steady_clock::now();
+    job.state = state;  // Published last: pollers read the result once they see the final state
+    ended.push_back(job.id);
+    while (ended.size() > retained) {
+        jobs.erase(ended.front());  // Pollers that hold the job keep it alive
+        ended.pop_front();
+    }
+}
@@ -0,0 +1,145 @@
+#include "../hpp_files/MSTCache.hpp"
+#include "../hpp_files/KruskalMST.hpp"
+#include "../hpp_files/PrimMST.hpp"
+#include "../hpp_files/Profiler.hpp"
+
+MSTCache::MSTCache() : version(0), algorithm(MSTFactory::KRUSKAL), pool(nullptr) {}
+
+std::shared_ptr<Tree> MSTCache::refresh(std::unique_lock<TimedMutex>& lock, const std::shared_ptr<Graph>& g,
+                                        MSTFactory::AlgorithmType algorithm, bool anyAlgorithm,
+                                        JobControl* control) {
+    if (isFresh(*g) && (anyAlgorithm || this->algorithm == algorithm)) return tree;
+    if (anyAlgorithm) algorithm = this->algorithm;
+    if (control && control->cancelled()) return nullptr; // E.g. the deadline passed while the command was queued
+    if (algorithm == MSTFactory::PRIM) {
+        return recompute(*g, algorithm, control) ? tree : nullptr;
+    }
+
+    int n = g->getNumNodes();
+    uint64_t snapshot = g->getVersion();
+    std::vector<std::pair<std::pair<int, int>, double>> edges;
+    {
+        PROFILE_PHASE(EDGE_COPY);
+        edges = g->getEdges();
+    }
+    std::shared_ptr<const VertexIds> ids = g->getVertexIds(); // Read under the lock like the edges
+    lock.unlock();
+    std::shared_ptr<Tree> rebuilt = compute(n, std::move(edges), std::move(ids), algorithm, pool, control);
+    lock.lock();
+    if (!rebuilt) return nullptr; // Cancelled: the copy and the partial MST are freed already
+    install(*g, snapshot, rebuilt, algorithm); // Only this command sees the tree if the graph moved on
+    return rebuilt;
+}
+
+MSTCache::UpdateKind MSTCache::update(Graph& g, const std::vector<EdgeOp>& ops, uint64_t previousVersion) {
+    if (!tree || version != previousVersion) return NOT_CACHED; // Nobody asked for this graph's MST yet
+
+    // Kruskal over the old MST plus the touched edges is exact only if every edge left out is still
+    // the heaviest on its cycle through the old MST, i.e. MST edges may only get lighter.
+    // Prim trees cover a single component, so they are always rebuilt.
+    bool incremental = algorithm == MSTFactory::KRUSKAL && ops.size() <= static_cast<size_t>(g.getNumNodes());
+    for (size_t i = 0; incremental && i < ops.size(); ++i) {
+        double oldWeight, newWeight;
+        if (tree->getEdgeWeight(ops[i].u, ops[i].v, oldWeight)) {
+            incremental = g.getEdgeWeight(ops[i].u, ops[i].v, newWeight) && newWeight <= oldWeight;
+        }
+    }
+    if (!incremental) {
+        recompute(g, algorithm);
+        return REBUILT;
+    }
+
+    // Candidate edges: the old MST with current weights, and every touched edge that still exists
+    std::vector<std::pair<std::pair<int, int>, double>> candidates;
+    candidates.reserve(tree->getNumEdges() + ops.size());
+    for (const auto& edge : tree->getEdges()) {
+        double weight;
+        g.getEdgeWeight(edge.first.first, edge.first.second, weight); // MST edges were not removed
+        candidates.push_back({edge.first, weight});
+    }
+    for (const auto& op : ops) {
+        double weight;
+        if (!tree->hasEdge(op.u, op.v) && g.getEdgeWeight(op.u, op.v, weight)) {
+            candidates.push_back({{op.u, op.v}, weight}); // Graph merges edges touched twice
+        }
+    }
+
+    Graph reduced(g.getNumNodes(), candidates);
+    auto kruskalMST = MSTFactory::createKruskalMST(reduced, pool);
+    kruskalMST->findMST();
+    {
+        PROFILE_PHASE(TREE_BUILD);
+        tree = std::make_shared<Tree>(g.getNumNodes(), kruskalMST->getMSTEdges(), pool);
+    }
+    tree->setVertexIds(g.getVertexIds()); // Listings and paths show the client ids
+    version = g.getVersion();
+    return INCREMENTAL;
+}
+
+void MSTCache::clear() {
+    tree.reset();
+    version = 0;
+}
+
+bool MSTCache::install(const Graph& g, uint64_t version, std::shared_ptr<Tree> tree, MSTFactory::AlgorithmType algorithm) {
+    if (g.getVersion() != version) return false; // The graph changed while the tree was computed
+    this->tree = std::move(tree);
+    this->version = version;
+    this->algorithm = algorithm;
+    return true;
+}
+
+std::shared_ptr<Tree> MSTCache::compute(int n, std::vector<std::pair<std::pair<int, int>, double>> edges,
+                                        std::shared_ptr<const VertexIds> ids, MSTFactory::AlgorithmType algorithm,
+                                        ThreadPool* pool, JobControl* control) {
+    // Progress: 0-90% for the algorithm and the rest for the tree
+    std::vector<std::pair<std::pair<int, int>, double>> mstEdges;
+    if (control) control->setPhase(0, 90);
+    if (algorithm == MSTFactory::KRUSKAL) {
+        auto kruskalMST = MSTFactory::createKruskalMST(n, std::move(edges), pool, control);
+        kruskalMST->findMST();
+        mstEdges = kruskalMST->getMSTEdges();
+    } else {
+        auto primMST = MSTFactory::createPrimMST(n, std::move(edges), control); // Builds no Graph
+        primMST->findMST();
+        mstEdges = primMST->getMSTEdges();
+    }
+    if (control) {
+        if (control->cancelled()) return nullptr; // Partial MST
+        control->setPhase(90, 100);
+    }
+    PROFILE_PHASE(TREE_BUILD);
+    auto tree = std::make_shared<Tree>(n, mstEdges, pool);
+    tree->setVertexIds(std::move(ids));
+    return tree;
+}
+
+bool MSTCache::recompute(Graph& g, MSTFactory::AlgorithmType algorithm, JobControl* control) {
+    std::vector<std::pair<std::pair<int, int>, double>> mstEdges;
+    if (algorithm == MSTFactory::KRUSKAL) {
+        std::unique_ptr<KruskalMST> kruskalMST;
+        {
+            PROFILE_PHASE(EDGE_COPY); // The constructor copies the edge list
+            kruskalMST = MSTFactory::createKruskalMST(g, pool, control);
+        }
+        kruskalMST->findMST();
+        mstEdges = kruskalMST->getMSTEdges();
+    } else {
+        std::unique_ptr<PrimMST> primMST;
+        {
+            PROFILE_PHASE(EDGE_COPY); // The constructor copies the edge list
+            primMST = MSTFactory::createPrimMST(g, control);
+        }
+        primMST->findMST();
+        mstEdges = primMST->getMSTEdges();
+    }
+    if (control && control->cancelled()) return false; // Partial MST
+    {
+        PROFILE_PHASE(TREE_BUILD);
+        tree = std::make_shared<Tree>(g.getNumNodes(), mstEdges, pool);
+    }
+    tree->setVertexIds(g.getVertexIds());
+    version = g.getVersion();
+    this->algorithm = algorithm;
+    return true;
+}
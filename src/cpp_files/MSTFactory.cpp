@@ -2,12 +2,24 @@
 #include "../hpp_files/KruskalMST.hpp"
 #include "../hpp_files/PrimMST.hpp"
 
-std::unique_ptr<KruskalMST> MSTFactory::createKruskalMST(Graph& g) {
+std::unique_ptr<KruskalMST> MSTFactory::createKruskalMST(Graph& g, ThreadPool* pool, JobControl* control) {
     // Create and return a unique pointer to a KruskalMST instance using the provided graph
-    return std::make_unique<KruskalMST>(g);
+    return std::make_unique<KruskalMST>(g, pool, control);
 }
 
-std::unique_ptr<PrimMST> MSTFactory::createPrimMST(Graph& g) {
+std::unique_ptr<KruskalMST> MSTFactory::createKruskalMST(int n, std::vector<std::pair<std::pair<int, int>, double>> edges,
+                                                      ThreadPool* pool, JobControl* control) {
+    // Create a KruskalMST instance that owns the edge list
+    return std::make_unique<KruskalMST>(n, std::move(edges), pool, control);
+}
+
+std::unique_ptr<PrimMST> MSTFactory::createPrimMST(Graph& g, JobControl* control) {
     // Create and return a unique pointer to a PrimMST instance using the provided graph
-    return std::make_unique<PrimMST>(g);
+    return std::make_unique<PrimMST>(g, control);
+}
+
+std::unique_ptr<PrimMST> MSTFactory::createPrimMST(int n, std::vector<std::pair<std::pair<int, int>, double>> edges,
+                                                JobControl* control) {
+    // Create a PrimMST instance that owns the edge list
+    return std::make_unique<PrimMST>(n, std::move(edges), control);
 }
@@ -0,0 +1,44 @@
+#include "../hpp_files/OutputQueue.hpp"
+
+void OutputQueue::push(ResponseBuilder& response) {
+    if (streams.empty()) {
+        ready.splice(response);
+    } else {
+        streams.back().after.splice(response); // Waits for the stream ahead of it
+    }
+}
+
+void OutputQueue::push(std::unique_ptr<ResponseStream> stream) {
+    streams.push_back(PendingStream{std::move(stream), ResponseBuilder()});
+}
+
+ResponseBuilder::WriteResult OutputQueue::writeTo(int fd) {
+    while (true) {
+        ResponseBuilder::WriteResult result = ready.writeTo(fd);
+        if (result != ResponseBuilder::DONE) return result;
+        if (streams.empty()) return ResponseBuilder::DONE;
+
+        // The socket took everything so far: produce the next chunk of the oldest stream
+        PendingStream& front = streams.front();
+        if (!front.stream->next(ready)) {
+            ready.splice(front.after); // Stream finished, the output behind it is next
+            streams.pop_front();
+        }
+    }
+}
+
+int OutputQueue::gather(iovec* iov, int max) {
+    while (ready.empty() && !streams.empty()) {
+        PendingStream& front = streams.front();
+        if (!front.stream->next(ready)) {
+            ready.splice(front.after);
+            streams.pop_front();
+        }
+    }
+    return ready.gather(iov, max);
+}
+
+void OutputQueue::clear() {
+    ready.clear();
+    streams.clear();
+}
@@ -0,0 +1,192 @@
+#include "../hpp_files/Profiler.hpp"
+#include <atomic>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// Names of the phases, in the order of the enum
+static const char* const phaseNames[] = {"edge copy", "sort", "union-find", "graph build", "prim scan", "tree build",
+                                         "all-pairs index"};
+
+static_assert(sizeof(phaseNames) / sizeof(phaseNames[0]) == Profiler::numPhases, "every phase needs a name");
+
+// Hardware events counted with perf_event_open, the first one leading the group
+static const uint64_t hardwareEvents[] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+                                          PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+
+thread_local Profiler* Profiler::current = nullptr;
+
+#ifdef MST_PROFILE
+// Calls of operator new in the whole process
+static std::atomic<uint64_t> allocationCount{0};
+
+// Profiling builds count every allocation, and those of a profiled thread for its profile. malloc
+// and free are what the replaced operators do by default; the array and nothrow forms call these ones.
+void* operator new(std::size_t size) {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    if (Profiler* profiler = Profiler::active()) {
+        profiler->count(Profiler::ALLOCATIONS, 1);
+        profiler->count(Profiler::ALLOCATED_BYTES, size);
+    }
+    while (true) {
+        if (void* memory = std::malloc(size ? size : 1)) return memory;
+        std::new_handler handler = std::get_new_handler();
+        if (!handler) throw std::bad_alloc();
+        handler();
+    }
+}
+
+void operator delete(void* memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept {
+    std::free(memory);
+}
+#endif
+
+bool Profiler::countsAllocations() {
+#ifdef MST_PROFILE
+    return true;
+#else
+    return false;
+#endif
+}
+
+uint64_t Profiler::processAllocations() {
+#ifdef MST_PROFILE
+    return allocationCount.load(std::memory_order_relaxed);
+#else
+    return 0;
+#endif
+}
+
+// Returns the duration in milliseconds
+static double millis(Profiler::Clock::duration time) {
+    return std::chrono::duration<double, std::milli>(time).count();
+}
+
+Profiler::Profiler(bool hardware)
+    : previous(current), elapsed(0), stopped(false), hardware(hardware), hardwareError(0) {
+    for (int& fd : hardwareFds) fd = -1;
+    if (hardware) startHardware();
+    current = this;
+    started = Clock::now();
+}
+
+Profiler::~Profiler() {
+    stop();
+    for (int fd : hardwareFds) {
+        if (fd >= 0) close(fd);
+    }
+}
+
+void Profiler::startHardware() {
+    for (int i = 0; i < numHardwareCounters; ++i) {
+        perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = hardwareEvents[i];
+        attr.disabled = i == 0;  // The group starts when its leader is enabled
+        attr.exclude_kernel = 1;  // Allowed without privileges under the default perf_event_paranoid
+        attr.exclude_hv = 1;
+        // The calling thread on any CPU; threads it starts later are not counted
+        hardwareFds[i] = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, i == 0 ? -1 : hardwareFds[0], 0));
+        if (hardwareFds[i] < 0) {
+            hardwareError = errno;
+            return;
+        }
+    }
+    ioctl(hardwareFds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(hardwareFds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+}
+
+void Profiler::stop() {
+    if (stopped) return;
+    stopped = true;
+    elapsed = Clock::now() - started;
+    current = previous;
+    if (!hardware || hardwareError) return;
+    ioctl(hardwareFds[0], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+    for (int i = 0; i < numHardwareCounters; ++i) {
+        if (read(hardwareFds[i], &hardwareValues[i], sizeof(hardwareValues[i])) != sizeof(hardwareValues[i])) {
+            hardwareError = errno ? errno : EIO;
+            return;
+        }
+    }
+}
+
+void Profiler::report(ResponseBuilder& response) {
+    stop();
+    ResponseBuilder body;
+    size_t lines = 1;
+    body << "Total: ";
+    body.general(millis(elapsed)) << " ms\n";
+
+#ifdef MST_PROFILE
+    for (int phase = 0; phase < numPhases; ++phase) {
+        if (phaseRuns[phase] == 0) continue;
+        body << "Phase " << phaseNames[phase] << ": ";
+        body.general(millis(phaseTimes[phase])) << " ms in " << static_cast<unsigned long long>(phaseRuns[phase])
+                                                << (phaseRuns[phase] == 1 ? " run\n" : " runs\n");
+        ++lines;
+    }
+    body << "Kernels: edges scanned " << static_cast<unsigned long long>(counters[EDGES_SCANNED]) << ", finds "
+         << static_cast<unsigned long long>(counters[FINDS]) << ", unions " << static_cast<unsigned long long>(counters[UNIONS])
+         << ", path compression steps " << static_cast<unsigned long long>(counters[COMPRESSION_STEPS]) << "\n";
+    body << "Heap: pushes " << static_cast<unsigned long long>(counters[HEAP_PUSHES]) << ", pops "
+         << static_cast<unsigned long long>(counters[HEAP_POPS]) << ", stale pops "
+         << static_cast<unsigned long long>(counters[STALE_POPS]) << "\n";
+    body << "Allocations: " << static_cast<unsigned long long>(counters[ALLOCATIONS]) << ", "
+         << static_cast<unsigned long long>(counters[ALLOCATED_BYTES]) << " bytes\n";
+    lines += 3;
+#else
+    body << "Phases and counters: not compiled in, build the server with make profile\n";
+    ++lines;
+#endif
+
+    if (hardware) {
+        if (hardwareError) {
+            body << "Hardware counters unavailable: " << strerror(hardwareError) << "\n";
+        } else {
+            body << "Hardware: cycles " << static_cast<unsigned long long>(hardwareValues[0]) << ", instructions "
+                 << static_cast<unsigned long long>(hardwareValues[1]) << ", IPC ";
+            body.general(hardwareValues[0] ? static_cast<double>(hardwareValues[1]) / hardwareValues[0] : 0)
+                << ", cache misses " << static_cast<unsigned long long>(hardwareValues[2]) << ", branch misses "
+                << static_cast<unsigned long long>(hardwareValues[3]) << "\n";
+        }
+        ++lines;
+    }
+
+    ResponseBuilder profiled;
+    profiled << "Profile (" << static_cast<unsigned long long>(lines) << " lines):\n";
+    profiled.splice(body);
+    profiled.splice(response);
+    response = std::move(profiled);
+}
+
+Profiler::Mode Profiler::strip(std::string& command) {
+    static const char prefix[] = "Profile ";
+    static const char hardwarePrefix[] = "Profile hw ";
+    Mode mode;
+    size_t length;
+    if (command.rfind(hardwarePrefix, 0) == 0) {
+        mode = HARDWARE;
+        length = sizeof(hardwarePrefix) - 1;
+    } else if (command.rfind(prefix, 0) == 0) {
+        mode = ON;
+        length = sizeof(prefix) - 1;
+    } else {
+        return OFF;
+    }
+    while (length < command.size() && command[length] == ' ') ++length;
+    if (length == command.size()) return OFF;  // Nothing to profile: answered as an invalid command
+    command.erase(0, length);
+    return mode;
+}
@@ -0,0 +1,180 @@
+#include "../hpp_files/ResponseBuilder.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <mutex>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+// Free chunks shared by all builders; a few megabytes are kept for reuse, the rest is freed
+static std::mutex chunkPoolMutex;
+static std::vector<void*> chunkPool;
+static const size_t maxPooledChunks = 1024;
+
+// Most chunks one sendmsg call hands to the kernel
+static const int maxIovecs = 64;
+
+ResponseBuilder::ResponseBuilder() : bytes(0) {}
+
+ResponseBuilder::~ResponseBuilder() {
+    clear();
+}
+
+ResponseBuilder::ResponseBuilder(ResponseBuilder&& other) noexcept : chunks(std::move(other.chunks)), bytes(other.bytes) {
+    other.chunks.clear();
+    other.bytes = 0;
+}
+
+ResponseBuilder& ResponseBuilder::operator=(ResponseBuilder&& other) noexcept {
+    if (this != &other) {
+        clear();
+        chunks.swap(other.chunks);
+        bytes = other.bytes;
+        other.bytes = 0;
+    }
+    return *this;
+}
+
+ResponseBuilder& ResponseBuilder::operator<<(std::string_view text) {
+    while (!text.empty()) {
+        if (chunks.empty() || chunks.back()->end == chunkSize) {
+            chunks.push_back(acquireChunk());
+        }
+        Chunk* tail = chunks.back();
+        size_t count = std::min(text.size(), chunkSize - tail->end);
+        memcpy(tail->data + tail->end, text.data(), count);
+        tail->end += count;
+        bytes += count;
+        text.remove_prefix(count);
+    }
+    return *this;
+}
+
+ResponseBuilder& ResponseBuilder::operator<<(char c) {
+    return *this << std::string_view(&c, 1);
+}
+
+ResponseBuilder& ResponseBuilder::operator<<(long long value) {
+    char buffer[24];
+    auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    return *this << std::string_view(buffer, result.ptr - buffer);
+}
+
+ResponseBuilder& ResponseBuilder::operator<<(unsigned long long value) {
+    char buffer[24];
+    auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    return *this << std::string_view(buffer, result.ptr - buffer);
+}
+
+ResponseBuilder& ResponseBuilder::operator<<(double value) {
+    char buffer[400];  // Enough for the largest double with six decimals
+    auto result = std::to_chars(buffer, buffer + sizeof(buffer), value, std::chars_format::fixed, 6);
+    return *this << std::string_view(buffer, result.ptr - buffer);
+}
+
+ResponseBuilder& ResponseBuilder::general(double value) {
+    char buffer[32];
+    auto result = std::to_chars(buffer, buffer + sizeof(buffer), value, std::chars_format::general, 6);
+    return *this << std::string_view(buffer, result.ptr - buffer);
+}
+
+void ResponseBuilder::splice(ResponseBuilder& other) {
+    if (this == &other) return;
+    chunks.insert(chunks.end(), other.chunks.begin(), other.chunks.end());
+    bytes += other.bytes;
+    other.chunks.clear();
+    other.bytes = 0;
+}
+
+ResponseBuilder::WriteResult ResponseBuilder::writeTo(int fd) {
+    while (bytes > 0) {
+        iovec iov[maxIovecs];
+        int count = gather(iov, maxIovecs);
+
+        msghdr message{};
+        message.msg_iov = iov;
+        message.msg_iovlen = count;
+        // Like writev, but a client that went away fails the send instead of raising SIGPIPE
+        ssize_t written = sendmsg(fd, &message, MSG_NOSIGNAL);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return (errno == EAGAIN || errno == EWOULDBLOCK) ? WOULD_BLOCK : FAILED;
+        }
+        consume(written);  // A short write leaves the rest for the next call
+    }
+    return DONE;
+}
+
+int ResponseBuilder::gather(iovec* iov, int max) const {
+    int count = 0;
+    for (size_t i = 0; i < chunks.size() && count < max; ++i) {
+        if (chunks[i]->end == chunks[i]->begin) continue;
+        iov[count].iov_base = chunks[i]->data + chunks[i]->begin;
+        iov[count].iov_len = chunks[i]->end - chunks[i]->begin;
+        count++;
+    }
+    return count;
+}
+
+void ResponseBuilder::consume(size_t written) {
+    bytes -= written;
+    size_t finished = 0;
+    while (finished < chunks.size() && written > 0) {
+        Chunk* chunk = chunks[finished];
+        size_t available = chunk->end - chunk->begin;
+        size_t taken = std::min(available, written);
+        chunk->begin += taken;
+        written -= taken;
+        if (chunk->begin < chunk->end) break;
+        finished++;
+    }
+    for (size_t i = 0; i < finished; ++i) {
+        releaseChunk(chunks[i]);
+    }
+    chunks.erase(chunks.begin(), chunks.begin() + finished);
+    if (bytes == 0) clear();  // Hands back a fully written tail chunk
+}
+
+void ResponseBuilder::clear() {
+    for (Chunk* chunk : chunks) {
+        releaseChunk(chunk);
+    }
+    chunks.clear();
+    bytes = 0;
+}
+
+std::string ResponseBuilder::str() const {
+    std::string text;
+    text.reserve(bytes);
+    for (const Chunk* chunk : chunks) {
+        text.append(chunk->data + chunk->begin, chunk->end - chunk->begin);
+    }
+    return text;
+}
+
+ResponseBuilder::Chunk* ResponseBuilder::acquireChunk() {
+    Chunk* chunk = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(chunkPoolMutex);
+        if (!chunkPool.empty()) {
+            chunk = static_cast<Chunk*>(chunkPool.back());
+            chunkPool.pop_back();
+        }
+    }
+    if (!chunk) chunk = new Chunk;
+    chunk->begin = 0;
+    chunk->end = 0;
+    return chunk;
+}
+
+void ResponseBuilder::releaseChunk(Chunk* chunk) {
+    {
+        std::lock_guard<std::mutex> lock(chunkPoolMutex);
+        if (chunkPool.size() < maxPooledChunks) {
+            chunkPool.push_back(chunk);
+            return;
+        }
+    }
+    delete chunk;
+}
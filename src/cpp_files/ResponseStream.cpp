@@ -0,0 +1,46 @@
+#include "../hpp_files/ResponseStream.hpp"
+
+// Number of vertices or edges formatted between two checks of the chunk size
+static const size_t batchSize = 64;
+
+GraphPrintStream::GraphPrintStream(std::shared_ptr<const Graph> graph, TimedMutex& graphMutex, int first, int last)
+    : graph(std::move(graph)), graphMutex(graphMutex), version(this->graph->getVersion()), vertex(first), last(last) {}
+
+bool GraphPrintStream::next(ResponseBuilder& out) {
+    if (vertex >= last) return false;
+    std::lock_guard<TimedMutex> lock(graphMutex);
+    if (graph->getVersion() != version) {
+        out << "[Graph changed while it was being sent, output truncated]\n";
+        vertex = last;
+        return true;
+    }
+    size_t start = out.size();
+    while (vertex < last && out.size() - start < chunkBytes) {
+        int end = std::min(last, vertex + static_cast<int>(batchSize));
+        graph->printVertices(out, vertex, end);
+        vertex = end;
+    }
+    return true;
+}
+
+EdgeListStream::EdgeListStream(std::shared_ptr<const Tree> tree, size_t first, size_t last)
+    : tree(std::move(tree)), edge(first), last(last) {}
+
+bool EdgeListStream::next(ResponseBuilder& out) {
+    if (edge >= last) return false;
+    size_t start = out.size();
+    while (edge < last && out.size() - start < chunkBytes) {
+        size_t end = std::min(last, edge + batchSize);
+        printEdges(out, *tree, edge, end);
+        edge = end;
+    }
+    return true;
+}
+
+void EdgeListStream::printEdges(ResponseBuilder& out, const Tree& tree, size_t first, size_t last) {
+    const auto& edges = tree.getEdges();
+    for (size_t i = first; i < last && i < edges.size(); ++i) {
+        out << tree.vertexId(edges[i].first.first) << " -> " << tree.vertexId(edges[i].first.second)
+            << " (Weight: " << edges[i].second << ")\n";
+    }
+}
@@ -0,0 +1,257 @@
+#include "../hpp_files/ServerMetrics.hpp"
+#include <fstream>
+#include <unistd.h>
+
+// Names of the command types, in the order of the enum; the request lines of a type start with its name,
+// so a name must come after the longer names it is a prefix of
+static const char* const commandNames[] = {
+    "NewGraph", "GenerateGraph", "ApplyBatch", "Continuation", "NewEdge", "RemoveEdge", "UpdateWeight",
+    "Kruskal", "Prim", "MSTWeight", "LongestDistance", "AverageDistance", "ShortestPath", "PrintGraph",
+    "Async", "JobStatus", "JobResult", "CancelJob", "Stats", "TraceDump", "Trace", "exit", "Shed", "Invalid"};
+
+static_assert(sizeof(commandNames) / sizeof(commandNames[0]) == ServerMetrics::numCommandTypes,
+              "every command type needs a name");
+
+// Quantiles of the Prometheus summaries, as percentiles and as label values
+static const double quantilePercents[] = {50, 90, 99, 99.9};
+static const char* const quantileLabels[] = {"0.5", "0.9", "0.99", "0.999"};
+
+// Latency histograms of one thread, one per command type. Only the owning thread records into it.
+struct ServerMetrics::Shard {
+    AtomicHistogram latencies[numCommandTypes];
+};
+
+// Lends a shard to a thread for its lifetime, and hands it back for reuse when the thread exits
+struct ServerMetrics::ShardLease {
+    ServerMetrics* owner = nullptr;
+    Shard* shard = nullptr;
+
+    ~ShardLease() {
+        if (!owner) return;
+        std::lock_guard<std::mutex> lock(owner->shardsMutex);
+        owner->freeShards.push_back(shard);  // Its counts stay in the reports
+    }
+};
+
+thread_local ServerMetrics::ShardLease ServerMetrics::lease;
+
+// Body of a report, with the number of lines its header announces
+struct ReportBody {
+    ResponseBuilder text;
+    size_t lines = 0;
+
+    // Starts a line; the caller ends it with "\n"
+    ResponseBuilder& line() {
+        ++lines;
+        return text;
+    }
+};
+
+// Returns the resident set size of the process, 0 if /proc is not available
+static size_t residentBytes() {
+    std::ifstream statm("/proc/self/statm");
+    size_t pages = 0, resident = 0;
+    statm >> pages >> resident;
+    return resident * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+}
+
+// Appends the mean, percentiles and maximum of a histogram of nanoseconds, in microseconds
+static void appendLatencies(ResponseBuilder& out, const LatencyHistogram& histogram) {
+    out << "mean ";
+    out.general(histogram.mean() / 1e3) << " us, p50 ";
+    out.general(histogram.percentile(50) / 1e3) << " us, p90 ";
+    out.general(histogram.percentile(90) / 1e3) << " us, p99 ";
+    out.general(histogram.percentile(99) / 1e3) << " us, p99.9 ";
+    out.general(histogram.percentile(99.9) / 1e3) << " us, max ";
+    out.general(histogram.max() / 1e3) << " us";
+}
+
+// Appends the HELP and TYPE lines of a metric family
+static void appendFamily(ReportBody& body, const char* metric, const char* type, const char* help) {
+    body.line() << "# HELP " << metric << " " << help << "\n";
+    body.line() << "# TYPE " << metric << " " << type << "\n";
+}
+
+// Appends a single sample without labels
+static void appendSample(ReportBody& body, const char* metric, const char* type, const char* help, double value) {
+    appendFamily(body, metric, type, help);
+    body.line() << metric << " ";
+    body.text.general(value) << "\n";
+}
+
+// Appends a single whole-number sample without labels
+static void appendCount(ReportBody& body, const char* metric, const char* type, const char* help, unsigned long long value) {
+    appendFamily(body, metric, type, help);
+    body.line() << metric << " " << value << "\n";
+}
+
+// Appends the samples of a summary of nanoseconds, in seconds, e.g. labels `command="Prim"`
+static void appendSummary(ReportBody& body, const char* metric, const std::string& labels, const LatencyHistogram& histogram) {
+    for (size_t i = 0; i < sizeof(quantilePercents) / sizeof(quantilePercents[0]); ++i) {
+        body.line() << metric << "{" << labels << ",quantile=\"" << quantileLabels[i] << "\"} ";
+        body.text.general(histogram.percentile(quantilePercents[i]) / 1e9) << "\n";
+    }
+    body.line() << metric << "_sum{" << labels << "} ";
+    body.text.general(histogram.mean() * histogram.count() / 1e9) << "\n";
+    body.line() << metric << "_count{" << labels << "} " << static_cast<unsigned long long>(histogram.count()) << "\n";
+}
+
+ServerMetrics::ServerMetrics() : started(Clock::now()) {}
+
+ServerMetrics::~ServerMetrics() {
+    if (lease.owner == this) lease.owner = nullptr;  // The shard goes with this object
+}
+
+ServerMetrics::CommandType ServerMetrics::commandType(const std::string& command, bool continuation) {
+    // A new NewGraph or ApplyBatch starts over even in the middle of the lines of another one
+    if (command.rfind(commandNames[NEW_GRAPH], 0) == 0) return NEW_GRAPH;
+    if (command.rfind(commandNames[APPLY_BATCH], 0) == 0) return APPLY_BATCH;
+    if (continuation) return CONTINUATION;
+    for (int type = 0; type < SHED; ++type) {
+        if (type != CONTINUATION && command.rfind(commandNames[type], 0) == 0) return static_cast<CommandType>(type);
+    }
+    return INVALID;
+}
+
+const char* ServerMetrics::commandName(CommandType type) {
+    return commandNames[type];
+}
+
+ServerMetrics::Shard& ServerMetrics::localShard() {
+    if (lease.owner == this) return *lease.shard;
+    std::lock_guard<std::mutex> lock(shardsMutex);
+    if (!freeShards.empty()) {
+        lease.shard = freeShards.back();
+        freeShards.pop_back();
+    } else {
+        shards.push_back(std::make_unique<Shard>());
+        lease.shard = shards.back().get();
+    }
+    lease.owner = this;
+    return *lease.shard;
+}
+
+void ServerMetrics::recordCommand(CommandType type, Clock::time_point received) {
+    uint64_t nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - received).count();
+    localShard().latencies[type].record(nanos);
+}
+
+void ServerMetrics::addQueue(const std::string& name, const QueueGauge& gauge) {
+    queues.emplace_back(name, &gauge);
+}
+
+void ServerMetrics::addLock(const std::string& name, const TimedMutex& mutex) {
+    locks.emplace_back(name, &mutex);
+}
+
+LatencyHistogram ServerMetrics::commandLatencies(CommandType type) const {
+    LatencyHistogram merged;
+    std::lock_guard<std::mutex> lock(shardsMutex);  // Keeps new threads from growing the list meanwhile
+    for (const auto& shard : shards) shard->latencies[type].snapshot(merged);
+    return merged;
+}
+
+void ServerMetrics::report(ResponseBuilder& out, const Gauges& gauges) const {
+    ReportBody body;
+    body.line() << "Uptime: ";
+    body.text.general(std::chrono::duration<double>(Clock::now() - started).count())
+        << " s, commands in flight: " << static_cast<unsigned long long>(gauges.inFlight)
+        << ", shed: " << static_cast<unsigned long long>(gauges.shed) << "\n";
+
+    for (int type = 0; type < numCommandTypes; ++type) {
+        LatencyHistogram latencies = commandLatencies(static_cast<CommandType>(type));
+        if (latencies.count() == 0) continue;
+        body.line() << "Command " << commandNames[type] << ": count " << static_cast<unsigned long long>(latencies.count())
+                    << ", ";
+        appendLatencies(body.text, latencies);
+        body.text << "\n";
+    }
+
+    for (const auto& [name, gauge] : queues) {
+        LatencyHistogram waits;
+        gauge->waitTimes().snapshot(waits);
+        body.line() << "Queue " << name << ": depth " << static_cast<unsigned long long>(gauge->depth()) << ", enqueued "
+                    << static_cast<unsigned long long>(gauge->enqueuedCount()) << ", wait ";
+        appendLatencies(body.text, waits);
+        body.text << "\n";
+    }
+
+    for (const auto& [name, mutex] : locks) {
+        LatencyHistogram waits, holds;
+        mutex->waitTimes().snapshot(waits);
+        mutex->holdTimes().snapshot(holds);
+        body.line() << "Lock " << name << ": acquisitions " << static_cast<unsigned long long>(waits.count())
+                    << ", contended " << static_cast<unsigned long long>(mutex->contendedCount()) << ", wait ";
+        appendLatencies(body.text, waits);
+        body.text << "; hold ";
+        appendLatencies(body.text, holds);
+        body.text << "\n";
+    }
+
+    body.line() << "Memory: graph " << static_cast<unsigned long long>(gauges.graphBytes) << " bytes ("
+                << gauges.vertices << " vertices, " << static_cast<unsigned long long>(gauges.edges) << " edges), MST "
+                << static_cast<unsigned long long>(gauges.mstBytes) << " bytes, resident "
+                << static_cast<unsigned long long>(residentBytes()) << " bytes\n";
+    if (gauges.allocationsCounted) {
+        body.line() << "Allocations: " << static_cast<unsigned long long>(gauges.allocations) << " since the start\n";
+    }
+
+    out << "Stats (" << static_cast<unsigned long long>(body.lines) << " lines):\n";
+    out.splice(body.text);
+}
+
+void ServerMetrics::reportPrometheus(ResponseBuilder& out, const Gauges& gauges) const {
+    ReportBody body;
+    appendSample(body, "mst_uptime_seconds", "gauge", "Time since the server started.",
+                 std::chrono::duration<double>(Clock::now() - started).count());
+    appendCount(body, "mst_commands_in_flight", "gauge", "Admitted commands not answered yet.", gauges.inFlight);
+    appendCount(body, "mst_commands_shed_total", "counter", "Commands answered with BUSY under overload.", gauges.shed);
+
+    appendFamily(body, "mst_command_latency_seconds", "summary", "Time from reading a command to queueing its response.");
+    for (int type = 0; type < numCommandTypes; ++type) {
+        LatencyHistogram latencies = commandLatencies(static_cast<CommandType>(type));
+        if (latencies.count() == 0) continue;
+        appendSummary(body, "mst_command_latency_seconds", std::string("command=\"") + commandNames[type] + "\"", latencies);
+    }
+
+    appendFamily(body, "mst_queue_depth", "gauge", "Items waiting in a queue.");
+    for (const auto& [name, gauge] : queues) {
+        body.line() << "mst_queue_depth{queue=\"" << name << "\"} " << static_cast<unsigned long long>(gauge->depth()) << "\n";
+    }
+    appendFamily(body, "mst_queue_wait_seconds", "summary", "Time items waited in a queue.");
+    for (const auto& [name, gauge] : queues) {
+        LatencyHistogram waits;
+        gauge->waitTimes().snapshot(waits);
+        appendSummary(body, "mst_queue_wait_seconds", "queue=\"" + name + "\"", waits);
+    }
+
+    appendFamily(body, "mst_lock_contended_total", "counter", "Lock acquisitions that had to wait.");
+    for (const auto& [name, mutex] : locks) {
+        body.line() << "mst_lock_contended_total{lock=\"" << name << "\"} "
+                    << static_cast<unsigned long long>(mutex->contendedCount()) << "\n";
+    }
+    appendFamily(body, "mst_lock_wait_seconds", "summary", "Time from asking for a lock to getting it.");
+    for (const auto& [name, mutex] : locks) {
+        LatencyHistogram waits;
+        mutex->waitTimes().snapshot(waits);
+        appendSummary(body, "mst_lock_wait_seconds", "lock=\"" + name + "\"", waits);
+    }
+    appendFamily(body, "mst_lock_hold_seconds", "summary", "Time a lock was held.");
+    for (const auto& [name, mutex] : locks) {
+        LatencyHistogram holds;
+        mutex->holdTimes().snapshot(holds);
+        appendSummary(body, "mst_lock_hold_seconds", "lock=\"" + name + "\"", holds);
+    }
+
+    appendCount(body, "mst_graph_vertices", "gauge", "Vertices of the current graph.", gauges.vertices);
+    appendCount(body, "mst_graph_edges", "gauge", "Edges of the current graph.", gauges.edges);
+    appendCount(body, "mst_graph_memory_bytes", "gauge", "Estimated memory of the current graph.", gauges.graphBytes);
+    appendCount(body, "mst_tree_memory_bytes", "gauge", "Estimated memory of the cached MST.", gauges.mstBytes);
+    appendCount(body, "process_resident_memory_bytes", "gauge", "Resident memory size in bytes.", residentBytes());
+    if (gauges.allocationsCounted) {
+        appendCount(body, "mst_heap_allocations_total", "counter", "Calls of operator new since the start.", gauges.allocations);
+    }
+
+    out << "# Stats prometheus: " << static_cast<unsigned long long>(body.lines) << " lines follow\n";
+    out.splice(body.text);
+}
@@ -0,0 +1,156 @@
+#include "../hpp_files/ServerSocket.hpp"
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// Reads the numeric value following an option
+static bool parseNumber(int argc, char* argv[], int& i, long& value, long min, long max) {
+    if (i + 1 >= argc) return false;
+    char* end;
+    value = strtol(argv[++i], &end, 10);
+    return *argv[i] != '\0' && *end == '\0' && value >= min && value <= max;
+}
+
+bool ServerSocket::parseOptions(int argc, char* argv[], ServerOptions& options, bool reactorsSupported) {
+    for (int i = 1; i < argc; ++i) {
+        long value = 0;
+        bool valid = true;
+        if (strcmp(argv[i], "--io-uring") == 0) {
+            options.ioUring = true;
+        } else if (strcmp(argv[i], "--port") == 0) {
+            valid = parseNumber(argc, argv, i, value, 1, 65535);
+            options.port = static_cast<int>(value);
+        } else if (strcmp(argv[i], "--threads") == 0) {
+            valid = parseNumber(argc, argv, i, value, 1, 1024);
+            options.threads = static_cast<size_t>(value);
+        } else if (strcmp(argv[i], "--heavy") == 0) {
+            valid = parseNumber(argc, argv, i, value, 1, 1024);
+            options.heavy = static_cast<size_t>(value);
+        } else if (strcmp(argv[i], "--queue") == 0) {
+            valid = parseNumber(argc, argv, i, value, 1, 1 << 24);
+            options.queue = static_cast<size_t>(value);
+        } else if (strcmp(argv[i], "--inflight") == 0) {
+            valid = parseNumber(argc, argv, i, value, 1, 1 << 20);
+            options.inflight = static_cast<size_t>(value);
+        } else if (strcmp(argv[i], "--unix") == 0) {
+            valid = i + 1 < argc;
+            if (valid) options.unixPath = argv[++i];
+        } else if (strcmp(argv[i], "--shm") == 0) {
+            valid = i + 1 < argc;
+            if (valid) options.shmPath = argv[++i];
+        } else if (strcmp(argv[i], "--trace") == 0) {
+            valid = parseNumber(argc, argv, i, value, 0, 1 << 30);
+            options.trace = static_cast<unsigned>(value);
+        } else if (strcmp(argv[i], "--trace-file") == 0) {
+            valid = i + 1 < argc;
+            if (valid) options.tracePath = argv[++i];
+        } else if (reactorsSupported && strcmp(argv[i], "--reactors") == 0) {
+            valid = parseNumber(argc, argv, i, value, 1, 1024);
+            options.reactors = static_cast<size_t>(value);
+        } else {
+            valid = false;
+        }
+        if (!valid) {
+            std::cerr << "Usage: " << argv[0] << " [--port P] [--threads N] [--heavy N] [--queue N] [--inflight N]"
+                      << (reactorsSupported ? " [--reactors N | --io-uring]" : " [--io-uring]")
+                      << " [--unix PATH] [--shm PATH] [--trace N] [--trace-file PATH]" << std::endl;
+            return false;
+        }
+    }
+    if (options.reactors > 0 && options.ioUring) {
+        std::cerr << "--reactors and --io-uring cannot be combined" << std::endl;
+        return false;
+    }
+    std::string base = "/tmp/mst-server-" + std::to_string(options.port);
+    if (options.unixPath.empty()) options.unixPath = base + ".sock";
+    if (options.shmPath.empty()) options.shmPath = base + ".shm";
+    if (options.tracePath.empty()) options.tracePath = base + ".trace.json";
+    return true;
+}
+
+int ServerSocket::listenOn(int port, bool reusePort) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        std::cerr << "Error opening socket" << std::endl;
+        return -1;
+    }
+
+    int opt = 1;
+    if (setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) < 0 ||
+        (reusePort && setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) < 0)) {
+        std::cerr << "Error setting socket options" << std::endl;
+        close(fd);
+        return -1;
+    }
+
+    struct sockaddr_in serverAddr;
+    memset(&serverAddr, 0, sizeof(serverAddr));
+    serverAddr.sin_family = AF_INET;
+    serverAddr.sin_addr.s_addr = INADDR_ANY;
+    serverAddr.sin_port = htons(port);
+    if (bind(fd, (struct sockaddr*)&serverAddr, sizeof(serverAddr)) < 0) {
+        std::cerr << "Error on binding" << std::endl;
+        close(fd);
+        return -1;
+    }
+
+    // A burst of clients must not be refused while the accepting thread is busy; the kernel caps
+    // the backlog at net.core.somaxconn
+    if (listen(fd, backlog) < 0) {
+        std::cerr << "Error on listen" << std::endl;
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int ServerSocket::listenOnUnix(const std::string& path) {
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) {
+        std::cerr << "Socket path too long: " << path << std::endl;
+        return -1;
+    }
+    strcpy(address.sun_path, path.c_str());
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        std::cerr << "Error opening socket" << std::endl;
+        return -1;
+    }
+    unlink(path.c_str());  // Left behind by a server that did not exit cleanly
+    if (bind(fd, (struct sockaddr*)&address, sizeof(address)) < 0 || listen(fd, backlog) < 0) {
+        std::cerr << "Error on binding " << path << std::endl;
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+std::vector<int> ServerSocket::availableCpus() {
+    std::vector<int> cpus;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (CPU_ISSET(cpu, &set)) cpus.push_back(cpu);
+        }
+    }
+    if (cpus.empty()) cpus.push_back(0);
+    return cpus;
+}
+
+bool ServerSocket::pinCurrentThread(int cpu) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
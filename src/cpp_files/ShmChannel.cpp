@@ -0,0 +1,180 @@
+#include "../hpp_files/ShmChannel.hpp"
+#include <algorithm>
+#include <cstring>
+#include <ctime>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <thread>
+#include <unistd.h>
+
+static const uint32_t channelMagic = 0x4d535431;  // "MST1"
+static const size_t maxCapacity = size_t(1) << 30;
+
+// Doorbell checks before a side goes to sleep; the first half busy-polls, the second half yields.
+// On a single CPU the peer cannot run while we spin, so the side sleeps right away.
+static const int spinLimit = std::thread::hardware_concurrency() > 1 ? 2000 : 0;
+
+// The futex words live in memory shared between processes, so the non-private operations are used
+static long futex(std::atomic<uint32_t>* word, int operation, uint32_t value, const timespec* timeout) {
+    return syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), operation, value, timeout, nullptr, 0);
+}
+
+size_t ShmChannel::regionSize(size_t capacity) {
+    return sizeof(Header) + 2 * capacity;
+}
+
+ShmChannel::ShmChannel(void* region, size_t capacity, size_t size)
+    : header(static_cast<Header*>(region)), buffers(static_cast<char*>(region) + sizeof(Header)),
+      capacity(capacity), mask(static_cast<uint32_t>(capacity - 1)), size(size) {}
+
+ShmChannel* ShmChannel::create(size_t capacity, int& fd) {
+    size_t rounded = 4096;
+    while (rounded < capacity && rounded < maxCapacity) rounded <<= 1;
+
+    fd = memfd_create("mst-channel", MFD_CLOEXEC);
+    if (fd < 0) return nullptr;
+    size_t size = regionSize(rounded);
+    void* region = MAP_FAILED;
+    if (ftruncate(fd, static_cast<off_t>(size)) == 0) {
+        region = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    if (region == MAP_FAILED) {
+        ::close(fd);
+        fd = -1;
+        return nullptr;
+    }
+
+    // The new pages are zero: every position, doorbell and flag starts at 0
+    Header* shared = static_cast<Header*>(region);
+    shared->capacity = static_cast<uint32_t>(rounded);
+    shared->magic = channelMagic;
+    return new ShmChannel(region, rounded, size);
+}
+
+ShmChannel* ShmChannel::attach(int fd) {
+    struct stat info;
+    if (fstat(fd, &info) < 0 || static_cast<size_t>(info.st_size) < sizeof(Header)) return nullptr;
+    size_t size = static_cast<size_t>(info.st_size);
+    void* region = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (region == MAP_FAILED) return nullptr;
+
+    // The region comes from another process: its capacity must match the mapping before it is trusted.
+    // The client can still rewrite it later, so the checked value is copied and never read again.
+    const Header* shared = static_cast<const Header*>(region);
+    uint32_t magic = shared->magic;
+    size_t capacity = shared->capacity;
+    bool valid = magic == channelMagic && capacity >= 4096 && capacity <= maxCapacity &&
+                 (capacity & (capacity - 1)) == 0 && regionSize(capacity) == size;
+    if (!valid) {
+        munmap(region, size);
+        return nullptr;
+    }
+    return new ShmChannel(region, capacity, size);
+}
+
+void ShmChannel::detach() {
+    munmap(header, size);
+    delete this;
+}
+
+char* ShmChannel::data(Stream stream) {
+    return buffers + static_cast<size_t>(stream) * capacity;
+}
+
+size_t ShmChannel::write(Stream stream, const iovec* iov, int count) {
+    Ring& ring = header->rings[stream];
+    uint32_t tail = ring.tail.load(std::memory_order_relaxed);
+    uint32_t used = tail - ring.head.load(std::memory_order_acquire);
+    if (used > capacity) {
+        close();  // The peer corrupted the ring
+        return 0;
+    }
+
+    char* base = data(stream);
+    size_t room = capacity - used, written = 0;
+    for (int i = 0; i < count && room > 0; ++i) {
+        const char* source = static_cast<const char*>(iov[i].iov_base);
+        size_t length = std::min(iov[i].iov_len, room);
+        // Copy in up to two pieces, the second one starting over at the front of the ring
+        size_t offset = (tail + written) & mask;
+        size_t first = std::min(length, capacity - offset);
+        memcpy(base + offset, source, first);
+        memcpy(base, source + first, length - first);
+        written += length;
+        room -= length;
+    }
+    ring.tail.store(tail + static_cast<uint32_t>(written), std::memory_order_release);
+    return written;
+}
+
+size_t ShmChannel::read(Stream stream, char* buffer, size_t max) {
+    Ring& ring = header->rings[stream];
+    uint32_t head = ring.head.load(std::memory_order_relaxed);
+    uint32_t available = ring.tail.load(std::memory_order_acquire) - head;
+    if (available > capacity) {
+        close();
+        return 0;
+    }
+
+    size_t length = std::min<size_t>(available, max);
+    size_t offset = head & mask;
+    size_t first = std::min(length, capacity - offset);
+    const char* base = data(stream);
+    memcpy(buffer, base + offset, first);
+    memcpy(buffer + first, base, length - first);
+    ring.head.store(head + static_cast<uint32_t>(length), std::memory_order_release);
+    return length;
+}
+
+bool ShmChannel::readable(Stream stream) const {
+    const Ring& ring = header->rings[stream];
+    return ring.tail.load(std::memory_order_acquire) != ring.head.load(std::memory_order_relaxed);
+}
+
+bool ShmChannel::writable(Stream stream) const {
+    const Ring& ring = header->rings[stream];
+    return ring.tail.load(std::memory_order_relaxed) - ring.head.load(std::memory_order_acquire) < capacity;
+}
+
+uint32_t ShmChannel::doorbell(Side side) const {
+    return header->bells[side].rings.load(std::memory_order_seq_cst);
+}
+
+void ShmChannel::notify(Side side) {
+    Bell& bell = header->bells[side];
+    bell.rings.fetch_add(1, std::memory_order_seq_cst);
+    // A sleeper set its flag before checking the doorbell, so either it sees the new value or we see the flag
+    if (bell.sleeping.load(std::memory_order_seq_cst)) {
+        futex(&bell.rings, FUTEX_WAKE, 1, nullptr);
+    }
+}
+
+void ShmChannel::wait(Side self, uint32_t seen, int timeoutMs) {
+    Bell& bell = header->bells[self];
+    // Spin first: in a request/response exchange the peer usually answers within microseconds
+    for (int spin = 0; spin < spinLimit; ++spin) {
+        if (bell.rings.load(std::memory_order_acquire) != seen) return;
+        if (spin >= spinLimit / 2) std::this_thread::yield();
+    }
+
+    timespec timeout;
+    timeout.tv_sec = timeoutMs / 1000;
+    timeout.tv_nsec = static_cast<long>(timeoutMs % 1000) * 1000000;
+    bell.sleeping.store(1, std::memory_order_seq_cst);
+    if (bell.rings.load(std::memory_order_seq_cst) == seen) {
+        futex(&bell.rings, FUTEX_WAIT, seen, &timeout);  // Returns at once if the doorbell moved meanwhile
+    }
+    bell.sleeping.store(0, std::memory_order_relaxed);
+}
+
+void ShmChannel::close() {
+    header->isClosed.store(1, std::memory_order_release);
+    notify(CLIENT);
+    notify(SERVER);
+}
+
+bool ShmChannel::closed() const {
+    return header->isClosed.load(std::memory_order_acquire) != 0;
+}
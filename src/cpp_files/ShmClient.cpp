@@ -0,0 +1,115 @@
+#include "../hpp_files/ShmClient.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// Longest sleep before the client checks that the server process is still there
+static const int idleCheckMs = 200;
+
+ShmClient::ShmClient() : socket(-1), channel(nullptr) {}
+
+ShmClient::~ShmClient() {
+    close();
+}
+
+bool ShmClient::connect(const std::string& path, size_t capacity) {
+    close();
+    sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) return false;
+    strcpy(address.sun_path, path.c_str());
+
+    socket = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (socket < 0) return false;
+    int memfd = -1;
+    if (::connect(socket, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 ||
+        !(channel = ShmChannel::create(capacity, memfd))) {
+        close();
+        return false;
+    }
+
+    // Pass the region to the server and wait for its acknowledgement
+    char byte = 0;
+    iovec iov{&byte, 1};
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))];
+    memset(control, 0, sizeof(control));
+    msghdr message;
+    memset(&message, 0, sizeof(message));
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+    cmsghdr* header = CMSG_FIRSTHDR(&message);
+    header->cmsg_level = SOL_SOCKET;
+    header->cmsg_type = SCM_RIGHTS;
+    header->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(header), &memfd, sizeof(int));
+    bool accepted = sendmsg(socket, &message, MSG_NOSIGNAL) == 1 && read(socket, &byte, 1) == 1 && byte == '+';
+    ::close(memfd);  // The server mapped the region if it accepted it
+    if (!accepted) close();
+    return accepted;
+}
+
+bool ShmClient::send(const std::string& text) {
+    if (!channel) return false;
+    iovec iov{const_cast<char*>(text.data()), text.size()};
+    while (iov.iov_len > 0) {
+        uint32_t seen = channel->doorbell(ShmChannel::CLIENT);
+        if (channel->closed()) return false;
+        size_t written = channel->write(ShmChannel::REQUESTS, &iov, 1);
+        if (written > 0) {
+            channel->notify(ShmChannel::SERVER);
+            iov.iov_base = static_cast<char*>(iov.iov_base) + written;
+            iov.iov_len -= written;
+        } else if (!waitForServer(seen, idleCheckMs)) {
+            return false;  // The request ring stays full
+        }
+    }
+    return true;
+}
+
+size_t ShmClient::receive(char* buffer, size_t max, int timeoutMs) {
+    if (!channel) return 0;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+    while (true) {
+        uint32_t seen = channel->doorbell(ShmChannel::CLIENT);
+        size_t bytes = channel->read(ShmChannel::RESPONSES, buffer, max);
+        if (bytes > 0) {
+            channel->notify(ShmChannel::SERVER);  // The server may wait for room
+            return bytes;
+        }
+        if (channel->closed()) return 0;
+        int sleepMs = idleCheckMs;
+        if (timeoutMs >= 0) {
+            auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+            if (left.count() <= 0) return 0;
+            sleepMs = std::min<int>(sleepMs, static_cast<int>(left.count()));
+        }
+        if (!waitForServer(seen, sleepMs)) return 0;
+    }
+}
+
+bool ShmClient::waitForServer(uint32_t seen, int timeoutMs) {
+    channel->wait(ShmChannel::CLIENT, seen, timeoutMs);
+    if (channel->doorbell(ShmChannel::CLIENT) != seen) return true;
+    // Quiet for a while: a server that exited cannot close the channel, but its socket end is gone
+    pollfd peer{socket, POLLRDHUP, 0};
+    return poll(&peer, 1, 0) == 0;
+}
+
+void ShmClient::close() {
+    if (channel) {
+        channel->close();
+        channel->detach();
+        channel = nullptr;
+    }
+    if (socket >= 0) {
+        ::close(socket);
+        socket = -1;
+    }
+}
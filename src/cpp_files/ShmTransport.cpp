@@ -0,0 +1,206 @@
+#include "../hpp_files/ShmTransport.hpp"
+#include "../hpp_files/ServerSocket.hpp"
+#include <cstring>
+#include <iostream>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+// Longest sleep of a session thread before it checks whether the client process is still there
+static const int idleCheckMs = 200;
+
+// Most iovecs copied into the ring at once
+static const int maxIovecs = 64;
+
+ShmTransport::ShmTransport(ConnectionHandler& handler) : handler(handler), listenSocket(-1), stopFlag(false) {}
+
+ShmTransport::~ShmTransport() {
+    if (listenSocket < 0) return;
+    stopFlag = true;
+    shutdown(listenSocket, SHUT_RDWR);  // Wakes the acceptor
+    acceptor.join();
+    ::close(listenSocket);
+    unlink(path.c_str());
+
+    // The session threads take sessionsMutex when they end, so they are joined without it
+    std::unordered_map<int, std::unique_ptr<Session>> remaining;
+    {
+        std::lock_guard<std::mutex> lock(sessionsMutex);
+        remaining.swap(sessions);
+        for (auto& entry : remaining) {
+            Session& session = *entry.second;
+            session.closing = true;
+            if (!session.finished) session.channel->notify(ShmChannel::SERVER);
+        }
+    }
+    for (auto& entry : remaining) {
+        entry.second->thread.join();
+    }
+}
+
+bool ShmTransport::start(const std::string& socketPath) {
+    listenSocket = ServerSocket::listenOnUnix(socketPath);
+    if (listenSocket < 0) return false;
+    path = socketPath;
+    acceptor = std::thread(&ShmTransport::acceptLoop, this);
+    return true;
+}
+
+void ShmTransport::acceptLoop() {
+    while (!stopFlag) {
+        int fd = accept4(listenSocket, nullptr, nullptr, SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            return;  // The listener was shut down
+        }
+
+        // The handshake is one byte carrying the memfd of the channel; a silent client does not hold up the others
+        timeval timeout{1, 0};
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        char byte;
+        iovec iov{&byte, 1};
+        alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))];
+        msghdr message;
+        memset(&message, 0, sizeof(message));
+        message.msg_iov = &iov;
+        message.msg_iovlen = 1;
+        message.msg_control = control;
+        message.msg_controllen = sizeof(control);
+        ShmChannel* channel = nullptr;
+        if (recvmsg(fd, &message, MSG_CMSG_CLOEXEC) == 1) {
+            cmsghdr* header = CMSG_FIRSTHDR(&message);
+            if (header && header->cmsg_level == SOL_SOCKET && header->cmsg_type == SCM_RIGHTS) {
+                int memfd;
+                memcpy(&memfd, CMSG_DATA(header), sizeof(int));
+                channel = ShmChannel::attach(memfd);
+                ::close(memfd);  // The mapping keeps the region alive
+            }
+        }
+        if (!channel || ::send(fd, "+", 1, MSG_NOSIGNAL) != 1) {
+            std::cerr << "Rejected a shared memory channel" << std::endl;
+            if (channel) channel->detach();
+            ::close(fd);
+            continue;
+        }
+
+        std::lock_guard<std::mutex> lock(sessionsMutex);
+        // Join the sessions that ended; one of them may have used the same descriptor number
+        for (auto it = sessions.begin(); it != sessions.end();) {
+            if (it->second->finished || it->first == fd) {
+                it->second->thread.join();
+                it = sessions.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        Session* session = new Session(fd, channel);
+        sessions[fd].reset(session);
+        handler.accepted(fd);
+        session->thread = std::thread(&ShmTransport::serve, this, std::ref(*session));
+    }
+}
+
+void ShmTransport::serve(Session& session) {
+    ShmChannel& channel = *session.channel;
+    char buffer[16384];
+    bool blocked = false;  // Output is waiting for the client to make room in the response ring
+    bool hungUp = false;
+
+    while (true) {
+        uint32_t seen = channel.doorbell(ShmChannel::SERVER);
+        bool progress = false;
+
+        if (session.pending.exchange(false) || (blocked && channel.writable(ShmChannel::RESPONSES))) {
+            blocked = !flush(session);
+            progress = true;
+        }
+
+        // Requests are read only while all output fits into the ring, so a client that does not read
+        // its responses cannot make the server buffer without bound
+        if (!hungUp && !blocked && !session.throttled) {
+            size_t bytes = channel.read(ShmChannel::REQUESTS, buffer, sizeof(buffer));
+            if (bytes > 0) {
+                channel.notify(ShmChannel::CLIENT);  // The client may wait for room
+                handler.received(session.fd, buffer, bytes);
+                progress = true;
+            }
+        }
+
+        if (!hungUp && channel.closed() && !channel.readable(ShmChannel::REQUESTS)) {
+            hungUp = true;
+            handler.hungUp(session.fd);
+        }
+        if (session.closing && !session.pending && (!blocked || channel.closed())) break;
+        if (progress) continue;
+
+        channel.wait(ShmChannel::SERVER, seen, idleCheckMs);
+
+        // A client process that died cannot close the channel: after a quiet period, its end of the
+        // handshake socket tells
+        if (!hungUp && channel.doorbell(ShmChannel::SERVER) == seen) {
+            pollfd peer{session.fd, POLLRDHUP, 0};
+            if (poll(&peer, 1, 0) > 0) channel.close();
+        }
+    }
+
+    channel.close();
+    handler.closed(session.fd);
+    std::lock_guard<std::mutex> lock(sessionsMutex);  // No send() or close() is touching the channel
+    channel.detach();
+    ::close(session.fd);
+    session.finished = true;
+}
+
+bool ShmTransport::flush(Session& session) {
+    ShmChannel& channel = *session.channel;
+    iovec iov[maxIovecs];
+    while (!channel.closed()) {  // Output for a client that is gone is dropped with the connection
+        int count = handler.gather(session.fd, iov, maxIovecs);
+        if (count == 0) break;
+        size_t size = 0;
+        for (int i = 0; i < count; ++i) size += iov[i].iov_len;
+        size_t written = channel.write(ShmChannel::RESPONSES, iov, count);
+        if (written > 0) {
+            handler.sent(session.fd, written);
+            channel.notify(ShmChannel::CLIENT);
+        }
+        if (written < size) return false;
+    }
+    return true;
+}
+
+void ShmTransport::send(int fd) {
+    signal(fd, false);
+}
+
+void ShmTransport::close(int fd) {
+    signal(fd, true);
+}
+
+void ShmTransport::pauseReading(int fd) {
+    std::lock_guard<std::mutex> lock(sessionsMutex);
+    auto it = sessions.find(fd);
+    if (it != sessions.end()) it->second->throttled = true;  // The client waits once the request ring is full
+}
+
+void ShmTransport::resumeReading(int fd) {
+    std::lock_guard<std::mutex> lock(sessionsMutex);
+    auto it = sessions.find(fd);
+    if (it == sessions.end() || it->second->finished) return;
+    it->second->throttled = false;
+    it->second->channel->notify(ShmChannel::SERVER);
+}
+
+void ShmTransport::signal(int fd, bool closing) {
+    std::lock_guard<std::mutex> lock(sessionsMutex);
+    auto it = sessions.find(fd);
+    if (it == sessions.end() || it->second->finished) return;
+    Session& session = *it->second;
+    if (closing) {
+        session.closing = true;
+    } else {
+        session.pending = true;
+    }
+    session.channel->notify(ShmChannel::SERVER);
+}
@@ -1,10 +1,28 @@
 #include "../hpp_files/ThreadPool.hpp"
 
+// Identity of the current thread when it is a pool worker, used to find its own deque
+static thread_local ThreadPool* currentPool = nullptr;
+static thread_local size_t currentWorker = 0;
+
+// Strands each class may start per round robin round: while all classes have work, every round
+// starts 8 LIGHT, 4 NORMAL and 1 HEAVY strand, so no class starves the others
+static const size_t classWeights[] = {8, 4, 1};
+
 // Constructor
-ThreadPool::ThreadPool(size_t numThreads) : stopFlag(false) {
+ThreadPool::ThreadPool(size_t numThreads) : ThreadPool(numThreads, nullptr, nullptr) {}
+
+// Constructor with an event source for the leader
+ThreadPool::ThreadPool(size_t numThreads, EventWaiter waitEvent, EventHandler handleEvent)
+    : heavyLimit(1), runningHeavy(0), stopFlag(false), waitEvent(move(waitEvent)), handleEvent(move(handleEvent)),
+      leaderActive(false), queuedJobs(0), sleepingWorkers(0) {
+    copy(begin(classWeights), end(classWeights), credits);
+    // Every deque exists before any worker may try to steal from it
+    for (size_t i = 0; i < numThreads; ++i) {
+        deques.push_back(make_unique<WorkStealingDeque<Job*>>());
+    }
     // Create and start the worker threads
     for (size_t i = 0; i < numThreads; ++i) {
-        workers.emplace_back([this] { worker(); }); // Each thread runs the worker function
+        workers.emplace_back([this, i] { worker(i); }); // Each thread runs the worker function
     }
 }
 
@@ -13,19 +31,42 @@ ThreadPool::~ThreadPool() {
     stop(); // Ensure the thread pool is properly stopped and cleaned up
 }
 
-// Enqueue a new task with graphId to ensure leader-follower execution
-void ThreadPool::enqueue(int graphId, function<void()> task) {
+// Enqueue a new task into its strand
+void ThreadPool::enqueue(int strandId, Task task, TaskClass taskClass) {
+    QueueGauge::Clock::time_point queued = queueGauges[taskClass].enqueued(); // Read the clock outside the lock
+    {
+        unique_lock<mutex> lock(queueMutex); // Lock the strands to safely push the task
+        Strand& strand = strands[strandId];
+        strand.tasks.push({move(task), taskClass, queued});
+        if (strand.scheduled) return; // The strand is busy: the task waits in it
+        strand.scheduled = true;
+        readyStrands[taskClass].push(strandId);
+    }
+    condition.notify_one(); // Notify one worker thread that a strand is ready
+}
+
+// Put a continuation of the running task at the front of its strand
+void ThreadPool::enqueueNext(int strandId, Task task, TaskClass taskClass) {
+    QueueGauge::Clock::time_point queued = queueGauges[taskClass].enqueued();
+    lock_guard<mutex> lock(queueMutex);
+    // The strand is still scheduled: once the calling task returns, runStrand() queues it in the
+    // class of this task, so no thread is woken here
+    strands[strandId].tasks.pushFront({move(task), taskClass, queued});
+}
+
+void ThreadPool::setHeavyLimit(size_t limit) {
     {
-        unique_lock<mutex> lock(queueMutex); // Lock the queue to safely push the task
-        tasks.push({graphId, move(task)});   // Push the task with its graphId
+        lock_guard<mutex> lock(queueMutex);
+        heavyLimit = max<size_t>(limit, 1);
     }
-    condition.notify_one(); // Notify one worker thread that a new task is available
+    condition.notify_all(); // Waiting HEAVY strands may be able to start now
 }
 
 // Stop the thread pool
 void ThreadPool::stop() {
     {
         unique_lock<mutex> lock(queueMutex); // Lock the queue to update stopFlag
+        if (stopFlag) return; // Already stopped
         stopFlag = true; // Set the stop flag to true, signaling workers to stop
     }
     condition.notify_all(); // Wake up all worker threads to finish processing
@@ -35,40 +76,197 @@ void ThreadPool::stop() {
 }
 
 // Worker function following the Leader-Follower pattern
-void ThreadPool::worker() {
+void ThreadPool::worker(size_t index) {
+    currentPool = this;
+    currentWorker = index;
+
     while (true) {
-        pair<int, function<void()>> task;
+        // Fork-join jobs first: they are short and somebody is waiting for them
+        if (Job* job = findJob()) {
+            executeJob(job);
+            continue;
+        }
 
-        // Wait for a task to be available
-        {
-            unique_lock<mutex> lock(queueMutex);
-            condition.wait(lock, [this] { return stopFlag || !tasks.empty(); });
+        unique_lock<mutex> lock(queueMutex);
+        // Followers sleep until there is work or the leader role is free
+        sleepingWorkers++;
+        condition.wait(lock, [this] {
+            return stopFlag || hasRunnableStrand() || (waitEvent && !leaderActive) || queuedJobs > 0;
+        });
+        sleepingWorkers--;
 
-            if (stopFlag && tasks.empty()) return; // Exit if stopFlag is set and no tasks are left
+        if (queuedJobs > 0) continue; // Steal first, strands and events can wait a moment
 
-            task = move(tasks.front()); // Retrieve the task from the queue
-            tasks.pop(); // Remove the task from the queue
+        int strandId;
+        TaskClass taskClass;
+        if (takeReadyStrand(strandId, taskClass)) {
+            lock.unlock();
+            runStrand(strandId, taskClass);
+            continue;
         }
 
-        int graphId = task.first;
+        if (stopFlag) return; // Exit once the stop flag is set and no work is left
+
+        // Become the leader and wait for the next event
+        leaderActive = true;
+        lock.unlock();
+        int handle = waitEvent();
 
-        // Ensure only one thread processes the same graph
-        {
-            unique_lock<mutex> lock(queueMutex);
-            if (graphLocks[graphId]) {
-                tasks.push(move(task)); // Return task to the queue if graph is locked
-                continue;
-            }
-            graphLocks[graphId] = true; // Lock the graph for the current thread
+        // Promote a follower to leader before processing the event
+        lock.lock();
+        leaderActive = false;
+        lock.unlock();
+        condition.notify_one();
+
+        if (handle >= 0) handleEvent(handle);
+    }
+}
+
+bool ThreadPool::hasRunnableStrand() const {
+    return !readyStrands[LIGHT].empty() || !readyStrands[NORMAL].empty() ||
+           (!readyStrands[HEAVY].empty() && runningHeavy < heavyLimit);
+}
+
+bool ThreadPool::takeReadyStrand(int& strandId, TaskClass& taskClass) {
+    // Each class starts up to its weight in strands per round, cheapest class first. When no class
+    // with ready strands has credit left, a new round begins.
+    for (int attempt = 0; attempt < 2; ++attempt) {
+        for (int c = LIGHT; c < numClasses; ++c) {
+            if (readyStrands[c].empty() || credits[c] == 0) continue;
+            if (c == HEAVY && runningHeavy >= heavyLimit) continue; // Waits in its queue, not on a thread
+            credits[c]--;
+            strandId = readyStrands[c].front(); // The strand that waited longest in this class
+            readyStrands[c].pop();
+            taskClass = static_cast<TaskClass>(c);
+            if (taskClass == HEAVY) runningHeavy++;
+            return true;
         }
+        copy(begin(classWeights), end(classWeights), credits);
+    }
+    return false;
+}
+
+// Run one task of a strand, then hand the strand back to the pool if it has more
+void ThreadPool::runStrand(int strandId, TaskClass taskClass) {
+    Task task;
+    QueueGauge::Clock::time_point queued;
+    {
+        unique_lock<mutex> lock(queueMutex);
+        Strand& strand = strands[strandId];
+        task = move(strand.tasks.front().task);
+        queued = strand.tasks.front().queued;
+        strand.tasks.pop();
+    }
+    queueGauges[taskClass].dequeued(queued);
+
+    task(); // Execute the task, no other task of this strand runs meanwhile
 
-        // Execute the task
-        task.second();
+    {
+        unique_lock<mutex> lock(queueMutex);
+        if (taskClass == HEAVY) runningHeavy--; // This thread looks for waiting HEAVY strands next
+        Strand& strand = strands[strandId];
+        if (strand.tasks.empty()) {
+            strand.scheduled = false; // Idle strands stay in the map, so the next task reuses their queue
+            return;
+        }
+        readyStrands[strand.tasks.front().taskClass].push(strandId); // At the back, so other strands get their turn
+    }
+    condition.notify_one();
+}
+
+void ThreadPool::parallelFor(size_t begin, size_t end, size_t grain, const function<void(size_t, size_t)>& body) {
+    if (grain == 0) grain = 1;
+    if (end <= begin) return;
+    if (end - begin <= grain || workers.empty()) {
+        body(begin, end); // Too small to be worth forking
+        return;
+    }
+
+    TaskGroup group(*this);
+    // Split the range in halves: the upper half is forked, the lower half is processed here
+    function<void(size_t, size_t)> split = [&](size_t b, size_t e) {
+        while (e - b > grain) {
+            size_t mid = b + (e - b) / 2;
+            group.run([&split, mid, e] { split(mid, e); });
+            e = mid;
+        }
+        body(b, e);
+    };
+    split(begin, end);
+    group.wait();
+}
+
+void ThreadPool::submitJob(Job* job) {
+    queuedJobs++; // Counted before it becomes visible, so a thief never decrements below zero
+    if (currentPool == this) {
+        deques[currentWorker]->push(job); // Lock-free: only this thread pushes to its deque
+    } else {
+        lock_guard<mutex> lock(injectMutex);
+        injectedJobs.push(job);
+    }
+
+    // Wake a sleeper; taking queueMutex orders this with a worker that is about to sleep
+    if (sleepingWorkers > 0) {
+        lock_guard<mutex> lock(queueMutex);
+        condition.notify_one();
+    }
+}
+
+ThreadPool::Job* ThreadPool::findJob() {
+    if (queuedJobs == 0) return nullptr; // Nothing anywhere, skip the scan
+    Job* job = nullptr;
+    size_t numDeques = deques.size();
+    size_t self = currentPool == this ? currentWorker : 0;
+
+    // Own deque first (LIFO keeps the working set hot), then steal the oldest jobs of the others
+    if (currentPool == this && deques[self]->pop(job)) {
+        queuedJobs--;
+        return job;
+    }
+    for (size_t i = 1; i <= numDeques; ++i) {
+        size_t victim = (self + i) % numDeques;
+        if (currentPool == this && victim == self) continue;
+        if (deques[victim]->steal(job)) {
+            queuedJobs--;
+            return job;
+        }
+    }
+
+    lock_guard<mutex> lock(injectMutex);
+    if (injectedJobs.empty()) return nullptr;
+    job = injectedJobs.front();
+    injectedJobs.pop();
+    queuedJobs--;
+    return job;
+}
+
+void ThreadPool::executeJob(Job* job) {
+    job->fn();
+    TaskGroup* group = job->group;
+    delete job;
+    group->finishJob(); // Last access to the group: the waiter may return right after this
+}
+
+void TaskGroup::run(Task fn) {
+    pending++;
+    pool.submitJob(new ThreadPool::Job{move(fn), this});
+}
+
+void TaskGroup::finishJob() {
+    // Decremented under the lock, so wait() cannot return and destroy the group while we notify
+    lock_guard<mutex> lock(doneMutex);
+    if (--pending == 0) done.notify_all();
+}
 
-        // Release the lock on the graph
-        {
-            unique_lock<mutex> lock(queueMutex);
-            graphLocks[graphId] = false; // Unlock the graph for other threads
+void TaskGroup::wait() {
+    while (pending > 0) {
+        if (ThreadPool::Job* job = pool.findJob()) {
+            pool.executeJob(job); // Help instead of sleeping
+        } else {
+            // Nothing queued: the rest of our jobs run on other threads, sleep until the last one ends
+            unique_lock<mutex> lock(doneMutex);
+            done.wait(lock, [this] { return pending == 0; });
         }
     }
+    lock_guard<mutex> lock(doneMutex); // The job that finished last has released the lock
 }
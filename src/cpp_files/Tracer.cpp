@@ -0,0 +1,160 @@
+#include "../hpp_files/Tracer.hpp"
+#include <algorithm>
+
+// Names of the stages, in the order of the enum
+static const char* const stageNames[] = {
+    "request", "parse.queue", "parse", "strand.queue", "execute", "respond.queue", "reorder", "send"};
+
+static_assert(sizeof(stageNames) / sizeof(stageNames[0]) == Tracer::numStages, "every stage needs a name");
+
+/**
+ * Ring buffer of the spans of one thread. Only the owning thread writes; a dump reads concurrently,
+ * so each slot is a seqlock: its sequence number is odd while the slot is written, and even and
+ * tied to the position of the span once it is complete. Every field is a relaxed atomic, so a read
+ * that races with a write is torn but not undefined, and the sequence check throws it away.
+ */
+struct Tracer::Buffer {
+    struct Slot {
+        std::atomic<uint64_t> sequence{0};  // 2 * position + 1 while written, 2 * position + 2 after
+        std::atomic<uint64_t> id{0};
+        std::atomic<int64_t> start{0}, end{0};  // Nanoseconds since the tracer's origin
+        std::atomic<const char*> label{nullptr};
+        std::atomic<int> stage{0};
+    };
+
+    unsigned index;  // Position in Tracer::buffers, written to the trace as the thread id
+    size_t mask;
+    std::unique_ptr<Slot[]> slots;
+    std::atomic<uint64_t> head{0};  // Spans ever written; the next one goes to slots[head & mask]
+
+    Buffer(unsigned index, size_t capacity) : index(index), mask(capacity - 1), slots(new Slot[capacity]) {}
+};
+
+// Lends a buffer to a thread for its lifetime, and hands it back for reuse when the thread exits
+struct Tracer::BufferLease {
+    Tracer* owner = nullptr;
+    Buffer* buffer = nullptr;
+
+    ~BufferLease() {
+        if (!owner) return;
+        std::lock_guard<std::mutex> lock(owner->buffersMutex);
+        owner->freeBuffers.push_back(buffer);  // Its spans stay in the dumps until overwritten
+    }
+};
+
+thread_local Tracer::BufferLease Tracer::lease;
+
+// A span copied out of a buffer for a dump
+struct SpanCopy {
+    uint64_t id;
+    int64_t start, end;
+    const char* label;
+    int stage;
+    unsigned thread;
+};
+
+// Writes a time in nanoseconds as microseconds with three decimals, the unit of trace-event timestamps
+static void writeMicros(std::ostream& out, int64_t nanos) {
+    if (nanos < 0) nanos = 0;  // Requests read just before the tracer was created
+    int64_t fraction = nanos % 1000;
+    out << nanos / 1000 << '.' << static_cast<char>('0' + fraction / 100) << static_cast<char>('0' + fraction / 10 % 10)
+        << static_cast<char>('0' + fraction % 10);
+}
+
+// Writes the begin or end event of a span
+static void writeEvent(std::ostream& out, const SpanCopy& span, bool begin) {
+    const char* name = span.stage == Tracer::REQUEST && span.label ? span.label : stageNames[span.stage];
+    out << "{\"name\":\"" << name << "\",\"cat\":\"request\",\"ph\":\"" << (begin ? 'b' : 'e') << "\",\"id\":" << span.id
+        << ",\"pid\":1,\"tid\":" << span.thread << ",\"ts\":";
+    writeMicros(out, begin ? span.start : span.end);
+    if (begin && span.stage == Tracer::REQUEST) out << ",\"args\":{\"request\":" << span.id << "}";
+    out << "}";
+}
+
+Tracer::Tracer(size_t spansPerThread) : capacity(1), origin(Clock::now()), sampleEvery(0), requests(0) {
+    while (capacity < spansPerThread) capacity <<= 1;
+}
+
+Tracer::~Tracer() {
+    if (lease.owner == this) lease.owner = nullptr;  // The buffer goes with this object
+}
+
+const char* Tracer::stageName(Stage stage) {
+    return stageNames[stage];
+}
+
+Tracer::Buffer& Tracer::localBuffer() {
+    if (lease.owner == this) return *lease.buffer;
+    std::lock_guard<std::mutex> lock(buffersMutex);
+    if (!freeBuffers.empty()) {
+        lease.buffer = freeBuffers.back();
+        freeBuffers.pop_back();
+    } else {
+        buffers.push_back(std::make_unique<Buffer>(static_cast<unsigned>(buffers.size()), capacity));
+        lease.buffer = buffers.back().get();
+    }
+    lease.owner = this;
+    return *lease.buffer;
+}
+
+void Tracer::record(uint64_t id, Stage stage, Clock::time_point start, Clock::time_point end, const char* label) {
+    Buffer& buffer = localBuffer();
+    uint64_t position = buffer.head.load(std::memory_order_relaxed);
+    Buffer::Slot& slot = buffer.slots[position & buffer.mask];
+    slot.sequence.store(2 * position + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);  // A reader that sees the fields sees the odd sequence
+    slot.id.store(id, std::memory_order_relaxed);
+    slot.start.store(std::chrono::duration_cast<std::chrono::nanoseconds>(start - origin).count(), std::memory_order_relaxed);
+    slot.end.store(std::chrono::duration_cast<std::chrono::nanoseconds>(end - origin).count(), std::memory_order_relaxed);
+    slot.label.store(label, std::memory_order_relaxed);
+    slot.stage.store(stage, std::memory_order_relaxed);
+    slot.sequence.store(2 * position + 2, std::memory_order_release);
+    buffer.head.store(position + 1, std::memory_order_release);
+}
+
+size_t Tracer::writeChromeTrace(std::ostream& out) const {
+    std::vector<SpanCopy> spans;
+    unsigned threads;
+    {
+        std::lock_guard<std::mutex> lock(buffersMutex);  // Keeps new threads from growing the list meanwhile
+        threads = static_cast<unsigned>(buffers.size());
+        for (const auto& buffer : buffers) {
+            uint64_t head = buffer->head.load(std::memory_order_acquire);
+            uint64_t first = head > buffer->mask + 1 ? head - (buffer->mask + 1) : 0;
+            for (uint64_t position = first; position < head; ++position) {
+                const Buffer::Slot& slot = buffer->slots[position & buffer->mask];
+                uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+                if (sequence != 2 * position + 2) continue;  // Being overwritten by a newer span
+                SpanCopy span{slot.id.load(std::memory_order_relaxed), slot.start.load(std::memory_order_relaxed),
+                              slot.end.load(std::memory_order_relaxed), slot.label.load(std::memory_order_relaxed),
+                              slot.stage.load(std::memory_order_relaxed), buffer->index};
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (slot.sequence.load(std::memory_order_relaxed) != sequence) continue;  // Torn by a writer
+                spans.push_back(span);
+            }
+        }
+    }
+
+    // By start time, and a request before the stages it contains, so every track reads in order
+    std::sort(spans.begin(), spans.end(), [](const SpanCopy& a, const SpanCopy& b) {
+        if (a.start != b.start) return a.start < b.start;
+        return a.end > b.end;
+    });
+
+    out << "{\"traceEvents\":[";
+    bool first = true;
+    for (unsigned thread = 0; thread < threads; ++thread) {
+        out << (first ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << thread
+            << ",\"args\":{\"name\":\"thread " << thread << "\"}}";
+        first = false;
+    }
+    for (const SpanCopy& span : spans) {
+        out << (first ? "" : ",") << "\n";
+        writeEvent(out, span, true);
+        out << ",\n";
+        writeEvent(out, span, false);
+        first = false;
+    }
+    out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+    return spans.size();
+}
@@ -1,31 +1,32 @@
 #include "../hpp_files/Tree.hpp"
+#include "../hpp_files/Profiler.hpp"
 #include <vector>
 #include <algorithm>
 #include <limits>
 #include <iostream>
 
-Tree::Tree(int n, const std::vector<std::pair<std::pair<int, int>, double>>& edges)
-    : Graph(n, edges) {
-    // Add edges to the tree, for undirected graph, add both directions
-    for (const auto& edge : edges) {
-        addEdge(edge.first.first, edge.first.second, edge.second);
-        addEdge(edge.first.second, edge.first.first, edge.second); // Undirected graph
-    }
+Tree::Tree(int n, const std::vector<std::pair<std::pair<int, int>, double>>& edges, ThreadPool* pool)
+    : Graph(n, edges), pool(pool), cachedWeight(0), weightVersion(0), pairsVersion(0) {
+    // The Graph constructor already stores every edge in both directions
+    getMSTWeight(); // Sum the weights now, so weight queries never scan the edges
 }
 
 double Tree::getMSTWeight() const {
-    double totalWeight = 0;
-    // Sum up the weight of all edges
-    for (const auto& edge : getEdges()) {
-        totalWeight += edge.second;
+    if (weightVersion != getVersion()) {
+        double totalWeight = 0;
+        // Sum up the weight of all edges
+        for (const auto& edge : getEdges()) {
+            totalWeight += edge.second;
+        }
+        cachedWeight = totalWeight;
+        weightVersion = getVersion();
     }
-    return totalWeight; // Return the total weight of the MST
+    return cachedWeight; // Return the total weight of the MST
 }
 
 double Tree::shortestDistance(int u, int v) {
     // Calculate all-pairs shortest distances using Floyd-Warshall
-    auto [dist, next] = floydWarshall();
-    return dist[u][v]; // Return the shortest distance between u and v
+    return allPairs().first[u][v]; // Return the shortest distance between u and v
 }
 
 void Tree::dfs(int current, int parent, double currentWeight, int target, double &maxWeight, bool &found, std::vector<int>& currentPath, std::vector<int>& bestPath) {
@@ -52,11 +53,11 @@ void Tree::dfs(int current, int parent, double currentWeight, int target, double
 double Tree::longestDistance(int u, int v) {
     double maxWeight = 0;
     bool found = false;
-    std::vector<int> currentPath, bestPath;
-    // Use DFS to find the longest path between u and v
-    dfs(u, -1, 0, v, maxWeight, found, currentPath, bestPath);
+    searchPath.clear();
+    longestPath.clear();
+    // Use DFS to find the longest path between u and v, storing it in longestPath
+    dfs(u, -1, 0, v, maxWeight, found, searchPath, longestPath);
 
-    longestPath = bestPath; // Store the longest path found
     return found ? maxWeight : -1; // Return the maximum weight or -1 if not found
 }
 
@@ -65,13 +66,23 @@ std::vector<int> Tree::getLongestPath(int u, int v) {
     return longestPath; // Return the longest path
 }
 
-std::pair<std::vector<std::vector<double>>, std::vector<std::vector<int>>> Tree::floydWarshall() {
+void Tree::getLongestPath(int u, int v, std::vector<int>& path) {
+    longestDistance(u, v); // Compute the longest path
+    path.assign(longestPath.begin(), longestPath.end()); // Copy into the caller's buffer
+}
+
+std::pair<std::vector<std::vector<double>>, std::vector<std::vector<int>>> Tree::floydWarshall(JobControl* control) {
     int n = getNumNodes(); // Get the number of nodes
-    std::vector<std::vector<double>> dist(n + 1, std::vector<double>(n + 1, std::numeric_limits<double>::infinity()));
-    std::vector<std::vector<int>> next(n + 1, std::vector<int>(n + 1, -1));
+    std::vector<std::vector<double>> dist(n + 1);
+    std::vector<std::vector<int>> next(n + 1);
 
     // Initialize distances and paths for direct neighbors
-    for (int i = 1; i <= n; ++i) {
+    for (int i = 0; i <= n; ++i) {
+        // Allocating the matrices is O(n^2) too, so cancellation is checked row by row
+        if (control && control->cancelled()) return {};
+        dist[i].assign(n + 1, std::numeric_limits<double>::infinity());
+        next[i].assign(n + 1, -1);
+        if (i == 0) continue; // Vertices are numbered from 1
         dist[i][i] = 0; // Distance to itself is 0
         for (const auto& neighbor : getAdjacencyList()[i]) {
             dist[i][neighbor.first] = neighbor.second; // Set the edge weight
@@ -81,19 +92,38 @@ std::pair<std::vector<std::vector<double>>, std::vector<std::vector<int>>> Tree:
 
     // Floyd-Warshall algorithm to find all pairs shortest paths
     for (int k = 1; k <= n; ++k) {
-        for (int i = 1; i <= n; ++i) {
-            for (int j = 1; j <= n; ++j) {
-                if (dist[i][j] > dist[i][k] + dist[k][j]) {
-                    dist[i][j] = dist[i][k] + dist[k][j]; // Update the shortest distance
-                    next[i][j] = next[i][k]; // Update the next node in the path
+        if (control && control->cancelled()) return {};  // Frees the matrices
+        // Row k and column k do not change during round k, so the rows can be relaxed in parallel
+        auto relaxRows = [&dist, &next, k, n, control](size_t first, size_t last) {
+            if (control && control->cancelled()) return;  // Skips the rest of the round, O(n) per row
+            for (size_t i = first; i < last; ++i) {
+                for (int j = 1; j <= n; ++j) {
+                    if (dist[i][j] > dist[i][k] + dist[k][j]) {
+                        dist[i][j] = dist[i][k] + dist[k][j]; // Update the shortest distance
+                        next[i][j] = next[i][k]; // Update the next node in the path
+                    }
                 }
             }
+        };
+        if (pool) {
+            pool->parallelFor(1, n + 1, max<size_t>(1, 4096 / (n + 1)), relaxRows);
+        } else {
+            relaxRows(1, n + 1);
         }
     }
 
     return {dist, next}; // Return the distance matrix and the path matrix
 }
 
+const std::pair<std::vector<std::vector<double>>, std::vector<std::vector<int>>>& Tree::allPairs(JobControl* control) {
+    if (pairsVersion != getVersion()) {
+        PROFILE_PHASE(ALL_PAIRS);
+        pairsCache = floydWarshall(control); // The tree changed since the last query, rebuild the index
+        if (!pairsCache.first.empty()) pairsVersion = getVersion(); // Not cancelled
+    }
+    return pairsCache;
+}
+
 void Tree::reconstructPath(int u, int v, const std::vector<std::vector<int>>& next, std::vector<int>& path) {
     if (next[u][v] == -1) return; // If there is no path between u and v, return
 
@@ -103,3 +133,11 @@ void Tree::reconstructPath(int u, int v, const std::vector<std::vector<int>>& ne
         path.push_back(u); // Add the node to the path
     }
 }
+
+size_t Tree::memoryUsage() const {
+    size_t bytes = Graph::memoryUsage() + sizeof(*this) - sizeof(Graph) +
+                   (longestPath.capacity() + searchPath.capacity()) * sizeof(int);
+    for (const auto& row : pairsCache.first) bytes += sizeof(row) + row.capacity() * sizeof(double);
+    for (const auto& row : pairsCache.second) bytes += sizeof(row) + row.capacity() * sizeof(int);
+    return bytes;
+}
@@ -0,0 +1,59 @@
+#include "../hpp_files/VertexIds.hpp"
+#include "../hpp_files/LinearProbing.hpp"
+#include <cerrno>
+#include <cstdlib>
+
+VertexIds::VertexIds() : table(16, Entry{0, 0}), ids(1, 0) {}
+
+std::shared_ptr<const VertexIds> VertexIds::build(int n, const std::vector<std::pair<std::pair<uint64_t, uint64_t>, double>>& edges,
+                                                  std::vector<std::pair<std::pair<int, int>, double>>& dense) {
+    dense.clear();
+    dense.reserve(edges.size());
+    auto inRange = [n](uint64_t id) { return id >= 1 && n > 0 && id <= static_cast<uint64_t>(n); };
+    bool identity = true;
+    for (const auto& edge : edges) {
+        identity = identity && inRange(edge.first.first) && inRange(edge.first.second);
+    }
+    if (identity) {
+        for (const auto& edge : edges) {
+            dense.push_back({{static_cast<int>(edge.first.first), static_cast<int>(edge.first.second)}, edge.second});
+        }
+        return nullptr;
+    }
+
+    std::shared_ptr<VertexIds> vertexIds(new VertexIds());
+    for (const auto& edge : edges) {
+        int u = vertexIds->insert(edge.first.first);
+        int v = vertexIds->insert(edge.first.second);
+        dense.push_back({{u, v}, edge.second});
+    }
+    vertexIds->ids.shrink_to_fit();
+    return vertexIds;
+}
+
+bool VertexIds::parse(const char*& text, uint64_t& id) {
+    while (*text == ' ' || *text == '\t') ++text;
+    if (*text < '0' || *text > '9') return false;
+    errno = 0;
+    char* end;
+    unsigned long long value = strtoull(text, &end, 10);
+    if (errno == ERANGE) return false;  // More than 64 bits
+    id = value;
+    text = end;
+    return true;
+}
+
+int VertexIds::find(uint64_t id) const {
+    return table[LinearProbing::probe(table, id, isEmpty)].vertex; // 0 at an empty entry
+}
+
+int VertexIds::insert(uint64_t id) {
+    Entry& entry = table[LinearProbing::probe(table, id, isEmpty)];
+    if (!isEmpty(entry)) return entry.vertex;
+    int vertex = static_cast<int>(ids.size());
+    entry = {id, vertex};
+    ids.push_back(id);
+    // Keep the load factor below 1/2 so probe sequences stay short
+    if (ids.size() * 2 > table.size()) LinearProbing::rehash(table, table.size() * 2, Entry{0, 0}, isEmpty);
+    return vertex;
+}
@@ -0,0 +1,61 @@
+#ifndef ADMISSION_CONTROL_H
+#define ADMISSION_CONTROL_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Bounds the work a server accepts, so overload is answered by rejecting commands quickly instead of
+ * queueing them until every client's latency explodes.
+ * At most `capacity` commands are admitted (queued or running) across the server; further commands
+ * are shed and answered with busyResponse, in order, without being executed. A connection with
+ * `perConnection` commands in flight is not read until some of them are answered.
+ * Thread-safe and lock-free.
+ */
+class AdmissionControl {
+public:
+    // Reply to a command that was shed
+    static constexpr const char* busyResponse = "BUSY: server overloaded, command not executed. Retry later.\n";
+
+    AdmissionControl(size_t capacity = 512, size_t perConnection = 32)
+        : capacity(capacity), perConnection(perConnection), admitted(0), shed(0) {}
+
+    /**
+     * Sets the limits; 0 keeps the current value. Called before the server accepts connections.
+     */
+    void configure(size_t capacity, size_t perConnection) {
+        if (capacity) this->capacity = capacity;
+        if (perConnection) this->perConnection = perConnection;
+    }
+
+    /**
+     * Admits a command if there is room; every admitted command must be released once it was answered.
+     * @return false if the command is shed.
+     */
+    bool admit() {
+        if (admitted.fetch_add(1, std::memory_order_relaxed) < capacity) return true;
+        admitted.fetch_sub(1, std::memory_order_relaxed);
+        shed.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    void release() { admitted.fetch_sub(1, std::memory_order_relaxed); }
+
+    /**
+     * Returns true if a connection with this many commands in flight must not be read for now.
+     */
+    bool saturated(size_t inFlight) const { return inFlight >= perConnection; }
+
+    size_t inUse() const { return admitted.load(std::memory_order_relaxed); }
+
+    uint64_t shedCount() const { return shed.load(std::memory_order_relaxed); }
+
+private:
+    size_t capacity;       // Most commands admitted at once
+    size_t perConnection;  // Most commands in flight per connection before its reads stop
+    std::atomic<size_t> admitted;
+    std::atomic<uint64_t> shed;
+};
+
+#endif // ADMISSION_CONTROL_H
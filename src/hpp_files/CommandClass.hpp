@@ -0,0 +1,64 @@
+#ifndef COMMAND_CLASS_H
+#define COMMAND_CLASS_H
+
+#include <cstdlib>
+#include <string>
+#include "Graph.hpp"
+#include "MSTCache.hpp"
+#include "ThreadPool.hpp"
+
+// Most vertices and edges of a graph built by GenerateGraph or announced by NewGraph, about 2 GB of memory
+constexpr unsigned long long maxGeneratedEdges = 20000000;
+
+// Reply to a command whose deadline passed, or whose client left, before its result was computed
+constexpr const char* deadlineResponse = "Deadline exceeded: command aborted.\n";
+
+/**
+ * Removes the optional "Deadline ms " prefix from a command line, e.g. "Deadline 500 Kruskal".
+ * @return The deadline in milliseconds after the command was read, or 0 if the line has no valid prefix
+ *         and was left as it is.
+ */
+inline long stripDeadline(std::string& command) {
+    static const char prefix[] = "Deadline ";
+    if (command.rfind(prefix, 0) != 0) return 0;
+    const char* start = command.c_str() + sizeof(prefix) - 1;
+    char* end;
+    long millis = std::strtol(start, &end, 10);
+    if (end == start || millis <= 0 || *end != ' ') return 0;  // Answered as an invalid command
+    while (*end == ' ') ++end;
+    command.erase(0, end - command.c_str());
+    return millis;
+}
+
+/**
+ * Returns the scheduling class of a command line by its expected cost. Lookups in the job table or
+ * the metrics, tracing settings and MSTWeight are LIGHT; commands that may rebuild the MST or its
+ * all-pairs index, or generate a whole graph, are HEAVY; mutations, listings and the rest are NORMAL.
+ * MSTWeight is O(1) on a cached MST but has to rebuild it after a mutation, which the class cannot
+ * tell in advance: the handler checks with mustRunHeavy() and moves a rebuild to the HEAVY class.
+ */
+inline ThreadPool::TaskClass classifyCommand(const std::string& command) {
+    static const char* const light[] = {"MSTWeight", "JobStatus", "JobResult", "CancelJob", "Stats", "Trace ", "exit"};
+    static const char* const heavy[] = {"Kruskal", "Prim", "LongestDistance", "AverageDistance", "ShortestPath",
+                                        "GenerateGraph"};
+    for (const char* prefix : light) {
+        if (command.rfind(prefix, 0) == 0) return ThreadPool::LIGHT;
+    }
+    for (const char* prefix : heavy) {
+        if (command.rfind(prefix, 0) == 0) return ThreadPool::HEAVY;
+    }
+    return ThreadPool::NORMAL;
+}
+
+/**
+ * Returns true if a command running as LIGHT would rebuild the MST because the cache is stale.
+ * The command must then not compute in its LIGHT slot, which is outside the cap on HEAVY tasks, and
+ * continues as a HEAVY task in front of its strand (ThreadPool::enqueueNext). Called with the graph
+ * mutex held, so the answer holds until it is released.
+ * @param taskClass - class the command is running in; commands run outside the pool never move
+ */
+inline bool mustRunHeavy(ThreadPool::TaskClass taskClass, const MSTCache& cache, const Graph& graph) {
+    return taskClass == ThreadPool::LIGHT && !cache.isFresh(graph);
+}
+
+#endif // COMMAND_CLASS_H
@@ -0,0 +1,36 @@
+#ifndef CONNECTION_HANDLER_H
+#define CONNECTION_HANDLER_H
+
+#include <cstddef>
+#include <sys/uio.h>
+
+/**
+ * Callbacks through which a transport that owns the I/O of its connections (io_uring, shared memory)
+ * drives the connection objects of a server. A connection is identified by a descriptor that stays
+ * open, and unique among the server's sockets, until closed() was called.
+ */
+class ConnectionHandler {
+public:
+    virtual ~ConnectionHandler() = default;
+
+    /// A client connected; its first receive is armed when this returns.
+    virtual void accepted(int fd) = 0;
+
+    /// Bytes arrived from a client; the next receive is armed when this returns.
+    virtual void received(int fd, const char* data, size_t size) = 0;
+
+    /// The client closed its end or the connection failed. The connection stays open until the transport's close(fd).
+    virtual void hungUp(int fd) = 0;
+
+    /// Describes the unsent output of a connection as iovecs, which must stay valid until sent().
+    /// @return the number of iovecs filled, 0 when there is nothing to send.
+    virtual int gather(int fd, iovec* iov, int max) = 0;
+
+    /// The first bytes of the gathered output were sent.
+    virtual void sent(int fd, size_t bytes) = 0;
+
+    /// The connection was closed; no buffer of it is referenced by the transport any more.
+    virtual void closed(int fd) = 0;
+};
+
+#endif // CONNECTION_HANDLER_H
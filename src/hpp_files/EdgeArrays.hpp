@@ -0,0 +1,86 @@
+#ifndef EDGE_ARRAYS_H
+#define EDGE_ARRAYS_H
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/**
+ * Edge list stored as a structure of arrays, the endpoints and the weights in separate vectors of
+ * the narrowest types that hold them, so the MST kernels scan only the fields they need. It is a
+ * working copy made by KruskalMST and PrimMST for one run: Graph keeps its edge records, which the
+ * rest of the server works with, so the arrays speed up the kernels but do not shrink a graph.
+ */
+template <typename Index, typename Weight>
+struct EdgeArrays {
+    static_assert(std::is_unsigned<Index>::value, "vertices are unsigned indexes");
+    static_assert(std::is_arithmetic<Weight>::value, "weights are numbers");
+
+    // Bytes an edge takes in the arrays
+    static constexpr size_t bytesPerEdge = 2 * sizeof(Index) + sizeof(Weight);
+
+    std::vector<Index> from, to;
+    std::vector<Weight> weight;
+
+    EdgeArrays() = default;
+
+    /**
+     * Converts edge records. Vertices must be positive and the weights must fit the Weight type,
+     * see fitsUnsigned32().
+     */
+    explicit EdgeArrays(const std::vector<std::pair<std::pair<int, int>, double>>& edges) {
+        reserve(edges.size());
+        for (const auto& edge : edges) push(edge.first.first, edge.first.second, static_cast<Weight>(edge.second));
+    }
+
+    size_t size() const { return weight.size(); }
+
+    void reserve(size_t edges) {
+        from.reserve(edges);
+        to.reserve(edges);
+        weight.reserve(edges);
+    }
+
+    void push(Index u, Index v, Weight w) {
+        from.push_back(u);
+        to.push_back(v);
+        weight.push_back(w);
+    }
+
+    void clear() {
+        from.clear();
+        to.clear();
+        weight.clear();
+    }
+
+    /**
+     * Returns the edges as records, in their order in the arrays.
+     */
+    std::vector<std::pair<std::pair<int, int>, double>> records() const {
+        std::vector<std::pair<std::pair<int, int>, double>> out;
+        out.reserve(size());
+        for (size_t i = 0; i < size(); ++i) {
+            out.push_back({{static_cast<int>(from[i]), static_cast<int>(to[i])}, static_cast<double>(weight[i])});
+        }
+        return out;
+    }
+};
+
+/**
+ * Returns true if every weight is a whole number below 2^32 - 1, so the edges fit
+ * EdgeArrays<uint32_t, uint32_t> and the kernels can sort by integer keys. The largest value is
+ * left out because the kernels use it as "no edge yet".
+ */
+inline bool fitsUnsigned32(const std::vector<std::pair<std::pair<int, int>, double>>& edges) {
+    if (edges.size() > UINT32_MAX) return false;  // Kernels number the edges with 32 bits
+    for (const auto& edge : edges) {
+        double weight = edge.second;
+        if (!(weight >= 0 && weight < double(UINT32_MAX)) || std::floor(weight) != weight) return false;
+    }
+    return true;
+}
+
+#endif // EDGE_ARRAYS_H
@@ -0,0 +1,78 @@
+#ifndef EDGE_INDEX_H
+#define EDGE_INDEX_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Open-addressing hash table that maps an undirected edge (u, v) to a slot number.
+ * The key is normalized to (min(u, v), max(u, v)), so (u, v) and (v, u) share one entry.
+ * Uses linear probing (see LinearProbing) with backward-shift deletion, so there are no tombstones
+ * and lookups stay O(1) on average no matter how many edges were removed before.
+ */
+class EdgeIndex {
+public:
+    static constexpr size_t npos = static_cast<size_t>(-1);  // Returned by find() for a missing edge
+
+    EdgeIndex();
+
+    /**
+     * Looks up the slot stored for the edge (u, v).
+     * @param u - first endpoint
+     * @param v - second endpoint
+     * @return The slot of the edge, or npos if the edge is not indexed.
+     */
+    size_t find(int u, int v) const;
+
+    /**
+     * Inserts the edge (u, v) or overwrites the slot of an existing entry.
+     * @param u - first endpoint
+     * @param v - second endpoint
+     * @param slot - the value to associate with the edge
+     */
+    void assign(int u, int v, size_t slot);
+
+    /**
+     * Removes the edge (u, v) from the index.
+     * @return true if the edge was present.
+     */
+    bool erase(int u, int v);
+
+    /**
+     * Pre-sizes the table so that `count` edges fit without rehashing.
+     */
+    void reserve(size_t count);
+
+    /// @brief Returns the number of indexed edges.
+    size_t size() const { return count; }
+
+    /// @brief Returns the bytes of the probe table.
+    size_t memoryUsage() const { return table.capacity() * sizeof(Entry); }
+
+private:
+    struct Entry {
+        uint64_t key;  // Packed (min, max) endpoints, emptyKey when unused
+        size_t slot;   // Slot associated with the edge
+    };
+
+    static constexpr uint64_t emptyKey = ~static_cast<uint64_t>(0);
+
+    std::vector<Entry> table;  // Power-of-two sized probe table
+    size_t count;              // Number of occupied entries
+
+    static uint64_t makeKey(int u, int v);
+    static bool isEmpty(const Entry& entry) { return entry.key == emptyKey; }
+
+    /**
+     * Returns the position of `key` in the table, or the empty position where it would go.
+     */
+    size_t probe(uint64_t key) const;
+
+    /**
+     * Resizes the table to `newCapacity` entries (a power of two) and reinserts all entries.
+     */
+    void rehash(size_t newCapacity);
+};
+
+#endif // EDGE_INDEX_H
@@ -7,38 +7,122 @@
 #include <utility> // For std::pair
 #include <queue>
 #include <algorithm>
+#include <cstdint>
+#include <memory>
+#include "EdgeIndex.hpp"
+#include "ResponseBuilder.hpp"
+#include "VertexIds.hpp"
 
 using namespace std;
 
+/// @brief A single edge mutation, applied in groups by Graph::applyBatch().
+struct EdgeOp {
+    enum Type { ADD, REMOVE, UPDATE };
+    Type type;      ///< Kind of mutation.
+    int u;          ///< First endpoint.
+    int v;          ///< Second endpoint.
+    double weight;  ///< New weight for ADD and UPDATE, ignored for REMOVE.
+};
+
 class Graph {
 public:
     /// @brief Constructor to initialize the graph with n nodes and edges.
     /// @param n The number of nodes in the graph.
     /// @param edges The edges of the graph (pair of nodes with weights).
+    /// Repeated (u, v) pairs are merged into a single edge keeping the smallest weight.
     Graph(int n, const vector<pair<pair<int, int>, double>>& edges);
 
+    // The edge index stores iterators into this graph's adjacency lists, so a copy would dangle.
+    Graph(const Graph&) = delete;
+    Graph& operator=(const Graph&) = delete;
+
     /// @brief Adds an edge with weight to the graph.
-    void addEdge(int u, int v, double weight);
+    /// @return false if the edge already exists or a vertex is out of range.
+    bool addEdge(int u, int v, double weight);
+
+    /// @brief Removes an edge from the graph in O(1).
+    /// @return false if the edge does not exist.
+    bool removeEdge(int u, int v);
+
+    /// @brief Changes the weight of an existing edge in place.
+    /// @return false if the edge does not exist.
+    bool updateWeight(int u, int v, double weight);
+
+    /// @brief Applies a batch of edge mutations as one transaction.
+    /// The batch is validated first: if any operation cannot be applied (adding an existing edge,
+    /// removing or updating a missing one, vertex out of range), nothing is changed.
+    /// @param failedOp Set to the index of the first invalid operation on failure.
+    /// @return true if every operation was applied.
+    bool applyBatch(const vector<EdgeOp>& ops, size_t& failedOp);
+
+    /// @brief Returns true if the edge (u, v) exists.
+    bool hasEdge(int u, int v) const { return edgeIndex.find(u, v) != EdgeIndex::npos; }
+
+    /// @brief Looks up the weight of the edge (u, v).
+    /// @return false if the edge does not exist.
+    bool getEdgeWeight(int u, int v, double& weight) const;
+
+    /// @brief Returns true if u is a vertex of the graph (1-based).
+    bool isValidVertex(int u) const { return u >= 1 && u <= n; }
+
+    /// @brief Gives the vertices the client ids they were loaded with, see VertexIds::build().
+    /// nullptr, the default, means every vertex is its own id.
+    void setVertexIds(shared_ptr<const VertexIds> ids) { vertexIds = move(ids); }
 
-    /// @brief Removes an edge from the graph.
-    void removeEdge(int u, int v);
+    /// @brief Returns the client ids of the vertices, nullptr if every vertex is its own id.
+    const shared_ptr<const VertexIds>& getVertexIds() const { return vertexIds; }
+
+    /// @brief Returns the vertex with client id `id`, or 0 if the graph has no such vertex.
+    int findVertex(uint64_t id) const {
+        if (vertexIds) return vertexIds->find(id);
+        return id >= 1 && id <= static_cast<uint64_t>(max(n, 0)) ? static_cast<int>(id) : 0;
+    }
+
+    /// @brief Returns the client id of vertex u, which responses show instead of u.
+    uint64_t vertexId(int u) const { return vertexIds ? vertexIds->id(u) : static_cast<uint64_t>(u); }
 
     /// @brief Prints the current state of the graph.
     void printGraph() const;
 
+    /// @brief Appends the current state of the graph to a response, in the format of printGraph().
+    void printGraph(ResponseBuilder& out) const;
+
+    /// @brief Appends the adjacency lines of the vertices in [first, last) to a response, without the header.
+    void printVertices(ResponseBuilder& out, int first, int last) const;
+
     /// @brief Returns the number of nodes in the graph.
     int getNumNodes() const { return n; }
 
+    /// @brief Returns the number of edges in the graph.
+    size_t getNumEdges() const { return edges.size(); }
+
+    /// @brief Returns an estimate of the bytes the graph occupies: its buffers, list nodes and edge index,
+    /// without the overhead of the allocator.
+    size_t memoryUsage() const;
+
+    /// @brief Returns a version stamp that changes on every mutation.
+    /// Stamps are unique across all Graph instances, so a replaced graph never matches an old stamp.
+    uint64_t getVersion() const { return version; }
+
     /// @brief Returns all the edges in the graph.
-    vector<pair<pair<int, int>, double>> getEdges() const { return edges; }
+    const vector<pair<pair<int, int>, double>>& getEdges() const { return edges; }
 
     /// @brief Returns the adjacency list for Prim's algorithm.
     const vector<list<pair<int, double>>>& getAdjacencyList() const { return graph; }
 
 private:
+    using Neighbor = list<pair<int, double>>::iterator;
+
     int n;  ///< Number of nodes in the graph.
     vector<list<pair<int, double>>> graph;  ///< Adjacency list of the graph (with weights).
     vector<pair<pair<int, int>, double>> edges;  ///< Stores edges for Kruskal's algorithm.
+    vector<pair<Neighbor, Neighbor>> edgeSlots;  ///< Positions of edges[i] in graph[u] and graph[v].
+    EdgeIndex edgeIndex;  ///< Maps (min(u, v), max(u, v)) to the position of the edge in `edges`.
+    uint64_t version;  ///< Mutation stamp, see getVersion().
+    shared_ptr<const VertexIds> vertexIds;  ///< Client ids of the vertices, nullptr if they are their own ids.
+
+    /// @brief Gives the graph a fresh version stamp after a mutation.
+    void bumpVersion();
 };
 
 #endif
@@ -0,0 +1,102 @@
+#ifndef GRAPH_GENERATOR_H
+#define GRAPH_GENERATOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+class ThreadPool;
+
+/**
+ * Synthetic weighted graphs for benchmarks and load tests, in the edge-list form the Graph
+ * constructor takes. Vertices are numbered 1..n, edges are undirected without self-loops or
+ * repeated pairs, and weights are whole numbers from 1 to maxWeight.
+ * Every random choice is a hash of the seed and the index of the choice, and work is split into
+ * chunks of a fixed size whose results are joined in order, so the same arguments give the same
+ * graph on any machine, with or without a pool and whatever the number of threads.
+ */
+class GraphGenerator {
+public:
+    using EdgeList = std::vector<std::pair<std::pair<int, int>, double>>;
+
+    // The graph models, see the generator of each model
+    enum Model { ERDOS_RENYI, GRID, GEOMETRIC, RMAT, COMPLETE };
+
+    static const int maxWeight = 1000;
+
+    /**
+     * Looks up a model by name: "er" (or "erdos-renyi", "random"), "grid", "geometric", "rmat" (or
+     * "power-law") or "complete".
+     * @return false if the name is unknown.
+     */
+    static bool parseModel(const std::string& name, Model& model);
+
+    /**
+     * Returns the short name of a model, as accepted by parseModel().
+     */
+    static const char* modelName(Model model);
+
+    /**
+     * Generates a graph of the given model.
+     * @param n - number of vertices
+     * @param m - number of edges; the grid and the complete graph have a fixed number of edges
+     *            and ignore it, and a random geometric graph has about m edges
+     * @param seed - selects the graph; equal arguments give equal graphs
+     * @param pool - thread pool that generates the chunks in parallel, or nullptr
+     */
+    static EdgeList generate(Model model, int n, size_t m, uint64_t seed, ThreadPool* pool = nullptr);
+
+    /**
+     * Returns the number of edges generate() produces for these arguments; for a random geometric
+     * graph the expected number, m.
+     */
+    static uint64_t edgeCount(Model model, int n, uint64_t m);
+
+    /**
+     * Erdős–Rényi G(n, m): m distinct vertex pairs chosen uniformly at random, at most n(n-1)/2.
+     */
+    static EdgeList erdosRenyi(int n, size_t m, uint64_t seed, ThreadPool* pool = nullptr);
+
+    /**
+     * 2D grid of n vertices in rows of about sqrt(n), each joined to its right and lower neighbour.
+     */
+    static EdgeList grid(int n, uint64_t seed, ThreadPool* pool = nullptr);
+
+    /**
+     * Random geometric graph: n points placed uniformly in the unit square, joined when closer than
+     * the radius that gives about m edges. Weights grow with the distance.
+     */
+    static EdgeList randomGeometric(int n, size_t m, uint64_t seed, ThreadPool* pool = nullptr);
+
+    /**
+     * R-MAT power-law graph with the Graph500 quadrant probabilities (0.57, 0.19, 0.19, 0.05): a few
+     * vertices have very high degree. Gives fewer than m edges only if the model cannot produce m
+     * distinct pairs on n vertices.
+     */
+    static EdgeList rmat(int n, size_t m, uint64_t seed, ThreadPool* pool = nullptr);
+
+    /**
+     * Complete graph on n vertices, n(n-1)/2 edges.
+     */
+    static EdgeList complete(int n, uint64_t seed, ThreadPool* pool = nullptr);
+
+private:
+    /**
+     * Keeps the first m distinct pairs of a sequence of sampled edges, in sampling order, and gives
+     * them the weights of their endpoints.
+     * @param sample - writes the i-th sampled edge of the stream, with u == v to reject it
+     */
+    template <typename Sampler>
+    static EdgeList distinctEdges(size_t m, uint64_t seed, ThreadPool* pool, Sampler sample);
+
+    /**
+     * Calls produce(first, last, out) for the chunks of [0, count), in parallel if there is a pool,
+     * and joins the edges of the chunks in order.
+     */
+    template <typename Producer>
+    static EdgeList joinChunks(size_t count, size_t grain, ThreadPool* pool, Producer produce);
+};
+
+#endif // GRAPH_GENERATOR_H
@@ -0,0 +1,194 @@
+#ifndef IO_URING_BACKEND_H
+#define IO_URING_BACKEND_H
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include "ConnectionHandler.hpp"
+#include <linux/io_uring.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+/**
+ * io_uring event source for the servers, used instead of epoll/select when the kernel supports it.
+ * One multishot accept serves the listening socket, receives take their memory from a ring of
+ * provided buffers, and the sends requested by any thread are collected and submitted together
+ * with the next wait, so a busy server makes one io_uring_enter call for many socket operations.
+ *
+ * The backend owns the I/O state of each client socket; the server keeps its own connection
+ * objects and is called back through a Handler. A socket has at most one receive and one send in
+ * flight, so the callbacks of one socket never run concurrently and its data arrives in order.
+ * While a send is short (the client does not read its responses), the socket is not read until
+ * its output drained; the server can also hold back reading with pauseReading().
+ *
+ * wait() is called by one thread at a time (the select loop or the Leader-Follower leader).
+ * dispatch(), send() and close() may be called from any thread.
+ */
+class IoUringBackend {
+public:
+    // Callbacks into the server, run by the thread that dispatches the completion
+    using Handler = ConnectionHandler;
+
+    // A completed operation, as returned by wait()
+    struct Completion {
+        uint64_t data;   // Operation and socket
+        int32_t result;  // Result of the system call, -errno on failure
+        uint32_t flags;  // IORING_CQE_F_* flags
+    };
+
+    explicit IoUringBackend(Handler& handler);
+    ~IoUringBackend();
+
+    IoUringBackend(const IoUringBackend&) = delete;
+    IoUringBackend& operator=(const IoUringBackend&) = delete;
+
+    /**
+     * Creates the ring, registers the receive buffers and starts accepting on the listening socket.
+     * @return false if io_uring or one of the features used is not available; the caller falls back
+     *         to its epoll/select loop.
+     */
+    bool start(int listenSocket);
+
+    /**
+     * Starts accepting on one more listening socket, e.g. a Unix domain socket next to the TCP one.
+     * Called after start(); the accept is submitted with the next wait().
+     */
+    void addListener(int socket);
+
+    /**
+     * Submits all prepared operations and waits until at least one completion is ready.
+     * Wakeups and cancellations are handled internally and never returned.
+     * @return the number of completions stored in events, at most max.
+     */
+    size_t wait(Completion* events, size_t max);
+
+    /**
+     * Handles a completion returned by wait(), calling the handler and preparing follow-up operations.
+     * The operations are submitted by the next wait() or submit().
+     */
+    void dispatch(const Completion& event);
+
+    /**
+     * Submits the prepared operations without waiting, for threads other than the one in wait().
+     */
+    void submit();
+
+    /**
+     * Requests a send of the connection's output. Requests of all threads are batched into the next wait().
+     */
+    void send(int fd);
+
+    /**
+     * Closes a socket once its queued output was sent, then calls Handler::closed().
+     */
+    void close(int fd);
+
+    /**
+     * Stops reading a socket after the receive in flight until resumeReading(), e.g. while the
+     * connection has too many commands in flight. May be called from any thread, also from received().
+     */
+    void pauseReading(int fd);
+
+    /**
+     * Reads a socket again after pauseReading(). May be called from any thread.
+     */
+    void resumeReading(int fd);
+
+private:
+    static const int maxIovecs = 64;  // Most iovecs of one send
+
+    // I/O state of a client socket, guarded by stateMutex. The iovecs belong to the thread that set writing.
+    struct Socket {
+        bool reading = false;     // A receive is in flight
+        bool writing = false;     // A send is in flight or being prepared
+        bool sendAgain = false;   // More output was queued while writing
+        bool blocked = false;     // The last send was short: reading waits until the output drained
+        bool readPaused = false;  // A receive is due once the output drained and reading is not paused
+        bool throttled = false;   // pauseReading() was called
+        bool hungUp = false;      // Handler::hungUp() was called
+        bool failed = false;      // A send failed, the rest of the output is dropped
+        bool closing = false;     // close() was requested
+        size_t requested = 0;     // Bytes of the send in flight
+        msghdr message;
+        iovec iov[maxIovecs];
+    };
+
+    Handler& handler;
+    int ringFd;
+    int wakeFd;               // eventfd that interrupts wait() when other threads request sends
+    uint64_t wakeValue;       // Target of the eventfd read
+
+    // Submission queue, shared with the kernel; prepared entries are guarded by sqMutex
+    std::mutex sqMutex;
+    unsigned sqEntries;
+    unsigned* sqHead;
+    unsigned* sqTail;
+    unsigned* sqMask;
+    unsigned* sqArray;
+    struct io_uring_sqe* sqes;
+
+    // Completion queue, only read by the thread in wait()
+    unsigned* cqHead;
+    unsigned* cqTail;
+    unsigned* cqMask;
+    struct io_uring_cqe* cqes;
+
+    void* rings;              // Submission and completion rings, mapped together
+    size_t ringsSize;
+    size_t sqesSize;
+
+    // Provided receive buffers, handed back to the kernel under bufferMutex
+    std::mutex bufferMutex;
+    struct io_uring_buf* bufferRing;
+    char* buffers;
+    unsigned short bufferTail;
+
+    std::mutex stateMutex;
+    std::unordered_map<int, Socket> sockets;  // Open client sockets; nodes never move
+
+    std::mutex requestMutex;
+    std::vector<int> sendRequests;    // Sockets with new output, guarded by requestMutex
+    std::vector<int> closeRequests;   // Sockets to close after their output, guarded by requestMutex
+    std::vector<int> resumeRequests;  // Sockets to read again, guarded by requestMutex
+    std::vector<int> takenSends;      // Requests being handled by the thread in wait()
+    std::vector<int> takenCloses;
+    std::vector<int> takenResumes;
+
+    // Returns a free submission entry, cleared; called with sqMutex held
+    struct io_uring_sqe* nextEntry();
+
+    // Makes the entries prepared so far visible to the kernel; called with sqMutex held
+    void publish(struct io_uring_sqe* entry);
+
+    void prepareAccept(int listenSocket);
+    void prepareReceive(int fd);
+    void prepareWake();
+    void prepareCancel(uint64_t target);
+    void returnBuffer(unsigned short id);
+
+    // Gathers and sends the next output of a socket whose writing flag the caller set
+    void writeNext(int fd, Socket& socket);
+
+    // Takes the send, close and resume requests of other threads
+    void takeRequests();
+
+    // Starts sending the output of a socket unless a send is already in flight
+    void startSend(int fd);
+
+    // Forgets the socket if it is closing and nothing is in flight any more; called with stateMutex held.
+    // @return true if the caller must call closeSocket() once the lock is released.
+    bool finishClose(int fd, Socket& socket);
+
+    void closeSocket(int fd);
+    void wake();
+
+    void onReceive(int fd, const Completion& event);
+    void onSend(int fd, const Completion& event);
+
+    unsigned pendingEntries();
+    void release();
+};
+
+#endif // IO_URING_BACKEND_H
@@ -0,0 +1,120 @@
+#ifndef JOB_CONTROL_H
+#define JOB_CONTROL_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Link between a long-running computation and the threads watching it.
+ * The computation reports its progress and checks cancelled() at bounded intervals; any thread may
+ * read the progress or request cancellation. A computation is also cancelled once its deadline has
+ * passed or the flag it watches, e.g. the hang-up of its client, is set. A cancelled computation
+ * stops early and leaves a partial result, which the caller must discard.
+ */
+class JobControl {
+public:
+    // Kernels check for cancellation and report progress once per this many steps
+    static const size_t checkInterval = 4096;
+
+    using Clock = std::chrono::steady_clock;
+
+    JobControl() : cancelFlag(false), deadline(0), watched(nullptr), percent(0), phaseFirst(0), phaseLast(100) {}
+
+    /**
+     * Prepares the control for the next computation: no cancellation, deadline or watched flag.
+     * Called before the computation starts, while no other thread uses the control.
+     */
+    void reset() {
+        cancelFlag.store(false, std::memory_order_relaxed);
+        deadline.store(0, std::memory_order_relaxed);
+        watched = nullptr;
+        percent.store(0, std::memory_order_relaxed);
+        phaseFirst = 0;
+        phaseLast = 100;
+    }
+
+    /**
+     * Asks the computation to stop at its next check.
+     */
+    void cancel() { cancelFlag.store(true, std::memory_order_relaxed); }
+
+    /**
+     * Cancels the computation at the first check after `when`.
+     */
+    void setDeadline(Clock::time_point when) {
+        deadline.store(std::max<int64_t>(1, when.time_since_epoch().count()), std::memory_order_relaxed);
+    }
+
+    /**
+     * Gives the computation the deadline of another control, e.g. of the request that started it.
+     */
+    void copyDeadline(const JobControl& other) {
+        deadline.store(other.deadline.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    }
+
+    /**
+     * Cancels the computation at the first check that finds `flag` set. The flag must outlive the
+     * computation. Called before the computation starts.
+     */
+    void watch(const std::atomic<bool>* flag) { watched = flag; }
+
+    /**
+     * Returns true if the computation must stop: it was cancelled, its deadline passed or the
+     * watched flag is set. Reads the clock only if a deadline was set.
+     */
+    bool cancelled() const {
+        if (cancelFlag.load(std::memory_order_relaxed)) return true;
+        if ((watched && watched->load(std::memory_order_relaxed)) || expired()) {
+            cancelFlag.store(true, std::memory_order_relaxed);  // Later checks skip the clock
+            return true;
+        }
+        return false;
+    }
+
+    /**
+     * Returns true if the deadline passed at time `now`.
+     */
+    bool expired(Clock::time_point now = Clock::now()) const {
+        int64_t when = deadline.load(std::memory_order_relaxed);
+        return when != 0 && now.time_since_epoch().count() >= when;
+    }
+
+    /**
+     * Sets the share of the total progress, in percent, that the following report() calls cover.
+     * Called by the computation only.
+     */
+    void setPhase(int first, int last) {
+        phaseFirst = first;
+        phaseLast = last;
+        percent.store(first, std::memory_order_relaxed);
+    }
+
+    /**
+     * Reports that `done` of the `total` steps of the current phase are complete.
+     * Called by the computation only.
+     */
+    void report(size_t done, size_t total) {
+        int value = phaseLast;
+        if (total > 0 && done < total) {
+            value = phaseFirst + static_cast<int>(static_cast<double>(done) / total * (phaseLast - phaseFirst));
+        }
+        percent.store(value, std::memory_order_relaxed);
+    }
+
+    /**
+     * Returns the progress in percent.
+     */
+    int progress() const { return percent.load(std::memory_order_relaxed); }
+
+private:
+    mutable std::atomic<bool> cancelFlag;
+    std::atomic<int64_t> deadline;     // Clock ticks since the epoch, 0 if there is none
+    const std::atomic<bool>* watched;  // Flag that cancels the computation once set, may be nullptr
+    std::atomic<int> percent;
+    int phaseFirst, phaseLast;  // Range of the current phase
+};
+
+#endif // JOB_CONTROL_H
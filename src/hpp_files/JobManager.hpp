@@ -0,0 +1,115 @@
+#ifndef JOB_MANAGER_H
+#define JOB_MANAGER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "JobControl.hpp"
+#include "Tree.hpp"
+
+/**
+ * Runs heavy commands as background jobs on threads of its own, so the connection that started a
+ * job and the server's workers are free while it runs. Jobs are identified by ids that are never
+ * reused; finished jobs are kept for polling until `retained` newer jobs have finished.
+ * Thread-safe.
+ */
+class JobManager {
+public:
+    enum State { QUEUED, RUNNING, DONE, CANCELLED };
+
+    struct Job {
+        uint64_t id;
+        std::string name;                 // Command the job runs, e.g. "Kruskal"
+        JobControl control;               // Progress of the job and its cancellation request
+        std::atomic<State> state;
+        std::chrono::steady_clock::time_point submitted;
+        std::chrono::steady_clock::time_point finished;  // Valid once the state is DONE or CANCELLED
+        std::string summary;              // One-line result, valid once DONE
+        std::shared_ptr<const Tree> tree; // MST computed by the job, valid once DONE
+
+        Job(uint64_t id, const std::string& name) : id(id), name(name), state(QUEUED) {}
+    };
+
+    using Work = std::function<void(Job&)>;            // Computes the result of the job, checking job.control
+    // Called once the job ended: on the job thread, or on the cancelling thread for a job that never started
+    using Callback = std::function<void(const Job&)>;
+
+    /**
+     * @param threads - number of jobs that run at the same time
+     * @param retained - number of finished jobs kept for polling
+     */
+    explicit JobManager(size_t threads = 2, size_t retained = 1024);
+
+    /**
+     * Cancels the jobs that did not finish and joins the job threads.
+     */
+    ~JobManager();
+
+    JobManager(const JobManager&) = delete;
+    JobManager& operator=(const JobManager&) = delete;
+
+    /**
+     * Registers a job without running it, so its id can reach the client before any notice of its end.
+     */
+    std::shared_ptr<Job> create(const std::string& name);
+
+    /**
+     * Queues a job returned by create(). A job cancelled before it was started does not run.
+     * @param finished - called when the job is done or was cancelled, may be empty
+     */
+    void start(const std::shared_ptr<Job>& job, Work work, Callback finished);
+
+    /**
+     * Returns the job with this id, or nullptr if it is unknown or was dropped from the retained jobs.
+     */
+    std::shared_ptr<const Job> find(uint64_t id) const;
+
+    /**
+     * Cancels a queued job at once, or asks a running job to stop at its next check.
+     * @return false if the job is unknown or already ended.
+     */
+    bool cancel(uint64_t id);
+
+    /**
+     * Returns the state as shown to clients: "queued", "running", "done" or "cancelled".
+     */
+    static const char* stateName(State state);
+
+    /**
+     * Appends the status line of a job, e.g. "Job 3 (Kruskal): running, 40%", with its result once done.
+     */
+    static void describe(const Job& job, ResponseBuilder& out);
+
+private:
+    struct Entry {
+        std::shared_ptr<Job> job;
+        Work work;
+        Callback finished;
+    };
+
+    size_t retained;
+    mutable std::mutex mutex;                 // Guards the fields below
+    std::condition_variable condition;        // Signals queued jobs and stop requests
+    std::deque<Entry> queue;                  // Jobs waiting for a thread, oldest first
+    std::unordered_map<uint64_t, std::shared_ptr<Job>> jobs;  // Queued, running and retained jobs by id
+    std::deque<uint64_t> ended;               // Ids of the ended jobs still in `jobs`, oldest first
+    uint64_t nextId;
+    bool stopFlag;
+    std::vector<std::thread> workers;
+
+    void worker();
+
+    // Records the end of a job and drops the oldest ended jobs beyond `retained`. Called with mutex held.
+    void retire(Job& job, State state);
+};
+
+#endif // JOB_MANAGER_H
@@ -2,22 +2,41 @@
 #define KRUSKAL_MST_H
 
 #include "Graph.hpp"   // Include the Graph class header
+#include "ThreadPool.hpp"  // Optional pool for sorting the edges in parallel
+#include "JobControl.hpp"
 #include <vector>      // Include vector for dynamic array support
 
 /**
  * Class that implements Kruskal's algorithm for finding the Minimum Spanning Tree (MST).
- * The MST is stored in the `mstEdges` vector.
+ * The MST is stored in the `mstEdges` vector. findMST() runs MSTKernels::kruskal on the edges
+ * converted to EdgeArrays: 32-bit vertices and weights, sorted by radix, when every weight is a
+ * whole number that fits (see fitsUnsigned32()), 32-bit vertices and double weights otherwise.
  */
 class KruskalMST {
 public:
     /**
-     * Constructor that initializes the KruskalMST with a reference to the graph.
+     * Constructor that initializes the KruskalMST with a copy of the edges of the graph.
      * @param g - reference to the graph object
+     * @param pool - thread pool used to sort the edges in parallel, or nullptr to sort sequentially
+     * @param control - receives the progress of findMST() and may cancel it, or nullptr
      */
-    KruskalMST(Graph& g) : g(g) {}
+    KruskalMST(Graph& g, ThreadPool* pool = nullptr, JobControl* control = nullptr)
+        : KruskalMST(g.getNumNodes(), g.getEdges(), pool, control) {}
+
+    /**
+     * Constructor that takes the edge list of a graph, e.g. a snapshot copied under the graph's lock.
+     * Kruskal only needs the edges, so no Graph has to be built for them.
+     * @param n - number of vertices; edges use the vertices 1..n
+     * @param edges - the edges with their weights, without repeated pairs
+     */
+    KruskalMST(int n, std::vector<std::pair<std::pair<int, int>, double>> edges, ThreadPool* pool = nullptr,
+               JobControl* control = nullptr)
+        : n(n), edges(std::move(edges)), pool(pool), control(control) {}
 
     /**
      * Method to find the Minimum Spanning Tree (MST) using Kruskal's algorithm.
+     * If the control is cancelled, the method returns early with a partial MST.
+     * The edge list is converted and released, so the method runs once per object.
      * @return The total weight of the MST.
      */
     double findMST();
@@ -29,25 +48,17 @@ public:
     std::vector<std::pair<std::pair<int, int>, double>> getMSTEdges() const;
 
 private:
-    Graph& g;   // Reference to the graph
+    int n;   // Number of vertices
+    std::vector<std::pair<std::pair<int, int>, double>> edges;  // Edges of the graph, released by findMST()
+    ThreadPool* pool;  // Pool for the parallel edge sort, may be nullptr
+    JobControl* control;  // Progress and cancellation of a background job, may be nullptr
     std::vector<std::pair<std::pair<int, int>, double>> mstEdges;  // Vector to store the edges of the MST
 
     /**
-     * Helper function to find the root of a node `u` in the disjoint set (used in union-find).
-     * @param u - the node to find the root for
-     * @param parent - the parent array representing the disjoint set
-     * @return The root of the node `u`.
-     */
-    int find(int u, std::vector<int>& parent);
-
-    /**
-     * Helper function to unite two sets containing `u` and `v` in the disjoint set (union by rank).
-     * @param u - the first node
-     * @param v - the second node
-     * @param parent - the parent array representing the disjoint set
-     * @param rank - the rank array to optimize union operations
+     * Runs the kernel on the edges stored with the given types.
      */
-    void unite(int u, int v, std::vector<int>& parent, std::vector<int>& rank);
+    template <typename Index, typename Weight>
+    double run();
 };
 
 #endif // KRUSKAL_MST_H
@@ -0,0 +1,109 @@
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Log-linear histogram of latencies in the style of HdrHistogram: every power of two is split
+ * into 32 linear sub-buckets, so any recorded value is known to within about 3% while the whole
+ * range up to 2^63 ns takes 1920 counters. Recording is a few instructions and never allocates.
+ * Not thread-safe: each thread records into its own histogram, and the results are merged;
+ * AtomicHistogram (Metrics.hpp) counts in the same buckets for values recorded by many threads.
+ */
+class LatencyHistogram {
+public:
+    LatencyHistogram() : counts(bucketCount, 0), total(0), sum(0), smallest(UINT64_MAX), largest(0) {}
+
+    /**
+     * Records one value, e.g. a latency in nanoseconds.
+     */
+    void record(uint64_t value) {
+        counts[bucketOf(value)]++;
+        total++;
+        sum += value;
+        smallest = std::min(smallest, value);
+        largest = std::max(largest, value);
+    }
+
+    /**
+     * Adds the values recorded by another histogram.
+     */
+    void merge(const LatencyHistogram& other) {
+        for (size_t i = 0; i < bucketCount; ++i) counts[i] += other.counts[i];
+        total += other.total;
+        sum += other.sum;
+        smallest = std::min(smallest, other.smallest);
+        largest = std::max(largest, other.largest);
+    }
+
+    /**
+     * Adds values counted elsewhere in the buckets of this layout, e.g. by an AtomicHistogram.
+     * @param bucketCounts - bucketCount counters, indexed by bucketOf()
+     */
+    void merge(const std::vector<uint64_t>& bucketCounts, uint64_t valueSum, uint64_t smallestValue, uint64_t largestValue) {
+        uint64_t added = 0;
+        for (size_t i = 0; i < bucketCount; ++i) {
+            counts[i] += bucketCounts[i];
+            added += bucketCounts[i];
+        }
+        if (added == 0) return;
+        total += added;
+        sum += valueSum;
+        smallest = std::min(smallest, smallestValue);
+        largest = std::max(largest, largestValue);
+    }
+
+    void clear() {
+        std::fill(counts.begin(), counts.end(), 0);
+        total = sum = largest = 0;
+        smallest = UINT64_MAX;
+    }
+
+    uint64_t count() const { return total; }
+    uint64_t min() const { return total ? smallest : 0; }
+    uint64_t max() const { return largest; }
+    double mean() const { return total ? static_cast<double>(sum) / total : 0; }
+
+    /**
+     * Returns the value below which `percent` percent of the recorded values lie: the upper end of
+     * the bucket holding that rank, but never more than the largest value recorded.
+     */
+    uint64_t percentile(double percent) const {
+        if (total == 0) return 0;
+        uint64_t rank = static_cast<uint64_t>(percent / 100.0 * total + 0.5);
+        rank = std::min(std::max<uint64_t>(rank, 1), total);
+        uint64_t seen = 0;
+        for (size_t i = 0; i < bucketCount; ++i) {
+            seen += counts[i];
+            if (seen >= rank) return std::min(upperBound(i), largest);
+        }
+        return largest;
+    }
+
+    static const int subBits = 5;                        // 32 sub-buckets per power of two
+    static const uint64_t subCount = uint64_t(1) << subBits;
+    static const size_t bucketCount = (64 - subBits) * subCount + subCount;
+
+    // Values below 64 have a bucket each; above, a bucket covers 1/32 of a power of two
+    static size_t bucketOf(uint64_t value) {
+        if (value < 2 * subCount) return static_cast<size_t>(value);
+        int shift = 63 - __builtin_clzll(value) - subBits;  // At least 1
+        return static_cast<size_t>(shift) * subCount + static_cast<size_t>(value >> shift);
+    }
+
+private:
+    std::vector<uint64_t> counts;
+    uint64_t total, sum, smallest, largest;
+
+    static uint64_t upperBound(size_t index) {
+        if (index < 2 * subCount) return index;
+        uint64_t shift = index / subCount - 1;
+        uint64_t sub = index - shift * subCount;
+        return ((sub + 1) << shift) - 1;
+    }
+};
+
+#endif // LATENCY_HISTOGRAM_H
@@ -0,0 +1,59 @@
+#ifndef LINEAR_PROBING_H
+#define LINEAR_PROBING_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Hashing and probing shared by the open-addressing tables of the server (EdgeIndex, VertexIds).
+ * A table is a power-of-two sized vector of entries with a 64-bit `key` field; each table decides
+ * which entries are empty through the `isEmpty` predicate, so any key value can still be stored.
+ * Callers keep the load factor below 1/2 so probe sequences stay short.
+ */
+class LinearProbing {
+public:
+    /**
+     * splitmix64 finalizer: spreads keys that differ only in a few bits, e.g. consecutive vertices
+     * or ids that are multiples of 2^32, over the whole table.
+     */
+    static size_t hash(uint64_t key) {
+        key ^= key >> 30;
+        key *= 0xbf58476d1ce4e5b9ULL;
+        key ^= key >> 27;
+        key *= 0x94d049bb133111ebULL;
+        key ^= key >> 31;
+        return static_cast<size_t>(key);
+    }
+
+    /**
+     * Returns the position of `key` in the table, or the empty position where it would go.
+     * The table must have at least one empty entry.
+     */
+    template <typename Entry, typename IsEmpty>
+    static size_t probe(const std::vector<Entry>& table, uint64_t key, IsEmpty isEmpty) {
+        size_t mask = table.size() - 1;
+        size_t pos = hash(key) & mask;
+        while (!isEmpty(table[pos]) && table[pos].key != key) {
+            pos = (pos + 1) & mask;
+        }
+        return pos;
+    }
+
+    /**
+     * Resizes the table to `capacity` entries (a power of two) filled with `empty` and reinserts
+     * the entries it held.
+     */
+    template <typename Entry, typename IsEmpty>
+    static void rehash(std::vector<Entry>& table, size_t capacity, const Entry& empty, IsEmpty isEmpty) {
+        std::vector<Entry> old(capacity, empty);
+        old.swap(table);
+        for (const auto& entry : old) {
+            if (!isEmpty(entry)) {
+                table[probe(table, entry.key, isEmpty)] = entry; // Keys are unique, so this lands on an empty position
+            }
+        }
+    }
+};
+
+#endif // LINEAR_PROBING_H
@@ -0,0 +1,148 @@
+#ifndef MPSC_QUEUE_H
+#define MPSC_QUEUE_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+/**
+ * Bounded multi-producer single-consumer ring buffer.
+ * Each slot carries a sequence number (Vyukov's bounded queue), so producers claim a slot with one
+ * CAS and hand it to the consumer with one release store; no lock is taken on the fast path.
+ * The consumer spins briefly when the queue is empty and then parks on a condition variable;
+ * producers only touch the mutex when the consumer is actually parked.
+ */
+template <typename T>
+class MPSCQueue {
+public:
+    /**
+     * @param capacity - maximum number of queued items, rounded up to a power of two
+     */
+    explicit MPSCQueue(size_t capacity) : enqueuePos(0), dequeuePos(0), sleeping(false), closed(false) {
+        size_t size = 2;
+        while (size < capacity) size *= 2;
+        mask = size - 1;
+        slots.reset(new Slot[size]);
+        for (size_t i = 0; i < size; ++i) {
+            slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    MPSCQueue(const MPSCQueue&) = delete;
+    MPSCQueue& operator=(const MPSCQueue&) = delete;
+
+    /**
+     * Appends an item if there is room.
+     * @return false if the queue is full; the item is left untouched in that case.
+     */
+    bool tryPush(T& item) {
+        size_t pos = enqueuePos.load(std::memory_order_relaxed);
+        while (true) {
+            Slot& slot = slots[pos & mask];
+            size_t seq = slot.sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                // The slot is free for this lap: claim it
+                if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    slot.item = std::move(item);
+                    slot.sequence.store(pos + 1, std::memory_order_release); // Publish to the consumer
+                    wakeConsumer();
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false; // The consumer has not freed this slot yet: full
+            } else {
+                pos = enqueuePos.load(std::memory_order_relaxed); // Another producer won, retry
+            }
+        }
+    }
+
+    /**
+     * Appends an item, yielding while the queue is full (backpressure on the producer).
+     */
+    void push(T item) {
+        while (!tryPush(item)) {
+            std::this_thread::yield();
+        }
+    }
+
+    /**
+     * Removes the oldest item if there is one. Consumer thread only.
+     */
+    bool tryPop(T& item) {
+        size_t pos = dequeuePos.load(std::memory_order_relaxed);
+        Slot& slot = slots[pos & mask];
+        size_t seq = slot.sequence.load(std::memory_order_acquire);
+        if (static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1) < 0) return false; // Empty
+        item = std::move(slot.item);
+        slot.sequence.store(pos + mask + 1, std::memory_order_release); // Free the slot for the next lap
+        dequeuePos.store(pos + 1, std::memory_order_relaxed);
+        return true;
+    }
+
+    /**
+     * Removes the oldest item, spinning and then parking while the queue is empty. Consumer thread only.
+     * @return false once the queue was closed and drained.
+     */
+    bool pop(T& item) {
+        // Spin first: under load the next item is usually only a few hundred nanoseconds away
+        for (int spin = 0; spin < spinLimit; ++spin) {
+            if (tryPop(item)) return true;
+            if (spin >= spinLimit / 2) std::this_thread::yield();
+        }
+
+        std::unique_lock<std::mutex> lock(parkMutex);
+        sleeping.store(true, std::memory_order_seq_cst);
+        while (!tryPop(item)) {
+            if (closed.load(std::memory_order_acquire)) {
+                sleeping.store(false, std::memory_order_relaxed);
+                return false;
+            }
+            parkCondition.wait(lock);
+        }
+        sleeping.store(false, std::memory_order_relaxed);
+        return true;
+    }
+
+    /**
+     * Wakes the consumer for good: pop() returns false once the remaining items are drained.
+     */
+    void close() {
+        std::lock_guard<std::mutex> lock(parkMutex);
+        closed.store(true, std::memory_order_release);
+        parkCondition.notify_one();
+    }
+
+private:
+    struct Slot {
+        std::atomic<size_t> sequence;  // pos: free for producers, pos + 1: holds an item for the consumer
+        T item;
+    };
+
+    static constexpr int spinLimit = 128;
+
+    std::unique_ptr<Slot[]> slots;
+    size_t mask;
+    alignas(64) std::atomic<size_t> enqueuePos;  // Next slot to claim by producers
+    alignas(64) std::atomic<size_t> dequeuePos;  // Next slot to read by the consumer
+    alignas(64) std::atomic<bool> sleeping;      // True while the consumer is parked or about to park
+    std::atomic<bool> closed;
+    std::mutex parkMutex;
+    std::condition_variable parkCondition;
+
+    void wakeConsumer() {
+        // Pairs with the seq_cst store in pop(): either the consumer sees the item or we see it sleeping
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (sleeping.load(std::memory_order_relaxed)) {
+            std::lock_guard<std::mutex> lock(parkMutex);
+            parkCondition.notify_one();
+        }
+    }
+};
+
+#endif // MPSC_QUEUE_H
@@ -0,0 +1,114 @@
+#ifndef MSTCACHE_H
+#define MSTCACHE_H
+
+#include "Graph.hpp"
+#include "Tree.hpp"
+#include "MSTFactory.hpp"
+#include "JobControl.hpp"
+#include "Metrics.hpp"
+#include <memory>
+#include <mutex>
+
+/**
+ * MSTCache keeps the last computed MST together with the graph version it was built from.
+ * Repeated MST requests on an unchanged graph return the cached tree without recomputing,
+ * and queries trigger a recompute only when the graph changed since the cached result.
+ * Not thread-safe: callers hold the graph mutex while using the cache and the returned tree.
+ */
+class MSTCache {
+public:
+    // How update() brought the cached MST up to date after a batch
+    enum UpdateKind { NOT_CACHED, INCREMENTAL, REBUILT };
+
+    MSTCache();
+
+    /**
+     * Returns the MST of the graph computed with the requested algorithm, or with any algorithm if
+     * anyAlgorithm is set (a stale tree is then rebuilt with the one used last, Kruskal if none was).
+     * The MST is recomputed only if the graph changed; a Kruskal rebuild sorts a copy of the edge
+     * list with the graph mutex released, so other commands use the graph meanwhile. Prim needs the
+     * adjacency lists, which cost more to copy than to run on, so it is rebuilt under the mutex.
+     * @param lock - holds the graph mutex on entry and on return
+     * @param g - the server's graph pointer, read again once the lock is taken back
+     * @param control - deadline and cancellation of the request, or nullptr
+     * @return The MST of the graph as it was when the call started. It is also cached unless the
+     *         graph changed during the rebuild. nullptr if the rebuild was cancelled; the cache is
+     *         left as it was.
+     */
+    std::shared_ptr<Tree> refresh(std::unique_lock<TimedMutex>& lock, const std::shared_ptr<Graph>& g,
+                                  MSTFactory::AlgorithmType algorithm, bool anyAlgorithm,
+                                  JobControl* control = nullptr);
+
+    /**
+     * Brings the cached MST up to date after a batch of mutations was applied to the graph.
+     * When the cached tree was built by Kruskal from the pre-batch graph, the batch is small and it
+     * neither removes nor increases the weight of an MST edge, the new MST is computed from the old
+     * MST edges plus the touched edges only. Otherwise the MST is rebuilt from the whole graph.
+     * Nothing is computed if no tree was cached for the pre-batch graph.
+     * @param g - reference to the graph, after the batch was applied
+     * @param ops - the applied operations
+     * @param previousVersion - graph version before the batch
+     * @return How the MST was updated.
+     */
+    UpdateKind update(Graph& g, const std::vector<EdgeOp>& ops, uint64_t previousVersion);
+
+    /**
+     * Stores a tree computed from version `version` of the graph outside the graph mutex, e.g. by a
+     * background job, unless the graph changed since.
+     * @return false if the tree is outdated and was not stored.
+     */
+    bool install(const Graph& g, uint64_t version, std::shared_ptr<Tree> tree, MSTFactory::AlgorithmType algorithm);
+
+    /**
+     * Computes the MST from a copy of a graph's edge list without touching any cache, so it can run
+     * without holding the graph mutex. Both algorithms work on the edges as they are.
+     * @param n - number of vertices of the graph
+     * @param edges - the graph's edges
+     * @param ids - the graph's vertex ids (Graph::getVertexIds()), given to the tree
+     * @param pool - pool for the parallel kernels, or nullptr
+     * @param control - progress and cancellation, or nullptr
+     * @return The tree, or nullptr if the computation was cancelled.
+     */
+    static std::shared_ptr<Tree> compute(int n, std::vector<std::pair<std::pair<int, int>, double>> edges,
+                                         std::shared_ptr<const VertexIds> ids, MSTFactory::AlgorithmType algorithm,
+                                         ThreadPool* pool, JobControl* control);
+
+    /**
+     * Returns true if the cached tree matches the current version of the graph.
+     */
+    bool isFresh(const Graph& g) const { return tree && version == g.getVersion(); }
+
+    /**
+     * Returns shared ownership of the cached tree, which stays valid after the cache moves on to a
+     * newer tree, e.g. while a response streams its edges. The tree is never modified once built.
+     */
+    std::shared_ptr<const Tree> share() const { return tree; }
+
+    /**
+     * Drops the cached tree.
+     */
+    void clear();
+
+    /**
+     * Sets the thread pool used by Kruskal's edge sort and the tree's all-pairs index.
+     * @param pool - the pool, or nullptr to compute sequentially
+     */
+    void setThreadPool(ThreadPool* pool) { this->pool = pool; }
+
+    ThreadPool* threadPool() const { return pool; }
+
+private:
+    std::shared_ptr<Tree> tree;          // The cached MST
+    uint64_t version;                    // Graph version the tree was computed from
+    MSTFactory::AlgorithmType algorithm; // Algorithm that produced the tree
+    ThreadPool* pool;                    // Pool for the parallel kernels, may be nullptr
+
+    /**
+     * Runs the algorithm on the graph and replaces the cached tree.
+     * @param control - cancellation of the computation, or nullptr
+     * @return false if the computation was cancelled and the cache left as it was.
+     */
+    bool recompute(Graph& g, MSTFactory::AlgorithmType algorithm, JobControl* control = nullptr);
+};
+
+#endif // MSTCACHE_H
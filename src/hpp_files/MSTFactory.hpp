@@ -1,38 +1,61 @@
-#ifndef MSTFACTORY_H 
-#define MSTFACTORY_H
-
-#include "Graph.hpp"
-#include <memory>  // For std::unique_ptr
-
-// Forward declarations of KruskalMST and PrimMST classes
-class KruskalMST;  
-class PrimMST;     
-
-/**
- * MSTFactory is responsible for creating objects of different MST (Minimum Spanning Tree)
- * algorithms such as Kruskal and Prim.
- */
-class MSTFactory {
-public:
-    // Enum to specify the type of MST algorithm
-    enum AlgorithmType { KRUSKAL, PRIM };
-
-    /**
-     * Creates and returns a unique pointer to a KruskalMST object.
-     * @param g - reference to the graph object
-     * @return A unique pointer to the KruskalMST object.
-     */
-    static std::unique_ptr<KruskalMST> createKruskalMST(Graph& g);
-
-    /**
-     * Creates and returns a unique pointer to a PrimMST object.
-     * @param g - reference to the graph object
-     * @return A unique pointer to the PrimMST object.
-     */
-    static std::unique_ptr<PrimMST> createPrimMST(Graph& g);
-
-    // Virtual destructor for proper cleanup in case of inheritance
-    virtual ~MSTFactory() {}
-};
-
-#endif // MSTFACTORY_H
+#ifndef MSTFACTORY_H 
+#define MSTFACTORY_H
+
+#include "Graph.hpp"
+#include <memory>  // For std::unique_ptr
+
+// Forward declarations of KruskalMST and PrimMST classes
+class KruskalMST;  
+class PrimMST;     
+class ThreadPool;
+class JobControl;
+
+/**
+ * MSTFactory is responsible for creating objects of different MST (Minimum Spanning Tree)
+ * algorithms such as Kruskal and Prim.
+ */
+class MSTFactory {
+public:
+    // Enum to specify the type of MST algorithm
+    enum AlgorithmType { KRUSKAL, PRIM };
+
+    /**
+     * Creates and returns a unique pointer to a KruskalMST object.
+     * @param g - reference to the graph object
+     * @param pool - optional thread pool for the parallel edge sort
+     * @param control - optional progress and cancellation of a background job
+     * @return A unique pointer to the KruskalMST object.
+     */
+    static std::unique_ptr<KruskalMST> createKruskalMST(Graph& g, ThreadPool* pool = nullptr, JobControl* control = nullptr);
+
+    /**
+     * Creates a KruskalMST object working on an edge list instead of a graph.
+     * @param n - number of vertices
+     * @param edges - the edges of the graph, moved into the object
+     * @return A unique pointer to the KruskalMST object.
+     */
+    static std::unique_ptr<KruskalMST> createKruskalMST(int n, std::vector<std::pair<std::pair<int, int>, double>> edges,
+                                                        ThreadPool* pool = nullptr, JobControl* control = nullptr);
+
+    /**
+     * Creates and returns a unique pointer to a PrimMST object.
+     * @param g - reference to the graph object
+     * @param control - optional progress and cancellation of a background job
+     * @return A unique pointer to the PrimMST object.
+     */
+    static std::unique_ptr<PrimMST> createPrimMST(Graph& g, JobControl* control = nullptr);
+
+    /**
+     * Creates a PrimMST object working on an edge list instead of a graph.
+     * @param n - number of vertices
+     * @param edges - the edges of the graph, moved into the object
+     * @return A unique pointer to the PrimMST object.
+     */
+    static std::unique_ptr<PrimMST> createPrimMST(int n, std::vector<std::pair<std::pair<int, int>, double>> edges,
+                                                  JobControl* control = nullptr);
+
+    // Virtual destructor for proper cleanup in case of inheritance
+    virtual ~MSTFactory() {}
+};
+
+#endif // MSTFACTORY_H
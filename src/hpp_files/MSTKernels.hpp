@@ -0,0 +1,234 @@
+#ifndef MST_KERNELS_H
+#define MST_KERNELS_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <queue>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "EdgeArrays.hpp"
+#include "JobControl.hpp"
+#include "Profiler.hpp"
+#include "ThreadPool.hpp"
+
+/**
+ * Disjoint sets of the vertices 0..n-1 with union by rank and path compression.
+ */
+template <typename Index>
+class DisjointSets {
+public:
+    explicit DisjointSets(size_t n) : parent(n), rank(n, 0) {
+        for (size_t i = 0; i < n; ++i) parent[i] = static_cast<Index>(i);
+    }
+
+    Index find(Index u) {
+        Index root = u;
+        while (parent[root] != root) root = parent[root];
+        while (parent[u] != root) {  // Point the whole path at the root
+            Index next = parent[u];
+            parent[u] = root;
+            u = next;
+            PROFILE_COUNT(COMPRESSION_STEPS, 1);
+        }
+        return root;
+    }
+
+    /**
+     * Merges the sets of u and v.
+     * @return false if they were in the same set already.
+     */
+    bool unite(Index u, Index v) {
+        PROFILE_COUNT(FINDS, 2);
+        Index rootU = find(u), rootV = find(v);
+        if (rootU == rootV) return false;
+        PROFILE_COUNT(UNIONS, 1);
+        if (rank[rootU] < rank[rootV]) std::swap(rootU, rootV);
+        parent[rootV] = rootU;
+        if (rank[rootU] == rank[rootV]) rank[rootU]++;
+        return true;
+    }
+
+private:
+    std::vector<Index> parent;
+    std::vector<uint8_t> rank;  // At most log2(n)
+};
+
+/**
+ * Kruskal and Prim on EdgeArrays, compiled for each vertex index and weight type they are used
+ * with. Integer weights sort by radix on integer keys; floating-point weights by comparison, in
+ * parallel on a pool. Both kernels report progress to a JobControl and stop early once it is
+ * cancelled, leaving a partial MST. KruskalMST and PrimMST choose the instantiation for a graph.
+ */
+class MSTKernels {
+public:
+    /**
+     * Returns the positions of the edges ordered by weight, ties by position, so the order, and the
+     * MST, are the same with or without a pool.
+     * Integer weights of up to 32 bits: a stable LSD radix sort of (weight << 32 | position) keys over
+     * the weight bytes that differ between edges, usually two or three passes; the positions start in
+     * order and stay in order among equal weights. Other weights: a comparison sort of (weight, position)
+     * pairs, fork-join on the pool if one is given. The result is allocated after the sort buffers are
+     * freed, so it does not add to their peak.
+     */
+    template <typename Weight>
+    static std::vector<uint32_t> sortByWeight(const std::vector<Weight>& weights, ThreadPool* pool) {
+        size_t m = weights.size();
+        std::vector<uint32_t> order;
+        if constexpr (std::is_integral<Weight>::value) {
+            static_assert(sizeof(Weight) <= 4 && std::is_unsigned<Weight>::value, "keys hold 32-bit unsigned weights");
+            std::vector<uint64_t> keys(m), buffer(m);
+            uint64_t anyBits = 0, allBits = ~uint64_t(0);
+            for (size_t i = 0; i < m; ++i) {
+                keys[i] = uint64_t(weights[i]) << 32 | i;
+                anyBits |= keys[i];
+                allBits &= keys[i];
+            }
+            for (int shift = 32; shift < 64; shift += 8) {
+                if (((anyBits ^ allBits) >> shift & 0xFF) == 0) continue;  // Every key has the same byte here
+                size_t counts[257] = {};
+                for (uint64_t key : keys) counts[(key >> shift & 0xFF) + 1]++;
+                for (int digit = 0; digit < 256; ++digit) counts[digit + 1] += counts[digit];
+                for (uint64_t key : keys) buffer[counts[key >> shift & 0xFF]++] = key;
+                keys.swap(buffer);
+            }
+            std::vector<uint64_t>().swap(buffer);
+            order.resize(m);
+            for (size_t i = 0; i < m; ++i) order[i] = static_cast<uint32_t>(keys[i]);
+        } else {
+            std::vector<std::pair<Weight, uint32_t>> pairs(m);
+            for (size_t i = 0; i < m; ++i) pairs[i] = {weights[i], static_cast<uint32_t>(i)};
+            if (pool) {
+                pool->parallelSort(pairs.begin(), pairs.end(), std::less<std::pair<Weight, uint32_t>>());
+            } else {
+                std::sort(pairs.begin(), pairs.end());
+            }
+            order.resize(m);
+            for (size_t i = 0; i < m; ++i) order[i] = pairs[i].second;
+        }
+        return order;
+    }
+
+    /**
+     * Kruskal's algorithm on the vertices 1..n.
+     * @param mst - receives the MST edges in the order they were chosen
+     * @param pool - pool for the sort of floating-point weights, or nullptr
+     * @param control - progress and cancellation, or nullptr
+     * @return The total weight of the MST.
+     */
+    template <typename Index, typename Weight>
+    static double kruskal(Index n, const EdgeArrays<Index, Weight>& edges, EdgeArrays<Index, Weight>& mst, ThreadPool* pool,
+                          JobControl* control) {
+        mst.clear();
+        std::vector<uint32_t> order;
+        {
+            PROFILE_PHASE(SORT);
+            order = sortByWeight(edges.weight, pool);
+        }
+
+        PROFILE_PHASE(UNION_FIND);
+        DisjointSets<Index> sets(size_t(n) + 1);
+        mst.reserve(n > 0 ? n - 1 : 0);
+        double total = 0;
+        for (size_t i = 0; i < order.size(); ++i) {
+            if (control && i % JobControl::checkInterval == 0) {
+                if (control->cancelled()) break;
+                control->report(i, order.size());
+            }
+            uint32_t edge = order[i];
+            PROFILE_COUNT(EDGES_SCANNED, 1);
+            if (sets.unite(edges.from[edge], edges.to[edge])) {
+                total += edges.weight[edge];
+                mst.push(edges.from[edge], edges.to[edge], edges.weight[edge]);
+                if (mst.size() + 1 == n) break;  // Spanning: every later edge closes a cycle
+            }
+        }
+        return total;
+    }
+
+    /**
+     * Prim's algorithm from vertex 1, on the vertices 1..n; vertices outside the component of 1 are not
+     * reached. The edges are first laid out as adjacency arrays (CSR), which the heap loop scans
+     * sequentially.
+     * @param mst - receives an edge (parent, v) for each reached vertex v > 1, by ascending v
+     * @param control - progress and cancellation, or nullptr
+     * @return The total weight of the MST.
+     */
+    template <typename Index, typename Weight>
+    static double prim(Index n, const EdgeArrays<Index, Weight>& edges, EdgeArrays<Index, Weight>& mst, JobControl* control) {
+        mst.clear();
+        if (n < 1) return 0;
+        std::vector<size_t> offsets(size_t(n) + 2, 0);  // Neighbors of u are [offsets[u], offsets[u + 1])
+        std::vector<Index> targets(2 * edges.size());
+        std::vector<Weight> weights(2 * edges.size());
+        {
+            PROFILE_PHASE(GRAPH_BUILD);
+            for (size_t i = 0; i < edges.size(); ++i) {
+                offsets[edges.from[i] + 1]++;
+                offsets[edges.to[i] + 1]++;
+            }
+            for (size_t u = 1; u < offsets.size(); ++u) offsets[u] += offsets[u - 1];
+            std::vector<size_t> next(offsets.begin(), offsets.end() - 1);
+            for (size_t i = 0; i < edges.size(); ++i) {  // In edge order, like the adjacency lists of a Graph
+                size_t slot = next[edges.from[i]]++;
+                targets[slot] = edges.to[i];
+                weights[slot] = edges.weight[i];
+                slot = next[edges.to[i]]++;
+                targets[slot] = edges.from[i];
+                weights[slot] = edges.weight[i];
+            }
+        }
+        if (control && control->cancelled()) return 0;
+
+        PROFILE_PHASE(PRIM_SCAN);
+        const Weight unreached = std::numeric_limits<Weight>::max();
+        std::vector<bool> inTree(size_t(n) + 1, false);
+        std::vector<Weight> key(size_t(n) + 1, unreached);  // Lightest known edge into each vertex
+        std::vector<Index> parent(size_t(n) + 1, 0);        // Other end of that edge, 0 for none
+        key[1] = 0;
+
+        using Entry = std::pair<Weight, Index>;
+        std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> heap;
+        heap.push({0, 1});
+        PROFILE_COUNT(HEAP_PUSHES, 1);
+
+        double total = 0;
+        size_t pops = 0, added = 0;  // For the progress report
+        while (!heap.empty()) {
+            if (control && pops++ % JobControl::checkInterval == 0) {
+                if (control->cancelled()) break;
+                control->report(added, n);
+            }
+            auto [weight, u] = heap.top();
+            heap.pop();
+            PROFILE_COUNT(HEAP_POPS, 1);
+            if (inTree[u]) {
+                PROFILE_COUNT(STALE_POPS, 1);
+                continue;
+            }
+            inTree[u] = true;
+            added++;
+            total += weight;
+            for (size_t slot = offsets[u]; slot < offsets[u + 1]; ++slot) {
+                PROFILE_COUNT(EDGES_SCANNED, 1);
+                Index v = targets[slot];
+                if (!inTree[v] && weights[slot] < key[v]) {
+                    key[v] = weights[slot];
+                    parent[v] = u;
+                    heap.push({weights[slot], v});
+                    PROFILE_COUNT(HEAP_PUSHES, 1);
+                }
+            }
+        }
+
+        for (size_t v = 2; v <= size_t(n); ++v) {
+            if (parent[v] != 0) mst.push(parent[v], static_cast<Index>(v), key[v]);
+        }
+        return total;
+    }
+};
+
+#endif // MST_KERNELS_H
@@ -0,0 +1,160 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "LatencyHistogram.hpp"
+
+/**
+ * Latency histogram that any number of threads record into at once: the buckets of
+ * LatencyHistogram as relaxed atomic counters, so recording is a handful of uncontended atomic
+ * adds and never takes a lock. Readers take a snapshot while recording goes on; it may miss the
+ * values being recorded at that moment, which does not matter for monitoring.
+ */
+class AtomicHistogram {
+public:
+    AtomicHistogram()
+        : counts(new std::atomic<uint64_t>[LatencyHistogram::bucketCount]), total(0), sum(0), smallest(UINT64_MAX), largest(0) {
+        for (size_t i = 0; i < LatencyHistogram::bucketCount; ++i) counts[i].store(0, std::memory_order_relaxed);
+    }
+
+    AtomicHistogram(const AtomicHistogram&) = delete;
+    AtomicHistogram& operator=(const AtomicHistogram&) = delete;
+
+    /**
+     * Records one value, e.g. a latency in nanoseconds.
+     */
+    void record(uint64_t value) {
+        counts[LatencyHistogram::bucketOf(value)].fetch_add(1, std::memory_order_relaxed);
+        total.fetch_add(1, std::memory_order_relaxed);
+        sum.fetch_add(value, std::memory_order_relaxed);
+        // The extremes rarely change, so the compare-exchange loops almost never run
+        uint64_t seen = smallest.load(std::memory_order_relaxed);
+        while (value < seen && !smallest.compare_exchange_weak(seen, value, std::memory_order_relaxed)) {}
+        seen = largest.load(std::memory_order_relaxed);
+        while (value > seen && !largest.compare_exchange_weak(seen, value, std::memory_order_relaxed)) {}
+    }
+
+    /**
+     * Adds the values recorded so far to a histogram, e.g. to merge the shards of several threads.
+     */
+    void snapshot(LatencyHistogram& into) const {
+        if (count() == 0) return;  // Most shards never see most command types
+        std::vector<uint64_t> buckets(LatencyHistogram::bucketCount);
+        for (size_t i = 0; i < buckets.size(); ++i) buckets[i] = counts[i].load(std::memory_order_relaxed);
+        into.merge(buckets, sum.load(std::memory_order_relaxed), smallest.load(std::memory_order_relaxed),
+                   largest.load(std::memory_order_relaxed));
+    }
+
+    uint64_t count() const { return total.load(std::memory_order_relaxed); }
+
+private:
+    std::unique_ptr<std::atomic<uint64_t>[]> counts;  // One counter per bucket of LatencyHistogram
+    std::atomic<uint64_t> total, sum, smallest, largest;
+};
+
+/**
+ * Depth and waiting time of a queue: producers call enqueued() for each item they push and keep
+ * the returned time with the item, the consumer passes it to dequeued(). Lock-free.
+ */
+class QueueGauge {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    QueueGauge() : items(0), total(0) {}
+
+    /**
+     * Counts an item entering the queue.
+     * @return The time the item entered, to hand to dequeued().
+     */
+    Clock::time_point enqueued() {
+        items.fetch_add(1, std::memory_order_relaxed);
+        total.fetch_add(1, std::memory_order_relaxed);
+        return Clock::now();
+    }
+
+    /**
+     * Counts an item leaving the queue and records how long it waited.
+     */
+    void dequeued(Clock::time_point since) {
+        waits.record(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - since).count());
+        items.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    // Items in the queue now
+    size_t depth() const { return items.load(std::memory_order_relaxed); }
+
+    // Items that entered the queue since it was created
+    uint64_t enqueuedCount() const { return total.load(std::memory_order_relaxed); }
+
+    // Nanoseconds the items spent in the queue
+    const AtomicHistogram& waitTimes() const { return waits; }
+
+private:
+    std::atomic<size_t> items;
+    std::atomic<uint64_t> total;
+    AtomicHistogram waits;
+};
+
+/**
+ * Mutex that records how long threads wait for it and how long they hold it, in nanoseconds.
+ * An uncontended lock costs one clock read more than a std::mutex; a contended one two. It meets
+ * the Lockable requirements, so std::lock_guard and std::unique_lock work with it.
+ */
+class TimedMutex {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    TimedMutex() : contended(0) {}
+
+    TimedMutex(const TimedMutex&) = delete;
+    TimedMutex& operator=(const TimedMutex&) = delete;
+
+    void lock() {
+        if (mutex.try_lock()) {
+            acquired = Clock::now();
+            waits.record(0);
+            return;
+        }
+        Clock::time_point start = Clock::now();
+        mutex.lock();
+        acquired = Clock::now();
+        waits.record(std::chrono::duration_cast<std::chrono::nanoseconds>(acquired - start).count());
+        contended.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    bool try_lock() {
+        if (!mutex.try_lock()) return false;
+        acquired = Clock::now();
+        waits.record(0);
+        return true;
+    }
+
+    void unlock() {
+        uint64_t held = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - acquired).count();
+        mutex.unlock();
+        holds.record(held);
+    }
+
+    // Time from asking for the lock to getting it, one value per acquisition
+    const AtomicHistogram& waitTimes() const { return waits; }
+
+    // Time from getting the lock to releasing it
+    const AtomicHistogram& holdTimes() const { return holds; }
+
+    // Acquisitions that found the mutex locked and had to wait
+    uint64_t contendedCount() const { return contended.load(std::memory_order_relaxed); }
+
+private:
+    std::mutex mutex;
+    Clock::time_point acquired;  // When the holder got the lock, written and read by the holder only
+    AtomicHistogram waits, holds;
+    std::atomic<uint64_t> contended;
+};
+
+#endif // METRICS_H
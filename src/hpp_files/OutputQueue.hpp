@@ -0,0 +1,63 @@
+#ifndef OUTPUT_QUEUE_H
+#define OUTPUT_QUEUE_H
+
+#include "ResponseBuilder.hpp"
+#include "ResponseStream.hpp"
+#include <deque>
+#include <memory>
+
+/**
+ * Unsent output of a connection: complete responses and streamed responses, in request order.
+ * Streams are pulled one chunk at a time, only when everything queued before them was written,
+ * so a connection never holds more than about one chunk of a streamed response.
+ * Not thread-safe: the connection's output mutex guards it.
+ */
+class OutputQueue {
+public:
+    /**
+     * Queues a complete response, moving its chunks out of the builder.
+     */
+    void push(ResponseBuilder& response);
+
+    /**
+     * Queues a streamed response behind everything queued so far.
+     */
+    void push(std::unique_ptr<ResponseStream> stream);
+
+    /**
+     * Writes as much as the descriptor accepts, pulling chunks from the streams as it drains.
+     * @return DONE once everything was written, WOULD_BLOCK if the socket is full, FAILED on an error.
+     */
+    ResponseBuilder::WriteResult writeTo(int fd);
+
+    /**
+     * Describes the next output as iovecs for an asynchronous send, pulling the next chunk of a
+     * stream once everything queued before it was consumed.
+     * @return the number of iovecs filled, 0 once everything was sent.
+     */
+    int gather(iovec* iov, int max);
+
+    /**
+     * Drops the first bytes of the gathered output once an asynchronous send accepted them.
+     */
+    void consume(size_t written) { ready.consume(written); }
+
+    bool empty() const { return ready.empty() && streams.empty(); }
+
+    /**
+     * Drops all unsent output.
+     */
+    void clear();
+
+private:
+    // A streamed response and the output queued behind it
+    struct PendingStream {
+        std::unique_ptr<ResponseStream> stream;
+        ResponseBuilder after;
+    };
+
+    ResponseBuilder ready;               // Bytes to write before the first stream
+    std::deque<PendingStream> streams;   // Streams in order, usually empty
+};
+
+#endif // OUTPUT_QUEUE_H
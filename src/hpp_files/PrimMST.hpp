@@ -2,22 +2,37 @@
 #define PRIM_MST_H
 
 #include "Graph.hpp"
+#include "JobControl.hpp"
 #include <vector>  // Include vector for storing edges
 
 /**
  * Class that implements Prim's algorithm for finding the Minimum Spanning Tree (MST).
- * The MST edges are stored in the `mstEdges` vector.
+ * The MST edges are stored in the `mstEdges` vector. findMST() runs MSTKernels::prim on the edges
+ * converted to EdgeArrays, with 32-bit weights when every weight is a whole number that fits (see
+ * fitsUnsigned32()) and double weights otherwise.
  */
 class PrimMST {
 public:
     /**
-     * Constructor that initializes the PrimMST with a reference to the graph.
+     * Constructor that initializes the PrimMST with a copy of the edges of the graph.
      * @param g - reference to the graph object
+     * @param control - receives the progress of findMST() and may cancel it, or nullptr
      */
-    PrimMST(Graph& g) : g(g) {}
+    PrimMST(Graph& g, JobControl* control = nullptr) : PrimMST(g.getNumNodes(), g.getEdges(), control) {}
+
+    /**
+     * Constructor that takes the edge list of a graph, e.g. a snapshot copied under the graph's lock.
+     * The kernel lays the edges out as adjacency arrays itself, so no Graph has to be built for them.
+     * @param n - number of vertices; edges use the vertices 1..n
+     * @param edges - the edges with their weights
+     */
+    PrimMST(int n, std::vector<std::pair<std::pair<int, int>, double>> edges, JobControl* control = nullptr)
+        : n(n), edges(std::move(edges)), control(control) {}
 
     /**
      * Method to find the Minimum Spanning Tree (MST) using Prim's algorithm.
+     * If the control is cancelled, the method returns early with a partial MST.
+     * The edge list is converted and released, so the method runs once per object.
      * @return The total weight of the MST.
      */
     double findMST();
@@ -29,8 +44,16 @@ public:
     std::vector<std::pair<std::pair<int, int>, double>> getMSTEdges() const;
 
 private:
-    Graph& g;   // Reference to the graph
+    int n;   // Number of vertices
+    std::vector<std::pair<std::pair<int, int>, double>> edges;  // Edges of the graph, released by findMST()
+    JobControl* control;  // Progress and cancellation of a background job, may be nullptr
     std::vector<std::pair<std::pair<int, int>, double>> mstEdges;  // Vector to store MST edges
+
+    /**
+     * Runs the kernel on the edges stored with the given types.
+     */
+    template <typename Index, typename Weight>
+    double run();
 };
 
 #endif // PRIM_MST_H
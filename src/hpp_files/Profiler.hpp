@@ -0,0 +1,152 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include "ResponseBuilder.hpp"
+
+/**
+ * Profile of one command, run by the Profile command: the time the command took, the time spent in
+ * each phase of the MST kernels, counters of their hot loops and, on request, hardware counters.
+ * A Profiler is active on the thread that creates it until it is destroyed; the kernels report to
+ * the active Profiler of their thread through PROFILE_PHASE and PROFILE_COUNT. Those macros compile
+ * to nothing unless the server is built with MST_PROFILE (make profile), so normal builds carry no
+ * instrumentation and the profile then only holds the total time and the hardware counters.
+ * Work that the kernels fork to other pool threads, such as the parallel sort, counts toward its
+ * phase time but not toward the counters, which are per thread. Not thread-safe.
+ */
+class Profiler {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // Whether a command line asked to be profiled, and with hardware counters
+    enum Mode { OFF, ON, HARDWARE };
+
+    // Phases of the MST kernels that are timed
+    enum Phase {
+        EDGE_COPY,    // Copying the edge list of the graph into the arrays of a kernel
+        SORT,         // Kruskal's edge sort
+        UNION_FIND,   // Kruskal's scan of the sorted edges
+        GRAPH_BUILD,  // Building the adjacency arrays of an edge list, for Prim
+        PRIM_SCAN,    // Prim's heap loop
+        TREE_BUILD,   // Building the Tree of the MST edges
+        ALL_PAIRS,    // Floyd-Warshall index of the tree for distance queries
+        numPhases
+    };
+
+    // Events counted in the hot loops
+    enum Counter {
+        EDGES_SCANNED,      // Edges Kruskal took from the sorted list, adjacency entries Prim relaxed
+        FINDS,              // Union-find lookups
+        UNIONS,             // Sets merged
+        COMPRESSION_STEPS,  // Parent links shortened by path compression
+        HEAP_PUSHES,
+        HEAP_POPS,
+        STALE_POPS,         // Heap entries of vertices already in the tree
+        ALLOCATIONS,        // Calls of operator new on the profiled thread
+        ALLOCATED_BYTES,
+        numCounters
+    };
+
+    /**
+     * Starts profiling the calling thread.
+     * @param hardware - also count cycles, instructions, cache and branch misses with perf_event_open
+     */
+    explicit Profiler(bool hardware);
+    ~Profiler();
+
+    Profiler(const Profiler&) = delete;
+    Profiler& operator=(const Profiler&) = delete;
+
+    /**
+     * Returns the Profiler active on the calling thread, or nullptr.
+     */
+    static Profiler* active() { return current; }
+
+    void count(Counter counter, uint64_t events) { counters[counter] += events; }
+
+    void addPhase(Phase phase, Clock::duration time) {
+        phaseTimes[phase] += time;
+        phaseRuns[phase]++;
+    }
+
+    /**
+     * Stops the clock and the hardware counters and puts the profile in front of the response of the
+     * profiled command: a "Profile (N lines):" header and N lines, times in milliseconds.
+     */
+    void report(ResponseBuilder& response);
+
+    /**
+     * Returns true if operator new is counted, in servers built with MST_PROFILE.
+     */
+    static bool countsAllocations();
+
+    /**
+     * Returns the calls of operator new on every thread of the process since it started, 0 unless
+     * countsAllocations(). Stats reports it, so a client can count what a run of requests allocates
+     * from the read of each request to the send of its reply.
+     */
+    static uint64_t processAllocations();
+
+    /**
+     * Removes the optional "Profile " or "Profile hw " prefix from a command line, e.g. "Profile hw Kruskal".
+     * @return OFF if the line has no prefix and was left as it is.
+     */
+    static Mode strip(std::string& command);
+
+    /**
+     * Adds the time from its construction to its destruction to a phase of the active Profiler.
+     */
+    class PhaseTimer {
+    public:
+        explicit PhaseTimer(Phase phase) : profiler(active()), phase(phase) {
+            if (profiler) start = Clock::now();
+        }
+
+        ~PhaseTimer() {
+            if (profiler) profiler->addPhase(phase, Clock::now() - start);
+        }
+
+        PhaseTimer(const PhaseTimer&) = delete;
+        PhaseTimer& operator=(const PhaseTimer&) = delete;
+
+    private:
+        Profiler* profiler;
+        Phase phase;
+        Clock::time_point start;
+    };
+
+private:
+    static const int numHardwareCounters = 4;
+
+    static thread_local Profiler* current;
+
+    Profiler* previous;  // Profiler that was active on the thread before this one
+    Clock::time_point started;
+    Clock::duration elapsed;
+    bool stopped;
+    uint64_t counters[numCounters] = {};
+    Clock::duration phaseTimes[numPhases] = {};
+    uint64_t phaseRuns[numPhases] = {};
+    bool hardware;
+    int hardwareFds[numHardwareCounters];  // The first one leads the group, -1 if not opened
+    int hardwareError;  // errno of perf_event_open, 0 if the counters run
+    uint64_t hardwareValues[numHardwareCounters] = {};
+
+    void startHardware();
+    void stop();
+};
+
+#ifdef MST_PROFILE
+// Times the rest of the enclosing scope as a phase of the active Profiler; one per scope
+#define PROFILE_PHASE(phase) Profiler::PhaseTimer profilePhase(Profiler::phase)
+// Adds events to a counter of the active Profiler
+#define PROFILE_COUNT(counter, events) \
+    do { if (Profiler* activeProfiler = Profiler::active()) activeProfiler->count(Profiler::counter, events); } while (0)
+#else
+#define PROFILE_PHASE(phase) do {} while (0)
+#define PROFILE_COUNT(counter, events) do {} while (0)
+#endif
+
+#endif // PROFILER_H
@@ -0,0 +1,113 @@
+#ifndef RESPONSE_BUILDER_H
+#define RESPONSE_BUILDER_H
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <sys/uio.h>
+
+/**
+ * ResponseBuilder serializes a response into a chain of fixed-size chunks taken from a
+ * process-wide pool, formatting numbers with std::to_chars instead of temporary strings.
+ * The same object doubles as the output queue of a connection: finished responses are spliced
+ * onto it without copying, and writeTo() streams the chunks with one sendmsg, keeping whatever a
+ * non-blocking socket did not accept for the next call.
+ * Not thread-safe: a builder is used by one thread at a time.
+ */
+class ResponseBuilder {
+public:
+    static constexpr size_t chunkSize = 4096;  // Bytes per pooled chunk
+
+    // Outcome of writeTo()
+    enum WriteResult { DONE, WOULD_BLOCK, FAILED };
+
+    ResponseBuilder();
+    ~ResponseBuilder();
+
+    ResponseBuilder(ResponseBuilder&& other) noexcept;
+    ResponseBuilder& operator=(ResponseBuilder&& other) noexcept;
+    ResponseBuilder(const ResponseBuilder&) = delete;
+    ResponseBuilder& operator=(const ResponseBuilder&) = delete;
+
+    ResponseBuilder& operator<<(std::string_view text);
+    ResponseBuilder& operator<<(const char* text) { return *this << std::string_view(text); }
+    ResponseBuilder& operator<<(const std::string& text) { return *this << std::string_view(text); }
+    ResponseBuilder& operator<<(char c);
+    ResponseBuilder& operator<<(int value) { return *this << static_cast<long long>(value); }
+    ResponseBuilder& operator<<(long value) { return *this << static_cast<long long>(value); }
+    ResponseBuilder& operator<<(long long value);
+    ResponseBuilder& operator<<(unsigned value) { return *this << static_cast<unsigned long long>(value); }
+    ResponseBuilder& operator<<(unsigned long value) { return *this << static_cast<unsigned long long>(value); }
+    ResponseBuilder& operator<<(unsigned long long value);
+
+    /**
+     * Appends a double with six decimals, the format of std::to_string.
+     */
+    ResponseBuilder& operator<<(double value);
+
+    /**
+     * Appends a double with six significant digits, the default format of std::ostream.
+     */
+    ResponseBuilder& general(double value);
+
+    /**
+     * Moves the content of another builder to the end of this one, leaving the other empty.
+     * Whole chunks change hands, nothing is copied.
+     */
+    void splice(ResponseBuilder& other);
+
+    /**
+     * Writes as much as the socket accepts with a gathering sendmsg and drops the written bytes.
+     * @param fd - socket to write to, usually non-blocking; a closed peer fails the write without SIGPIPE
+     * @return DONE once the builder is empty, WOULD_BLOCK if the socket is full (call again when
+     *         it is writable), FAILED on any other error.
+     */
+    WriteResult writeTo(int fd);
+
+    /**
+     * Describes the unwritten bytes as iovecs for an asynchronous send, without dropping them.
+     * The described memory stays valid until consume() or clear(); appending to the builder does not move it.
+     * @param iov - array receiving the iovecs
+     * @param max - capacity of the array
+     * @return the number of iovecs filled, 0 if the builder is empty
+     */
+    int gather(iovec* iov, int max) const;
+
+    /**
+     * Drops the first bytes, after an asynchronous send of gathered iovecs accepted them.
+     */
+    void consume(size_t written);
+
+    /**
+     * Returns the number of bytes not written yet.
+     */
+    size_t size() const { return bytes; }
+
+    bool empty() const { return bytes == 0; }
+
+    /**
+     * Drops the content and returns the chunks to the pool.
+     */
+    void clear();
+
+    /**
+     * Returns a copy of the content.
+     */
+    std::string str() const;
+
+private:
+    struct Chunk {
+        size_t begin;  // First byte not written yet
+        size_t end;    // One past the last byte appended
+        char data[chunkSize];
+    };
+
+    std::vector<Chunk*> chunks;  // Chunks in order, the last one receives appends
+    size_t bytes;                // Bytes appended and not written yet
+
+    static Chunk* acquireChunk();
+    static void releaseChunk(Chunk* chunk);
+};
+
+#endif // RESPONSE_BUILDER_H
@@ -0,0 +1,80 @@
+#ifndef RESPONSE_STREAM_H
+#define RESPONSE_STREAM_H
+
+#include "ResponseBuilder.hpp"
+#include "Graph.hpp"
+#include "Tree.hpp"
+#include "Metrics.hpp"
+#include <memory>
+#include <mutex>
+
+/**
+ * A response produced lazily, one bounded chunk at a time.
+ * The I/O layer asks for the next chunk only once the socket accepted the previous one, so the
+ * memory held for a response does not depend on its total size.
+ */
+class ResponseStream {
+public:
+    static constexpr size_t chunkBytes = 64 * 1024;  // Approximate size of one chunk
+
+    virtual ~ResponseStream() = default;
+
+    /**
+     * Appends the next chunk of the response.
+     * @return false once the response is complete and nothing was appended.
+     */
+    virtual bool next(ResponseBuilder& out) = 0;
+};
+
+/**
+ * Streams the adjacency lines of a range of vertices of a graph.
+ * Each chunk is produced under the graph mutex. If the graph is modified while the response is
+ * streaming, the stream ends with a notice instead of mixing two versions of the graph.
+ */
+class GraphPrintStream : public ResponseStream {
+public:
+    /**
+     * @param graph - the graph, kept alive until the stream is done
+     * @param graphMutex - mutex guarding modifications of the graph
+     * @param first - first vertex to print
+     * @param last - one past the last vertex to print
+     */
+    GraphPrintStream(std::shared_ptr<const Graph> graph, TimedMutex& graphMutex, int first, int last);
+
+    bool next(ResponseBuilder& out) override;
+
+private:
+    std::shared_ptr<const Graph> graph;
+    TimedMutex& graphMutex;
+    uint64_t version;  // Version of the graph when the response started
+    int vertex;        // Next vertex to print
+    int last;
+};
+
+/**
+ * Streams a range of the edges of an MST in the format of the Kruskal and Prim replies.
+ * MST trees are immutable, so no lock is needed; the tree is kept alive until the stream is done.
+ */
+class EdgeListStream : public ResponseStream {
+public:
+    /**
+     * @param tree - the MST
+     * @param first - index of the first edge to print
+     * @param last - one past the index of the last edge to print
+     */
+    EdgeListStream(std::shared_ptr<const Tree> tree, size_t first, size_t last);
+
+    bool next(ResponseBuilder& out) override;
+
+    /**
+     * Appends the edges [first, last) of a tree, the formatting shared by the stream and inline replies.
+     */
+    static void printEdges(ResponseBuilder& out, const Tree& tree, size_t first, size_t last);
+
+private:
+    std::shared_ptr<const Tree> tree;
+    size_t edge;  // Next edge to print
+    size_t last;
+};
+
+#endif // RESPONSE_STREAM_H
@@ -0,0 +1,81 @@
+#ifndef RING_QUEUE_H
+#define RING_QUEUE_H
+
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+/**
+ * FIFO queue on a circular buffer that only grows.
+ * std::queue (std::deque) frees and reallocates its blocks as items pass through; this queue
+ * keeps its buffer, so a queue that has reached its working size never allocates again.
+ * T must be default constructible and move assignable. Not thread-safe.
+ */
+template <typename T>
+class RingQueue {
+public:
+    explicit RingQueue(size_t capacity = 16) : head(0), count(0) {
+        size_t size = 1;
+        while (size < capacity) size *= 2;
+        mask = size - 1;
+        slots.reset(new T[size]);
+    }
+
+    RingQueue(RingQueue&&) = default;
+    RingQueue& operator=(RingQueue&&) = default;
+
+    bool empty() const { return count == 0; }
+    size_t size() const { return count; }
+
+    /**
+     * Appends an item, doubling the buffer if it is full.
+     */
+    void push(T item) {
+        if (count > mask) grow();
+        slots[(head + count) & mask] = std::move(item);
+        count++;
+    }
+
+    /**
+     * Inserts an item before the oldest one, so it is taken next, doubling the buffer if it is full.
+     */
+    void pushFront(T item) {
+        if (count > mask) grow();
+        head = (head + mask) & mask;  // One slot back
+        slots[head] = std::move(item);
+        count++;
+    }
+
+    /**
+     * Returns the oldest item. The queue must not be empty.
+     */
+    T& front() { return slots[head]; }
+
+    /**
+     * Removes the oldest item. The queue must not be empty.
+     */
+    void pop() {
+        slots[head] = T(); // Release what the item holds now, not when the slot is reused
+        head = (head + 1) & mask;
+        count--;
+    }
+
+private:
+    std::unique_ptr<T[]> slots;
+    size_t mask;   // Capacity - 1, the capacity is a power of two
+    size_t head;   // Slot of the oldest item
+    size_t count;  // Number of queued items
+
+    void grow() {
+        size_t capacity = (mask + 1) * 2;
+        std::unique_ptr<T[]> bigger(new T[capacity]);
+        for (size_t i = 0; i < count; ++i) {
+            bigger[i] = std::move(slots[(head + i) & mask]);
+        }
+        slots = std::move(bigger);
+        mask = capacity - 1;
+        head = 0;
+    }
+};
+
+#endif // RING_QUEUE_H
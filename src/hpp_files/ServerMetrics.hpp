@@ -0,0 +1,116 @@
+#ifndef SERVER_METRICS_H
+#define SERVER_METRICS_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+#include "Metrics.hpp"
+#include "ResponseBuilder.hpp"
+
+/**
+ * Live metrics of a server, reported by the Stats command as text or in the Prometheus text format.
+ * Command latencies go into per-thread shards of histograms, one per command type, so recording
+ * never takes a lock and threads do not share cache lines; a report merges the shards. Queue and
+ * lock metrics are read from the QueueGauges and TimedMutexes registered at startup, and gauges
+ * that belong to the server, such as the size of the graph, are passed in with each report.
+ * Recording is thread-safe; queues and locks are registered before the server takes requests.
+ */
+class ServerMetrics {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // Kinds of request lines, each with its own latency histogram
+    enum CommandType {
+        NEW_GRAPH, GENERATE_GRAPH, APPLY_BATCH, CONTINUATION, NEW_EDGE, REMOVE_EDGE, UPDATE_WEIGHT,
+        KRUSKAL, PRIM, MST_WEIGHT, LONGEST_DISTANCE, AVERAGE_DISTANCE, SHORTEST_PATH, PRINT_GRAPH,
+        ASYNC, JOB_STATUS, JOB_RESULT, CANCEL_JOB, STATS, TRACE_DUMP, TRACE, EXIT, SHED, INVALID, numCommandTypes
+    };
+
+    // State of the server at the time of a report
+    struct Gauges {
+        size_t inFlight = 0;    // Admitted commands not answered yet
+        uint64_t shed = 0;      // Commands answered with BUSY since the start
+        int vertices = 0;       // Size of the current graph, 0 without one
+        size_t edges = 0;
+        size_t graphBytes = 0;  // Graph::memoryUsage() of the current graph
+        size_t mstBytes = 0;    // Tree::memoryUsage() of the cached MST, 0 without one
+        bool allocationsCounted = false;  // The server counts its heap allocations (make profile)
+        uint64_t allocations = 0;         // Calls of operator new in the process since the start
+    };
+
+    ServerMetrics();
+    ~ServerMetrics();
+
+    ServerMetrics(const ServerMetrics&) = delete;
+    ServerMetrics& operator=(const ServerMetrics&) = delete;
+
+    /**
+     * Returns the type of a request line, without its "Deadline ms " prefix.
+     * @param continuation - the line continues a NewGraph or ApplyBatch, as an edge or an operation
+     */
+    static CommandType commandType(const std::string& command, bool continuation);
+
+    /**
+     * Returns the name of a command type as it appears in the reports, e.g. "Kruskal".
+     */
+    static const char* commandName(CommandType type);
+
+    /**
+     * Records a command whose response was queued now, `received` being when its line was read.
+     * Lock-free: the value goes to the calling thread's shard.
+     */
+    void recordCommand(CommandType type, Clock::time_point received);
+
+    /**
+     * Adds a queue to the reports, e.g. "pool_light". The gauge must outlive this object.
+     */
+    void addQueue(const std::string& name, const QueueGauge& gauge);
+
+    /**
+     * Adds a lock to the reports, e.g. "graph". The mutex must outlive this object.
+     */
+    void addLock(const std::string& name, const TimedMutex& mutex);
+
+    /**
+     * Appends the text report: a "Stats (N lines):" header followed by N lines, so clients know
+     * where the response ends. Latencies are in microseconds.
+     */
+    void report(ResponseBuilder& out, const Gauges& gauges) const;
+
+    /**
+     * Appends the report in the Prometheus text exposition format, after a comment line
+     * "# Stats prometheus: N lines follow" that a scraper ignores. Times are in seconds and
+     * histograms are summaries with the 0.5, 0.9, 0.99 and 0.999 quantiles.
+     */
+    void reportPrometheus(ResponseBuilder& out, const Gauges& gauges) const;
+
+private:
+    struct Shard;
+    struct ShardLease;
+
+    Clock::time_point started;
+    mutable std::mutex shardsMutex;  // Guards shards and freeShards, not the histograms in them
+    std::vector<std::unique_ptr<Shard>> shards;  // Every shard ever handed to a thread
+    std::vector<Shard*> freeShards;  // Shards of threads that exited, reused by new threads
+    std::vector<std::pair<std::string, const QueueGauge*>> queues;
+    std::vector<std::pair<std::string, const TimedMutex*>> locks;
+
+    static thread_local ShardLease lease;  // The calling thread's shard
+
+    /**
+     * Returns the shard of the calling thread, taking one on its first call.
+     */
+    Shard& localShard();
+
+    /**
+     * Merges the latencies of a command type over all shards.
+     */
+    LatencyHistogram commandLatencies(CommandType type) const;
+};
+
+#endif // SERVER_METRICS_H
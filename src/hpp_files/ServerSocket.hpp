@@ -0,0 +1,66 @@
+#ifndef SERVER_SOCKET_H
+#define SERVER_SOCKET_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/**
+ * Command line settings shared by both servers.
+ */
+struct ServerOptions {
+    int port = 9034;         // TCP port to listen on
+    size_t threads = 0;      // Worker threads (LFServer) or stage replicas (pipelineServer), 0: server default
+    size_t reactors = 0;     // Reactor threads with their own listener, 0: no reactors (LFServer only)
+    size_t heavy = 0;        // Commands that may rebuild the MST running at once, 0: server default (1)
+    size_t queue = 0;        // Commands admitted (queued or running) at once, 0: server default (512)
+    size_t inflight = 0;     // Commands in flight per connection before its reads stop, 0: server default (32)
+    bool ioUring = false;    // Socket I/O through io_uring
+    std::string unixPath;    // Unix domain socket for local clients, /tmp/mst-server-<port>.sock by default
+    std::string shmPath;     // Handshake socket of the shared-memory channels, /tmp/mst-server-<port>.shm by default
+    unsigned trace = 0;      // Trace one request in N, 0: tracing off until a Trace command
+    std::string tracePath;   // File TraceDump writes, /tmp/mst-server-<port>.trace.json by default
+};
+
+/**
+ * Helpers for setting up the listening sockets and threads of the servers.
+ */
+class ServerSocket {
+public:
+    // Pending connections the kernel queues per listener before accept
+    static const int backlog = 1024;
+
+    /**
+     * Parses --port P, --threads N, --heavy N, --queue N, --inflight N, --reactors N, --io-uring, --unix PATH, --shm PATH, --trace N and --trace-file PATH, printing the usage on errors.
+     * @param reactorsSupported - false for servers without a reactor mode, which reject --reactors
+     * @return false if the arguments are invalid.
+     */
+    static bool parseOptions(int argc, char* argv[], ServerOptions& options, bool reactorsSupported);
+
+    /**
+     * Creates a TCP socket listening on the port of all interfaces.
+     * @param reusePort - sets SO_REUSEPORT, so several sockets can listen on the same port and the
+     *                    kernel spreads the incoming connections over them
+     * @return the socket, or -1 after printing an error.
+     */
+    static int listenOn(int port, bool reusePort);
+
+    /**
+     * Creates a Unix domain stream socket listening at path, replacing a socket file left behind.
+     * @return the socket, or -1 after printing an error.
+     */
+    static int listenOnUnix(const std::string& path);
+
+    /**
+     * Returns the CPUs the process may run on, in ascending order.
+     */
+    static std::vector<int> availableCpus();
+
+    /**
+     * Restricts the calling thread to one CPU.
+     * @return false if the affinity could not be set; the thread keeps running unpinned.
+     */
+    static bool pinCurrentThread(int cpu);
+};
+
+#endif // SERVER_SOCKET_H
@@ -0,0 +1,129 @@
+#ifndef SHM_CHANNEL_H
+#define SHM_CHANNEL_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <sys/uio.h>
+
+/**
+ * A request/response channel between a local client and the server in one shared memory region:
+ * two single-producer single-consumer byte rings carrying the same text protocol as the sockets.
+ * Each side has a doorbell, a futex word the other side increments after it wrote data or freed
+ * space; a side with nothing to do spins briefly and then sleeps on its doorbell, and is only woken
+ * by a futex call when it announced that it sleeps. A busy exchange makes no system calls at all.
+ *
+ * The client creates the region (a memfd) and hands it to the server over a Unix domain socket,
+ * which stays open for the lifetime of the channel so either side notices when the other exits.
+ * A ShmChannel is a handle private to one process: the ring capacity and the size of the mapping are
+ * validated once and kept in the handle, since the peer can overwrite anything in the region.
+ */
+class ShmChannel {
+public:
+    enum Side { CLIENT = 0, SERVER = 1 };
+    enum Stream { REQUESTS = 0, RESPONSES = 1 };  // Written by the client and the server respectively
+
+    static const size_t defaultCapacity = 1 << 20;  // Bytes per ring
+
+    /**
+     * Creates a region with two rings of `capacity` bytes (rounded up to a power of two).
+     * @param fd - receives the memfd of the region, to be passed to the server
+     * @return the channel, or nullptr if the region could not be created.
+     */
+    static ShmChannel* create(size_t capacity, int& fd);
+
+    /**
+     * Maps a region created by a client. The descriptor can be closed afterwards.
+     * @return the channel, or nullptr if the region is not a valid channel.
+     */
+    static ShmChannel* attach(int fd);
+
+    /**
+     * Unmaps the region and deletes the handle; the channel must not be used afterwards.
+     */
+    void detach();
+
+    /**
+     * Copies as much of the iovecs as the ring has room for and publishes it.
+     * Only one thread at a time may write a stream.
+     * @return the number of bytes written.
+     */
+    size_t write(Stream stream, const iovec* iov, int count);
+
+    /**
+     * Copies up to `max` bytes out of the ring and frees their space.
+     * @return the number of bytes read, 0 if the ring is empty.
+     */
+    size_t read(Stream stream, char* buffer, size_t max);
+
+    /**
+     * Returns true if the ring holds unread bytes.
+     */
+    bool readable(Stream stream) const;
+
+    /**
+     * Returns true if the ring has room for more bytes.
+     */
+    bool writable(Stream stream) const;
+
+    /**
+     * Returns the doorbell of a side, to be passed to wait() after checking the rings.
+     */
+    uint32_t doorbell(Side side) const;
+
+    /**
+     * Rings the doorbell of a side after writing to or reading from a ring it waits for.
+     */
+    void notify(Side side);
+
+    /**
+     * Sleeps until the doorbell of `self` moves away from `seen` or the timeout (milliseconds) expires.
+     */
+    void wait(Side self, uint32_t seen, int timeoutMs);
+
+    /**
+     * Marks the channel closed by one side and wakes the other.
+     */
+    void close();
+
+    /**
+     * Returns true once a side closed the channel.
+     */
+    bool closed() const;
+
+private:
+    // Positions run freely and wrap at 2^32; the capacity is a power of two, so they index by masking
+    struct alignas(64) Ring {
+        std::atomic<uint32_t> head;  // Next byte to read, advanced by the consumer
+        alignas(64) std::atomic<uint32_t> tail;  // Next byte to write, advanced by the producer
+    };
+
+    struct alignas(64) Bell {
+        std::atomic<uint32_t> rings;     // Futex word
+        std::atomic<uint32_t> sleeping;  // Set while the side may be waiting on the futex
+    };
+
+    // Layout of the shared region, followed by the request ring and then the response ring
+    struct Header {
+        uint32_t magic;
+        uint32_t capacity;  // Only read by attach(), which validates it
+        std::atomic<uint32_t> isClosed;
+        Bell bells[2];
+        Ring rings[2];
+    };
+
+    Header* header;   // Start of the mapping
+    char* buffers;    // First byte after the header
+    size_t capacity;  // Bytes per ring, a power of two
+    uint32_t mask;    // capacity - 1
+    size_t size;      // Bytes mapped
+
+    ShmChannel(void* region, size_t capacity, size_t size);
+    ShmChannel(const ShmChannel&) = delete;
+    ShmChannel& operator=(const ShmChannel&) = delete;
+
+    char* data(Stream stream);
+    static size_t regionSize(size_t capacity);
+};
+
+#endif // SHM_CHANNEL_H
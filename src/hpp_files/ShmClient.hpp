@@ -0,0 +1,53 @@
+#ifndef SHM_CLIENT_H
+#define SHM_CLIENT_H
+
+#include <cstddef>
+#include <string>
+#include "ShmChannel.hpp"
+
+/**
+ * Client side of a shared-memory channel to a server on the same host (see ShmTransport).
+ * Commands and responses use the same text protocol as the TCP and Unix sockets.
+ * An instance is used by one thread at a time.
+ */
+class ShmClient {
+public:
+    ShmClient();
+    ~ShmClient();
+
+    ShmClient(const ShmClient&) = delete;
+    ShmClient& operator=(const ShmClient&) = delete;
+
+    /**
+     * Creates a channel with rings of `capacity` bytes and hands it to the server listening on `path`.
+     * @return false if the server could not be reached or rejected the channel.
+     */
+    bool connect(const std::string& path, size_t capacity = ShmChannel::defaultCapacity);
+
+    /**
+     * Queues commands (newline terminated) for the server, waiting while the request ring is full.
+     * @return false if the channel is closed.
+     */
+    bool send(const std::string& text);
+
+    /**
+     * Waits for response bytes and copies up to `max` of them into buffer.
+     * @param timeoutMs - longest wait in milliseconds, negative to wait as long as the server lives
+     * @return the number of bytes received, 0 on timeout or when the channel is closed.
+     */
+    size_t receive(char* buffer, size_t max, int timeoutMs = -1);
+
+    /**
+     * Closes the channel; the server drops output that was not received yet.
+     */
+    void close();
+
+private:
+    int socket;
+    ShmChannel* channel;
+
+    // Sleeps until the client doorbell moves from `seen` or the timeout expires; returns false if the server is gone
+    bool waitForServer(uint32_t seen, int timeoutMs);
+};
+
+#endif // SHM_CLIENT_H
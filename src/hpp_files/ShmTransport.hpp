@@ -0,0 +1,93 @@
+#ifndef SHM_TRANSPORT_H
+#define SHM_TRANSPORT_H
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include "ConnectionHandler.hpp"
+#include "ShmChannel.hpp"
+
+/**
+ * Serves local clients over shared-memory channels (see ShmChannel).
+ * A client connects to a Unix domain socket and passes the memfd of its channel with SCM_RIGHTS;
+ * the connection is then identified by that socket, which the transport keeps open until close().
+ *
+ * Each channel has a session thread that sleeps on the server doorbell, hands the requests to the
+ * handler and copies the connection's output into the response ring. send() only flags the output
+ * and rings the doorbell, so it may be called while the server holds the locks gather() takes.
+ * While output does not fit into the ring, requests are not read (the same backpressure as the sockets);
+ * the server can also hold back reading with pauseReading().
+ */
+class ShmTransport {
+public:
+    explicit ShmTransport(ConnectionHandler& handler);
+    ~ShmTransport();
+
+    ShmTransport(const ShmTransport&) = delete;
+    ShmTransport& operator=(const ShmTransport&) = delete;
+
+    /**
+     * Listens for channel handshakes on a Unix domain socket at `path`, replacing a stale socket file.
+     * @return false if the socket could not be created.
+     */
+    bool start(const std::string& path);
+
+    /**
+     * Requests a copy of the connection's output into its response ring. May be called from any thread,
+     * but not after close(fd).
+     */
+    void send(int fd);
+
+    /**
+     * Closes a channel once its queued output was handed to the client, then calls ConnectionHandler::closed().
+     */
+    void close(int fd);
+
+    /**
+     * Stops reading the connection's requests until resumeReading(). May be called from any thread,
+     * also from ConnectionHandler::received().
+     */
+    void pauseReading(int fd);
+
+    /**
+     * Reads the connection's requests again after pauseReading(). May be called from any thread.
+     */
+    void resumeReading(int fd);
+
+private:
+    struct Session {
+        int fd;                       // Handshake socket, identifies the connection
+        ShmChannel* channel;          // Unmapped when the session ends, under sessionsMutex
+        std::atomic<bool> pending;    // send() was called since the session thread last copied output
+        std::atomic<bool> closing;    // close() was requested
+        std::atomic<bool> finished;   // The session thread is done
+        std::atomic<bool> throttled;  // pauseReading() was called
+        std::thread thread;
+        Session(int fd, ShmChannel* channel)
+            : fd(fd), channel(channel), pending(false), closing(false), finished(false), throttled(false) {}
+    };
+
+    ConnectionHandler& handler;
+    int listenSocket;
+    std::string path;
+    std::atomic<bool> stopFlag;
+    std::thread acceptor;
+
+    std::mutex sessionsMutex;  // Guards sessions and keeps a session's channel mapped while held
+    std::unordered_map<int, std::unique_ptr<Session>> sessions;  // By handshake socket
+
+    void acceptLoop();
+    void serve(Session& session);
+
+    // Copies output into the response ring; session thread only.
+    // @return false if some output did not fit.
+    bool flush(Session& session);
+
+    // Flags the session and rings its doorbell
+    void signal(int fd, bool closing);
+};
+
+#endif // SHM_TRANSPORT_H
@@ -0,0 +1,59 @@
+#ifndef SLAB_POOL_H
+#define SLAB_POOL_H
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/**
+ * Pool of reusable objects allocated in slabs.
+ * acquire() hands out an object from the free list and release() puts it back without destroying
+ * it, so the buffers an object owns (strings, vectors) keep their capacity from one use to the next.
+ * The heap is only touched when all objects are in use and a new slab is needed.
+ * Objects live as long as the pool. Thread-safe.
+ */
+template <typename T>
+class SlabPool {
+public:
+    /**
+     * @param slabSize - number of objects allocated at once when the pool runs dry
+     */
+    explicit SlabPool(size_t slabSize = 8) : slabSize(slabSize) {}
+
+    SlabPool(const SlabPool&) = delete;
+    SlabPool& operator=(const SlabPool&) = delete;
+
+    /**
+     * Returns a free object in the state its last user left it in.
+     */
+    T* acquire() {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (freeList.empty()) {
+            slabs.emplace_back(new T[slabSize]);
+            freeList.reserve(slabs.size() * slabSize); // release() never reallocates
+            for (size_t i = 0; i < slabSize; ++i) {
+                freeList.push_back(&slabs.back()[i]);
+            }
+        }
+        T* object = freeList.back();
+        freeList.pop_back();
+        return object;
+    }
+
+    /**
+     * Returns an object obtained from acquire() to the pool.
+     */
+    void release(T* object) {
+        std::lock_guard<std::mutex> lock(mutex);
+        freeList.push_back(object);
+    }
+
+private:
+    size_t slabSize;
+    std::mutex mutex;
+    std::vector<std::unique_ptr<T[]>> slabs;  // Every object ever allocated
+    std::vector<T*> freeList;                 // Objects not in use, most recently released last
+};
+
+#endif // SLAB_POOL_H
@@ -0,0 +1,113 @@
+#ifndef TASK_H
+#define TASK_H
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+/**
+ * Move-only type-erased void() callable with small-buffer optimization.
+ * Callables of up to inlineSize bytes (a few pointers, which covers every task the servers
+ * enqueue) are stored inside the Task itself, so creating, queueing and running a task does not
+ * touch the heap. Larger callables fall back to a single heap allocation.
+ * Unlike std::function, the callable does not need to be copyable.
+ */
+class Task {
+public:
+    static constexpr size_t inlineSize = 48;  // Bytes available for an inline callable
+
+    Task() noexcept : ops(nullptr) {}
+
+    template <typename F, typename = std::enable_if_t<!std::is_same<std::decay_t<F>, Task>::value>>
+    Task(F&& fn) {
+        using Fn = std::decay_t<F>;
+        if constexpr (fitsInline<Fn>()) {
+            new (storage) Fn(std::forward<F>(fn));
+            ops = &inlineOps<Fn>;
+        } else {
+            *reinterpret_cast<Fn**>(storage) = new Fn(std::forward<F>(fn));
+            ops = &heapOps<Fn>;
+        }
+    }
+
+    Task(Task&& other) noexcept : ops(other.ops) {
+        if (ops) {
+            ops->move(storage, other.storage);
+            other.ops = nullptr;
+        }
+    }
+
+    Task& operator=(Task&& other) noexcept {
+        if (this != &other) {
+            reset();
+            ops = other.ops;
+            if (ops) {
+                ops->move(storage, other.storage);
+                other.ops = nullptr;
+            }
+        }
+        return *this;
+    }
+
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+
+    ~Task() { reset(); }
+
+    /**
+     * Runs the callable. The task must not be empty.
+     */
+    void operator()() { ops->invoke(storage); }
+
+    /**
+     * Returns true if the task holds a callable.
+     */
+    explicit operator bool() const noexcept { return ops != nullptr; }
+
+    /**
+     * Destroys the callable, leaving the task empty.
+     */
+    void reset() noexcept {
+        if (ops) {
+            ops->destroy(storage);
+            ops = nullptr;
+        }
+    }
+
+private:
+    // Operations of one callable type, shared by all tasks holding that type
+    struct Ops {
+        void (*invoke)(void* storage);
+        void (*move)(void* destination, void* source);  // Leaves the source destroyed
+        void (*destroy)(void* storage);
+    };
+
+    template <typename Fn>
+    static constexpr bool fitsInline() {
+        return sizeof(Fn) <= inlineSize && alignof(Fn) <= alignof(std::max_align_t) &&
+               std::is_nothrow_move_constructible<Fn>::value;
+    }
+
+    template <typename Fn>
+    static constexpr Ops inlineOps = {
+        [](void* storage) { (*static_cast<Fn*>(storage))(); },
+        [](void* destination, void* source) {
+            new (destination) Fn(std::move(*static_cast<Fn*>(source)));
+            static_cast<Fn*>(source)->~Fn();
+        },
+        [](void* storage) { static_cast<Fn*>(storage)->~Fn(); },
+    };
+
+    template <typename Fn>
+    static constexpr Ops heapOps = {
+        [](void* storage) { (**static_cast<Fn**>(storage))(); },
+        [](void* destination, void* source) { *static_cast<Fn**>(destination) = *static_cast<Fn**>(source); },
+        [](void* storage) { delete *static_cast<Fn**>(storage); },
+    };
+
+    alignas(std::max_align_t) unsigned char storage[inlineSize];
+    const Ops* ops;  // nullptr for an empty task
+};
+
+#endif // TASK_H
@@ -1,4 +1,4 @@
-#ifndef THREADPOOL_H 
+#ifndef THREADPOOL_H
 #define THREADPOOL_H
 
 #include <iostream>
@@ -9,50 +9,261 @@
 #include <condition_variable>
 #include <functional>
 #include <atomic>
+#include <memory>
+#include <algorithm>
 #include <unordered_map>
+#include "WorkStealingDeque.hpp"
+#include "RingQueue.hpp"
+#include "Task.hpp"
+#include "Metrics.hpp"
 
 using namespace std;
 
+class TaskGroup;
+
 /**
- * ThreadPool class that manages a pool of worker threads to execute tasks asynchronously.
+ * ThreadPool class that manages a pool of worker threads following the Leader-Follower pattern.
+ * One idle thread at a time (the leader) waits on the event source; when an event arrives it
+ * promotes a follower to leader and then processes the event itself.
+ * Tasks are grouped in strands: tasks of the same strand run one at a time in FIFO order, while a
+ * busy strand's tasks wait in it without occupying a thread.
+ *
+ * Every task has a cost class. A ready strand waits in the queue of the class of its next task,
+ * and the queues are served by weighted round robin, so cheap tasks do not queue behind expensive
+ * ones and expensive ones still get their share. At most heavyLimit HEAVY tasks run at a time,
+ * which keeps threads free for the other classes.
+ *
+ * Fine-grained parallel work (TaskGroup, parallelFor, parallelSort) does not go through the
+ * strands: each worker keeps its own work-stealing deque, pushes the jobs it forks there, and
+ * idle workers steal from the other deques, so parallel kernels never serialize on queueMutex.
+ *
+ * Tasks are move-only Task objects with inline storage and the strand queues keep their buffers,
+ * so enqueueing a command with a small capture does not allocate once the pool is warmed up.
+ * Each class has a QueueGauge with the number of its tasks waiting and how long they waited.
  */
 class ThreadPool {
 public:
+    using EventWaiter = function<int()>;      // Blocks until an event is ready and returns its handle (negative: none)
+    using EventHandler = function<void(int)>; // Processes the event handle returned by the waiter
+
+    // Expected cost of a strand task, from lookups to full recomputations
+    enum TaskClass { LIGHT, NORMAL, HEAVY };
+
     /**
      * Constructor that creates a thread pool with the specified number of threads.
+     * Without an event source the threads only run enqueued tasks.
      * @param numThreads - Number of threads to be created in the pool.
      */
     ThreadPool(size_t numThreads);
 
+    /**
+     * Constructor that creates a Leader-Follower thread pool around an event source.
+     * @param numThreads - Number of threads to be created in the pool.
+     * @param waitEvent - Called by the leader to wait for the next event.
+     * @param handleEvent - Called with the event after a new leader was promoted.
+     */
+    ThreadPool(size_t numThreads, EventWaiter waitEvent, EventHandler handleEvent);
+
     /**
      * Destructor that joins all threads and cleans up resources.
      */
     ~ThreadPool();
 
     /**
-     * Method to enqueue a task into the thread pool.
+     * Method to enqueue a task into a strand.
+     * @param strandId - Tasks with the same strandId never run concurrently and keep their order.
      * @param task - A function representing the task to be executed.
+     * @param taskClass - Cost class, selects the queue the strand waits in while this task is next.
+     */
+    void enqueue(int strandId, Task task, TaskClass taskClass = NORMAL);
+
+    /**
+     * Puts a task at the front of a strand, so it runs before the strand's other pending tasks.
+     * Only called by the task of that strand that is running now: the work continues in another
+     * class, e.g. a LIGHT lookup that found it has to recompute continues as HEAVY, under heavyLimit.
+     * @param strandId - The strand of the calling task.
+     * @param task - The continuation.
+     * @param taskClass - Cost class of the continuation.
+     */
+    void enqueueNext(int strandId, Task task, TaskClass taskClass);
+
+    /**
+     * Sets how many HEAVY tasks may run at the same time (1 by default, at least 1).
+     */
+    void setHeavyLimit(size_t limit);
+
+    /**
+     * Runs body(chunkBegin, chunkEnd) over [begin, end) split into chunks of at most `grain` items,
+     * in parallel on the pool. The calling thread takes part and returns when every chunk is done.
+     * The body must not block on locks held by other pool tasks.
+     */
+    void parallelFor(size_t begin, size_t end, size_t grain, const function<void(size_t, size_t)>& body);
+
+    /**
+     * Sorts [first, last) with a fork-join merge sort on the pool.
+     * Ranges of at most `grain` elements are sorted sequentially with std::sort.
      */
-    void enqueue(int graphId, function<void()> task);
+    template <typename RandomIt, typename Compare>
+    void parallelSort(RandomIt first, RandomIt last, Compare comp, size_t grain = 1 << 14);
+
+    /**
+     * Returns the number of worker threads.
+     */
+    size_t size() const { return workers.size(); }
+
+    /**
+     * Returns the depth and waiting times of the strand tasks of a class, from enqueue() to their start.
+     */
+    const QueueGauge& queueStats(TaskClass taskClass) const { return queueGauges[taskClass]; }
 
     /**
      * Method to stop all threads in the pool.
-     * Ensures that no more tasks are processed once the pool is stopped.
+     * Queued tasks are still executed. A leader blocked in the event source only notices the
+     * stop request once waitEvent returns.
      */
     void stop();
 
 private:
+    friend class TaskGroup;
+
+    // A strand task, its cost class and when it was enqueued
+    struct Pending {
+        Task task;
+        TaskClass taskClass = NORMAL;
+        QueueGauge::Clock::time_point queued;
+    };
+
+    // Serial queue of tasks, e.g. the commands of one connection
+    struct Strand {
+        RingQueue<Pending> tasks;  // Pending tasks in arrival order
+        bool scheduled = false;    // True while the strand is in a ready queue or running
+    };
+
+    static const int numClasses = HEAVY + 1;
+
+    // A fork-join job and the group waiting for it
+    struct Job {
+        Task fn;
+        TaskGroup* group;
+    };
+
     vector<thread> workers;  // Vector to hold worker threads
-    queue<pair<int, function<void()>>> tasks;  // Task queue with graphId and task function
-    unordered_map<int, bool> graphLocks;  // Track which graph is locked by which thread
-    mutex queueMutex;  // Mutex to ensure thread-safe access to the task queue
-    condition_variable condition;  // Condition variable to notify worker threads of new tasks
+    unordered_map<int, Strand> strands;  // Every strand that ever had a task, by strandId
+    RingQueue<int> readyStrands[numClasses];  // Strands waiting for a thread by the class of their next task
+    size_t credits[numClasses];  // Strands each class may still start in the current round robin round
+    size_t heavyLimit;  // Most HEAVY tasks running at once
+    size_t runningHeavy;  // HEAVY tasks running now
+    mutex queueMutex;  // Mutex to ensure thread-safe access to the strands
+    condition_variable condition;  // Condition variable to wake followers
     atomic<bool> stopFlag;  // Flag to indicate whether the thread pool should stop
+    EventWaiter waitEvent;  // Event source of the leader, empty for a plain task pool
+    EventHandler handleEvent;  // Event processing callback
+    bool leaderActive;  // True while a thread is waiting on the event source
+    QueueGauge queueGauges[numClasses];  // Strand tasks waiting per class
+
+    vector<unique_ptr<WorkStealingDeque<Job*>>> deques;  // One deque per worker, only its owner pushes
+    queue<Job*> injectedJobs;  // Jobs forked by threads outside the pool, guarded by injectMutex
+    mutex injectMutex;
+    atomic<size_t> queuedJobs;  // Jobs sitting in any deque or in injectedJobs
+    atomic<size_t> sleepingWorkers;  // Workers waiting on the condition variable
 
     /**
-     * Worker thread function that processes tasks from the task queue.
+     * Worker thread function: runs jobs, then ready strands, or becomes the leader when there is none.
      */
-    void worker();
+    void worker(size_t index);
+
+    /**
+     * Returns true if a ready strand may start now. Called with queueMutex held.
+     */
+    bool hasRunnableStrand() const;
+
+    /**
+     * Takes the next ready strand by weighted round robin over the classes. Called with queueMutex held.
+     * @return false if no strand may start now.
+     */
+    bool takeReadyStrand(int& strandId, TaskClass& taskClass);
+
+    /**
+     * Runs the oldest task of a strand and reschedules the strand if it has more work.
+     * @param strandId - The strand to run.
+     * @param taskClass - Class of the task, as taken from the ready queue.
+     */
+    void runStrand(int strandId, TaskClass taskClass);
+
+    /**
+     * Queues a fork-join job: on the caller's deque for pool threads, in injectedJobs otherwise.
+     */
+    void submitJob(Job* job);
+
+    /**
+     * Takes a job from the caller's own deque, another worker's deque or injectedJobs.
+     * @return nullptr if no job was found.
+     */
+    Job* findJob();
+
+    /**
+     * Runs a job and signals its group.
+     */
+    void executeJob(Job* job);
 };
 
+/**
+ * A set of fork-join jobs submitted to a ThreadPool that can be waited for as a whole.
+ * While jobs are queued, the waiting thread executes them itself, so nested groups cannot deadlock
+ * the pool; once the rest of its jobs are running on other threads it sleeps until the last one
+ * finishes. Jobs must not block on locks held by strand tasks.
+ */
+class TaskGroup {
+public:
+    explicit TaskGroup(ThreadPool& pool) : pool(pool), pending(0) {}
+
+    /**
+     * Waits for the remaining jobs, so no job can outlive the captures it references.
+     */
+    ~TaskGroup() { wait(); }
+
+    TaskGroup(const TaskGroup&) = delete;
+    TaskGroup& operator=(const TaskGroup&) = delete;
+
+    /**
+     * Forks a job into the pool.
+     */
+    void run(Task fn);
+
+    /**
+     * Returns once every job run through this group has finished, helping with queued jobs meanwhile.
+     */
+    void wait();
+
+private:
+    friend class ThreadPool;
+
+    ThreadPool& pool;
+    atomic<size_t> pending;  // Jobs forked but not finished yet, decremented under doneMutex
+    mutex doneMutex;
+    condition_variable done;  // Notified when pending drops to 0
+
+    /**
+     * Counts a finished job and wakes the waiter after the last one.
+     */
+    void finishJob();
+};
+
+template <typename RandomIt, typename Compare>
+void ThreadPool::parallelSort(RandomIt first, RandomIt last, Compare comp, size_t grain) {
+    size_t n = static_cast<size_t>(last - first);
+    if (n <= grain || workers.empty()) {
+        std::sort(first, last, comp);
+        return;
+    }
+    RandomIt mid = first + n / 2;
+    {
+        TaskGroup group(*this);
+        group.run([this, first, mid, comp, grain] { parallelSort(first, mid, comp, grain); }); // Left half may be stolen
+        parallelSort(mid, last, comp, grain);
+        group.wait();
+    }
+    std::inplace_merge(first, mid, last, comp);
+}
+
 #endif // THREADPOOL_H
@@ -0,0 +1,121 @@
+#ifndef TRACER_H
+#define TRACER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+/**
+ * Per-request tracing: a sampled request gets a trace id, and the servers record a span for each
+ * stage it passes, queues included, with the time it entered and left. Spans go into a ring buffer
+ * of the recording thread, so tracing takes no lock and the oldest spans are overwritten once a
+ * buffer is full. writeChromeTrace() exports what the buffers hold as Chrome trace-event JSON, for
+ * chrome://tracing or Perfetto, with every request on its own track.
+ * One request in `every` is traced, so tracing can stay on under load: an untraced request costs
+ * one relaxed load, a traced stage one clock read and a few relaxed stores. Thread-safe.
+ */
+class Tracer {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // The stages a request passes; a span covers the time the request spent in one of them
+    enum Stage {
+        REQUEST,        // From reading the command line to queueing the response
+        PARSE_QUEUE,    // Waiting for a parser replica (pipelineServer)
+        PARSE,          // Normalizing the command line (pipelineServer)
+        STRAND_QUEUE,   // Waiting in the strand and class queues of the pool
+        EXECUTE,        // Running the command on the graph
+        RESPOND_QUEUE,  // Waiting for a response replica (pipelineServer)
+        REORDER,        // Finished, waiting for an earlier response of the connection (pipelineServer)
+        SEND,           // Queueing the response on the connection and writing what the socket takes
+        numStages
+    };
+
+    /**
+     * @param spansPerThread - capacity of each thread's ring buffer, rounded up to a power of two
+     */
+    explicit Tracer(size_t spansPerThread = 8192);
+    ~Tracer();
+
+    Tracer(const Tracer&) = delete;
+    Tracer& operator=(const Tracer&) = delete;
+
+    /**
+     * Traces one request in `every`; 0 turns tracing off. Spans already recorded are kept.
+     */
+    void setSampling(unsigned every) { sampleEvery.store(every, std::memory_order_relaxed); }
+
+    unsigned sampling() const { return sampleEvery.load(std::memory_order_relaxed); }
+
+    /**
+     * Decides whether a new request is traced.
+     * @return The trace id of the request, or 0 if it is not traced.
+     */
+    uint64_t sample() {
+        unsigned every = sampling();
+        if (every == 0) return 0;
+        uint64_t request = requests.fetch_add(1, std::memory_order_relaxed) + 1;
+        return request % every == 0 ? request : 0;
+    }
+
+    /**
+     * Records a span of a traced request on the calling thread. Does nothing for trace id 0.
+     * @param label - static text shown with the span, e.g. the command name, or nullptr
+     */
+    void span(uint64_t id, Stage stage, Clock::time_point start, Clock::time_point end, const char* label = nullptr) {
+        if (id != 0) record(id, stage, start, end, label);
+    }
+
+    /**
+     * Records the span of a stage that began at `since` and ends now, then moves `since` to now, so
+     * consecutive stages take one clock read each. Does nothing for trace id 0.
+     */
+    void lap(uint64_t id, Stage stage, Clock::time_point& since) {
+        if (id == 0) return;
+        Clock::time_point now = Clock::now();
+        record(id, stage, since, now, nullptr);
+        since = now;
+    }
+
+    /**
+     * Writes the spans in the buffers as a Chrome trace-event JSON object. Spans are written as
+     * nestable async events grouped by trace id, timestamps in microseconds since the tracer was
+     * created; each event names the thread that recorded it. Spans overwritten while the buffers
+     * are read are skipped.
+     * @return The number of spans written.
+     */
+    size_t writeChromeTrace(std::ostream& out) const;
+
+    /**
+     * Returns the name of a stage as it appears in the trace, e.g. "strand.queue".
+     */
+    static const char* stageName(Stage stage);
+
+private:
+    struct Buffer;
+    struct BufferLease;
+
+    size_t capacity;  // Spans per buffer, a power of two
+    Clock::time_point origin;
+    std::atomic<unsigned> sampleEvery;
+    std::atomic<uint64_t> requests;  // Requests seen while sampling, for the 1-in-N choice
+    mutable std::mutex buffersMutex;  // Guards the lists below, not the spans in the buffers
+    std::vector<std::unique_ptr<Buffer>> buffers;  // Every buffer ever handed to a thread
+    std::vector<Buffer*> freeBuffers;  // Buffers of threads that exited, reused by new threads
+
+    static thread_local BufferLease lease;  // The calling thread's buffer
+
+    void record(uint64_t id, Stage stage, Clock::time_point start, Clock::time_point end, const char* label);
+
+    /**
+     * Returns the buffer of the calling thread, taking one on its first span.
+     */
+    Buffer& localBuffer();
+};
+
+#endif // TRACER_H
@@ -2,6 +2,8 @@
 #define TREE_H
 
 #include "Graph.hpp"
+#include "ThreadPool.hpp"
+#include "JobControl.hpp"
 #include <vector>
 
 /**
@@ -14,11 +16,13 @@ public:
      * Constructor that initializes a tree with a specified number of nodes and edges.
      * @param n - Number of nodes in the tree.
      * @param edges - A vector of pairs representing edges and their weights.
+     * @param pool - Thread pool used to build the all-pairs index in parallel, or nullptr.
      */
-    Tree(int n, const std::vector<std::pair<std::pair<int, int>, double>>& edges);
+    Tree(int n, const std::vector<std::pair<std::pair<int, int>, double>>& edges, ThreadPool* pool = nullptr);
 
     /**
      * Returns the total weight of the Minimum Spanning Tree (MST).
+     * The sum is computed when the tree is built, and again only if the tree is modified.
      * @return Total MST weight.
      */
     double getMSTWeight() const;
@@ -47,13 +51,32 @@ public:
      */
     std::vector<int> getLongestPath(int u, int v);
 
+    /**
+     * Stores the longest path between two nodes in a caller-provided vector, reusing its capacity.
+     * @param u - First node.
+     * @param v - Second node.
+     * @param path - Vector that receives the nodes of the path from u to v.
+     */
+    void getLongestPath(int u, int v, std::vector<int>& path);
+
     /**
      * Executes the Floyd-Warshall algorithm to find all pairs shortest paths.
+     * @param control - checked for cancellation once per round, or nullptr
      * @return A pair of matrices:
      *         - First matrix is the distances between each pair of nodes.
      *         - Second matrix holds the next node in the path for reconstructing the path.
+     *         Both are empty if the computation was cancelled.
      */
-    std::pair<std::vector<std::vector<double>>, std::vector<std::vector<int>>> floydWarshall();
+    std::pair<std::vector<std::vector<double>>, std::vector<std::vector<int>>> floydWarshall(JobControl* control = nullptr);
+
+    /**
+     * Returns the Floyd-Warshall matrices, running the algorithm only if the tree changed
+     * since the last call.
+     * @param control - checked for cancellation while the matrices are computed, or nullptr
+     * @return The same pair as floydWarshall(), owned by the tree. Empty if the computation was
+     *         cancelled, in which case the next call starts over.
+     */
+    const std::pair<std::vector<std::vector<double>>, std::vector<std::vector<int>>>& allPairs(JobControl* control = nullptr);
 
     /**
      * Reconstructs the path between two nodes based on the Floyd-Warshall results.
@@ -64,8 +87,20 @@ public:
      */
     void reconstructPath(int u, int v, const std::vector<std::vector<int>>& next, std::vector<int>& path);
 
+    /**
+     * Returns an estimate of the bytes the tree occupies, as Graph::memoryUsage(), including the
+     * all-pairs index once it was computed.
+     */
+    size_t memoryUsage() const;
+
 private:
     std::vector<int> longestPath;  // Stores the longest path between two nodes.
+    std::vector<int> searchPath;  // DFS stack of longestDistance(), kept to reuse its capacity
+    ThreadPool* pool;  // Pool for the parallel Floyd-Warshall rows, may be nullptr
+    mutable double cachedWeight;  // Total weight, valid while weightVersion matches getVersion()
+    mutable uint64_t weightVersion;
+    std::pair<std::vector<std::vector<double>>, std::vector<std::vector<int>>> pairsCache;  // Result of allPairs()
+    uint64_t pairsVersion;  // Version of the tree pairsCache was computed for
 
     /**
      * Depth-first search (DFS) helper function to find the longest path between two nodes.
@@ -0,0 +1,73 @@
+#ifndef VERTEX_IDS_H
+#define VERTEX_IDS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+/**
+ * Translates between the vertex ids a client uses, any 64-bit numbers, and the vertices 1..n of a
+ * Graph. Built once when a graph is loaded and never modified afterwards, so the graph and the trees
+ * computed from it share it across threads. Ids are looked up in an open-addressing hash table (see
+ * LinearProbing); vertices are translated back through an array.
+ */
+class VertexIds {
+public:
+    /**
+     * Numbers the vertices of a graph loaded with NewGraph and rewrites its edges on them. If every id
+     * is between 1 and n, the ids are the vertices and nothing is built; otherwise every distinct id
+     * becomes the next vertex in the order it first appears, and the graph has exactly these vertices.
+     * The two cases differ for isolated vertices: with ids 1..n the graph keeps all n vertices, those
+     * no edge names included, while renumbered ids only know the vertices that appear in an edge, so
+     * the graph has size() vertices instead of n. NewGraph says so in its reply.
+     * @param n - number of vertices the client announced
+     * @param edges - the edges on client ids
+     * @param dense - receives the edges on vertices, in the same order
+     * @return The translation, or nullptr if the ids are the vertices.
+     */
+    static std::shared_ptr<const VertexIds> build(int n, const std::vector<std::pair<std::pair<uint64_t, uint64_t>, double>>& edges,
+                                                  std::vector<std::pair<std::pair<int, int>, double>>& dense);
+
+    /**
+     * Reads a vertex id after any spaces and moves `text` past it. Ids are unsigned decimal numbers;
+     * a sign is rejected, so "-1" does not wrap around to the largest id.
+     * @return false if no id could be read.
+     */
+    static bool parse(const char*& text, uint64_t& id);
+
+    /**
+     * Returns the vertex of a client id, or 0 if no vertex has that id.
+     */
+    int find(uint64_t id) const;
+
+    /// @brief Returns the client id of vertex v, 1 <= v <= size().
+    uint64_t id(int v) const { return ids[v]; }
+
+    /// @brief Returns the number of vertices.
+    int size() const { return static_cast<int>(ids.size()) - 1; }
+
+    /// @brief Returns the bytes of the table and the array.
+    size_t memoryUsage() const { return table.capacity() * sizeof(Entry) + ids.capacity() * sizeof(uint64_t); }
+
+private:
+    struct Entry {
+        uint64_t key;  // Client id
+        int vertex;    // Vertex of the id, 0 when the entry is unused
+    };
+
+    std::vector<Entry> table;   // Power-of-two sized probe table, at most half full
+    std::vector<uint64_t> ids;  // Client id of each vertex; ids[0] is unused
+
+    VertexIds();
+
+    static bool isEmpty(const Entry& entry) { return entry.vertex == 0; }
+
+    /**
+     * Returns the vertex of `id`, numbering it first if it is new.
+     */
+    int insert(uint64_t id);
+};
+
+#endif // VERTEX_IDS_H
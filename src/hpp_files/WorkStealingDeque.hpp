@@ -0,0 +1,119 @@
+#ifndef WORK_STEALING_DEQUE_H
+#define WORK_STEALING_DEQUE_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+/**
+ * Chase-Lev work-stealing deque (Le, Pop, Cohen, Zappa Nardelli, PPoPP 2013).
+ * The owning thread pushes and pops at the bottom without locks; any other thread may steal
+ * from the top with a single CAS. The buffer grows on demand; retired buffers are kept until the
+ * deque is destroyed because a concurrent thief may still be reading them.
+ * T must be trivially copyable (the pool stores job pointers).
+ */
+template <typename T>
+class WorkStealingDeque {
+public:
+    explicit WorkStealingDeque(int64_t capacity = 256) : top(0), bottom(0) {
+        buffers.push_back(std::make_unique<Buffer>(capacity));
+        buffer.store(buffers.back().get(), std::memory_order_relaxed);
+    }
+
+    WorkStealingDeque(const WorkStealingDeque&) = delete;
+    WorkStealingDeque& operator=(const WorkStealingDeque&) = delete;
+
+    /**
+     * Pushes an item at the bottom. Owner thread only.
+     */
+    void push(T item) {
+        int64_t b = bottom.load(std::memory_order_relaxed);
+        int64_t t = top.load(std::memory_order_acquire);
+        Buffer* buf = buffer.load(std::memory_order_relaxed);
+        if (b - t > buf->capacity - 1) {
+            buf = grow(buf, t, b); // Full: double the buffer
+        }
+        buf->put(b, item);
+        std::atomic_thread_fence(std::memory_order_release);
+        bottom.store(b + 1, std::memory_order_relaxed);
+    }
+
+    /**
+     * Pops the most recently pushed item. Owner thread only.
+     * @return false if the deque is empty or a thief took the last item.
+     */
+    bool pop(T& item) {
+        int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+        Buffer* buf = buffer.load(std::memory_order_relaxed);
+        bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t t = top.load(std::memory_order_relaxed);
+        if (t > b) {
+            bottom.store(b + 1, std::memory_order_relaxed); // Empty
+            return false;
+        }
+        item = buf->get(b);
+        if (t == b) {
+            // Last item: race against thieves for it
+            bool won = top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+            bottom.store(b + 1, std::memory_order_relaxed);
+            return won;
+        }
+        return true;
+    }
+
+    /**
+     * Steals the oldest item. Safe from any thread.
+     * @return false if the deque is empty or another thread won the race.
+     */
+    bool steal(T& item) {
+        int64_t t = top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t b = bottom.load(std::memory_order_acquire);
+        if (t >= b) return false;
+        Buffer* buf = buffer.load(std::memory_order_acquire);
+        T stolen = buf->get(t);
+        if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+            return false;
+        }
+        item = stolen;
+        return true;
+    }
+
+    /**
+     * Returns true if the deque looked empty at the time of the call.
+     */
+    bool empty() const {
+        return bottom.load(std::memory_order_relaxed) <= top.load(std::memory_order_relaxed);
+    }
+
+private:
+    // Circular array indexed by the ever-growing top/bottom counters
+    struct Buffer {
+        int64_t capacity;
+        std::unique_ptr<std::atomic<T>[]> slots;
+
+        explicit Buffer(int64_t capacity) : capacity(capacity), slots(new std::atomic<T>[capacity]) {}
+
+        T get(int64_t i) const { return slots[i & (capacity - 1)].load(std::memory_order_relaxed); }
+        void put(int64_t i, T item) { slots[i & (capacity - 1)].store(item, std::memory_order_relaxed); }
+    };
+
+    alignas(64) std::atomic<int64_t> top;     // Next item to steal
+    alignas(64) std::atomic<int64_t> bottom;  // Next free slot of the owner
+    std::atomic<Buffer*> buffer;              // Current buffer
+    std::vector<std::unique_ptr<Buffer>> buffers;  // All buffers ever allocated, owned by the deque
+
+    Buffer* grow(Buffer* old, int64_t t, int64_t b) {
+        buffers.push_back(std::make_unique<Buffer>(old->capacity * 2));
+        Buffer* bigger = buffers.back().get();
+        for (int64_t i = t; i < b; ++i) {
+            bigger->put(i, old->get(i));
+        }
+        buffer.store(bigger, std::memory_order_release);
+        return bigger;
+    }
+};
+
+#endif // WORK_STEALING_DEQUE_H